@@ -0,0 +1,39 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _COMPRESSION_SINK
+#define _COMPRESSION_SINK
+
+#include <cstddef>
+
+//Receives the output of a CompressionStrategy as it is produced
+class CompressionSink
+{
+	public:
+		virtual ~CompressionSink();
+		
+		//Accepts the next piece of output. The bytes belong to the compression strategy, but may be modified in place
+		//(such as by encrypting them) until the call returns.
+		virtual void Write(char* output, size_t length) = 0;
+};
+
+#endif
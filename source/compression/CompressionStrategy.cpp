@@ -21,5 +21,55 @@
 //  SOFTWARE.
 */
 #include "CompressionStrategy.h"
+#include "../utility/AlignedBufferPool.h"
+#include "../utility/MemoryBudget.h"
 
-CompressionStrategy::~CompressionStrategy() {}
+//Pieces smaller than this would make the per-piece overheads significant
+#define MIN_PIECE_SIZE (4*1024)
+
+namespace
+{
+	//Collects the output of a transformation into a string
+	class StringSink : public CompressionSink
+	{
+		public:
+			StringSink(string& output) : output(output) {}
+			
+			void Write(char* piece, size_t length)
+			{
+				output.append(piece, length);
+			}
+			
+		private:
+			string& output;
+	};
+}
+
+CompressionStrategy::CompressionStrategy()
+{
+	piece     = NULL;
+	pieceSize = 0;
+}
+
+CompressionStrategy::~CompressionStrategy()
+{
+	AlignedBufferPool::Release(piece, pieceSize);
+	MemoryBudget::Release(pieceSize);
+}
+
+void CompressionStrategy::AllocatePiece()
+{
+	if (piece == NULL)
+	{
+		pieceSize = MemoryBudget::Reserve(PieceSize, MIN_PIECE_SIZE);
+		piece = AlignedBufferPool::Acquire(pieceSize);
+	}
+}
+
+string CompressionStrategy::TransformInput(const char* input, size_t length, bool isFinalInput)
+{
+	string output = "";
+	StringSink sink(output);
+	this->TransformInput(input, length, isFinalInput, sink);
+	return output;
+}
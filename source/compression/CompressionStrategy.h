@@ -23,15 +23,37 @@
 #ifndef _COMPRESSION_STRATEGY
 #define _COMPRESSION_STRATEGY
 
+#include "CompressionSink.h"
+
 #include <string>
 using std::string;
 
 class CompressionStrategy
 {
 	public:
+		CompressionStrategy();
 		virtual ~CompressionStrategy();
 		
-		virtual string TransformInput(char* input, size_t length, bool isFinalInput) = 0;
+		//Transforms the input, collecting all of the output (only suitable when the output is known to be small)
+		string TransformInput(const char* input, size_t length, bool isFinalInput);
+		
+		//Transforms the input, passing the output to the sink in pieces as it is produced, so that the memory used
+		//doesn't depend on how much output there is (decompressing a small input can produce a huge output)
+		virtual void TransformInput(const char* input, size_t length, bool isFinalInput, CompressionSink& sink) = 0;
+		
+		//The preferred size of each piece of output (under a memory limit, pieces may be smaller)
+		static const size_t PieceSize = 256*1024;
+		
+	protected:
+		//The buffer that each piece of output is produced in, which is allocated from the memory budget on first use
+		char*  piece;
+		size_t pieceSize;
+		void AllocatePiece();
+		
+	private:
+		//Strategies own their piece buffer, so they can't be copied
+		CompressionStrategy(const CompressionStrategy&);
+		CompressionStrategy& operator=(const CompressionStrategy&);
 };
 
 #endif
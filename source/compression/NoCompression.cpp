@@ -22,12 +22,17 @@
 */
 #include "NoCompression.h"
 
-string NoCompression::TransformInput(char* input, size_t length, bool isFinalInput)
+#include <algorithm>
+#include <cstring>
+
+void NoCompression::TransformInput(const char* input, size_t length, bool isFinalInput, CompressionSink& sink)
 {
-	//Create a string and populate it with the input data
-	string output;
-	output.assign(input, length);
-	
-	//Return the string containing the input data
-	return output;
+	//Pass the input through a piece at a time, since the sink may modify it
+	this->AllocatePiece();
+	for (size_t offset = 0; offset < length; offset += pieceSize)
+	{
+		size_t count = std::min(pieceSize, length - offset);
+		memcpy(piece, input + offset, count);
+		sink.Write(piece, count);
+	}
 }
@@ -28,7 +28,7 @@
 class NoCompression : public CompressionStrategy
 {
 	public:
-		string TransformInput(char* input, size_t length, bool isFinalInput);
+		void TransformInput(const char* input, size_t length, bool isFinalInput, CompressionSink& sink);
 };
 
 #endif
@@ -21,8 +21,19 @@
 //  SOFTWARE.
 */
 #include "ZlibCompression.h"
+#include "../utility/MemoryBudget.h"
 
-string ZlibCompression::TransformInput(char* input, size_t length, bool isFinalInput)
+ZlibCompression::ZlibCompression()
+{
+	stateSize = 0;
+}
+
+ZlibCompression::~ZlibCompression()
+{
+	MemoryBudget::Release(stateSize);
+}
+
+void ZlibCompression::TransformInput(const char* input, size_t length, bool isFinalInput, CompressionSink& sink)
 {
 	//Accept the input
 	strm.next_in  = (Bytef*)input;
@@ -31,31 +42,22 @@ string ZlibCompression::TransformInput(char* input, size_t length, bool isFinalI
 	//Use no flush mode, until we reach the last of the input
 	int flush = (isFinalInput) ? Z_FINISH : Z_NO_FLUSH;
 	
-	//Create a string to hold all of the produced output
-	string output;
-	
-	//Create a buffer to hold each round of output
-	char* outputBuffer = new char[length];
-	
-	int count = 0;
+	//Each round of output is passed on as soon as it is produced, so however much the input expands, only one piece is held at a time
+	this->AllocatePiece();
 	do
 	{
-		//Point the stream to the output buffer
-		strm.avail_out = length;
-		strm.next_out  = (Bytef*)outputBuffer;
+		//Point the stream to the piece buffer
+		strm.avail_out = pieceSize;
+		strm.next_out  = (Bytef*)piece;
 		
 		//Perform the transformation
 		PerformTransform(strm, flush);
 		
-		//If any bytes were produced, add them to the output string
-		count = length - strm.avail_out;
+		//If any bytes were produced, pass them on
+		size_t count = pieceSize - strm.avail_out;
 		if (count) {
-			output.append(outputBuffer, count);
+			sink.Write(piece, count);
 		}
 		
 	} while (strm.avail_out == 0);
-	
-	//Free memory and return the output
-	delete[] outputBuffer;
-	return output;
 }
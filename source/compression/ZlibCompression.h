@@ -30,11 +30,17 @@
 class ZlibCompression : public CompressionStrategy
 {
 	public:
-		string TransformInput(char* input, size_t length, bool isFinalInput);
+		ZlibCompression();
+		~ZlibCompression();
+		
+		void TransformInput(const char* input, size_t length, bool isFinalInput, CompressionSink& sink);
 		
 	protected:
 		virtual void PerformTransform(z_stream& strm, int flush) = 0;
 		z_stream strm;
+		
+		//The memory reserved for zlib's internal state, which is returned to the budget on destruction
+		size_t stateSize;
 };
 
 #endif
@@ -21,10 +21,12 @@
 //  SOFTWARE.
 */
 #include "ZlibCompressor.h"
+#include "../utility/MemoryBudget.h"
 
 ZlibCompressor::ZlibCompressor()
 {
-	//Allocate deflate state
+	//Allocate deflate state, accounting for it in the memory budget
+	stateSize = MemoryBudget::Reserve(StateSize, StateSize);
 	strm.zalloc = Z_NULL;
 	strm.zfree  = Z_NULL;
 	strm.opaque = Z_NULL;
@@ -31,6 +31,9 @@ class ZlibCompressor : public ZlibCompression
 		ZlibCompressor();
 		~ZlibCompressor();
 		
+		//The memory used by deflate with the default window size and memory level (from the formula in zconf.h)
+		static const size_t StateSize = (1 << 17) + (1 << 17) + 6*1024;
+		
 	private:
 		void PerformTransform(z_stream& strm, int flush);
 };
@@ -21,10 +21,12 @@
 //  SOFTWARE.
 */
 #include "ZlibDecompressor.h"
+#include "../utility/MemoryBudget.h"
 
 ZlibDecompressor::ZlibDecompressor()
 {
-	//Allocate inflate state
+	//Allocate inflate state, accounting for it in the memory budget
+	stateSize = MemoryBudget::Reserve(StateSize, StateSize);
 	strm.zalloc = Z_NULL;
 	strm.zfree  = Z_NULL;
 	strm.opaque = Z_NULL;
@@ -31,6 +31,9 @@ class ZlibDecompressor : public ZlibCompression
 		ZlibDecompressor();
 		~ZlibDecompressor();
 		
+		//The memory used by inflate with the default window size (from the formula in zconf.h)
+		static const size_t StateSize = (1 << 15) + 7*1024;
+		
 	private:
 		void PerformTransform(z_stream& strm, int flush);
 };
@@ -0,0 +1,129 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#include "EFCBinaryHeader.h"
+#include "EFCHeaderFactory.h"
+
+#include <simple-base/base.h>
+#include <zlib.h>
+
+//Upper bound on the length of the header, so a corrupt header cannot trigger a huge allocation
+#define MAX_HEADER_LENGTH (64*1024*1024)
+
+EFCBinaryHeader::EFCBinaryHeader() {}
+
+EFCBinaryHeader::EFCBinaryHeader(MeteredIfstream& inputFile)
+{
+	this->valid = false;
+	
+	//The magic bytes have already been read, and the total length tells us how much of the rest to read
+	char magicBytes[4] = { 'E', 'F', 'C', (char)EFCHeaderVersion::Binary };
+	uint32_t headerLength = 0;
+	if (inputFile.ReadLittleEndian((char*)&headerLength, sizeof(headerLength)) != sizeof(headerLength) || headerLength < MinimumLength || headerLength > MAX_HEADER_LENGTH) {
+		return;
+	}
+	
+	//Read the whole header in one go, so that the checksum can be verified before anything is interpreted
+	string header(magicBytes, sizeof(magicBytes));
+	AppendLittleEndian(header, (char*)&headerLength, sizeof(headerLength));
+	header.resize(headerLength);
+	
+	size_t remaining = headerLength - sizeof(magicBytes) - sizeof(headerLength);
+	if (inputFile.read(&header[sizeof(magicBytes) + sizeof(headerLength)], remaining) != remaining) {
+		return;
+	}
+	
+	//The obfuscated magic bytes are accepted too, so the checksum is computed over the ones we expect
+	size_t offset = headerLength - sizeof(uint32_t);
+	uint32_t storedChecksum = 0;
+	ExtractLittleEndian(header, offset, (char*)&storedChecksum, sizeof(storedChecksum));
+	if (storedChecksum != crc32(0L, (const Bytef*)header.data(), headerLength - sizeof(uint32_t))) {
+		return;
+	}
+	
+	//Extract the fixed-width fields
+	uint8_t  cipherID        = 0;
+	uint8_t  compressionID   = 0;
+	uint16_t extensionLength = 0;
+	uint32_t fieldsLength    = 0;
+	offset = sizeof(magicBytes) + sizeof(headerLength);
+	ExtractLittleEndian(header, offset, (char*)&this->payloadSize, sizeof(this->payloadSize));
+	ExtractLittleEndian(header, offset, (char*)&cipherID,          sizeof(cipherID));
+	ExtractLittleEndian(header, offset, (char*)&compressionID,     sizeof(compressionID));
+	ExtractLittleEndian(header, offset, (char*)&extensionLength,   sizeof(extensionLength));
+	ExtractLittleEndian(header, offset, (char*)&fieldsLength,      sizeof(fieldsLength));
+	
+	//The variable-length parts must exactly fill the space before the checksum
+	if ((uint64_t)MinimumLength + extensionLength + fieldsLength != headerLength) {
+		return;
+	}
+	
+	string extension = this->ObfuscateText(header.substr(offset, extensionLength));
+	offset += extensionLength;
+	
+	//The algorithm IDs are stored directly, so unrecognised ones are reported as unsupported by the factories
+	this->cipher      = cipherID;
+	this->compression = compressionID;
+	
+	this->valid = (this->payloadSize >= 0 && this->ParseFields(header.substr(offset, fieldsLength)));
+	
+	//Replace the input file's extension with the original one to get the filename (the first volume of a split container has the volume number appended)
+	string containerName = basename(inputFile.GetFileName());
+	if (this->IsSplit() && containerName.rfind('.') != string::npos) {
+		containerName = containerName.substr(0, containerName.rfind('.'));
+	}
+	
+	this->filename = replace_extension(containerName, extension);
+}
+
+void EFCBinaryHeader::WriteHeader(MeteredOfstream& outputFile)
+{
+	string header = this->Serialise();
+	outputFile.write(header.data(), header.length());
+}
+
+string EFCBinaryHeader::Serialise()
+{
+	string extension = this->ObfuscateText(get_extension(this->filename));
+	string fields    = this->SerialiseFields();
+	
+	uint8_t  cipherID        = this->cipher;
+	uint8_t  compressionID   = this->compression;
+	uint16_t extensionLength = extension.length();
+	uint32_t fieldsLength    = fields.length();
+	uint32_t headerLength    = MinimumLength + extensionLength + fieldsLength;
+	
+	//Build the whole header in memory, so that it can be checksummed and written in one go
+	string header = string("EFC") + (char)EFCHeaderVersion::Binary;
+	AppendLittleEndian(header, (char*)&headerLength,      sizeof(headerLength));
+	AppendLittleEndian(header, (char*)&this->payloadSize, sizeof(this->payloadSize));
+	AppendLittleEndian(header, (char*)&cipherID,          sizeof(cipherID));
+	AppendLittleEndian(header, (char*)&compressionID,     sizeof(compressionID));
+	AppendLittleEndian(header, (char*)&extensionLength,   sizeof(extensionLength));
+	AppendLittleEndian(header, (char*)&fieldsLength,      sizeof(fieldsLength));
+	header += extension.substr(0, extensionLength);
+	header += fields;
+	
+	uint32_t checksum = crc32(0L, (const Bytef*)header.data(), header.length());
+	AppendLittleEndian(header, (char*)&checksum, sizeof(checksum));
+	return header;
+}
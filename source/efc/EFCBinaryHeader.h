@@ -0,0 +1,55 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _EFC_BINARY_HEADER
+#define _EFC_BINARY_HEADER
+
+#include "EFCHeader.h"
+
+//Version 2 of the header stores the same information as version 1 in a fixed binary layout, so that it can be read in a
+//single bounded read and validated in place. All integers are little endian:
+//
+//  char[4]  magic bytes ("EFC" followed by the version)
+//  uint32   total length of the header, including the magic bytes and the checksum
+//  int64    payload size
+//  uint8    cipher (EncryptionType::[...])
+//  uint8    compression (CompressionType::[...])
+//  uint16   length of the file extension
+//  uint32   length of the optional fields
+//  char[]   the obfuscated file extension
+//  char[]   the optional fields, as produced by EFCHeader::SerialiseFields()
+//  uint32   CRC-32 of everything before it
+class EFCBinaryHeader : public EFCHeader
+{
+	public:
+		EFCBinaryHeader();
+		EFCBinaryHeader(MeteredIfstream& inputFile);
+		void WriteHeader(MeteredOfstream& outputFile);
+		
+		//Builds the header in memory, exactly as WriteHeader() writes it
+		string Serialise();
+		
+		//The length of the header when it has no extension or optional fields
+		static const uint32_t MinimumLength = 28;
+};
+
+#endif
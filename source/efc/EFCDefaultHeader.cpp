@@ -39,7 +39,9 @@ EFCDefaultHeader::EFCDefaultHeader(MeteredIfstream& inputFile)
 	EFCDefaultHeader();
 	
 	//Read the "filesize" field (will include header length, which we need to remove)
-	inputFile.ReadLittleEndian((char*)&this->payloadSize, sizeof(this->payloadSize));
+	int32_t filesize = 0;
+	inputFile.ReadLittleEndian((char*)&filesize, sizeof(filesize));
+	this->payloadSize = filesize;
 	
 	//Read the file extension (we need to replace the input file's extension with it to get the filename)
 	string extension = "";
@@ -82,8 +84,9 @@ void EFCDefaultHeader::WriteHeader(MeteredOfstream& outputFile)
 	this->payloadSize += cipherName.length() + 1;
 	this->payloadSize += sizeof(compressionUsed);
 	
-	//Write the "filesize" field
-	outputFile.WriteLittleEndian((char*)&this->payloadSize, sizeof(this->payloadSize));
+	//Write the "filesize" field (the default header only has room for 32 bits)
+	int32_t filesize = this->payloadSize;
+	outputFile.WriteLittleEndian((char*)&filesize, sizeof(filesize));
 	
 	//Write the extension
 	outputFile.write(extension.c_str(), extension.length() + 1);
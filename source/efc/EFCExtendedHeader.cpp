@@ -0,0 +1,97 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#include "EFCExtendedHeader.h"
+#include "EFCHeaderFactory.h"
+
+#include <simple-base/base.h>
+
+//Upper bound on the length of the optional fields, so a corrupt header cannot trigger a huge allocation
+#define MAX_FIELDS_LENGTH (64*1024*1024)
+
+EFCExtendedHeader::EFCExtendedHeader() {}
+
+EFCExtendedHeader::EFCExtendedHeader(MeteredIfstream& inputFile)
+{
+	//Read the payload size (unlike the default header, this does not include the header length)
+	inputFile.ReadLittleEndian((char*)&this->payloadSize, sizeof(this->payloadSize));
+	
+	//Read the file extension (we need to replace the input file's extension with it to get the filename)
+	string extension = "";
+	inputFile.getline(extension, '\0');
+	this->filename = replace_extension(basename(inputFile.GetFileName()), this->ObfuscateText(extension));
+	
+	//Read the "cipher" field, and transform it into a valid EncryptionType member
+	string cipherName = "";
+	inputFile.getline(cipherName, '\0');
+	this->cipher = (this->ObfuscateText(cipherName) == "AES_256_CFB") ? EncryptionType::AES_256_CFB : EncryptionType::None;
+	
+	//Read whether or not compression is being used
+	bool useCompression = false;
+	inputFile.read((char*)&(useCompression), sizeof(useCompression));
+	this->compression = (useCompression) ? CompressionType::Zlib : CompressionType::None;
+	
+	//Read the length of the optional fields, followed by the fields themselves
+	uint32_t fieldsLength = 0;
+	if (inputFile.ReadLittleEndian((char*)&fieldsLength, sizeof(fieldsLength)) != sizeof(fieldsLength) || fieldsLength > MAX_FIELDS_LENGTH)
+	{
+		this->valid = false;
+		return;
+	}
+	
+	string fields(fieldsLength, '\0');
+	if (fieldsLength > 0 && inputFile.read(const_cast<char*>(fields.data()), fieldsLength) != fieldsLength)
+	{
+		this->valid = false;
+		return;
+	}
+	
+	this->valid = (this->payloadSize >= 0 && this->ParseFields(fields));
+}
+
+void EFCExtendedHeader::WriteHeader(MeteredOfstream& outputFile)
+{
+	//Write the magic bytes
+	char magicBytes[4] = { 'E', 'F', 'C', (char)EFCHeaderVersion::Extended };
+	outputFile.write(magicBytes, sizeof(magicBytes));
+	
+	//Write the payload size
+	outputFile.WriteLittleEndian((char*)&this->payloadSize, sizeof(this->payloadSize));
+	
+	//Retrieve the file extension from the filename, and obfuscate it
+	string extension = this->ObfuscateText(get_extension(this->filename));
+	outputFile.write(extension.c_str(), extension.length() + 1);
+	
+	//Generate the cipher name from the EncryptionType member, and obfuscate it
+	string cipherName = this->ObfuscateText((this->cipher == EncryptionType::AES_256_CFB) ? "AES_256_CFB" : "");
+	outputFile.write(cipherName.c_str(), cipherName.length() + 1);
+	
+	//Write the compression flag
+	bool compressionUsed = (this->compression == CompressionType::Zlib);
+	outputFile.write((char*)&compressionUsed, sizeof(compressionUsed));
+	
+	//Write the optional fields, prefixed by their total length
+	string fields = this->SerialiseFields();
+	uint32_t fieldsLength = fields.length();
+	outputFile.WriteLittleEndian((char*)&fieldsLength, sizeof(fieldsLength));
+	outputFile.write(fields.data(), fields.length());
+}
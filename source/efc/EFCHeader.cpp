@@ -22,6 +22,72 @@
 */
 #include "EFCHeader.h"
 
+//Needed for endianness detection
+#include <simple-base/base.h>
+
+EFCHeader::EFCHeader()
+{
+	this->compression = CompressionType::None;
+	this->cipher      = EncryptionType::None;
+	this->filename    = "";
+	this->payloadSize = 0;
+	
+	this->checksumType       = ChecksumType::SHA1;
+	this->checksumChunkSize  = 0;
+	this->checksumChunkCount = 0;
+	this->plaintextSize      = 0;
+	this->chunkSize          = 0;
+	this->volumeSize         = 0;
+	this->volumeCount        = 0;
+	this->displacedOffset    = 0;
+	this->displacedLength    = 0;
+	this->displacedTo        = 0;
+	this->streaming          = false;
+	
+	this->valid = true;
+}
+
+EFCHeader::~EFCHeader() {}
+
+bool EFCHeader::IsValid()
+{
+	return this->valid;
+}
+
+bool EFCHeader::UsesEnvelope()
+{
+	return (this->wrappedKeys.size() > 0);
+}
+
+bool EFCHeader::IsSparse()
+{
+	return !this->sparseMap.IsEmpty();
+}
+
+bool EFCHeader::IsSplit()
+{
+	return (this->volumeSize > 0);
+}
+
+bool EFCHeader::IsDisplaced()
+{
+	return (this->displacedLength > 0);
+}
+
+SparseMap EFCHeader::DisplacedExtents()
+{
+	//The start of the container, the displaced bytes from the end of the file, then the rest of the container up to them
+	SparseMap extents;
+	extents.fileSize = this->displacedTo + this->displacedLength;
+	extents.offsets.push_back(0);
+	extents.lengths.push_back(this->displacedOffset);
+	extents.offsets.push_back(this->displacedTo);
+	extents.lengths.push_back(this->displacedLength);
+	extents.offsets.push_back(this->displacedLength);
+	extents.lengths.push_back(this->displacedTo - this->displacedOffset);
+	return extents;
+}
+
 string EFCHeader::ObfuscateText(string s)
 {
 	//Since we are passing by value, we can manipulate the copy directly
@@ -51,3 +117,291 @@ unsigned char EFCHeader::ObfuscateByte(unsigned char theByte)
 	//Return the result
 	return (unsigned char)tempVal;
 }
+
+string EFCHeader::SerialiseFields()
+{
+	string fields = "";
+	
+	//Tree checksums need the chunk size and count to interpret the checksum stored at the start of the payload
+	if (this->checksumType == ChecksumType::Tree)
+	{
+		uint16_t tag    = EFCHeaderField::TreeChecksum;
+		uint32_t length = sizeof(this->checksumChunkSize) + sizeof(this->checksumChunkCount);
+		AppendLittleEndian(fields, (char*)&tag,    sizeof(tag));
+		AppendLittleEndian(fields, (char*)&length, sizeof(length));
+		AppendLittleEndian(fields, (char*)&this->checksumChunkSize,  sizeof(this->checksumChunkSize));
+		AppendLittleEndian(fields, (char*)&this->checksumChunkCount, sizeof(this->checksumChunkCount));
+	}
+	
+	//Passwords need the salt and cost parameters to derive the key again
+	if (this->kdf.algorithm != KeyDerivationType::SHA256)
+	{
+		uint16_t tag       = EFCHeaderField::KeyDerivation;
+		uint8_t  algorithm = this->kdf.algorithm;
+		uint32_t length    = sizeof(algorithm) + sizeof(this->kdf.costExponent) + sizeof(this->kdf.blockSize) + sizeof(this->kdf.lanes) + this->kdf.salt.length();
+		AppendLittleEndian(fields, (char*)&tag,    sizeof(tag));
+		AppendLittleEndian(fields, (char*)&length, sizeof(length));
+		AppendLittleEndian(fields, (char*)&algorithm, sizeof(algorithm));
+		AppendLittleEndian(fields, (char*)&this->kdf.costExponent, sizeof(this->kdf.costExponent));
+		AppendLittleEndian(fields, (char*)&this->kdf.blockSize,    sizeof(this->kdf.blockSize));
+		AppendLittleEndian(fields, (char*)&this->kdf.lanes,        sizeof(this->kdf.lanes));
+		fields += this->kdf.salt;
+	}
+	
+	//Each wrapped copy of the data key is stored as a separate field
+	for (size_t i = 0; i < this->wrappedKeys.size(); ++i)
+	{
+		uint16_t tag    = EFCHeaderField::WrappedKey;
+		uint32_t length = this->wrappedKeys[i].length();
+		AppendLittleEndian(fields, (char*)&tag,    sizeof(tag));
+		AppendLittleEndian(fields, (char*)&length, sizeof(length));
+		fields += this->wrappedKeys[i];
+	}
+	
+	//Sparse files need the extent map to put the data back in the right places
+	if (this->IsSparse())
+	{
+		string extents  = this->sparseMap.Serialise();
+		uint16_t tag    = EFCHeaderField::SparseExtents;
+		uint32_t length = extents.length();
+		AppendLittleEndian(fields, (char*)&tag,    sizeof(tag));
+		AppendLittleEndian(fields, (char*)&length, sizeof(length));
+		fields += extents;
+	}
+	
+	//The plaintext size lets the decoder allocate the whole output file before writing it
+	if (this->plaintextSize > 0)
+	{
+		uint16_t tag    = EFCHeaderField::PlaintextSize;
+		uint32_t length = sizeof(this->plaintextSize);
+		AppendLittleEndian(fields, (char*)&tag,    sizeof(tag));
+		AppendLittleEndian(fields, (char*)&length, sizeof(length));
+		AppendLittleEndian(fields, (char*)&this->plaintextSize, sizeof(this->plaintextSize));
+	}
+	
+	//The chunk size isn't needed to decode the payload, but records how the encoder read the input
+	if (this->chunkSize > 0)
+	{
+		uint16_t tag    = EFCHeaderField::ChunkSize;
+		uint32_t length = sizeof(this->chunkSize);
+		AppendLittleEndian(fields, (char*)&tag,    sizeof(tag));
+		AppendLittleEndian(fields, (char*)&length, sizeof(length));
+		AppendLittleEndian(fields, (char*)&this->chunkSize, sizeof(this->chunkSize));
+	}
+	
+	//The manifest of a split container is written in the placeholder too, so that filling in the count doesn't change the header's length
+	if (this->IsSplit())
+	{
+		uint16_t tag    = EFCHeaderField::SplitVolumes;
+		uint32_t length = sizeof(this->volumeSize) + sizeof(this->volumeCount);
+		AppendLittleEndian(fields, (char*)&tag,    sizeof(tag));
+		AppendLittleEndian(fields, (char*)&length, sizeof(length));
+		AppendLittleEndian(fields, (char*)&this->volumeSize,  sizeof(this->volumeSize));
+		AppendLittleEndian(fields, (char*)&this->volumeCount, sizeof(this->volumeCount));
+	}
+	
+	//Files encrypted in place need to know where the displaced part of the payload was moved to
+	if (this->IsDisplaced())
+	{
+		uint16_t tag    = EFCHeaderField::Displaced;
+		uint32_t length = sizeof(this->displacedOffset) + sizeof(this->displacedLength) + sizeof(this->displacedTo);
+		AppendLittleEndian(fields, (char*)&tag,    sizeof(tag));
+		AppendLittleEndian(fields, (char*)&length, sizeof(length));
+		AppendLittleEndian(fields, (char*)&this->displacedOffset, sizeof(this->displacedOffset));
+		AppendLittleEndian(fields, (char*)&this->displacedLength, sizeof(this->displacedLength));
+		AppendLittleEndian(fields, (char*)&this->displacedTo,     sizeof(this->displacedTo));
+	}
+	
+	//Streams written in a single pass have their checksum in a trailer, so it can't be read from the start of the payload
+	if (this->streaming)
+	{
+		uint16_t tag    = EFCHeaderField::StreamTrailer;
+		uint32_t length = 0;
+		AppendLittleEndian(fields, (char*)&tag,    sizeof(tag));
+		AppendLittleEndian(fields, (char*)&length, sizeof(length));
+	}
+	
+	return fields;
+}
+
+bool EFCHeader::ParseFields(const string& fields)
+{
+	size_t offset = 0;
+	while (offset < fields.length())
+	{
+		//Read the tag and length of the current field
+		uint16_t tag    = EFCHeaderField::End;
+		uint32_t length = 0;
+		if (!ExtractLittleEndian(fields, offset, (char*)&tag, sizeof(tag)) || !ExtractLittleEndian(fields, offset, (char*)&length, sizeof(length))) {
+			return false;
+		}
+		
+		//Make sure the value does not extend past the end of the fields
+		if (length > fields.length() - offset) {
+			return false;
+		}
+		
+		size_t valueEnd = offset + length;
+		switch (tag)
+		{
+			case EFCHeaderField::TreeChecksum:
+				if (length != sizeof(this->checksumChunkSize) + sizeof(this->checksumChunkCount)) {
+					return false;
+				}
+				
+				this->checksumType = ChecksumType::Tree;
+				ExtractLittleEndian(fields, offset, (char*)&this->checksumChunkSize,  sizeof(this->checksumChunkSize));
+				ExtractLittleEndian(fields, offset, (char*)&this->checksumChunkCount, sizeof(this->checksumChunkCount));
+				
+				//A zero chunk size can never have been written by a valid encoder
+				if (this->checksumChunkSize == 0 || this->checksumChunkCount == 0) {
+					return false;
+				}
+				break;
+			
+			case EFCHeaderField::KeyDerivation:
+			{
+				uint8_t algorithm = 0;
+				size_t fixedLength = sizeof(algorithm) + sizeof(this->kdf.costExponent) + sizeof(this->kdf.blockSize) + sizeof(this->kdf.lanes);
+				if (length <= fixedLength) {
+					return false;
+				}
+				
+				ExtractLittleEndian(fields, offset, (char*)&algorithm, sizeof(algorithm));
+				ExtractLittleEndian(fields, offset, (char*)&this->kdf.costExponent, sizeof(this->kdf.costExponent));
+				ExtractLittleEndian(fields, offset, (char*)&this->kdf.blockSize,    sizeof(this->kdf.blockSize));
+				ExtractLittleEndian(fields, offset, (char*)&this->kdf.lanes,        sizeof(this->kdf.lanes));
+				this->kdf.algorithm = algorithm;
+				this->kdf.salt      = fields.substr(offset, valueEnd - offset);
+				
+				//Reject parameters that would make key derivation unreasonably expensive
+				if (!this->kdf.IsValid()) {
+					return false;
+				}
+				break;
+			}
+			
+			case EFCHeaderField::WrappedKey:
+				if (length == 0) {
+					return false;
+				}
+				
+				this->wrappedKeys.push_back(fields.substr(offset, length));
+				break;
+			
+			case EFCHeaderField::SparseExtents:
+				if (!this->sparseMap.Parse(fields.substr(offset, length))) {
+					return false;
+				}
+				break;
+			
+			case EFCHeaderField::PlaintextSize:
+				if (length != sizeof(this->plaintextSize)) {
+					return false;
+				}
+				
+				ExtractLittleEndian(fields, offset, (char*)&this->plaintextSize, sizeof(this->plaintextSize));
+				break;
+			
+			case EFCHeaderField::ChunkSize:
+				if (length != sizeof(this->chunkSize)) {
+					return false;
+				}
+				
+				ExtractLittleEndian(fields, offset, (char*)&this->chunkSize, sizeof(this->chunkSize));
+				break;
+			
+			case EFCHeaderField::SplitVolumes:
+				if (length != sizeof(this->volumeSize) + sizeof(this->volumeCount)) {
+					return false;
+				}
+				
+				ExtractLittleEndian(fields, offset, (char*)&this->volumeSize,  sizeof(this->volumeSize));
+				ExtractLittleEndian(fields, offset, (char*)&this->volumeCount, sizeof(this->volumeCount));
+				
+				//Every volume must hold at least part of the container
+				if (this->volumeSize == 0) {
+					return false;
+				}
+				break;
+			
+			case EFCHeaderField::Displaced:
+				if (length != sizeof(this->displacedOffset) + sizeof(this->displacedLength) + sizeof(this->displacedTo)) {
+					return false;
+				}
+				
+				ExtractLittleEndian(fields, offset, (char*)&this->displacedOffset, sizeof(this->displacedOffset));
+				ExtractLittleEndian(fields, offset, (char*)&this->displacedLength, sizeof(this->displacedLength));
+				ExtractLittleEndian(fields, offset, (char*)&this->displacedTo,     sizeof(this->displacedTo));
+				
+				//The displaced bytes must have been moved past the part of the container that replaced them
+				if (this->displacedLength == 0 || this->displacedTo < this->displacedOffset || this->displacedLength > this->displacedOffset) {
+					return false;
+				}
+				break;
+			
+			case EFCHeaderField::StreamTrailer:
+				if (length != 0) {
+					return false;
+				}
+				
+				this->streaming = true;
+				break;
+			
+			default:
+				//Unrecognised fields can be skipped, unless they alter the payload format
+				if ((tag & EFCHeaderField::Critical) != 0) {
+					return false;
+				}
+				break;
+		}
+		
+		//Move to the next field
+		offset = valueEnd;
+	}
+	
+	//The chunk count of a tree checksum sizes the buffer its hashes are read into, so it must agree with the rest of the header.
+	//The hashes are stored at the start of the payload, which must have room for them, and when the size of the data they cover
+	//was recorded (for sparse files, just their extents), the count must be the number of chunks it splits into.
+	if (this->checksumType == ChecksumType::Tree)
+	{
+		if (this->payloadSize <= 0 || this->checksumChunkCount >= (uint64_t)this->payloadSize / ChecksumUtility::ChecksumSize) {
+			return false;
+		}
+		
+		uint64_t dataSize = (this->IsSparse()) ? this->sparseMap.DataLength() : this->plaintextSize;
+		if ((dataSize > 0 || this->IsSparse()) && this->checksumChunkCount != ChecksumUtility::TreeChunkCount(dataSize, this->checksumChunkSize)) {
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+void EFCHeader::AppendLittleEndian(string& s, const char* data, size_t n)
+{
+	//Copy the bytes, flipping them on big endian systems
+	string bytes(data, n);
+	if (endianness() != LITTLE_ENDIAN) {
+		flipBytes(const_cast<char*>(bytes.data()), n);
+	}
+	
+	s += bytes;
+}
+
+bool EFCHeader::ExtractLittleEndian(const string& s, size_t& offset, char* data, size_t n)
+{
+	//Make sure there are enough bytes remaining
+	if (n > s.length() - offset) {
+		return false;
+	}
+	
+	//Copy the bytes, flipping them on big endian systems
+	memcpy(data, s.data() + offset, n);
+	if (endianness() != LITTLE_ENDIAN) {
+		flipBytes(data, n);
+	}
+	
+	offset += n;
+	return true;
+}
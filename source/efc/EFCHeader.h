@@ -25,15 +25,39 @@
 
 #include <stdint.h>
 #include <string>
+#include <vector>
 using std::string;
+using std::vector;
 
 #include "../utility/MeteredFilestream.h"
+#include "../utility/ChecksumUtility.h"
+#include "../utility/SparseMap.h"
 #include "../compression/CompressionFactory.h"
 #include "../encryption/EncryptionFactory.h"
+#include "../encryption/KeyDerivation.h"
+
+//Tags for the optional fields stored by header versions that support them.
+//Tags with the Critical bit set describe the payload format, so a header containing an unrecognised critical field cannot be decoded.
+namespace EFCHeaderField
+{
+	static const uint16_t Critical     = 0x8000;
+	static const uint16_t End          = 0x0000;  //Sentinel value, never stored
+	static const uint16_t TreeChecksum  = Critical | 0x0001;
+	static const uint16_t KeyDerivation = Critical | 0x0002;
+	static const uint16_t WrappedKey    = Critical | 0x0003;  //Repeated once for each wrapped copy of the data key
+	static const uint16_t StreamTrailer = Critical | 0x0004;  //No value, the checksum and plaintext size follow the payload
+	static const uint16_t SparseExtents = Critical | 0x0005;  //The payload holds only the data extents of a sparse file
+	static const uint16_t PlaintextSize = 0x0006;             //The size of the original file, so the output can be allocated up front
+	static const uint16_t ChunkSize     = 0x0007;             //The size of the chunks the input was read and transformed in
+	static const uint16_t SplitVolumes  = Critical | 0x0008;  //The container continues in further volumes, named after the first
+	static const uint16_t Displaced     = Critical | 0x0009;  //Part of the payload is stored at the end of the file (files encrypted in place)
+}
 
 class EFCHeader
 {
 	public:
+		EFCHeader();
+		virtual ~EFCHeader();
 		
 		//(De)obfuscates a string
 		static string ObfuscateText(string s);
@@ -44,11 +68,64 @@ class EFCHeader
 		//Serialises the header to an output file
 		virtual void WriteHeader(MeteredOfstream& outputFile) = 0;
 		
+		//Determines if the header was parsed successfully
+		bool IsValid();
+		
+		//Determines if the payload is encrypted under a data key stored in the header
+		bool UsesEnvelope();
+		
+		//Determines if the payload holds only the data extents of a sparse file
+		bool IsSparse();
+		
+		//Determines if the container is split across several volumes
+		bool IsSplit();
+		
+		//Determines if part of the payload is stored out of order, because the file was encrypted in place
+		bool IsDisplaced();
+		
+		//For displaced containers, the extents of the file that hold the container, listed in the order they are read
+		SparseMap DisplacedExtents();
+		
 		//Standard Header fields
 		int32_t compression; //The compression type used, i.e: CompressionType::[...]
 		int32_t cipher;      //The encryption type used,  i.e: EncryptionType::[...]
 		string  filename;    //The filename of the original file
-		int32_t payloadSize; //The length (in bytes) of the payload, including IV
+		int64_t payloadSize; //The length (in bytes) of the payload, including IV
+		
+		//Optional fields (only stored by header versions that support them)
+		int32_t  checksumType;       //The checksum type used, i.e: ChecksumType::[...]
+		uint32_t checksumChunkSize;  //For tree checksums, the size (in bytes) of each chunk
+		uint64_t checksumChunkCount; //For tree checksums, the number of chunks
+		KeyDerivation kdf;           //The function (and its parameters) used to derive the key from a password
+		vector<string> wrappedKeys;  //For envelope encryption, the data key wrapped under each of the user keys
+		SparseMap sparseMap;         //For sparse files, the extents of the original file that hold data (the checksum covers only these)
+		uint64_t plaintextSize;      //The length (in bytes) of the original file, or zero if it wasn't known when the header was written
+		uint32_t chunkSize;          //The size (in bytes) of the chunks the encoder read and transformed the input in, or zero if not recorded
+		uint64_t volumeSize;         //For split containers, the size (in bytes) of every volume but the last, or zero if the container is a single file
+		uint32_t volumeCount;        //For split containers, the number of volumes, or zero if it wasn't known when the header was written
+		
+		//Files encrypted in place have the header written over the start of the original file, whose bytes are moved to the end.
+		//The displacedLength bytes at offset displacedOffset of the container are stored at displacedTo in the file instead,
+		//and the rest of the container (from displacedOffset + displacedLength onwards) is stored from displacedLength onwards.
+		uint64_t displacedOffset;
+		uint64_t displacedLength;
+		uint64_t displacedTo;
+		
+		bool streaming;              //Whether the payload was written in a single pass, and is followed by an encrypted trailer (payloadSize is zero)
+	
+	protected:
+		//Serialises the optional fields as a series of tagged, length-prefixed values
+		string SerialiseFields();
+		
+		//Parses a series of fields produced by SerialiseFields(), returning false if they are malformed
+		bool ParseFields(const string& fields);
+		
+		//Helpers to append and extract little endian integers when (de)serialising fields
+		static void AppendLittleEndian(string& s, const char* data, size_t n);
+		static bool ExtractLittleEndian(const string& s, size_t& offset, char* data, size_t n);
+		
+		//Set to false by the parsing constructors of derived classes if the header is malformed
+		bool valid;
 	
 	private:
 		//Helper function to facilitate the (de)obfuscation of individual bytes
@@ -24,6 +24,8 @@
 
 #include <cstring>
 #include "EFCDefaultHeader.h"
+#include "EFCExtendedHeader.h"
+#include "EFCBinaryHeader.h"
 
 EFCHeader* EFCHeaderFactory::createHeader(char version)
 {
@@ -31,6 +33,12 @@ EFCHeader* EFCHeaderFactory::createHeader(char version)
 	{
 		case EFCHeaderVersion::Default:
 			return new EFCDefaultHeader();
+		
+		case EFCHeaderVersion::Extended:
+			return new EFCExtendedHeader();
+		
+		case EFCHeaderVersion::Binary:
+			return new EFCBinaryHeader();
 	}
 	
 	//Unsupported header version
@@ -63,13 +71,39 @@ EFCHeader* EFCHeaderFactory::parseHeader(MeteredIfstream& file)
 			memcmp(magicBytes, legacyEFCpng, sizeof(legacyEFCpng)) == 0
 		)
 	)
+	{
+		return new EFCDefaultHeader(file);
+	}
+	else if
+	(
+		headerVersion != 0 &&
+		(
+			memcmp(magicBytes, standardEFC,   sizeof(obfuscatedEFC)) == 0 ||
+			memcmp(magicBytes, obfuscatedEFC, sizeof(obfuscatedEFC)) == 0
+		)
+	)
 	{
 		//Instantiate the correct version of the header class
+		EFCHeader* header = NULL;
 		switch (headerVersion)
 		{
-			case EFCHeaderVersion::Default:
-				return new EFCDefaultHeader(file);
+			case EFCHeaderVersion::Extended:
+				header = new EFCExtendedHeader(file);
+				break;
+			
+			case EFCHeaderVersion::Binary:
+				header = new EFCBinaryHeader(file);
+				break;
+		}
+		
+		//Discard headers that could not be parsed
+		if (header != NULL && !header->IsValid())
+		{
+			delete header;
+			header = NULL;
 		}
+		
+		return header;
 	}
 	
 	//The file does not contain a valid EFC header
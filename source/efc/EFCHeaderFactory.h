@@ -28,7 +28,9 @@
 
 namespace EFCHeaderVersion
 {
-	static const int Default = 0;
+	static const int Default  = 0;
+	static const int Extended = 1;
+	static const int Binary   = 2;
 }
 
 class EFCHeaderFactory
@@ -0,0 +1,302 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#include "EFCHeaderScanner.h"
+#include "EFCHeaderFactory.h"
+#include "../utility/MemoryInputBackend.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+//Entries whose type the directory listing didn't provide
+#define UNKNOWN_TYPE 0
+
+EFCHeaderScanner::EFCHeaderScanner(ScanCallback callback, void* context, unsigned int threads)
+{
+	this->callback = callback;
+	this->context  = context;
+	this->threads  = std::max(threads, 1u);
+	pending        = 0;
+}
+
+EFCHeaderScanner::~EFCHeaderScanner() {}
+
+EFCHeaderScanner::Directory::~Directory()
+{
+	#ifndef _WIN32
+	closedir((DIR*)handle);
+	#endif
+}
+
+void EFCHeaderScanner::Add(const string& path)
+{
+	Task task;
+	task.name = path;
+	task.type = UNKNOWN_TYPE;
+	this->Push(task);
+}
+
+void EFCHeaderScanner::Run()
+{
+	vector<std::thread> workers;
+	for (unsigned int t = 0; t < threads; ++t) {
+		workers.push_back(std::thread(&EFCHeaderScanner::Worker, this));
+	}
+	
+	for (unsigned int t = 0; t < threads; ++t) {
+		workers[t].join();
+	}
+}
+
+void EFCHeaderScanner::Push(const Task& task)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	tasks.push_back(task);
+	++pending;
+	changed.notify_one();
+}
+
+void EFCHeaderScanner::Finish()
+{
+	//Once nothing is left in progress, no more tasks can appear
+	std::lock_guard<std::mutex> guard(lock);
+	if (--pending == 0) {
+		changed.notify_all();
+	}
+}
+
+void EFCHeaderScanner::Worker()
+{
+	while (true)
+	{
+		Task task;
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			while (tasks.empty() && pending > 0) {
+				changed.wait(guard);
+			}
+			
+			if (tasks.empty()) {
+				return;
+			}
+			
+			task = tasks.back();
+			tasks.pop_back();
+		}
+		
+		this->Process(task);
+		this->Finish();
+	}
+}
+
+string EFCHeaderScanner::PathOf(const Task& task)
+{
+	if (task.parent == NULL) {
+		return task.name;
+	}
+	
+	string separator = (task.parent->path.length() > 0 && task.parent->path[task.parent->path.length() - 1] == '/') ? "" : "/";
+	return task.parent->path + separator + task.name;
+}
+
+void EFCHeaderScanner::Report(const string& path, EFCHeader* header, const string& error)
+{
+	std::lock_guard<std::mutex> guard(reportLock);
+	callback(context, path, header, error);
+}
+
+void EFCHeaderScanner::Process(const Task& task)
+{
+	string path = this->PathOf(task);
+	
+	#ifndef _WIN32
+	//Without a type from the listing, the entry is checked without following it, since links to directories aren't walked
+	int dirfd = (task.parent != NULL) ? task.parent->fd : AT_FDCWD;
+	int type  = task.type;
+	struct stat details;
+	if (type == UNKNOWN_TYPE && task.parent != NULL)
+	{
+		if (fstatat(dirfd, task.name.c_str(), &details, AT_SYMLINK_NOFOLLOW) != 0)
+		{
+			this->Report(path, NULL, string("could not open the file (") + strerror(errno) + ")");
+			return;
+		}
+		
+		type = (S_ISDIR(details.st_mode)) ? DT_DIR : ((S_ISREG(details.st_mode)) ? DT_REG : ((S_ISLNK(details.st_mode)) ? DT_LNK : UNKNOWN_TYPE));
+		if (type == UNKNOWN_TYPE) {
+			return;
+		}
+	}
+	
+	//Reading the header shouldn't change the file's access time (although avoiding that requires owning the file), and special files reached through links mustn't block
+	int flags = O_RDONLY | O_CLOEXEC | O_NONBLOCK | ((type == DT_DIR) ? O_DIRECTORY : 0);
+	int fd = -1;
+	#ifdef O_NOATIME
+	fd = openat(dirfd, task.name.c_str(), flags | O_NOATIME);
+	#endif
+	if (fd == -1) {
+		fd = openat(dirfd, task.name.c_str(), flags);
+	}
+	
+	if (fd == -1)
+	{
+		this->Report(path, NULL, string("could not open the file (") + strerror(errno) + ")");
+		return;
+	}
+	
+	//The listing's type saves a stat() for each regular file, but the targets of links (and the paths that were added) must be checked
+	bool link = (type == DT_LNK);
+	if (type != DT_REG && type != DT_DIR)
+	{
+		if (fstat(fd, &details) != 0)
+		{
+			close(fd);
+			this->Report(path, NULL, string("could not open the file (") + strerror(errno) + ")");
+			return;
+		}
+		
+		type = (S_ISDIR(details.st_mode)) ? DT_DIR : ((S_ISREG(details.st_mode)) ? DT_REG : UNKNOWN_TYPE);
+	}
+	
+	if (type == DT_DIR && link == false) {
+		this->Walk(fd, path);
+	}
+	else if (type == DT_REG) {
+		this->ScanFile(fd, path);
+	}
+	else {
+		close(fd);
+	}
+	#else
+	this->Report(path, NULL, "scanning is not supported on this platform");
+	#endif
+}
+
+void EFCHeaderScanner::Walk(int fd, const string& path)
+{
+	#ifndef _WIN32
+	DIR* handle = fdopendir(fd);
+	if (handle == NULL)
+	{
+		close(fd);
+		this->Report(path, NULL, string("could not read the directory (") + strerror(errno) + ")");
+		return;
+	}
+	
+	std::shared_ptr<Directory> directory(new Directory());
+	directory->handle = handle;
+	directory->fd     = fd;
+	directory->path   = path;
+	
+	struct dirent* entry = NULL;
+	while ((entry = readdir(handle)) != NULL)
+	{
+		string name = entry->d_name;
+		if (name == "." || name == "..") {
+			continue;
+		}
+		
+		//Only directories, regular files and the entries that may turn out to be either are of interest
+		if (entry->d_type != DT_DIR && entry->d_type != DT_REG && entry->d_type != DT_LNK && entry->d_type != DT_UNKNOWN) {
+			continue;
+		}
+		
+		Task task;
+		task.parent = directory;
+		task.name   = name;
+		task.type   = entry->d_type;
+		
+		//When the queue is already long, files are scanned here instead of being queued for another thread
+		bool queueFull = false;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			queueFull = (tasks.size() >= threads * MaxQueuedPerThread);
+		}
+		
+		if (queueFull && task.type == DT_REG) {
+			this->Process(task);
+		}
+		else {
+			this->Push(task);
+		}
+	}
+	#endif
+}
+
+void EFCHeaderScanner::ScanFile(int fd, const string& path)
+{
+	#ifndef _WIN32
+	string buffer = "";
+	size_t readSize = InitialReadSize;
+	while (true)
+	{
+		//Read the start of the file (continuing from where the previous, smaller read left off)
+		size_t bytesRead = buffer.length();
+		buffer.resize(readSize);
+		while (bytesRead < readSize)
+		{
+			ssize_t result = pread(fd, &buffer[bytesRead], readSize - bytesRead, bytesRead);
+			if (result == -1 && errno == EINTR) {
+				continue;
+			}
+			
+			if (result < 0)
+			{
+				close(fd);
+				this->Report(path, NULL, string("could not read the file (") + strerror(errno) + ")");
+				return;
+			}
+			
+			if (result == 0) {
+				break;
+			}
+			
+			bytesRead += result;
+		}
+		buffer.resize(bytesRead);
+		
+		//A header that runs right up to the end of what was read may have been cut short, so it is read again with more of the file
+		MeteredIfstream stream(new MemoryInputBackend(buffer.data(), buffer.length()), path);
+		EFCHeader* header = EFCHeaderFactory::parseHeader(stream);
+		bool truncated = (bytesRead == readSize && (uint64_t)(streamoff)stream.tellg() >= bytesRead && readSize < MaxHeaderSize);
+		if (!truncated)
+		{
+			close(fd);
+			this->Report(path, header, (header == NULL) ? "not an EFC container" : "");
+			delete header;
+			return;
+		}
+		
+		delete header;
+		readSize = std::min(readSize * ReadGrowth, (size_t)MaxHeaderSize);
+	}
+	#endif
+}
@@ -0,0 +1,119 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _EFC_HEADER_SCANNER
+#define _EFC_HEADER_SCANNER
+
+#include "EFCHeader.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+using std::string;
+using std::vector;
+
+//Receives the result of scanning a file: its header, or NULL and the reason it couldn't be read (the header is deleted once this returns)
+typedef void (*ScanCallback)(void* context, const string& path, EFCHeader* header, const string& error);
+
+//Reads the headers of many files at once, such as every container in an archive, walking directory trees on a pool of threads.
+//Each file is opened relative to its directory (openat) and only the first few kilobytes are read, so that the scan is limited by
+//the filesystem's metadata rather than by the size of the containers. Nothing beyond the header is read or decrypted.
+class EFCHeaderScanner
+{
+	public:
+		//The callback is called from the worker threads, but never by more than one at a time
+		EFCHeaderScanner(ScanCallback callback, void* context, unsigned int threads);
+		~EFCHeaderScanner();
+		
+		//Adds a file to be scanned, or a directory whose whole tree is scanned (links to directories within it aren't followed)
+		void Add(const string& path);
+		
+		//Scans everything that has been added, returning once every file has been reported
+		void Run();
+		
+		//The first read from each file covers all but unusually large headers, which are read again (growing by this factor each time)
+		static const size_t InitialReadSize = 4096;
+		static const size_t ReadGrowth      = 16;
+		
+		//No header is read beyond this size
+		static const size_t MaxHeaderSize = 64*1024*1024;
+		
+		//Directories scan their own files, rather than queueing them, once this many tasks are waiting for each thread
+		static const size_t MaxQueuedPerThread = 1024;
+		
+	private:
+		//An open directory, which stays open until every entry queued from it has been scanned
+		struct Directory
+		{
+			void*  handle;
+			int    fd;
+			string path;
+			
+			~Directory();
+		};
+		
+		//A file or directory waiting to be scanned, named relative to its parent (or the working directory, if there is no parent)
+		struct Task
+		{
+			std::shared_ptr<Directory> parent;
+			string name;
+			int    type;
+		};
+		
+		ScanCallback callback;
+		void*        context;
+		unsigned int threads;
+		
+		//Tasks are taken from the back, so the tree is walked depth first and only the directories on each thread's path stay open
+		vector<Task>            tasks;
+		size_t                  pending;
+		std::mutex              lock;
+		std::condition_variable changed;
+		
+		//Serialises the calls to the callback
+		std::mutex reportLock;
+		
+		//Takes tasks until none are left
+		void Worker();
+		
+		//Queues a task, and the counterpart that marks one as finished
+		void Push(const Task& task);
+		void Finish();
+		
+		//Scans a task, whose type is only a hint (the file is checked once it is open)
+		void Process(const Task& task);
+		
+		//Queues (or scans) each entry of an open directory
+		void Walk(int fd, const string& path);
+		
+		//Reads just enough of an open file to parse its header, and reports it
+		void ScanFile(int fd, const string& path);
+		
+		//Reports a file to the callback
+		void Report(const string& path, EFCHeader* header, const string& error);
+		
+		//The path of a task, for reporting
+		static string PathOf(const Task& task);
+};
+
+#endif
@@ -25,13 +25,116 @@
 #include <simple-base/base.h>
 #include "compression/CompressionFactory.h"
 #include "encryption/EncryptionFactory.h"
+#include "encryption/InPlaceConversion.h"
 #include "utility/ChecksumUtility.h"
+#include "utility/StreamingChecksum.h"
 #include "utility/MeteredFilestream.h"
 #include "utility/ApplicationConfig.h"
+#include "utility/AlignedBufferPool.h"
+#include "utility/DurabilityPolicy.h"
 #include "efc/EFCHeaderFactory.h"
 
 using namespace std;
 
+//Outputs the original checksum and that of the decrypted output, returning true if they match
+bool CompareChecksums(ApplicationConfig& config, EFCHeader* header, const string& checksum, const string& outputChecksum)
+{
+	//Output the checksums (for tree checksums, only the root hash)
+	clog << "Original Checksum:  " << hex(checksum.data(), ChecksumUtility::ChecksumSize) << endl;
+	clog << "Decrypted Checksum: " << hex(outputChecksum.data(), ChecksumUtility::ChecksumSize) << endl;
+	
+	//Determine if the two checksums match (for streams, the plaintext sizes must also match)
+	bool checksumsMatch = (header->streaming) ? (checksum == outputChecksum) : (memcmp(checksum.data(), outputChecksum.data(), ChecksumUtility::ChecksumSize) == 0);
+	if (checksumsMatch)
+	{
+		clog << "The checksums match!" << endl;
+	}
+	else
+	{
+		//For tree checksums, we can report exactly which chunks are damaged
+		if (header->checksumType == ChecksumType::Tree)
+		{
+			vector<uint64_t> damaged = ChecksumUtility::FindDamagedChunks(checksum, outputChecksum);
+			for (size_t i = 0; i < damaged.size(); ++i) {
+				clog << "Damaged chunk " << damaged[i] << " (bytes " << damaged[i] * header->checksumChunkSize << " to " << (damaged[i] + 1) * header->checksumChunkSize - 1 << ")" << endl;
+			}
+		}
+		
+		#ifdef _WIN32
+		if (config.GUIMode == true)
+		{
+			MessageBox(NULL, "The checksums do not match!", "Error Decrypting", MB_ICONERROR);
+		}
+		#endif
+		clog << "The checksums do not match!" << endl;
+	}
+	
+	return checksumsMatch;
+}
+
+//Decrypts a file that was encrypted in place, then gives it the output filename. Returns true if an error occurred.
+bool DecryptInPlace(ApplicationConfig& config)
+{
+	EFCHeader* header = config.header;
+	if (header == NULL)
+	{
+		clog << "Error: invalid EFC header!" << endl;
+		return true;
+	}
+	
+	//The input file was only needed for its header, and must not be read while the file is cut back to its original size
+	uint64_t headerLength = config.infile->tellg();
+	config.infile->close();
+	
+	//The plaintext is checksummed as it is restored, unless an interrupted conversion is resumed partway through
+	InPlaceConversion conversion(config.infilePath, EncryptionMode::Decrypt);
+	StreamingChecksum writtenChecksum(header->checksumType, header->checksumChunkSize);
+	string payloadKey = (header->UsesEnvelope()) ? config.dataKey : config.key;
+	bool resumed = conversion.Interrupted();
+	string checksum = "";
+	try
+	{
+		if (resumed)
+		{
+			clog << "Resuming the interrupted decryption of " << config.infilePath << endl;
+			conversion.Resume(payloadKey);
+		}
+		else {
+			conversion.Decrypt(header, headerLength, payloadKey, &writtenChecksum);
+		}
+		
+		checksum = conversion.StoredChecksum();
+	}
+	catch (const string& message)
+	{
+		clog << "Error: " << message << "!" << endl;
+		if (conversion.Interrupted()) {
+			clog << "Run the same command again to finish decrypting " << config.infilePath << "." << endl;
+		}
+		return true;
+	}
+	
+	//The file is only given its new name once it holds the whole of the original
+	if (config.outfilePath != config.infilePath)
+	{
+		#ifdef _WIN32
+		remove(config.outfilePath.c_str());
+		#endif
+		if (rename(config.infilePath.c_str(), config.outfilePath.c_str()) != 0 || !DurabilityPolicy::SyncDirectory(DurabilityPolicy::ParentDirectory(config.outfilePath)))
+		{
+			clog << "Error: could not rename " << config.infilePath << " to " << config.outfilePath << "!" << endl;
+			return true;
+		}
+	}
+	
+	string outputChecksum = writtenChecksum.Result();
+	if (resumed) {
+		outputChecksum = (header->checksumType == ChecksumType::Tree) ? ChecksumUtility::GenerateTreeChecksum(config.outfilePath, header->checksumChunkSize, config.threads) : ChecksumUtility::GenerateFileChecksum(config.outfilePath);
+	}
+	
+	return (CompareChecksums(config, header, checksum, outputChecksum) == false);
+}
+
 int main (int argc, char* argv[])
 {
 	//Output the program's header and copyright information
@@ -54,14 +157,22 @@ int main (int argc, char* argv[])
 			exit(1);
 		}
 		
-		//Attempt to open the input file
-		MeteredIfstream infile(config.infilePath);
-		if (infile.is_open())
+		//The input file was opened (and its header read) while parsing the arguments, since stdin can't be opened twice
+		MeteredIfstream& infile = *config.infile;
+		if (config.inPlace == true && infile.is_open()) {
+			errorOcurred = DecryptInPlace(config);
+		}
+		else if (infile.is_open())
 		{
-			//Read the file's header
-			EFCHeader* header = EFCHeaderFactory::parseHeader(infile);
+			EFCHeader* header = config.header;
 			if (header != NULL)
 			{
+				//The container is read in chunks chosen for it, rather than those the encoder used for the original file
+				clog << "Chunk size: " << infile.ChunkSize() / 1024 << " KB" << ((config.io.chunkSize == 0) ? " (auto)" : "") << endl;
+				if (header->IsSplit()) {
+					clog << "Reading " << header->volumeCount << " volumes of up to " << header->volumeSize / (1024*1024) << " MB" << endl;
+				}
+				
 				//Create the compression instance
 				CompressionStrategy* compression = CompressionFactory::CreateCompression(header->compression, CompressionMode::Decompress);
 				if (compression != NULL)
@@ -74,44 +185,79 @@ int main (int argc, char* argv[])
 						MeteredOfstream outfile(config.outfilePath);
 						if (outfile.is_open())
 						{
-							//Restrict input to the specified payload length
-							infile.SetReadLimit(header->payloadSize);
-							
-							//Create a blank checksum (will be filled by the decryption algorithm)
-							string checksum = ChecksumUtility::GenerateBlankChecksum();
-							
-							//Decrypt the file
-							encryption->TransformFile(compression, infile, outfile, config.key, checksum);
+							//Output to stdout is viewed as it is written
+							bool toStdout = IOOptions::IsStandardStream(config.outfilePath);
+							if (config.viewOutput == true && toStdout == true) {
+								clog << endl << endl << "Decrypted Output:" << endl << endl;
+							}
 							
-							//Close the output file
-							outfile.close();
+							//With envelope encryption, the payload is encrypted under the data key unwrapped from the header
+							string payloadKey = (header->UsesEnvelope()) ? config.dataKey : config.key;
 							
-							//Determine the chcksum of the written output file
-							string outputChecksum = ChecksumUtility::GenerateFileChecksum(config.outfilePath);
+							//The data of sparse files is written into its extents, recreating the holes between them
+							if (header->IsSparse()) {
+								outfile.RecreateHoles(header->sparseMap);
+							}
 							
-							//Output the checksums
-							clog << "Original Checksum:  " << hex(checksum.data(), checksum.length()) << endl;
-							clog << "Decrypted Checksum: " << hex(outputChecksum.data(), outputChecksum.length()) << endl;
+							//Otherwise, the whole output file is allocated up front when its size is known (this does nothing for stdout)
+							else if (header->plaintextSize > 0) {
+								outfile.Preallocate(header->plaintextSize);
+							}
 							
-							//Determine if the two checksums match
-							if (memcmp(checksum.data(), outputChecksum.data(), checksum.length()) == 0)
+							bool treeChecksum = (header->checksumType == ChecksumType::Tree);
+							bool written = true;
+							string checksum = "";
+							string outputChecksum = "";
+							if (header->streaming)
 							{
-								clog << "The checksums match!" << endl;
+								//The checksum and size of the plaintext are in a trailer after the payload, and the output is checked as it is written
+								encryption->TransformStream(compression, infile, outfile, payloadKey, checksum, outputChecksum);
+								written = outfile.close();
 							}
 							else
 							{
-								#ifdef _WIN32
-								if (config.GUIMode == true)
-								{
-									MessageBox(NULL, "The checksums do not match!", "Error Decrypting", MB_ICONERROR);
+								//Restrict input to the specified payload length
+								infile.SetReadLimit(header->payloadSize);
+								
+								//Create a blank checksum (will be filled by the decryption algorithm)
+								checksum = (treeChecksum) ? ChecksumUtility::GenerateBlankTreeChecksum(header->checksumChunkCount) : ChecksumUtility::GenerateBlankChecksum();
+								
+								//Output written to stdout can't be read back, and the checksum of a sparse file only covers its data, so these are checksummed as they are written
+								bool checksumWritten = (toStdout == true || header->IsSparse());
+								StreamingChecksum writtenChecksum(header->checksumType, header->checksumChunkSize);
+								if (checksumWritten == true) {
+									outfile.AttachChecksum(&writtenChecksum);
 								}
-								#endif
-								clog << "The checksums do not match!" << endl;
+								
+								//Decrypt the file
+								encryption->TransformFile(compression, infile, outfile, payloadKey, checksum);
+								
+								//Close the output file, which reports whether any of it (including what was still buffered) couldn't be written
+								written = outfile.close();
+								
+								//Determine the chcksum of the written output file (tree checksums are verified in parallel)
+								if (checksumWritten == true) {
+									outputChecksum = writtenChecksum.Result();
+								}
+								else if (written == true) {
+									outputChecksum = (treeChecksum) ? ChecksumUtility::GenerateTreeChecksum(config.outfilePath, header->checksumChunkSize, config.threads) : ChecksumUtility::GenerateFileChecksum(config.outfilePath);
+								}
+							}
+							
+							//Output that couldn't be written is reported instead of being checked (or viewed)
+							if (written == false)
+							{
+								clog << "Error: " << outfile.WriteError() << "!" << endl;
+								errorOcurred = true;
+							}
+							
+							//Compare the checksum of the output with the original
+							else if (CompareChecksums(config, header, checksum, outputChecksum) == false) {
 								errorOcurred = true;
 							}
 							
-							//Check if we are opening the output file for viewing with the default application
-							if (config.viewOutput == true)
+							//Check if we are opening the output file for viewing with the default application (output to stdout has already been viewed)
+							if (config.viewOutput == true && toStdout == false && written == true)
 							{
 								//View the output file
 								string command = "\"" + config.outfilePath + "\"";
@@ -167,14 +313,15 @@ int main (int argc, char* argv[])
 				clog << "Error: invalid EFC header!" << endl;
 				errorOcurred = true;
 			}
-			
-			//Close the input file
-			infile.close();
 		}
 		else {
 			clog << "Error: could not open input file (" << config.infilePath << ")!" << endl;
 			errorOcurred = true;
 		}
+		
+		if (config.hugePages) {
+			clog << AlignedBufferPool::HugePageReport() << endl;
+		}
 	}
 	else
 	{
@@ -22,66 +22,178 @@
 */
 #include <iostream>
 #include <fstream>
+#include <set>
 #include <simple-base/base.h>
 #include "compression/CompressionFactory.h"
 #include "encryption/EncryptionFactory.h"
+#include "encryption/InPlaceConversion.h"
 #include "utility/ChecksumUtility.h"
+#include "utility/StreamingChecksum.h"
 #include "utility/MeteredFilestream.h"
 #include "utility/ApplicationConfig.h"
+#include "utility/AlignedBufferPool.h"
+#include "utility/DurabilityPolicy.h"
+#include "utility/MemoryBudget.h"
+#include "utility/SplitOutputBackend.h"
 #include "efc/EFCHeaderFactory.h"
 
 using namespace std;
 
-int main (int argc, char* argv[])
+//Headroom reserved for the header and IV, on top of the payload, when preallocating the output file
+#define CONTAINER_OVERHEAD (64*1024)
+
+//Suffix for the temporary files that batches are written to when the outputs must be durable
+#define DURABLE_TEMP_SUFFIX ".partial"
+
+//Determines the size of an input file, or zero if it can't be determined in advance (such as for stdin)
+uint64_t InputFileSize(const string& inputPath)
 {
-	//Output the program's header and copyright information
-	clog << "EFC Encryption Utility" << endl << "Copyright (c) 2011, Adam Rehn" << endl << endl;
-	
-	//Keep track of whether or not we encounter any errors so we can generate the right exit code
-	bool errorOcurred = false;
+	if (IOOptions::IsStandardStream(inputPath)) {
+		return 0;
+	}
 	
-	//Check if any arguments were supplied
-	if (argc > 1)
+	ifstream infile(inputPath.c_str(), ios::binary | ios::ate);
+	return (infile.is_open() && infile.tellg() > 0) ? (uint64_t)infile.tellg() : 0;
+}
+
+//Creates the header for an input file, with the field values set from the configuration
+EFCHeader* CreateHeader(ApplicationConfig& config, const string& inputPath)
+{
+	EFCHeader* header = EFCHeaderFactory::createHeader(config.headerVersion);
+	if (header != NULL)
 	{
-		//Parse the command line arguments
-		ApplicationConfig config(argc, argv, EncryptionMode::Encrypt);
+		//Set the header field values
+		header->filename     = inputPath;
+		header->compression  = config.compression;
+		header->cipher       = config.cipher;
+		header->checksumType = config.checksumType;
+		header->kdf          = config.kdf;
 		
-		//Output any errors generated during argument parsing
-		clog << config.error;
-		
-		//Abort immediately if requested
-		if (config.abort == true) {
-			exit(1);
+		//Recording the plaintext size lets the decoder allocate the output file up front
+		header->plaintextSize = InputFileSize(inputPath);
+	}
+	
+	return header;
+}
+
+//Generates the checksum of the input file, recording the chunk layout in the header for tree checksums
+string GenerateChecksum(ApplicationConfig& config, EFCHeader* header, MeteredIfstream& infile, const string& inputPath)
+{
+	string checksum = "";
+	if (header->checksumType == ChecksumType::Tree && header->IsSparse())
+	{
+		//The tree for a sparse file is built over its data extents, which are read through the stream without the holes
+		StreamingChecksum tree(ChecksumType::Tree, ChecksumUtility::DefaultTreeChunkSize);
+		const char* buffer = NULL;
+		size_t bytesRead = 0;
+		while ((bytesRead = infile.ReadView(&buffer, infile.ChunkSize()))) {
+			tree.Input(buffer, bytesRead);
 		}
+		infile.seekg(0);
 		
-		//Attempt to open the input file
-		MeteredIfstream infile(config.infilePath);
-		if (infile.is_open())
+		checksum = tree.Result();
+		header->checksumChunkSize  = ChecksumUtility::DefaultTreeChunkSize;
+		header->checksumChunkCount = (checksum.length() / ChecksumUtility::ChecksumSize) - 1;
+		clog << "Input file checksum: " << hex(checksum.data(), ChecksumUtility::ChecksumSize) << " (" << header->checksumChunkCount << " chunks)" << endl;
+	}
+	else if (header->checksumType == ChecksumType::Tree)
+	{
+		//Hash the chunks of the file in parallel, and record the chunk layout in the header
+		checksum = ChecksumUtility::GenerateTreeChecksum(inputPath, ChecksumUtility::DefaultTreeChunkSize, config.threads);
+		header->checksumChunkSize  = ChecksumUtility::DefaultTreeChunkSize;
+		header->checksumChunkCount = (checksum.length() / ChecksumUtility::ChecksumSize) - 1;
+		clog << "Input file checksum: " << hex(checksum.data(), ChecksumUtility::ChecksumSize) << " (" << header->checksumChunkCount << " chunks)" << endl;
+	}
+	else
+	{
+		checksum = ChecksumUtility::GenerateFileChecksum(infile);
+		clog << "Input file checksum: " << hex(checksum.data(), checksum.length()) << endl;
+	}
+	
+	return checksum;
+}
+
+//Determines whether a file is small enough to be encrypted as part of a batch
+bool IsBatchable(const string& inputPath)
+{
+	ifstream infile(inputPath.c_str(), ios::binary | ios::ate);
+	return (infile.is_open() && infile.tellg() <= (streamoff)BATCH_MAX_FILESIZE);
+}
+
+//Encrypts a single file, streaming it through the cipher. Returns true if an error occurred.
+bool EncryptFile(ApplicationConfig& config, const string& inputPath, const string& outputPath)
+{
+	bool errorOcurred = false;
+	
+	//Attempt to open the input file
+	MeteredIfstream infile(inputPath);
+	if (infile.is_open())
+	{
+		//Create a new EFC header
+		EFCHeader* header = CreateHeader(config, inputPath);
+		if (header != NULL)
 		{
-			//Create a new EFC header
-			EFCHeader* header = EFCHeaderFactory::createHeader(EFCHeaderVersion::Default);
-			if (header != NULL)
+			//Record the chunk size the input is read in, which is chosen for each file unless one was requested
+			header->chunkSize = infile.ChunkSize();
+			clog << "Chunk size: " << infile.ChunkSize() / 1024 << " KB" << ((config.io.chunkSize == 0) ? " (auto)" : "") << endl;
+			
+			//The holes in sparse files are recorded in the header instead of being read
+			if (config.sparse && !IOOptions::IsStandardStream(inputPath) && header->sparseMap.Scan(inputPath))
 			{
-				//Set the header field values
-				header->filename    = config.infilePath;
-				header->compression = config.compression;
-				header->cipher      = config.cipher;
-				
-				//Create the compression instance
-				CompressionStrategy* compression = CompressionFactory::CreateCompression(header->compression, CompressionMode::Compress);
-				if (compression != NULL)
+				infile.SkipHoles(header->sparseMap);
+				clog << "Sparse file: " << header->sparseMap.DataLength() << " of " << header->sparseMap.fileSize << " bytes hold data (" << header->sparseMap.offsets.size() << " extents)" << endl;
+			}
+			
+			//Create the compression instance
+			CompressionStrategy* compression = CompressionFactory::CreateCompression(header->compression, CompressionMode::Compress);
+			if (compression != NULL)
+			{
+				//Create the encryption instance
+				EncryptionStrategy* encryption = EncryptionFactory::CreateEncryption(header->cipher, EncryptionMode::Encrypt);
+				if (encryption != NULL)
 				{
-					//Create the encryption instance
-					EncryptionStrategy* encryption = EncryptionFactory::CreateEncryption(header->cipher, EncryptionMode::Encrypt);
-					if (encryption != NULL)
+					//Attempt to open the output file (or its first volume), along with any extra destinations that receive a copy of everything written to it
+					MeteredOfstream outfile(outputPath, config.volumeSize, config.volumeDirs);
+					if (outfile.is_open() && config.teePaths.size() > 0) {
+						outfile.Tee(config.teePaths);
+					}
+					
+					//The header of a split file records the volume size, along with the number of volumes once the payload is complete
+					header->volumeSize = config.volumeSize;
+					
+					if (outfile.is_open())
 					{
-						//Attempt to open the output file
-						MeteredOfstream outfile(config.outfilePath);
-						if (outfile.is_open())
+						//With envelope encryption, the payload is encrypted under a random data key, which is stored wrapped under each recipient's key
+						string payloadKey = config.key;
+						if (config.useEnvelope)
+						{
+							payloadKey = encryption->GenerateDataKey();
+							for (size_t i = 0; i < config.keys.size(); ++i) {
+								header->wrappedKeys.push_back(encryption->WrapKey(payloadKey, config.keys[i]));
+							}
+						}
+						
+						if (config.streaming)
+						{
+							//Pipes are processed in a single pass, with the checksum and size written in a trailer after the payload
+							header->streaming = true;
+							header->WriteHeader(outfile);
+							
+							string storedTrailer   = "";
+							string computedTrailer = "";
+							encryption->TransformStream(compression, infile, outfile, payloadKey, storedTrailer, computedTrailer);
+							clog << "Input file checksum: " << hex(storedTrailer.data(), ChecksumUtility::ChecksumSize) << endl;
+						}
+						else
 						{
 							//Generate the checksum of the input file
-							string checksum = ChecksumUtility::GenerateFileChecksum(infile);
-							clog << "Input file checksum: " << hex(checksum.data(), checksum.length()) << endl;
+							string checksum = GenerateChecksum(config, header, infile, inputPath);
+							
+							//Reserve space for the container, assuming the payload is no larger than the data being read (any excess is given back on close)
+							uint64_t dataSize = (header->IsSparse()) ? header->sparseMap.DataLength() : header->plaintextSize;
+							if (dataSize > 0) {
+								outfile.Preallocate(dataSize + CONTAINER_OVERHEAD + checksum.length());
+							}
 							
 							//Write the incomplete header as a placeholder
 							header->WriteHeader(outfile);
@@ -90,52 +202,374 @@ int main (int argc, char* argv[])
 							outfile.ResetWriteCount();
 							
 							//Encrypt the file
-							encryption->TransformFile(compression, infile, outfile, config.key, checksum);
+							encryption->TransformFile(compression, infile, outfile, payloadKey, checksum);
 							
-							//Fill in the payload size in the header
+							//Fill in the payload size in the header, and the number of volumes the container was split into
 							header->payloadSize = outfile.WriteCount();
+							if (header->IsSplit())
+							{
+								header->volumeCount = ((uint64_t)(streamoff)outfile.tellp() + header->volumeSize - 1) / header->volumeSize;
+								clog << "Split into " << header->volumeCount << " volumes of up to " << header->volumeSize / (1024*1024) << " MB" << endl;
+							}
 							
 							//Seek back to the beginning and write the completed header
 							outfile.seekp(0);
 							header->WriteHeader(outfile);
-							
-							clog << "Done!" << endl;
-							
-							//Close the output file
-							outfile.close();
 						}
-						else {
-							clog << "Error: could not open output file!" << endl;
+						
+						//Close the output file, which reports whether any of it (including what was still buffered) couldn't be written
+						if (!outfile.close())
+						{
+							clog << "Error: " << outfile.WriteError() << "!" << endl;
 							errorOcurred = true;
 						}
-						
-						//Free the encryption instance
-						delete encryption;
 					}
 					else {
-						clog << "Error: unsupported encryption algorithm (" << header->cipher << ")!" << endl;
+						clog << "Error: could not open output file (" << ((config.volumeSize > 0) ? SplitOutputBackend::VolumePath(outputPath, "", 0) : outputPath) << ((config.teePaths.size() > 0) ? " or one of its copies" : "") << ")!" << endl;
 						errorOcurred = true;
 					}
 					
-					//Free the compression instance
-					delete compression;
+					//Free the encryption instance
+					delete encryption;
 				}
 				else {
-					clog << "Error: unsupported compression mode (" << header->compression << ")!" << endl;
+					clog << "Error: unsupported encryption algorithm (" << header->cipher << ")!" << endl;
 					errorOcurred = true;
 				}
+				
+				//Free the compression instance
+				delete compression;
 			}
 			else {
-				clog << "Error: invalid EFC header!" << endl;
+				clog << "Error: unsupported compression mode (" << header->compression << ")!" << endl;
 				errorOcurred = true;
 			}
 			
-			//Close the input file
+			//Free the header
+			delete header;
+		}
+		else {
+			clog << "Error: invalid EFC header!" << endl;
+			errorOcurred = true;
+		}
+		
+		//Close the input file
+		infile.close();
+	}
+	else {
+		clog << "Error: could not open input file (" << inputPath << ")!" << endl;
+		errorOcurred = true;
+	}
+	
+	return errorOcurred;
+}
+
+//Encrypts a single file in place, then gives it the output filename. Returns true if an error occurred.
+bool EncryptInPlace(ApplicationConfig& config, const string& inputPath, const string& outputPath)
+{
+	bool errorOcurred = false;
+	
+	//An interrupted conversion is resumed with the header from its journal, rather than a new one
+	InPlaceConversion conversion(inputPath, EncryptionMode::Encrypt);
+	EFCHeader* header = (config.header == NULL) ? CreateHeader(config, inputPath) : NULL;
+	try
+	{
+		if (config.header != NULL)
+		{
+			clog << "Resuming the interrupted encryption of " << inputPath << endl;
+			conversion.Resume(config.dataKey);
+		}
+		else if (header != NULL)
+		{
+			//The payload is encrypted under a random data key, which is stored wrapped under each recipient's key
+			EncryptionStrategy* encryption = EncryptionFactory::CreateEncryption(header->cipher, EncryptionMode::Encrypt);
+			if (encryption == NULL) {
+				throw string("unsupported encryption algorithm");
+			}
+			
+			string payloadKey = encryption->GenerateDataKey();
+			for (size_t i = 0; i < config.keys.size(); ++i) {
+				header->wrappedKeys.push_back(encryption->WrapKey(payloadKey, config.keys[i]));
+			}
+			delete encryption;
+			
+			//The checksum is generated before any of the file is overwritten
+			MeteredIfstream infile(inputPath);
+			if (!infile.is_open()) {
+				throw string("could not open input file (" + inputPath + ")");
+			}
+			string checksum = GenerateChecksum(config, header, infile, inputPath);
 			infile.close();
+			
+			conversion.Encrypt(header, checksum, payloadKey);
+			if (header->IsDisplaced()) {
+				clog << "Encrypted in place, moving the first " << header->displacedLength << " bytes to the end of the file" << endl;
+			}
 		}
 		else {
-			clog << "Error: could not open input file (" << config.infilePath << ")!" << endl;
+			throw string("invalid EFC header");
+		}
+	}
+	catch (const string& message)
+	{
+		clog << "Error: " << message << "!" << endl;
+		if (conversion.Interrupted()) {
+			clog << "Run the same command again to finish encrypting " << inputPath << "." << endl;
+		}
+		errorOcurred = true;
+	}
+	delete header;
+	
+	//The file is only given its new name once it holds the whole container
+	if (errorOcurred == false && outputPath != inputPath)
+	{
+		#ifdef _WIN32
+		remove(outputPath.c_str());
+		#endif
+		if (rename(inputPath.c_str(), outputPath.c_str()) != 0 || !DurabilityPolicy::SyncDirectory(DurabilityPolicy::ParentDirectory(outputPath)))
+		{
+			clog << "Error: could not rename " << inputPath << " to " << outputPath << "!" << endl;
+			errorOcurred = true;
+		}
+	}
+	
+	return errorOcurred;
+}
+
+//Encrypts a batch of small files under the same key, interleaving their AES work. Returns true if an error occurred.
+bool EncryptBatch(ApplicationConfig& config, vector<size_t>& batch)
+{
+	bool errorOcurred = false;
+	
+	//Create the encryption instance, and check that the compression mode is supported (each file needs its own compressor, since they are stateful)
+	BatchEncryption*     encryption  = EncryptionFactory::CreateBatchEncryption(config.cipher);
+	CompressionStrategy* compression = CompressionFactory::CreateCompression(config.compression, CompressionMode::Compress);
+	if (encryption == NULL || compression == NULL)
+	{
+		clog << "Error: unsupported encryption algorithm or compression mode!" << endl;
+		delete encryption;
+		delete compression;
+		return true;
+	}
+	delete compression;
+	
+	//When the outputs must be durable, they are written to temporary files that are flushed and renamed into place together
+	bool durable = (config.io.durability != DurabilityMode::None);
+	IOOptions outputOptions = config.io;
+	if (durable) {
+		outputOptions.durability = DurabilityMode::Deferred;
+	}
+	
+	//The files that were opened successfully, with their headers and compressed payloads
+	vector<EFCHeader*>       headers;
+	vector<MeteredOfstream*> outfiles;
+	vector<string>           outputPaths;
+	vector<string>           payloads;
+	vector<string>           checksums;
+	size_t                   reserved = 0;
+	
+	for (size_t b = 0; b < batch.size(); ++b)
+	{
+		string inputPath  = config.infilePaths[batch[b]];
+		string outputPath = config.outfilePaths[batch[b]];
+		clog << "Encrypting " << inputPath << endl;
+		
+		//Attempt to open the input file
+		MeteredIfstream infile(inputPath);
+		if (!infile.is_open())
+		{
+			clog << "Error: could not open input file (" << inputPath << ")!" << endl;
+			errorOcurred = true;
+			continue;
+		}
+		
+		//Attempt to open the output file
+		MeteredOfstream* outfile = new MeteredOfstream((durable) ? outputPath + DURABLE_TEMP_SUFFIX : outputPath, true, outputOptions);
+		if (!outfile->is_open())
+		{
+			clog << "Error: could not open output file (" << outputPath << ")!" << endl;
+			errorOcurred = true;
+			delete outfile;
+			continue;
+		}
+		
+		//Generate the checksum of the input file
+		EFCHeader* header = CreateHeader(config, inputPath);
+		string checksum = GenerateChecksum(config, header, infile, inputPath);
+		
+		//Read the whole file into memory
+		string data = "";
+		char buffer[64*1024];
+		size_t bytesRead = 0;
+		while ((bytesRead = infile.read(buffer, sizeof(buffer)))) {
+			data.append(buffer, bytesRead);
+		}
+		infile.close();
+		
+		//Compress the file in a single step (empty files have an empty payload, just as with TransformFile)
+		string payload = "";
+		if (data.length() > 0)
+		{
+			compression = CompressionFactory::CreateCompression(config.compression, CompressionMode::Compress);
+			payload = compression->TransformInput(&data[0], data.length(), true);
+			delete compression;
+		}
+		
+		//The payload is held until the whole batch is encrypted, alongside the copy that TransformBuffers encrypts. If that doesn't fit
+		//within the memory limit, the file is encrypted on its own instead, which streams it through the pooled buffers.
+		size_t required = 2 * (payload.length() + checksum.length());
+		if (!MemoryBudget::TryReserve(required))
+		{
+			delete outfile;
+			delete header;
+			if (durable) {
+				remove((outputPath + DURABLE_TEMP_SUFFIX).c_str());
+			}
+			
+			errorOcurred = EncryptFile(config, inputPath, outputPath) || errorOcurred;
+			continue;
+		}
+		reserved += required;
+		
+		//Write the incomplete header as a placeholder
+		header->WriteHeader(*outfile);
+		outfile->ResetWriteCount();
+		
+		headers.push_back(header);
+		outfiles.push_back(outfile);
+		outputPaths.push_back(outputPath);
+		payloads.push_back(payload);
+		checksums.push_back(checksum);
+	}
+	
+	//Encrypt all of the payloads together
+	if (outfiles.size() > 0) {
+		encryption->TransformBuffers(payloads, checksums, outfiles, config.key);
+	}
+	
+	//Fill in the payload sizes and write the completed headers
+	vector<string> writtenPaths;
+	for (size_t i = 0; i < outfiles.size(); ++i)
+	{
+		headers[i]->payloadSize = outfiles[i]->WriteCount();
+		outfiles[i]->seekp(0);
+		headers[i]->WriteHeader(*outfiles[i]);
+		if (outfiles[i]->close()) {
+			writtenPaths.push_back(outputPaths[i]);
+		}
+		else
+		{
+			clog << "Error: " << outfiles[i]->WriteError() << " while writing " << outputPaths[i] << "!" << endl;
 			errorOcurred = true;
+			
+			//A temporary file that couldn't be written is never renamed into place
+			if (durable) {
+				remove((outputPaths[i] + DURABLE_TEMP_SUFFIX).c_str());
+			}
+		}
+		
+		delete outfiles[i];
+		delete headers[i];
+	}
+	
+	//Flush the temporary files (their writeback is already under way), then rename them into place and flush each directory once
+	if (durable)
+	{
+		set<string> directories;
+		for (size_t i = 0; i < writtenPaths.size(); ++i)
+		{
+			string tempPath = writtenPaths[i] + DURABLE_TEMP_SUFFIX;
+			#ifdef _WIN32
+			remove(writtenPaths[i].c_str());
+			#endif
+			if (!DurabilityPolicy::SyncFile(tempPath) || rename(tempPath.c_str(), writtenPaths[i].c_str()) != 0)
+			{
+				clog << "Error: could not write output file (" << writtenPaths[i] << ") to disk!" << endl;
+				remove(tempPath.c_str());
+				errorOcurred = true;
+				continue;
+			}
+			
+			directories.insert(DurabilityPolicy::ParentDirectory(writtenPaths[i]));
+		}
+		
+		for (set<string>::iterator directory = directories.begin(); directory != directories.end(); ++directory)
+		{
+			if (!DurabilityPolicy::SyncDirectory(*directory))
+			{
+				clog << "Error: could not flush directory (" << *directory << ") to disk!" << endl;
+				errorOcurred = true;
+			}
+		}
+	}
+	
+	MemoryBudget::Release(reserved);
+	delete encryption;
+	return errorOcurred;
+}
+
+int main (int argc, char* argv[])
+{
+	//Output the program's header and copyright information
+	clog << "EFC Encryption Utility" << endl << "Copyright (c) 2011, Adam Rehn" << endl << endl;
+	
+	//Keep track of whether or not we encounter any errors so we can generate the right exit code
+	bool errorOcurred = false;
+	
+	//Check if any arguments were supplied
+	if (argc > 1)
+	{
+		//Parse the command line arguments
+		ApplicationConfig config(argc, argv, EncryptionMode::Encrypt);
+		
+		//Output any errors generated during argument parsing
+		clog << config.error;
+		
+		//Abort immediately if requested
+		if (config.abort == true) {
+			exit(1);
+		}
+		
+		if (config.infilePaths.size() == 1 && config.inPlace) {
+			errorOcurred = EncryptInPlace(config, config.infilePath, config.outfilePath);
+		}
+		else if (config.infilePaths.size() == 1) {
+			errorOcurred = EncryptFile(config, config.infilePath, config.outfilePath);
+		}
+		else
+		{
+			//Small files are grouped into batches, unless each file needs its own data key or its own extent map
+			vector<size_t> batch;
+			for (size_t i = 0; i < config.infilePaths.size(); ++i)
+			{
+				if (config.useEnvelope == false && config.sparse == false && IsBatchable(config.infilePaths[i]))
+				{
+					batch.push_back(i);
+					if (batch.size() == BATCH_MAX_FILES)
+					{
+						errorOcurred = EncryptBatch(config, batch) || errorOcurred;
+						batch.clear();
+					}
+				}
+				else
+				{
+					clog << "Encrypting " << config.infilePaths[i] << endl;
+					errorOcurred = EncryptFile(config, config.infilePaths[i], config.outfilePaths[i]) || errorOcurred;
+				}
+			}
+			
+			//Encrypt the final partial batch
+			if (batch.size() > 0) {
+				errorOcurred = EncryptBatch(config, batch) || errorOcurred;
+			}
+		}
+		
+		if (config.hugePages) {
+			clog << AlignedBufferPool::HugePageReport() << endl;
+		}
+		
+		if (errorOcurred == false) {
+			clog << "Done!" << endl;
 		}
 	}
 	else
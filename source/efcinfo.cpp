@@ -22,15 +22,223 @@
 */
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <thread>
 #include <simple-base/base.h>
 #include "compression/CompressionFactory.h"
 #include "encryption/EncryptionFactory.h"
 #include "utility/ChecksumUtility.h"
 #include "utility/MeteredFilestream.h"
+#include "utility/ApplicationConfig.h"
 #include "efc/EFCHeaderFactory.h"
+#include "efc/EFCHeaderScanner.h"
 
 using namespace std;
 
+//The options for scanning many files, and the totals so far
+struct ScanOutput
+{
+	bool     csv;
+	uint64_t files;
+	uint64_t errors;
+};
+
+//A value in the line output for each file, which is either text or a literal (a number or boolean) in JSON
+struct ScanColumn
+{
+	string name;
+	string value;
+	bool   text;
+};
+
+//Quotes a string for JSON output
+string JsonString(const string& s)
+{
+	std::stringstream quoted;
+	quoted << "\"";
+	for (size_t i = 0; i < s.length(); ++i)
+	{
+		unsigned char c = s[i];
+		if (c == '"' || c == '\\') {
+			quoted << '\\' << c;
+		}
+		else if (c < 0x20)
+		{
+			char escaped[8];
+			snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+			quoted << escaped;
+		}
+		else {
+			quoted << c;
+		}
+	}
+	quoted << "\"";
+	return quoted.str();
+}
+
+//Quotes a string for CSV output, if it contains a delimiter, a quote or a line break
+string CsvString(const string& s)
+{
+	if (s.find_first_of(",\"\r\n") == string::npos) {
+		return s;
+	}
+	
+	string quoted = "\"";
+	for (size_t i = 0; i < s.length(); ++i) {
+		quoted += (s[i] == '"') ? "\"\"" : string(1, s[i]);
+	}
+	return quoted + "\"";
+}
+
+//Describes a file found by the scan. Every file has the same columns, which are empty where they don't apply.
+vector<ScanColumn> DescribeFile(const string& path, EFCHeader* header, const string& error)
+{
+	bool found = (header != NULL);
+	ScanColumn columns[] = {
+		{"path",            path, true},
+		{"filename",        (found) ? header->filename : "", true},
+		{"compression",     (found) ? CompressionFactory::TypeDescription(header->compression) : "", true},
+		{"cipher",          (found) ? EncryptionFactory::TypeDescription(header->cipher) : "", true},
+		{"kdf",             (found) ? header->kdf.Description() : "", true},
+		{"key_slots",       (found) ? std::to_string(header->wrappedKeys.size()) : "", false},
+		{"checksum",        (found) ? ChecksumUtility::TypeDescription(header->checksumType) : "", true},
+		{"checksum_chunks", (found && header->checksumType == ChecksumType::Tree) ? std::to_string(header->checksumChunkCount) : "", false},
+		{"original_size",   (found && header->plaintextSize > 0) ? std::to_string(header->plaintextSize) : "", false},
+		{"payload_size",    (found && !header->streaming) ? std::to_string(header->payloadSize) : "", false},
+		{"streamed",        (found) ? ((header->streaming) ? "true" : "false") : "", false},
+		{"sparse",          (found) ? ((header->IsSparse()) ? "true" : "false") : "", false},
+		{"volumes",         (found && header->IsSplit() && header->volumeCount > 0) ? std::to_string(header->volumeCount) : "", false},
+		{"in_place",        (found) ? ((header->IsDisplaced()) ? "true" : "false") : "", false},
+		{"error",           error, true}
+	};
+	
+	return vector<ScanColumn>(columns, columns + sizeof(columns) / sizeof(columns[0]));
+}
+
+//The header row for CSV output
+string CsvColumns()
+{
+	vector<ScanColumn> columns = DescribeFile("", NULL, "");
+	string header = "";
+	for (size_t i = 0; i < columns.size(); ++i) {
+		header += ((i > 0) ? "," : "") + columns[i].name;
+	}
+	
+	return header;
+}
+
+//Outputs a line describing each file found by the scan, as a JSON object or a CSV row (JSON leaves out the empty columns)
+void ReportHeader(void* context, const string& path, EFCHeader* header, const string& error)
+{
+	ScanOutput* output = (ScanOutput*)context;
+	output->files++;
+	if (header == NULL) {
+		output->errors++;
+	}
+	
+	vector<ScanColumn> columns = DescribeFile(path, header, error);
+	std::stringstream line;
+	for (size_t i = 0; i < columns.size(); ++i)
+	{
+		if (output->csv) {
+			line << ((i > 0) ? "," : "") << CsvString(columns[i].value);
+		}
+		else if (i == 0 || columns[i].value.length() > 0) {
+			line << ((i > 0) ? "," : "{") << JsonString(columns[i].name) << ":" << ((columns[i].text) ? JsonString(columns[i].value) : columns[i].value);
+		}
+	}
+	
+	//Lines are written whole, so they are never interleaved with those of other files
+	line << ((output->csv) ? "" : "}") << "\n";
+	cout << line.str();
+}
+
+//Decrypts the checksum of the original file that is stored ahead of a container's payload, using the keys supplied (see KeyMode).
+//Only the header, IV and the checksum itself are read, however large the container is. A tree checksum starts with its root hash,
+//which is all that is decrypted. Notes on what the checksum covers (where it is not the SHA-1 of the whole file) are added to notes.
+string ReadStoredChecksum(const string& path, const vector<int>& keyModes, vector<string>& keySources, string& notes)
+{
+	MeteredIfstream infile(path);
+	if (!infile.is_open()) {
+		throw string("could not open input file");
+	}
+	
+	EFCHeader* header = EFCHeaderFactory::parseHeader(infile);
+	if (header == NULL) {
+		throw string("invalid EFC header");
+	}
+	
+	//The keys are derived and unwrapped by the cipher's decrypter, and the checksum is read by its checksum reader
+	EncryptionStrategy*   encryption = (header->streaming) ? NULL : EncryptionFactory::CreateEncryption(header->cipher, EncryptionMode::Decrypt);
+	StoredChecksumReader* reader     = (header->streaming) ? NULL : EncryptionFactory::CreateStoredChecksumReader(header->cipher);
+	if (encryption == NULL || reader == NULL)
+	{
+		string error = (header->streaming) ? "the checksum of a streamed file is in its trailer, so it can only be read by decrypting the file" : "unsupported encryption algorithm (" + EncryptionFactory::TypeDescription(header->cipher) + ")";
+		delete encryption;
+		delete reader;
+		delete header;
+		throw error;
+	}
+	
+	string checksum = ChecksumUtility::GenerateBlankChecksum();
+	try
+	{
+		//Each password is stretched using the parameters stored in the header (raw keys from keyfiles are used as-is)
+		vector<string> keys;
+		for (size_t i = 0; i < keyModes.size(); ++i)
+		{
+			if (keyModes[i] == KeyMode::Password) {
+				keys.push_back(encryption->GenerateKeyFromPassword(keySources[i], header->kdf));
+			}
+			else if (keyModes[i] == KeyMode::TransformFile) {
+				keys.push_back(encryption->GenerateKeyFromFile(keySources[i]));
+			}
+			else {
+				keys.push_back(keySources[i]);
+			}
+		}
+		
+		//With envelope encryption, the payload is encrypted under the data key, and unwrapping it checks the key.
+		//Otherwise nothing records whether the key is right, so the first key is used as-is.
+		string payloadKey = keys[0];
+		if (header->UsesEnvelope())
+		{
+			bool unwrapped = false;
+			for (size_t k = 0; k < keys.size() && !unwrapped; ++k)
+			{
+				for (size_t i = 0; i < header->wrappedKeys.size() && !unwrapped; ++i) {
+					unwrapped = encryption->UnwrapKey(header->wrappedKeys[i], keys[k], payloadKey);
+				}
+			}
+			
+			if (!unwrapped) {
+				throw string((keys.size() > 1) ? "none of the supplied keys match this file" : "the supplied key does not match this file");
+			}
+		}
+		
+		reader->ReadStoredChecksum(infile, payloadKey, checksum);
+	}
+	catch (const string&)
+	{
+		delete encryption;
+		delete reader;
+		delete header;
+		throw;
+	}
+	
+	if (header->checksumType == ChecksumType::Tree) {
+		notes += "the root of a tree checksum over chunks of " + std::to_string(header->checksumChunkSize) + " bytes";
+	}
+	if (header->IsSparse()) {
+		notes += string((notes.length() > 0) ? ", " : "") + "covering only the data of the sparse file";
+	}
+	
+	delete encryption;
+	delete reader;
+	delete header;
+	return checksum;
+}
+
 int main (int argc, char* argv[])
 {
 	//EFC files have an arbitrary name field which, whilst adding indirection, could pose security problems in certain situations,
@@ -38,7 +246,72 @@ int main (int argc, char* argv[])
 	//We use the special flag --only-filename to suppress all other output and print only the output filename.
 	bool onlyOutputFilename = (argc > 2 && string(argv[2]) == "--only-filename");
 	
-	if (!onlyOutputFilename)
+	//Any other options scan many files at once, printing a line for each of them
+	string format = "";
+	unsigned int threads = std::thread::hardware_concurrency();
+	vector<string> paths;
+	vector<string> lists;
+	
+	//With --checksum, the checksum of the original file stored in each container is decrypted using the supplied keys
+	bool printChecksum = false;
+	vector<int> keyModes;
+	vector<string> keySources;
+	for (int i = 1; i < argc; ++i)
+	{
+		string arg = argv[i];
+		if (arg == "--only-filename") {
+			continue;
+		}
+		else if (arg == "--checksum") {
+			printChecksum = true;
+		}
+		else if ((arg == "-pass" || arg == "-password") && i + 1 < argc)
+		{
+			keyModes.push_back(KeyMode::Password);
+			keySources.push_back(argv[++i]);
+		}
+		else if (arg == "-keyfile" && i + 1 < argc)
+		{
+			keyModes.push_back(KeyMode::KeyFile);
+			keySources.push_back(file_get_contents(argv[++i]));
+			if (keySources.back().length() == 0)
+			{
+				clog << "Error: invalid keyfile supplied!" << endl;
+				return 1;
+			}
+		}
+		else if (arg == "-hkeyfile" && i + 1 < argc)
+		{
+			keyModes.push_back(KeyMode::TransformFile);
+			keySources.push_back(argv[++i]);
+		}
+		else if (arg == "-kdf-memory" && i + 1 < argc)
+		{
+			//The files choose the key derivation cost, so it is limited unless a higher limit is given
+			int limit = atoi(argv[++i]);
+			if (limit <= 0)
+			{
+				clog << "Error: invalid key derivation memory limit!" << endl;
+				return 1;
+			}
+			KeyDerivation::SetMemoryLimit((uint64_t)limit * 1024 * 1024);
+		}
+		else if (arg == "-format" && i + 1 < argc) {
+			format = argv[++i];
+		}
+		else if (arg == "-threads" && i + 1 < argc) {
+			threads = atoi(argv[++i]);
+		}
+		else if (arg == "-list" && i + 1 < argc) {
+			lists.push_back(argv[++i]);
+		}
+		else {
+			paths.push_back(arg);
+		}
+	}
+	bool scan = !printChecksum && (format != "" || lists.size() > 0 || paths.size() > 1 || (paths.size() == 1 && is_dir(paths[0])));
+	
+	if (!onlyOutputFilename && !scan && !printChecksum)
 	{
 		//Output the program's header and copyright information
 		cout << "EFC Header Probe Utility" << endl << "Copyright (c) 2011, Adam Rehn" << endl << endl;
@@ -47,10 +320,101 @@ int main (int argc, char* argv[])
 	//Keep track of whether or not we encounter any errors so we can generate the right exit code
 	bool errorOcurred = false;
 	
-	if (argc > 1)
+	if (printChecksum && paths.size() > 0)
+	{
+		if (keyModes.size() == 0)
+		{
+			clog << "Error: --checksum requires a key (-pass, -keyfile or -hkeyfile)!" << endl;
+			return 1;
+		}
+		
+		//Read the password from stdin, hiding the characters if using a console window
+		for (size_t i = 0; i < keySources.size(); ++i)
+		{
+			if (keyModes[i] == KeyMode::Password && keySources[i] == "-") {
+				keySources[i] = strip_chars("\r", get_cli_password_hidden("Password: "));
+			}
+		}
+		
+		//Each checksum is printed in the same format as sha1sum, so that the output can be compared with that of sha1sum for the original files
+		for (size_t i = 0; i < paths.size(); ++i)
+		{
+			try
+			{
+				string notes = "";
+				string checksum = ReadStoredChecksum(paths[i], keyModes, keySources, notes);
+				cout << hex(checksum.data(), ChecksumUtility::ChecksumSize) << "  " << paths[i] << endl;
+				if (notes.length() > 0) {
+					clog << "Note: the checksum of " << paths[i] << " is " << notes << endl;
+				}
+			}
+			catch (const string& error)
+			{
+				clog << "Error: " << error << " (" << paths[i] << ")!" << endl;
+				errorOcurred = true;
+			}
+		}
+	}
+	else if (scan)
+	{
+		ScanOutput output;
+		output.csv    = (format == "csv");
+		output.files  = 0;
+		output.errors = 0;
+		if (format != "" && format != "json" && format != "csv")
+		{
+			clog << "Error: unknown output format \"" << format << "\" (use json or csv)!" << endl;
+			return 1;
+		}
+		
+		//The paths in each list are added as they are read, so that the list can be piped in from another program (such as find)
+		EFCHeaderScanner scanner(&ReportHeader, &output, threads);
+		for (size_t i = 0; i < paths.size(); ++i) {
+			scanner.Add(paths[i]);
+		}
+		
+		for (size_t i = 0; i < lists.size(); ++i)
+		{
+			ifstream listFile;
+			if (lists[i] != "-") {
+				listFile.open(lists[i].c_str());
+			}
+			
+			istream& list = (lists[i] == "-") ? cin : listFile;
+			if (lists[i] != "-" && !listFile.is_open())
+			{
+				clog << "Error: could not open file list (" << lists[i] << ")!" << endl;
+				errorOcurred = true;
+				continue;
+			}
+			
+			string path = "";
+			while (std::getline(list, path))
+			{
+				if (path.length() > 0 && path[path.length() - 1] == '\r') {
+					path.erase(path.length() - 1);
+				}
+				
+				if (path.length() > 0) {
+					scanner.Add(path);
+				}
+			}
+		}
+		
+		if (output.csv) {
+			cout << CsvColumns() << "\n";
+		}
+		
+		scanner.Run();
+		cout.flush();
+		
+		clog << "Scanned " << output.files << " files, " << output.errors << " of which are not readable EFC containers" << endl;
+		errorOcurred = errorOcurred || (output.errors > 0);
+	}
+	else if (paths.size() > 0)
 	{
 		//Attempt to open the input file
-		MeteredIfstream infile(argv[1]);
+		MeteredIfstream infile(paths[0]);
 		if (infile.is_open())
 		{
 			//Read the file's header
@@ -60,16 +424,59 @@ int main (int argc, char* argv[])
 				if (!onlyOutputFilename)
 				{
 					cout << "Valid EFC File Detected, details as follows..." << endl;
-					cout << "Filename:     " << header->filename << endl;
-					cout << "Compression:  " << CompressionFactory::TypeDescription(header->compression) << endl;
-					cout << "Encryption:   " << EncryptionFactory::TypeDescription(header->cipher) << endl;
-					cout << "Payload size: " << header->payloadSize << " bytes" << endl << endl;
+					cout << "Filename:       " << header->filename << endl;
+					cout << "Compression:    " << CompressionFactory::TypeDescription(header->compression) << endl;
+					cout << "Encryption:     " << EncryptionFactory::TypeDescription(header->cipher) << endl;
+					cout << "Key derivation: " << header->kdf.Description() << endl;
+					if (header->UsesEnvelope()) {
+						cout << "Key slots:      " << header->wrappedKeys.size() << " (envelope encryption)" << endl;
+					}
+					cout << "Checksum:       " << ChecksumUtility::TypeDescription(header->checksumType);
+					if (header->checksumType == ChecksumType::Tree) {
+						cout << " (" << header->checksumChunkCount << " chunks of " << header->checksumChunkSize << " bytes)";
+					}
+					if (header->streaming) {
+						cout << " (in trailer)";
+					}
+					cout << endl;
+					if (header->IsSparse()) {
+						cout << "Sparse file:    " << header->sparseMap.DataLength() << " of " << header->sparseMap.fileSize << " bytes hold data (" << header->sparseMap.offsets.size() << " extents)" << endl;
+					}
+					if (header->plaintextSize > 0) {
+						cout << "Original size:  " << header->plaintextSize << " bytes" << endl;
+					}
+					if (header->IsSplit())
+					{
+						cout << "Volumes:        ";
+						if (header->volumeCount > 0) {
+							cout << header->volumeCount;
+						}
+						else {
+							cout << "unknown number";
+						}
+						cout << " of up to " << header->volumeSize << " bytes" << endl;
+					}
+					if (header->IsDisplaced()) {
+						cout << "Encrypted in place: the first " << header->displacedLength << " bytes of the payload are at offset " << header->displacedTo << endl;
+					}
+					if (header->chunkSize > 0) {
+						cout << "Chunk size:     " << header->chunkSize << " bytes" << endl;
+					}
+					if (header->streaming) {
+						cout << "Payload size:   unknown (streamed, the size is in the trailer)" << endl << endl;
+					}
+					else {
+						cout << "Payload size:   " << header->payloadSize << " bytes" << endl << endl;
+					}
 					cout << "Use --only-filename to print only the filename field's value." << endl;
 				}
 				else
 				{
 					cout << header->filename << endl;
 				}
+				
+				//Free the header
+				delete header;
 			}
 			else {
 				cout << "Error: invalid EFC header!" << endl;
@@ -80,14 +487,22 @@ int main (int argc, char* argv[])
 			infile.close();
 		}
 		else {
-			cout << "Error: could not open input file (" << argv[1] << ")!" << endl;
+			cout << "Error: could not open input file (" << paths[0] << ")!" << endl;
 			errorOcurred = true;
 		}
 	}
 	else
 	{
 		//No arguments were supplied
-		cout << "Usage Syntax:" << endl << "efcinfo INFILE" << endl;
+		cout << "Usage Syntax:" << endl << "efcinfo INFILE [--only-filename]" << endl << "efcinfo [-format json|csv] [-threads N] [-list FILE] [PATH...]" << endl << "efcinfo --checksum [key] INFILE..." << endl << endl;
+		cout << "Given several paths, a directory or a list of paths (one per line, - for stdin), every file" << endl;
+		cout << "in them is scanned on N threads and a line is printed for each, as JSON (the default) or CSV." << endl << endl;
+		cout << "With --checksum, the SHA-1 checksum of the original file stored in each container is decrypted" << endl;
+		cout << "and printed in the same format as sha1sum, without decrypting the rest of the payload. The key is" << endl;
+		cout << "supplied using -pass PASS (- to type it in), -keyfile FILE or -hkeyfile FILE, as for efcdecode." << endl;
+		cout << "Only files with envelope encryption record whether the key is right, so for other files a wrong" << endl;
+		cout << "key prints a wrong checksum. Deriving a key from a password may use up to " << DEFAULT_KDF_MEMORY_LIMIT << " MB, or the" << endl;
+		cout << "limit given with -kdf-memory MB." << endl;
 	}
 	
 	//All done!
@@ -0,0 +1,128 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#include <iostream>
+#include <fstream>
+#include <simple-base/base.h>
+#include "compression/CompressionFactory.h"
+#include "encryption/EncryptionFactory.h"
+#include "utility/MeteredFilestream.h"
+#include "utility/ApplicationConfig.h"
+#include "utility/HeaderJournal.h"
+#include "utility/MemoryOutputBackend.h"
+#include "efc/EFCHeaderFactory.h"
+
+using namespace std;
+
+int main (int argc, char* argv[])
+{
+	//Output the program's header and copyright information
+	clog << "EFC Rekeying Utility" << endl << "Copyright (c) 2011, Adam Rehn" << endl << endl;
+	
+	//Keep track of whether or not we encounter any errors so we can generate the right exit code
+	bool errorOcurred = false;
+	
+	//Check if any arguments were supplied
+	if (argc > 1)
+	{
+		//Parse the command line arguments (this also unwraps the data key using the current key)
+		ApplicationConfig config(argc, argv, ConfigMode::Rekey);
+		
+		//Output any errors generated during argument parsing
+		clog << config.error;
+		
+		//Abort immediately if requested
+		if (config.abort == true) {
+			exit(1);
+		}
+		
+		//Attempt to open the input file
+		MeteredIfstream infile(config.infilePath);
+		if (infile.is_open())
+		{
+			//Read the file's header, and record where it ends
+			EFCHeader* header = EFCHeaderFactory::parseHeader(infile);
+			streampos headerEnd = infile.tellg();
+			infile.close();
+			
+			if (header != NULL && header->UsesEnvelope() && config.keySlot >= 0)
+			{
+				//Create the encryption instance
+				EncryptionStrategy* encryption = EncryptionFactory::CreateEncryption(header->cipher, EncryptionMode::Encrypt);
+				if (encryption != NULL)
+				{
+					//Wrap the data key under the new key, replacing the copy wrapped under the current key
+					header->wrappedKeys[config.keySlot] = encryption->WrapKey(config.dataKey, config.newKey);
+					
+					//The wrapped key is the same length, so the header can be rewritten in place without touching the payload.
+					//It is built in memory first, so that nothing is written unless it is, and the original is kept in a journal until it has been replaced.
+					string rewritten = "";
+					MeteredOfstream buffer(new MemoryOutputBackend(rewritten), config.infilePath);
+					header->WriteHeader(buffer);
+					buffer.close();
+					
+					try
+					{
+						HeaderJournal journal(config.infilePath);
+						journal.Rewrite(headerEnd, rewritten);
+						clog << "Done!" << endl;
+					}
+					catch (const string& error)
+					{
+						clog << "Error: " << error << "!" << endl;
+						errorOcurred = true;
+					}
+					
+					//Free the encryption instance
+					delete encryption;
+				}
+				else {
+					clog << "Error: unsupported encryption algorithm (" << header->cipher << ")!" << endl;
+					errorOcurred = true;
+				}
+			}
+			else if (header != NULL) {
+				clog << "Error: file does not use envelope encryption, it must be decrypted and re-encrypted!" << endl;
+				errorOcurred = true;
+			}
+			else {
+				clog << "Error: invalid EFC header!" << endl;
+				errorOcurred = true;
+			}
+			
+			//Free the header
+			delete header;
+		}
+		else {
+			clog << "Error: could not open input file (" << config.infilePath << ")!" << endl;
+			errorOcurred = true;
+		}
+	}
+	else
+	{
+		//No arguments were supplied
+		clog << "No arguments supplied." << endl << "Use \"efcrekey --help\" for usage syntax." << endl;
+	}
+	
+	//All done!
+	return (errorOcurred == true);
+}
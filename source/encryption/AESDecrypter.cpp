@@ -21,6 +21,18 @@
 //  SOFTWARE.
 */
 #include "AESDecrypter.h"
+#include "../utility/AlignedBufferPool.h"
+
+AESDecrypter::AESDecrypter()
+{
+	decryptedData = NULL;
+	decryptedSize = 0;
+}
+
+AESDecrypter::~AESDecrypter()
+{
+	AlignedBufferPool::Release(decryptedData, decryptedSize);
+}
 
 void AESDecrypter::InitialiseKeyAndIV()
 {
@@ -41,23 +53,61 @@ void AESDecrypter::InitialiseKeyAndIV()
 	delete[] decryptedCheksum;
 }
 
-void AESDecrypter::PreCompressionStep(char* inputData, size_t length)
+const char* AESDecrypter::PreCompressionStep(const char* inputData, size_t length)
 {
 	//Decrypt the data prior to decompression
+	if (decryptedSize < length)
+	{
+		AlignedBufferPool::Release(decryptedData, decryptedSize);
+		decryptedData = AlignedBufferPool::Acquire(length);
+		decryptedSize = length;
+	}
 	
-	//Copy the current block
-	char* currentBlock = new char[length];
-	memcpy(currentBlock, inputData, length);
-	
-	//Perform the decryption
-	d.ProcessData((byte*)inputData, (const byte*)currentBlock, length);
-	
-	//Free the buffer
-	delete[] currentBlock;
+	d.ProcessData((byte*)decryptedData, (const byte*)inputData, length);
+	return decryptedData;
 }
 
-void AESDecrypter::PostCompressionStep(string& outputData)
+void AESDecrypter::PostCompressionStep(char* outputData, size_t length)
 {
 	//Write the block
-	outputFile->write(outputData.data(), outputData.length());
+	outputFile->write(outputData, length);
+}
+
+void AESDecrypter::AttachPlaintextChecksum(StreamingChecksum* plaintextChecksum)
+{
+	outputFile->AttachChecksum(plaintextChecksum);
+}
+
+size_t AESDecrypter::TrailerHoldback()
+{
+	return AES_STREAM_TRAILERSIZE;
+}
+
+void AESDecrypter::TransformTrailer(const char* heldData, size_t length, string& storedTrailer, string& computedTrailer)
+{
+	//If the input was cut short, the trailer is missing and is left blank so that it doesn't match
+	if (length != AES_STREAM_TRAILERSIZE)
+	{
+		storedTrailer = string(AES_STREAM_TRAILERSIZE, 0);
+		return;
+	}
+	
+	//Decrypt the trailer as a continuation of the payload
+	storedTrailer.assign(length, '\0');
+	d.ProcessData((byte*)&storedTrailer[0], (const byte*)heldData, length);
+}
+
+void AESDecrypter::ReadStoredChecksum(MeteredIfstream& inputFile, string& key, string& checksum)
+{
+	this->inputFile  = &inputFile;
+	this->outputFile = NULL;
+	this->key        = &key;
+	this->checksum   = &checksum;
+	
+	//The checksum is the first thing encrypted, so it can be decrypted on its own without touching the payload
+	size_t length = checksum.length();
+	InitialiseKeyAndIV();
+	if (inputFile.gcount() != length) {
+		throw string("The file ends before the stored checksum");
+	}
 }
@@ -24,15 +24,30 @@
 #define _AES_DECRYPTER
 
 #include "AESEncryption.h"
+#include "StoredChecksumReader.h"
 
-class AESDecrypter : public AESEncryption
+class AESDecrypter : public AESEncryption, public StoredChecksumReader
 {
+	public:
+		AESDecrypter();
+		~AESDecrypter();
+		
+		void ReadStoredChecksum(MeteredIfstream& inputFile, string& key, string& checksum);
+	
 	private:
 		void InitialiseKeyAndIV();
-		void PreCompressionStep(char* inputData, size_t length);
-		void PostCompressionStep(string& outputData);
+		const char* PreCompressionStep(const char* inputData, size_t length);
+		void PostCompressionStep(char* outputData, size_t length);
+		
+		void AttachPlaintextChecksum(StreamingChecksum* plaintextChecksum);
+		size_t TrailerHoldback();
+		void TransformTrailer(const char* heldData, size_t length, string& storedTrailer, string& computedTrailer);
 		
 		CFB_FIPS_Mode<AES>::Decryption d;
+		
+		//Holds the decrypted data, since the input data may be a read-only view of the file
+		char*  decryptedData;
+		size_t decryptedSize;
 };
 
 #endif
@@ -22,6 +22,7 @@
 */
 #include "AESEncrypter.h"
 
+#include <algorithm>
 #include <iostream>
 using namespace std;
 
@@ -45,23 +46,104 @@ void AESEncrypter::InitialiseKeyAndIV()
 	delete[] chksm;
 }
 
-void AESEncrypter::PreCompressionStep(char* inputData, size_t length)
+const char* AESEncrypter::PreCompressionStep(const char* inputData, size_t length)
 {
 	//Do nothing here, we encrypt the compressed data to increase performance
+	return inputData;
 }
 
-void AESEncrypter::PostCompressionStep(string& outputData)
+void AESEncrypter::PostCompressionStep(char* outputData, size_t length)
 {
-	//Fill a buffer with the current block of data
-	char* currentBlock = new char[outputData.length()];
-	memcpy(currentBlock, outputData.data(), outputData.length());
-	
-	//Encrypt the block
-	e.ProcessData((byte*)currentBlock, (const byte*)outputData.data(), outputData.length());
+	//Encrypt the block in place
+	e.ProcessData((byte*)outputData, (const byte*)outputData, length);
 	
 	//Write the block
-	outputFile->write(currentBlock, outputData.length());
+	outputFile->write(outputData, length);
+}
+
+void AESEncrypter::AttachPlaintextChecksum(StreamingChecksum* plaintextChecksum)
+{
+	inputFile->AttachChecksum(plaintextChecksum);
+}
+
+size_t AESEncrypter::TrailerHoldback()
+{
+	//All of the input is payload
+	return 0;
+}
+
+void AESEncrypter::TransformTrailer(const char* heldData, size_t length, string& storedTrailer, string& computedTrailer)
+{
+	//Encrypt the trailer as a continuation of the payload and write it to the file
+	storedTrailer = computedTrailer;
+	string encryptedTrailer(storedTrailer.length(), '\0');
+	e.ProcessData((byte*)&encryptedTrailer[0], (const byte*)storedTrailer.data(), storedTrailer.length());
+	outputFile->write(encryptedTrailer.data(), encryptedTrailer.length());
+}
+
+void AESEncrypter::TransformBuffers(vector<string>& payloads, vector<string>& checksums, vector<MeteredOfstream*>& outputFiles, string& key)
+{
+	//Each file's CFB chain is inherently serial, but the chains are independent. By encrypting one block from
+	//every file in a single call, the AES implementation can pipeline the blocks (as it does for CTR mode).
+	AES::Encryption cipher((byte*)key.data(), AES256_KEYSIZE);
+	AutoSeededRandomPool prng;
+	
+	//The encrypted stream for each file is the checksum followed by the payload, just as in TransformFile
+	size_t count = payloads.size();
+	vector<string> streams(count);
+	for (size_t i = 0; i < count; ++i) {
+		streams[i] = checksums[i] + payloads[i];
+	}
+	
+	//Process the streams from longest to shortest, so that the streams with blocks remaining are always a prefix of the order
+	vector<size_t> order(count);
+	for (size_t i = 0; i < count; ++i) {
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [&streams](size_t a, size_t b) { return streams[a].length() > streams[b].length(); });
+	
+	//The feedback registers start out holding a random IV for each stream, which is written ahead of the ciphertext
+	byte* registers = new byte[count * AES::BLOCKSIZE];
+	byte* input     = new byte[count * AES::BLOCKSIZE];
+	prng.GenerateBlock(registers, count * AES::BLOCKSIZE);
+	for (size_t lane = 0; lane < count; ++lane) {
+		outputFiles[order[lane]]->write((char*)(registers + lane * AES::BLOCKSIZE), AES::BLOCKSIZE);
+	}
+	
+	size_t active = count;
+	for (size_t offset = 0; active > 0; offset += AES::BLOCKSIZE)
+	{
+		//Drop the streams that have been fully encrypted
+		while (active > 0 && streams[order[active - 1]].length() <= offset) {
+			--active;
+		}
+		
+		//Gather the next block of each stream (the final block of a stream may be partial)
+		for (size_t lane = 0; lane < active; ++lane)
+		{
+			string& stream   = streams[order[lane]];
+			size_t blockSize = std::min((size_t)AES::BLOCKSIZE, stream.length() - offset);
+			memset(input + lane * AES::BLOCKSIZE, 0, AES::BLOCKSIZE);
+			memcpy(input + lane * AES::BLOCKSIZE, stream.data() + offset, blockSize);
+		}
+		
+		//C = E(previous C) ^ P, for every active stream at once, which becomes the next feedback register
+		cipher.AdvancedProcessBlocks(registers, input, registers, active * AES::BLOCKSIZE, AES::Encryption::BT_AllowParallel);
+		
+		//Scatter the ciphertext back into the streams
+		for (size_t lane = 0; lane < active; ++lane)
+		{
+			string& stream   = streams[order[lane]];
+			size_t blockSize = std::min((size_t)AES::BLOCKSIZE, stream.length() - offset);
+			stream.replace(offset, blockSize, (char*)(registers + lane * AES::BLOCKSIZE), blockSize);
+		}
+	}
+	
+	//Write the encrypted streams
+	for (size_t i = 0; i < count; ++i) {
+		outputFiles[i]->write(streams[i].data(), streams[i].length());
+	}
 	
-	//Free the buffer
-	delete[] currentBlock;
+	delete[] registers;
+	delete[] input;
 }
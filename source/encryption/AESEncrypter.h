@@ -24,13 +24,21 @@
 #define _AES_ENCRYPTER
 
 #include "AESEncryption.h"
+#include "BatchEncryption.h"
 
-class AESEncrypter : public AESEncryption
+class AESEncrypter : public AESEncryption, public BatchEncryption
 {
+	public:
+		void TransformBuffers(vector<string>& payloads, vector<string>& checksums, vector<MeteredOfstream*>& outputFiles, string& key);
+	
 	private:
 		void InitialiseKeyAndIV();
-		void PreCompressionStep(char* inputData, size_t length);
-		void PostCompressionStep(string& outputData);
+		const char* PreCompressionStep(const char* inputData, size_t length);
+		void PostCompressionStep(char* outputData, size_t length);
+		
+		void AttachPlaintextChecksum(StreamingChecksum* plaintextChecksum);
+		size_t TrailerHoldback();
+		void TransformTrailer(const char* heldData, size_t length, string& storedTrailer, string& computedTrailer);
 		
 		CFB_FIPS_Mode<AES>::Encryption e;
 };
@@ -21,6 +21,12 @@
 //  SOFTWARE.
 */
 #include "AESEncryption.h"
+#include "../utility/MemoryBudget.h"
+
+#include <algorithm>
+
+//Reading less than this at a time would make the per-block overheads significant
+#define MIN_READ_SIZE (64*1024)
 
 void AESEncryption::TransformFile(CompressionStrategy* compressionTransform, MeteredIfstream& inputFile, MeteredOfstream& outputFile, string& key, string& checksum)
 {
@@ -33,35 +39,83 @@ void AESEncryption::TransformFile(CompressionStrategy* compressionTransform, Met
 	//Initialise the cipher with the key and IV
 	InitialiseKeyAndIV();
 	
-	//Create a buffer to hold the data
-	size_t bufSize = 512*1024;
-	char* buffer = new char[bufSize];
+	//Transform the whole of the input
+	string heldData = "";
+	this->TransformPayload(compressionTransform, 0, heldData);
+}
+
+void AESEncryption::TransformStream(CompressionStrategy* compressionTransform, MeteredIfstream& inputFile, MeteredOfstream& outputFile, string& key, string& storedTrailer, string& computedTrailer)
+{
+	//Streams have no checksum ahead of the payload
+	string noChecksum = "";
+	this->inputFile  = &inputFile;
+	this->outputFile = &outputFile;
+	this->key        = &key;
+	this->checksum   = &noChecksum;
+	
+	//Initialise the cipher with the key and IV
+	InitialiseKeyAndIV();
+	
+	//Checksum the plaintext as it passes through, leaving the trailer (if we are reading one) untouched at the end of the input
+	StreamingChecksum plaintextChecksum(ChecksumType::SHA1);
+	this->AttachPlaintextChecksum(&plaintextChecksum);
+	string heldData = "";
+	this->TransformPayload(compressionTransform, this->TrailerHoldback(), heldData);
+	this->AttachPlaintextChecksum(NULL);
+	
+	//Build the trailer for the plaintext we have seen
+	uint64_t plaintextLength = plaintextChecksum.Length();
+	if (endianness() != LITTLE_ENDIAN) {
+		flipBytes((char*)&plaintextLength, sizeof(plaintextLength));
+	}
+	computedTrailer = plaintextChecksum.Result();
+	computedTrailer.append((char*)&plaintextLength, sizeof(plaintextLength));
 	
-	//Loop through the data
+	this->TransformTrailer(heldData.data(), heldData.length(), storedTrailer, computedTrailer);
+}
+
+void AESEncryption::TransformPayload(CompressionStrategy* compressionTransform, size_t holdback, string& heldData)
+{
+	//Each chunk of input may be copied (by the stream, to hold it back, or to decrypt it), so the budget must cover two copies.
+	//Under a memory limit, smaller chunks than the input stream prefers may be used.
+	size_t chunkSize = inputFile->ChunkSize();
+	size_t reserved  = MemoryBudget::Reserve(2 * chunkSize, 2 * std::min(chunkSize, (size_t)MIN_READ_SIZE));
+	size_t bufSize   = reserved / 2;
+	
+	//Loop through the data, using it in place where the input file is memory mapped
+	const char* inputData = NULL;
 	size_t bytesRead = 0;
-	while ((bytesRead = inputFile.read(buffer, bufSize)))
+	while ((bytesRead = inputFile->ReadView(&inputData, bufSize)))
 	{
-		//Create a buffer to hold the current block of data (only the bytes read)
-		char* inputData = new char[bytesRead];
-		
-		//Copy the current block into the buffer
-		memcpy(inputData, buffer, bytesRead);
-		
-		//Perform the pre-(de)compression step
-		PreCompressionStep(inputData, bytesRead);
-		
-		//Perform the (de)compression
-		string transformedData = compressionTransform->TransformInput(inputData, bytesRead, !inputFile.BytesRemaining());
+		//We can't tell where the payload ends until we reach the end of the input, so the held back bytes are carried over to the next block
+		if (holdback > 0)
+		{
+			heldData.append(inputData, bytesRead);
+			bytesRead = (heldData.length() > holdback) ? heldData.length() - holdback : 0;
+			inputData = heldData.data();
+		}
 		
-		//Perform the post-(de)compression step
-		PostCompressionStep(transformedData);
+		bool finalBlock = !inputFile->BytesRemaining();
+		if (bytesRead > 0)
+		{
+			//Perform the pre-(de)compression step
+			const char* preparedData = PreCompressionStep(inputData, bytesRead);
+			
+			//Perform the (de)compression, with each piece of output passed to the post-(de)compression step as it is produced
+			compressionTransform->TransformInput(preparedData, bytesRead, finalBlock, *this);
+		}
 		
-		//Free the buffer
-		delete[] inputData;
+		if (holdback > 0) {
+			heldData.erase(0, bytesRead);
+		}
 	}
 	
-	//Free the buffer
-	delete[] buffer;
+	MemoryBudget::Release(reserved);
+}
+
+void AESEncryption::Write(char* output, size_t length)
+{
+	PostCompressionStep(output, length);
 }
 
 string AESEncryption::GenerateKeyFromPassword(string password)
@@ -84,6 +138,17 @@ string AESEncryption::GenerateKeyFromPassword(string password)
 	return key;
 }
 
+string AESEncryption::GenerateKeyFromPassword(string password, KeyDerivation& kdf)
+{
+	//Passwords from the default header are simply hashed
+	if (kdf.algorithm == KeyDerivationType::SHA256) {
+		return this->GenerateKeyFromPassword(password);
+	}
+	
+	//Otherwise, stretch the password to the length of an AES-256 key
+	return kdf.DeriveKey(password, AES256_KEYSIZE);
+}
+
 string AESEncryption::GenerateKeyFromFile(string filename)
 {
 	//Create a buffer to hold the generated key
@@ -120,3 +185,62 @@ string AESEncryption::GenerateKeyFromFile(string filename)
 	//Return the string containing the key
 	return key;
 }
+
+string AESEncryption::GenerateDataKey()
+{
+	//Generate a random key of the correct length
+	byte theKey[AES256_KEYSIZE];
+	AutoSeededRandomPool prng;
+	prng.GenerateBlock(theKey, sizeof(theKey));
+	
+	string key;
+	key.assign((char*)theKey, sizeof(theKey));
+	return key;
+}
+
+string AESEncryption::WrapKey(string& dataKey, string& wrappingKey)
+{
+	//Generate a random nonce
+	byte nonce[AES_WRAP_NONCESIZE];
+	AutoSeededRandomPool prng;
+	prng.GenerateBlock(nonce, sizeof(nonce));
+	
+	//Encrypt the data key with AES-GCM, so that the tag can be used to check the wrapping key when unwrapping
+	byte* encryptedKey = new byte[dataKey.length()];
+	byte tag[AES_WRAP_TAGSIZE];
+	GCM<AES>::Encryption e;
+	e.SetKeyWithIV((byte*)wrappingKey.data(), AES256_KEYSIZE, nonce, sizeof(nonce));
+	e.EncryptAndAuthenticate(encryptedKey, tag, sizeof(tag), nonce, sizeof(nonce), NULL, 0, (const byte*)dataKey.data(), dataKey.length());
+	
+	//The wrapped key is the nonce, followed by the encrypted key and the tag
+	string wrappedKey;
+	wrappedKey.append((char*)nonce, sizeof(nonce));
+	wrappedKey.append((char*)encryptedKey, dataKey.length());
+	wrappedKey.append((char*)tag, sizeof(tag));
+	delete[] encryptedKey;
+	
+	return wrappedKey;
+}
+
+bool AESEncryption::UnwrapKey(const string& wrappedKey, string& wrappingKey, string& dataKey)
+{
+	//Make sure the wrapped key is the expected length
+	if (wrappedKey.length() != AES_WRAP_NONCESIZE + AES256_KEYSIZE + AES_WRAP_TAGSIZE || wrappingKey.length() < AES256_KEYSIZE) {
+		return false;
+	}
+	
+	const byte* nonce        = (const byte*)wrappedKey.data();
+	const byte* encryptedKey = nonce + AES_WRAP_NONCESIZE;
+	const byte* tag          = encryptedKey + AES256_KEYSIZE;
+	
+	//Decrypt the data key, verifying the tag
+	byte theKey[AES256_KEYSIZE];
+	GCM<AES>::Decryption d;
+	d.SetKeyWithIV((byte*)wrappingKey.data(), AES256_KEYSIZE, nonce, AES_WRAP_NONCESIZE);
+	if (!d.DecryptAndVerify(theKey, tag, AES_WRAP_TAGSIZE, nonce, AES_WRAP_NONCESIZE, NULL, 0, encryptedKey, AES256_KEYSIZE)) {
+		return false;
+	}
+	
+	dataKey.assign((char*)theKey, sizeof(theKey));
+	return true;
+}
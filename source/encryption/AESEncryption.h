@@ -24,31 +24,61 @@
 #define _AES_ENCRYPTION
 
 #include "EncryptionStrategy.h"
+#include "../utility/StreamingChecksum.h"
 
 #include <cryptopp/osrng.h>
 #include <cryptopp/aes.h>
 #include <cryptopp/ccm.h>
+#include <cryptopp/gcm.h>
 #include <cryptopp/sha.h>
 
 using CryptoPP::AutoSeededRandomPool;
 using CryptoPP::AES;
 using CryptoPP::CFB_FIPS_Mode;
+using CryptoPP::GCM;
 using CryptoPP::SHA256;
 
 #define AES256_KEYSIZE SHA256::DIGESTSIZE
 
-class AESEncryption : public EncryptionStrategy
+//Wrapped data keys consist of a random GCM nonce, the encrypted key, and the authentication tag
+#define AES_WRAP_NONCESIZE 12
+#define AES_WRAP_TAGSIZE   16
+
+//The trailer of a stream consists of the SHA-1 checksum of the plaintext, followed by its length as a 64-bit little endian integer
+#define AES_STREAM_TRAILERSIZE (ChecksumUtility::ChecksumSize + 8)
+
+class AESEncryption : public EncryptionStrategy, public CompressionSink
 {
 	public:
 		void TransformFile(CompressionStrategy* compressionTransform, MeteredIfstream& inputFile, MeteredOfstream& outputFile, string& key, string& checksum);
+		void TransformStream(CompressionStrategy* compressionTransform, MeteredIfstream& inputFile, MeteredOfstream& outputFile, string& key, string& storedTrailer, string& computedTrailer);
 		
 		string GenerateKeyFromPassword(string password);
+		string GenerateKeyFromPassword(string password, KeyDerivation& kdf);
 		string GenerateKeyFromFile(string filename);
+		
+		string GenerateDataKey();
+		string WrapKey(string& dataKey, string& wrappingKey);
+		bool   UnwrapKey(const string& wrappedKey, string& wrappingKey, string& dataKey);
+		
+		//Receives the (de)compressed data, and passes it to PostCompressionStep()
+		void Write(char* output, size_t length);
 	
 	protected:
 		virtual void InitialiseKeyAndIV() = 0;
-		virtual void PreCompressionStep(char* inputData, size_t length) = 0;
-		virtual void PostCompressionStep(string& outputData) = 0;
+		//Returns the data to be (de)compressed, which is either the input data itself or a transformed copy of it
+		virtual const char* PreCompressionStep(const char* inputData, size_t length) = 0;
+		//Receives each piece of the (de)compressed data, which may be modified in place
+		virtual void PostCompressionStep(char* outputData, size_t length) = 0;
+		
+		//Streaming hooks: attaches the checksum to whichever file holds the plaintext, determines how many bytes at the end of
+		//the input are the trailer rather than the payload, and writes (or decrypts) the trailer once the payload is done
+		virtual void AttachPlaintextChecksum(StreamingChecksum* plaintextChecksum) = 0;
+		virtual size_t TrailerHoldback() = 0;
+		virtual void TransformTrailer(const char* heldData, size_t length, string& storedTrailer, string& computedTrailer) = 0;
+		
+		//Helper function to process the input, holding back the specified number of bytes from the end
+		void TransformPayload(CompressionStrategy* compressionTransform, size_t holdback, string& heldData);
 		
 		MeteredIfstream* inputFile;
 		MeteredOfstream* outputFile;
@@ -0,0 +1,45 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _BATCH_ENCRYPTION
+#define _BATCH_ENCRYPTION
+
+#include "../utility/MeteredFilestream.h"
+
+#include <string>
+#include <vector>
+using std::string;
+using std::vector;
+
+//Batch encryption: encrypts several (already compressed) payloads under the same key in a single pass, writing the same output to
+//each file as EncryptionStrategy::TransformFile would. Only the encrypters of ciphers that can interleave the files implement this
+//(see EncryptionFactory::CreateBatchEncryption), so it is a separate role rather than part of every EncryptionStrategy. Implementations
+//may copy every checksum and payload while encrypting them, so callers account for twice their size against the memory limit.
+class BatchEncryption
+{
+	public:
+		virtual ~BatchEncryption();
+		
+		virtual void TransformBuffers(vector<string>& payloads, vector<string>& checksums, vector<MeteredOfstream*>& outputFiles, string& key) = 0;
+};
+
+#endif
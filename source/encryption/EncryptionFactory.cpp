@@ -46,6 +46,34 @@ EncryptionStrategy* EncryptionFactory::CreateEncryption(int algorithm, bool mode
 	}
 }
 
+BatchEncryption* EncryptionFactory::CreateBatchEncryption(int algorithm)
+{
+	switch (algorithm)
+	{
+		//AES with a 256-bit key in CFB Mode
+		case EncryptionType::AES_256_CFB:
+			return new AESEncrypter();
+		
+		//Unrecognised encryption algorithm
+		default:
+			return NULL;
+	}
+}
+
+StoredChecksumReader* EncryptionFactory::CreateStoredChecksumReader(int algorithm)
+{
+	switch (algorithm)
+	{
+		//AES with a 256-bit key in CFB Mode
+		case EncryptionType::AES_256_CFB:
+			return new AESDecrypter();
+		
+		//Unrecognised encryption algorithm
+		default:
+			return NULL;
+	}
+}
+
 string EncryptionFactory::TypeDescription(int algorithm)
 {
 	switch (algorithm)
@@ -29,6 +29,8 @@ using std::string;
 using std::vector;
 
 #include "EncryptionStrategy.h"
+#include "BatchEncryption.h"
+#include "StoredChecksumReader.h"
 
 //Neater usage syntax in C++ than an enum
 namespace EncryptionMode
@@ -48,6 +50,12 @@ class EncryptionFactory
 	public:
 		static EncryptionStrategy* CreateEncryption(int algorithm, bool mode);
 		
+		//Creates an encrypter that can encrypt several files in a single pass, or returns NULL if the cipher doesn't support it
+		static BatchEncryption*    CreateBatchEncryption(int algorithm);
+		
+		//Creates a decrypter that can decrypt the stored checksum on its own, or returns NULL if the cipher doesn't support it
+		static StoredChecksumReader* CreateStoredChecksumReader(int algorithm);
+		
 		//Gives a verbose description of a given cipher
 		static string              TypeDescription(int algorithm);
 		
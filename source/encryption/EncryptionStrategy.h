@@ -25,11 +25,14 @@
 
 #include "../compression/CompressionStrategy.h"
 #include "../utility/MeteredFilestream.h"
+#include "KeyDerivation.h"
 
 #include <simple-base/base.h>
 #include <string>
 #include <fstream>
+#include <vector>
 using std::string;
+using std::vector;
 using std::ifstream;
 using std::ofstream;
 
@@ -40,8 +43,21 @@ class EncryptionStrategy
 		
 		virtual void TransformFile(CompressionStrategy* compressionTransform, MeteredIfstream& inputFile, MeteredOfstream& outputFile, string& key, string& checksum) = 0;
 		
+		//Single pass variant of TransformFile for input and output that can't be seeked, such as pipes. Rather than preceding the payload,
+		//the SHA-1 checksum and size of the plaintext follow it in an encrypted trailer. Retrieves the trailer that was written (or read),
+		//along with the trailer computed from the plaintext that passed through, so the two can be compared.
+		virtual void TransformStream(CompressionStrategy* compressionTransform, MeteredIfstream& inputFile, MeteredOfstream& outputFile, string& key, string& storedTrailer, string& computedTrailer) = 0;
+		
 		virtual string GenerateKeyFromPassword(string password) = 0;
+		virtual string GenerateKeyFromPassword(string password, KeyDerivation& kdf) = 0;
 		virtual string GenerateKeyFromFile(string filename) = 0;
+		
+		//Envelope encryption: the payload is encrypted under a random data key, which is stored wrapped under the user's key
+		virtual string GenerateDataKey() = 0;
+		virtual string WrapKey(string& dataKey, string& wrappingKey) = 0;
+		
+		//Unwraps a data key, returning false if the wrapping key does not match
+		virtual bool UnwrapKey(const string& wrappedKey, string& wrappingKey, string& dataKey) = 0;
 };
 
 #endif
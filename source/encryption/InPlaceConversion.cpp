@@ -0,0 +1,539 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#include "InPlaceConversion.h"
+#include "EncryptionFactory.h"
+#include "../efc/EFCHeaderFactory.h"
+#include "../efc/EFCBinaryHeader.h"
+#include "../utility/AlignedBufferPool.h"
+#include "../utility/ChecksumUtility.h"
+#include "../utility/MemoryBudget.h"
+#include "../utility/MemoryInputBackend.h"
+#include "../utility/RateLimiter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <zlib.h>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+//Converting less than this at a time would make the per-chunk flushes significant
+#define MIN_CONVERSION_CHUNK (256*1024)
+
+InPlaceConversion::InPlaceConversion(const string& file, int mode, const IOOptions& options) : journal(file)
+{
+	this->file = file;
+	this->mode = mode;
+	readLimiter  = options.readLimiter;
+	writeLimiter = options.writeLimiter;
+	dropCache    = options.dropCache;
+	fd   = -1;
+	used = 0;
+	plaintextChecksum = NULL;
+}
+
+InPlaceConversion::~InPlaceConversion()
+{
+	#ifndef _WIN32
+	if (fd != -1) {
+		close(fd);
+	}
+	#endif
+}
+
+bool InPlaceConversion::Interrupted()
+{
+	return (journal.Exists() && journal.Load());
+}
+
+EFCHeader* InPlaceConversion::InterruptedHeader(const string& file, int& mode)
+{
+	ConversionJournal journal(file);
+	if (!journal.Exists() || !journal.Load()) {
+		return NULL;
+	}
+	
+	//The journal holds a copy of the header, which is parsed from memory rather than reading the journal a second time
+	MeteredIfstream stream(new MemoryInputBackend(journal.prefix.data(), journal.prefix.length()), file);
+	EFCHeader* header = EFCHeaderFactory::parseHeader(stream);
+	if (header != NULL)
+	{
+		header->filename = replace_extension(basename(file), get_extension(header->filename));
+		mode = journal.mode;
+	}
+	
+	return header;
+}
+
+void InPlaceConversion::Encrypt(EFCHeader* header, const string& checksum, const string& key)
+{
+	EFCBinaryHeader* binaryHeader = dynamic_cast<EFCBinaryHeader*>(header);
+	if (binaryHeader == NULL || header->compression != CompressionType::None || header->cipher != EncryptionType::AES_256_CFB) {
+		throw string("Only files with a binary header, AES encryption and no compression can be encrypted in place");
+	}
+	
+	cipher.SetKey((const byte*)key.data(), AES256_KEYSIZE);
+	
+	#ifndef _WIN32
+	fd = open(file.c_str(), O_RDWR);
+	struct stat details;
+	if (fd == -1 || fstat(fd, &details) != 0 || !S_ISREG(details.st_mode)) {
+		throw string("Could not open " + file + " for writing");
+	}
+	uint64_t size = details.st_size;
+	#else
+	throw string("In-place conversion is not supported on this platform");
+	uint64_t size = 0;
+	#endif
+	
+	//The layout fields are a fixed size, so the header is the same length once they are filled in
+	header->payloadSize     = AES::BLOCKSIZE + checksum.length() + size;
+	header->displacedOffset = (size > 0) ? 1 : 0;
+	header->displacedLength = header->displacedOffset;
+	header->displacedTo     = header->displacedOffset;
+	uint64_t headerLength = binaryHeader->Serialise().length();
+	uint64_t prefixLength = headerLength + AES::BLOCKSIZE + checksum.length();
+	
+	//The start of the file is moved to the end, past the bytes that the header, IV and checksum will take up
+	journal.mode            = mode;
+	journal.plaintextSize   = size;
+	journal.displacedOffset = prefixLength;
+	journal.displacedLength = std::min(prefixLength, size);
+	journal.displacedTo     = std::max(prefixLength, size);
+	journal.headerLength    = headerLength;
+	if (size > 0)
+	{
+		header->displacedOffset = journal.displacedOffset;
+		header->displacedLength = journal.displacedLength;
+		header->displacedTo     = journal.displacedTo;
+	}
+	
+	string prefix = binaryHeader->Serialise();
+	if (prefix.length() != headerLength) {
+		throw string("The header changed length while it was being prepared");
+	}
+	
+	//The checksum is encrypted following a random IV, just as TransformFile does
+	AutoSeededRandomPool prng;
+	prng.GenerateBlock(feedback, sizeof(feedback));
+	prefix.append((char*)feedback, sizeof(feedback));
+	prefix.append(checksum);
+	
+	cipher.ProcessBlock(feedback, reg);
+	used = 0;
+	this->Transform(&prefix[headerLength + AES::BLOCKSIZE], checksum.length(), true);
+	
+	//Nothing in the file is modified until the journal is on disk
+	journal.prefix = prefix;
+	journal.Create();
+	this->Run();
+}
+
+void InPlaceConversion::Decrypt(EFCHeader* header, uint64_t headerLength, const string& key, StreamingChecksum* plaintextChecksum)
+{
+	if (dynamic_cast<EFCBinaryHeader*>(header) == NULL || header->compression != CompressionType::None || header->cipher != EncryptionType::AES_256_CFB) {
+		throw string("Only files with a binary header, AES encryption and no compression can be decrypted in place");
+	}
+	
+	if (header->IsSparse() || header->IsSplit() || header->streaming) {
+		throw string("Only files that were encrypted in place can be decrypted in place");
+	}
+	
+	cipher.SetKey((const byte*)key.data(), AES256_KEYSIZE);
+	this->plaintextChecksum = plaintextChecksum;
+	
+	#ifndef _WIN32
+	fd = open(file.c_str(), O_RDWR);
+	struct stat details;
+	if (fd == -1 || fstat(fd, &details) != 0 || !S_ISREG(details.st_mode)) {
+		throw string("Could not open " + file + " for writing");
+	}
+	uint64_t size = details.st_size;
+	#else
+	throw string("In-place conversion is not supported on this platform");
+	uint64_t size = 0;
+	#endif
+	
+	//The payload holds the IV, the checksum and then the original file. An empty file has nothing to displace, so its container is laid out as usual.
+	uint64_t checksumLength = (header->checksumType == ChecksumType::Tree) ? ChecksumUtility::TreeChecksumLength(header->checksumChunkCount) : ChecksumUtility::ChecksumSize;
+	if (header->IsDisplaced() == false && (uint64_t)header->payloadSize != AES::BLOCKSIZE + checksumLength) {
+		throw string("Only files that were encrypted in place can be decrypted in place");
+	}
+	
+	uint64_t prefixLength = (header->IsDisplaced()) ? header->displacedOffset : (uint64_t)header->payloadSize + headerLength;
+	uint64_t plaintextSize = (uint64_t)header->payloadSize + headerLength - prefixLength;
+	
+	uint64_t displacedLength = std::min(prefixLength, plaintextSize);
+	uint64_t displacedTo     = std::max(prefixLength, plaintextSize);
+	if (prefixLength < headerLength + AES::BLOCKSIZE || (uint64_t)header->payloadSize + headerLength < prefixLength || size != displacedTo + displacedLength ||
+	    (header->IsDisplaced() && (header->displacedLength != displacedLength || header->displacedTo != displacedTo)))
+	{
+		throw string("The layout of " + file + " does not match its header (it may be incomplete)");
+	}
+	
+	journal.mode            = mode;
+	journal.plaintextSize   = plaintextSize;
+	journal.displacedOffset = prefixLength;
+	journal.displacedLength = displacedLength;
+	journal.displacedTo     = displacedTo;
+	journal.headerLength    = headerLength;
+	journal.prefix.resize(prefixLength);
+	this->ReadAt(&journal.prefix[0], prefixLength, 0);
+	
+	journal.Create();
+	this->Run();
+}
+
+void InPlaceConversion::Resume(const string& key)
+{
+	if (!journal.Load() || journal.mode != mode) {
+		throw string("There is no interrupted conversion of " + file + " to resume");
+	}
+	
+	cipher.SetKey((const byte*)key.data(), AES256_KEYSIZE);
+	
+	#ifndef _WIN32
+	fd = open(file.c_str(), O_RDWR);
+	#endif
+	if (fd == -1) {
+		throw string("Could not open " + file + " for writing");
+	}
+	
+	this->Run();
+}
+
+string InPlaceConversion::StoredChecksum()
+{
+	//A conversion that was resumed after the checksum was last needed hasn't decrypted it yet
+	if (checksum.length() == 0 && journal.prefix.length() > 0) {
+		this->Restart();
+	}
+	
+	return checksum;
+}
+
+void InPlaceConversion::Run()
+{
+	//Chunks are read into a single buffer, which may be smaller than the largest chunk under a memory limit
+	size_t reserved = MemoryBudget::Reserve(ConversionJournal::MaxChunkSize, MIN_CONVERSION_CHUNK);
+	char*  buffer   = AlignedBufferPool::Acquire(reserved);
+	
+	//Each chunk is already on disk by the time the next one has been journalled, so its pages can be dropped as we go
+	if (dropCache) {
+		advisor.AttachOutput(fd);
+	}
+	
+	ConversionJournal::Checkpoint latest = journal.Latest();
+	try
+	{
+		string head = "";
+		if (latest.phase < ConversionPhase::Body)
+		{
+			head = this->ConvertHead();
+			this->ConvertBody(journal.displacedLength, buffer, reserved);
+		}
+		else if (latest.phase == ConversionPhase::Body)
+		{
+			//The chunk that was being written when we were interrupted may have been only partly written
+			this->LoadState(latest);
+			this->RepairChunk(latest, buffer);
+			this->ConvertBody(latest.offset + latest.length, buffer, reserved);
+		}
+		
+		//Everything else has been transformed, so the start of the file can be overwritten
+		if (latest.phase < ConversionPhase::Finish) {
+			this->RecordPhase(ConversionPhase::Finish);
+		}
+		
+		if (mode == EncryptionMode::Encrypt)
+		{
+			//The header, IV and checksum take the place of the bytes that were moved to the end
+			this->WriteAt(journal.prefix.data(), journal.prefix.length(), 0);
+			this->Sync();
+		}
+		else
+		{
+			//The start of the original file takes the place of the header, IV and checksum (decrypted again if we were interrupted)
+			if (latest.phase < ConversionPhase::Truncate)
+			{
+				if (latest.phase >= ConversionPhase::Body) {
+					head = this->ConvertHead();
+				}
+				
+				this->WriteAt(head.data(), head.length(), 0);
+				this->RecordPhase(ConversionPhase::Truncate);
+			}
+			
+			//The displaced bytes at the end are no longer needed
+			#ifndef _WIN32
+			if (ftruncate(fd, journal.plaintextSize) != 0 || fsync(fd) != 0) {
+				throw string("Could not truncate " + file);
+			}
+			#endif
+		}
+	}
+	catch (...)
+	{
+		MemoryBudget::Release(reserved);
+		AlignedBufferPool::Release(buffer, reserved);
+		throw;
+	}
+	
+	MemoryBudget::Release(reserved);
+	AlignedBufferPool::Release(buffer, reserved);
+	advisor.Finish();
+	
+	//The conversion is complete once the journal is gone
+	journal.Remove();
+}
+
+void InPlaceConversion::Restart()
+{
+	//The IV is the first feedback, and the checksum is the first ciphertext
+	memcpy(feedback, journal.prefix.data() + journal.headerLength, sizeof(feedback));
+	cipher.ProcessBlock(feedback, reg);
+	used = 0;
+	
+	checksum = journal.prefix.substr(journal.headerLength + AES::BLOCKSIZE);
+	this->Transform(&checksum[0], checksum.length(), false);
+}
+
+void InPlaceConversion::SaveState(ConversionJournal::Checkpoint& checkpoint)
+{
+	//Only ciphertext is stored, since the keystream would reveal the plaintext
+	memcpy(checkpoint.feedback, feedback, sizeof(feedback));
+	memset(checkpoint.partial, 0, sizeof(checkpoint.partial));
+	memcpy(checkpoint.partial, reg, used);
+	checkpoint.used = used;
+}
+
+void InPlaceConversion::LoadState(const ConversionJournal::Checkpoint& checkpoint)
+{
+	memcpy(feedback, checkpoint.feedback, sizeof(feedback));
+	cipher.ProcessBlock(feedback, reg);
+	memcpy(reg, checkpoint.partial, checkpoint.used);
+	used = checkpoint.used;
+}
+
+void InPlaceConversion::Transform(char* data, size_t n, bool encrypt)
+{
+	size_t i = 0;
+	while (i < n)
+	{
+		//Use up the rest of the current block's keystream, one byte at a time until we are back on a block boundary
+		size_t blockBytes = std::min(n - i, (size_t)AES::BLOCKSIZE - used);
+		for (size_t j = 0; j < blockBytes; ++j)
+		{
+			byte input  = data[i + j];
+			byte output = input ^ reg[used + j];
+			reg[used + j] = (encrypt) ? output : input;
+			data[i + j]   = output;
+		}
+		
+		i    += blockBytes;
+		used += blockBytes;
+		
+		//The completed block of ciphertext becomes the feedback for the next one
+		if (used == AES::BLOCKSIZE)
+		{
+			memcpy(feedback, reg, sizeof(feedback));
+			cipher.ProcessBlock(feedback, reg);
+			used = 0;
+		}
+	}
+}
+
+void InPlaceConversion::PageChecksums(const char* data, uint64_t offset, size_t length, vector<uint32_t>& checksums)
+{
+	checksums.clear();
+	for (uint64_t position = offset; position < offset + length;)
+	{
+		uint64_t pageEnd = std::min(offset + length, (position / ConversionJournal::PageSize + 1) * ConversionJournal::PageSize);
+		checksums.push_back(crc32(0L, (const Bytef*)(data + (position - offset)), pageEnd - position));
+		position = pageEnd;
+	}
+}
+
+string InPlaceConversion::ConvertHead()
+{
+	//The displaced bytes come straight after the checksum in the cipher stream
+	this->Restart();
+	string head(journal.displacedLength, '\0');
+	if (head.length() == 0) {
+		return head;
+	}
+	
+	if (mode == EncryptionMode::Encrypt)
+	{
+		//The start of the original file is untouched until the end, so this can simply be repeated if we are interrupted
+		this->ReadAt(&head[0], head.length(), 0);
+		this->Transform(&head[0], head.length(), true);
+		this->WriteAt(head.data(), head.length(), journal.displacedTo);
+	}
+	else
+	{
+		this->ReadAt(&head[0], head.length(), journal.displacedTo);
+		this->Transform(&head[0], head.length(), false);
+		if (plaintextChecksum != NULL) {
+			plaintextChecksum->Input(head.data(), head.length());
+		}
+	}
+	
+	return head;
+}
+
+void InPlaceConversion::ConvertBody(uint64_t offset, char* buffer, size_t bufferSize)
+{
+	uint64_t end = journal.plaintextSize;
+	while (offset < end)
+	{
+		//Chunks end on a page boundary, so no page is shared by two of them
+		uint64_t chunkEnd = std::min(end, offset + bufferSize);
+		if (chunkEnd < end) {
+			chunkEnd -= chunkEnd % ConversionJournal::PageSize;
+		}
+		
+		size_t length = chunkEnd - offset;
+		this->ReadAt(buffer, length, offset);
+		
+		ConversionJournal::Checkpoint checkpoint;
+		checkpoint.phase  = ConversionPhase::Body;
+		checkpoint.offset = offset;
+		checkpoint.length = length;
+		this->SaveState(checkpoint);
+		PageChecksums(buffer, offset, length, checkpoint.before);
+		this->Transform(buffer, length, (mode == EncryptionMode::Encrypt));
+		PageChecksums(buffer, offset, length, checkpoint.after);
+		
+		if (plaintextChecksum != NULL && mode == EncryptionMode::Decrypt) {
+			plaintextChecksum->Input(buffer, length);
+		}
+		
+		//The previous chunk must be on disk before the journal moves past it, and the journal must be on disk before this chunk is written
+		this->Sync();
+		journal.Record(checkpoint);
+		this->WriteAt(buffer, length, offset);
+		advisor.Written(chunkEnd);
+		offset = chunkEnd;
+	}
+}
+
+void InPlaceConversion::RepairChunk(const ConversionJournal::Checkpoint& checkpoint, char* buffer)
+{
+	this->ReadAt(buffer, checkpoint.length, checkpoint.offset);
+	
+	//Each page is either as it was before the chunk was transformed, or as it is afterwards. The cipher state only depends on the
+	//ciphertext, so pages that were already written are transformed back (in a copy) just to advance it.
+	bool   forward = (mode == EncryptionMode::Encrypt);
+	string written = "";
+	size_t page    = 0;
+	uint64_t end   = checkpoint.offset + checkpoint.length;
+	for (uint64_t position = checkpoint.offset; position < end; ++page)
+	{
+		uint64_t pageEnd = std::min(end, (position / ConversionJournal::PageSize + 1) * ConversionJournal::PageSize);
+		char*  data   = buffer + (position - checkpoint.offset);
+		size_t length = pageEnd - position;
+		
+		uint32_t pageChecksum = crc32(0L, (const Bytef*)data, length);
+		if (page < checkpoint.before.size() && pageChecksum == checkpoint.before[page]) {
+			this->Transform(data, length, forward);
+		}
+		else if (page < checkpoint.after.size() && pageChecksum == checkpoint.after[page])
+		{
+			written.assign(data, length);
+			this->Transform(&written[0], length, !forward);
+		}
+		else {
+			throw string("The page at offset " + std::to_string(position) + " of " + file + " was damaged while it was being written, and can't be recovered");
+		}
+		
+		position = pageEnd;
+	}
+	
+	this->WriteAt(buffer, checkpoint.length, checkpoint.offset);
+}
+
+void InPlaceConversion::RecordPhase(uint8_t phase)
+{
+	//Everything written before the new phase must be on disk first
+	this->Sync();
+	
+	ConversionJournal::Checkpoint checkpoint;
+	checkpoint.phase  = phase;
+	checkpoint.offset = 0;
+	checkpoint.length = 0;
+	this->SaveState(checkpoint);
+	journal.Record(checkpoint);
+}
+
+void InPlaceConversion::ReadAt(char* s, size_t n, uint64_t offset)
+{
+	#ifndef _WIN32
+	size_t total = 0;
+	while (total < n)
+	{
+		ssize_t result = pread(fd, s + total, n - total, offset + total);
+		if (result <= 0) {
+			throw string("Could not read from " + file);
+		}
+		total += result;
+	}
+	#endif
+	
+	//Throttle the reads if a maximum rate was requested
+	if (readLimiter != NULL) {
+		readLimiter->Consume(n);
+	}
+}
+
+void InPlaceConversion::WriteAt(const char* s, size_t n, uint64_t offset)
+{
+	#ifndef _WIN32
+	size_t total = 0;
+	while (total < n)
+	{
+		ssize_t result = pwrite(fd, s + total, n - total, offset + total);
+		if (result <= 0) {
+			throw string("Could not write to " + file);
+		}
+		total += result;
+	}
+	#endif
+	
+	//Throttle the writes if a maximum rate was requested
+	if (writeLimiter != NULL) {
+		writeLimiter->Consume(n);
+	}
+}
+
+void InPlaceConversion::Sync()
+{
+	#ifndef _WIN32
+	if (fdatasync(fd) != 0) {
+		throw string("Could not flush " + file + " to disk");
+	}
+	#endif
+}
@@ -0,0 +1,122 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _IN_PLACE_CONVERSION
+#define _IN_PLACE_CONVERSION
+
+#include "AESEncryption.h"
+#include "../utility/ConversionJournal.h"
+#include "../utility/IOOptions.h"
+#include "../utility/PageCacheAdvisor.h"
+
+class EFCHeader;
+class RateLimiter;
+
+//Encrypts a file in place, transforming its own blocks rather than writing a separate output file, or decrypts a file that was
+//encrypted this way. Only containers without compression can be converted, since their payload is the same size as the file.
+//The start of the file is encrypted and moved to the end to make room for the header, IV and checksum (see EFCHeader::displacedOffset),
+//and the rest is encrypted where it is. The file is converted in chunks, each of which is recorded in the journal (along with the
+//cipher state at its start) before it is written, so a conversion interrupted by a crash or power loss resumes where it left off.
+//Every chunk is flushed to disk before the next one is journalled, so the file is always durable (and O_DIRECT isn't used).
+class InPlaceConversion
+{
+	public:
+		//The mode is EncryptionMode::Encrypt or EncryptionMode::Decrypt. The reads and writes are throttled by the options' rate limiters,
+		//and the converted chunks are dropped from the page cache if requested.
+		InPlaceConversion(const string& file, int mode, const IOOptions& options = IOOptions::Defaults());
+		~InPlaceConversion();
+		
+		//Determines if an earlier conversion of the file was interrupted, so that it can be finished with Resume()
+		bool Interrupted();
+		
+		//Reads the header of an interrupted conversion of a file from its journal (since the header in the file may not have been written yet,
+		//or may already have been overwritten), retrieving the mode of the conversion. Returns NULL if there is no conversion to resume.
+		static EFCHeader* InterruptedHeader(const string& file, int& mode);
+		
+		//Encrypts the file under the payload key. The header must be a binary header without compression, and its payload size and layout are filled in here.
+		void Encrypt(EFCHeader* header, const string& checksum, const string& key);
+		
+		//Decrypts a displaced container, whose header (of the specified length) has been parsed, adding the plaintext to the checksum as it is restored
+		void Decrypt(EFCHeader* header, uint64_t headerLength, const string& key, StreamingChecksum* plaintextChecksum);
+		
+		//Finishes an interrupted conversion
+		void Resume(const string& key);
+		
+		//The checksum of the original file that is stored in the container
+		string StoredChecksum();
+		
+	private:
+		string            file;
+		int               mode;
+		int               fd;
+		ConversionJournal journal;
+		
+		RateLimiter*     readLimiter;
+		RateLimiter*     writeLimiter;
+		bool             dropCache;
+		PageCacheAdvisor advisor;
+		AES::Encryption   cipher;
+		
+		//The cipher state (CFB with full block feedback). The register holds the keystream for the current block, with the bytes
+		//used so far replaced by their ciphertext, so that it becomes the feedback for the next block once it is complete.
+		byte   feedback[AES::BLOCKSIZE];
+		byte   reg[AES::BLOCKSIZE];
+		size_t used;
+		
+		string             checksum;
+		StreamingChecksum* plaintextChecksum;
+		
+		//Runs the conversion from the latest checkpoint in the journal, removing the journal once it is complete
+		void Run();
+		
+		//Sets the cipher state to the start of the payload (just past the checksum), decrypting the checksum
+		void Restart();
+		
+		//Saves and restores the cipher state
+		void SaveState(ConversionJournal::Checkpoint& checkpoint);
+		void LoadState(const ConversionJournal::Checkpoint& checkpoint);
+		
+		//Encrypts or decrypts bytes in place, advancing the cipher state
+		void Transform(char* data, size_t n, bool encrypt);
+		
+		//Computes the CRC-32 of each page of a chunk
+		static void PageChecksums(const char* data, uint64_t offset, size_t length, vector<uint32_t>& checksums);
+		
+		//Transforms the displaced bytes at the start of the original file (or the end of the container), returning the result
+		string ConvertHead();
+		
+		//Transforms the rest of the file in chunks, from the specified offset onwards
+		void ConvertBody(uint64_t offset, char* buffer, size_t bufferSize);
+		
+		//Finishes transforming the chunk that was being written when the conversion was interrupted, some pages of which may already have been written
+		void RepairChunk(const ConversionJournal::Checkpoint& checkpoint, char* buffer);
+		
+		//Records the start of a phase that has no chunks
+		void RecordPhase(uint8_t phase);
+		
+		//Helpers for reading, writing and flushing the file, which throw on failure
+		void ReadAt(char* s, size_t n, uint64_t offset);
+		void WriteAt(const char* s, size_t n, uint64_t offset);
+		void Sync();
+};
+
+#endif
@@ -0,0 +1,303 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#include "KeyDerivation.h"
+#include "../utility/MemoryBudget.h"
+
+#include <cryptopp/osrng.h>
+#include <cryptopp/pwdbased.h>
+#include <cryptopp/salsa.h>
+#include <cryptopp/sha.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using CryptoPP::AutoSeededRandomPool;
+using CryptoPP::PKCS5_PBKDF2_HMAC;
+using CryptoPP::Salsa20_Core;
+using CryptoPP::SHA256;
+using CryptoPP::word32;
+using std::vector;
+
+KeyDerivation::KeyDerivation()
+{
+	this->algorithm    = KeyDerivationType::SHA256;
+	this->salt         = "";
+	this->costExponent = 0;
+	this->blockSize    = 0;
+	this->lanes        = 0;
+}
+
+void KeyDerivation::UseScrypt()
+{
+	this->algorithm    = KeyDerivationType::Scrypt;
+	this->costExponent = KeyDerivation::DefaultCostExponent;
+	this->blockSize    = KeyDerivation::DefaultBlockSize;
+	this->lanes        = 1;
+	
+	//Generate a new random salt
+	byte saltBytes[KeyDerivation::SaltSize];
+	AutoSeededRandomPool prng;
+	prng.GenerateBlock(saltBytes, sizeof(saltBytes));
+	this->salt.assign((char*)saltBytes, sizeof(saltBytes));
+}
+
+string KeyDerivation::DeriveKey(string password, size_t keyLength)
+{
+	//Refuse to run with parameters we could not have generated, or that would take more memory than we are allowed
+	if (this->algorithm != KeyDerivationType::Scrypt || !this->IsValid()) {
+		throw string("Unsupported key derivation parameters");
+	}
+	
+	if (this->MemoryRequired() > KeyDerivation::MemoryLimit()) {
+		throw string("Key derivation would require " + std::to_string(this->MemoryRequired() / (1024*1024)) + " MB, more than the limit of " + std::to_string(KeyDerivation::MemoryLimit() / (1024*1024)) + " MB");
+	}
+	
+	//The working set is charged to the memory budget, alongside any buffers that are already open
+	size_t required = (size_t)this->MemoryRequired();
+	try {
+		MemoryBudget::Reserve(required, required);
+	}
+	catch (const string&) {
+		throw string("Key derivation would require " + std::to_string(required / (1024*1024)) + " MB, more than is left within the memory limit alongside the open buffers");
+	}
+	
+	//Create a buffer to hold the generated key
+	byte* theKey = new byte[keyLength];
+	
+	//Run scrypt over the password (RFC 7914). PBKDF2 expands the password and salt into a block for each lane, the lanes are mixed
+	//independently of each other, and PBKDF2 compresses the mixed blocks into the key. Each lane is mixed on its own thread.
+	size_t laneLength = 128 * (size_t)this->blockSize;
+	uint64_t cost = (uint64_t)1 << this->costExponent;
+	PKCS5_PBKDF2_HMAC<SHA256> pbkdf2;
+	try
+	{
+		vector<byte> lanes(laneLength * this->lanes);
+		pbkdf2.DeriveKey(&lanes[0], lanes.size(), 0, (const byte*)password.data(), password.length(), (const byte*)this->salt.data(), this->salt.length(), 1);
+		
+		std::atomic<bool> failed(false);
+		auto mix = [&](uint32_t lane)
+		{
+			try {
+				KeyDerivation::MixLane(&lanes[lane * laneLength], this->blockSize, cost);
+			}
+			catch (const std::bad_alloc&) {
+				failed = true;
+			}
+		};
+		
+		//The first lane is mixed on this thread, while the others are mixed on threads of their own
+		vector<std::thread> threads;
+		for (uint32_t lane = 1; lane < this->lanes; ++lane) {
+			threads.push_back(std::thread(mix, lane));
+		}
+		mix(0);
+		for (size_t i = 0; i < threads.size(); ++i) {
+			threads[i].join();
+		}
+		
+		if (failed) {
+			throw string("Could not allocate the memory for key derivation");
+		}
+		
+		pbkdf2.DeriveKey(theKey, keyLength, 0, (const byte*)password.data(), password.length(), &lanes[0], lanes.size(), 1);
+	}
+	catch (...)
+	{
+		delete[] theKey;
+		MemoryBudget::Release(required);
+		throw;
+	}
+	
+	//Copy the key into a string and free the buffer
+	string key;
+	key.assign((char*)theKey, keyLength);
+	delete[] theKey;
+	MemoryBudget::Release(required);
+	
+	return key;
+}
+
+void KeyDerivation::MixLane(uint8_t* lane, uint32_t blockSize, uint64_t cost)
+{
+	//The lane is mixed as little endian 32-bit words, in 2r blocks of 16 words (the size of the Salsa20 state)
+	size_t words = 32 * (size_t)blockSize;
+	vector<word32> x(words);
+	vector<word32> y(words);
+	vector<word32> scratch(words * cost);
+	for (size_t i = 0; i < words; ++i) {
+		x[i] = (word32)lane[i*4] | ((word32)lane[i*4 + 1] << 8) | ((word32)lane[i*4 + 2] << 16) | ((word32)lane[i*4 + 3] << 24);
+	}
+	
+	//Fill the scratch space with each successive mix of the lane
+	for (uint64_t i = 0; i < cost; ++i)
+	{
+		memcpy(&scratch[i * words], &x[0], words * sizeof(word32));
+		KeyDerivation::BlockMix(&x[0], &y[0], blockSize);
+		x.swap(y);
+	}
+	
+	//Then mix in the entries of the scratch space chosen by the lane itself (by the first word of its last block)
+	for (uint64_t i = 0; i < cost; ++i)
+	{
+		uint64_t entry = ((uint64_t)x[words - 16] | ((uint64_t)x[words - 15] << 32)) & (cost - 1);
+		for (size_t w = 0; w < words; ++w) {
+			x[w] ^= scratch[entry * words + w];
+		}
+		
+		KeyDerivation::BlockMix(&x[0], &y[0], blockSize);
+		x.swap(y);
+	}
+	
+	for (size_t i = 0; i < words; ++i)
+	{
+		lane[i*4]     = (uint8_t)(x[i]);
+		lane[i*4 + 1] = (uint8_t)(x[i] >> 8);
+		lane[i*4 + 2] = (uint8_t)(x[i] >> 16);
+		lane[i*4 + 3] = (uint8_t)(x[i] >> 24);
+	}
+}
+
+void KeyDerivation::BlockMix(const uint32_t* input, uint32_t* output, uint32_t blockSize)
+{
+	//Each block is chained through Salsa20/8, starting from the last one. The even blocks go to the first half of the output, and the odd blocks to the second.
+	word32 state[16];
+	memcpy(state, input + (2 * blockSize - 1) * 16, sizeof(state));
+	for (uint32_t i = 0; i < 2 * blockSize; ++i)
+	{
+		for (size_t w = 0; w < 16; ++w) {
+			state[w] ^= input[i * 16 + w];
+		}
+		Salsa20_Core(state, 8);
+		memcpy(output + (i / 2 + (i % 2) * blockSize) * 16, state, sizeof(state));
+	}
+}
+
+bool KeyDerivation::IsValid()
+{
+	switch (this->algorithm)
+	{
+		case KeyDerivationType::SHA256:
+			return true;
+		
+		case KeyDerivationType::Scrypt:
+			return
+			(
+				this->costExponent >= KeyDerivation::MinCostExponent && this->costExponent <= KeyDerivation::MaxCostExponent &&
+				this->blockSize >= 1 && this->blockSize <= KeyDerivation::MaxBlockSize &&
+				this->lanes >= 1 && this->lanes <= KeyDerivation::MaxLanes &&
+				this->MemoryRequired() <= KeyDerivation::MaxMemoryRequired &&
+				this->salt.length() > 0
+			);
+		
+		default:
+			return false;
+	}
+}
+
+uint64_t KeyDerivation::MemoryRequired()
+{
+	if (this->algorithm != KeyDerivationType::Scrypt) {
+		return 0;
+	}
+	
+	//Each lane requires 128 * r * N bytes of scratch space
+	return (uint64_t)128 * this->blockSize * ((uint64_t)1 << this->costExponent) * this->lanes;
+}
+
+uint64_t& KeyDerivation::Limit()
+{
+	static uint64_t limit = (uint64_t)DEFAULT_KDF_MEMORY_LIMIT * 1024 * 1024;
+	return limit;
+}
+
+void KeyDerivation::SetMemoryLimit(uint64_t limit)
+{
+	Limit() = limit;
+}
+
+uint64_t KeyDerivation::MemoryLimit()
+{
+	return Limit();
+}
+
+string KeyDerivation::Description()
+{
+	switch (this->algorithm)
+	{
+		case KeyDerivationType::SHA256:
+			return "SHA-256";
+		
+		case KeyDerivationType::Scrypt:
+		{
+			std::stringstream description;
+			description << "scrypt (N=2^" << (int)this->costExponent << ", r=" << this->blockSize << ", p=" << this->lanes << ", " << this->MemoryRequired() / (1024*1024) << " MB)";
+			return description.str();
+		}
+		
+		default:
+			return "[Unrecognised Algorithm]";
+	}
+}
+
+KeyDerivation KeyDerivation::Calibrate(unsigned int targetMilliseconds, uint32_t lanes, uint64_t maxMemory)
+{
+	//Start with the cheapest supported cost
+	KeyDerivation kdf;
+	kdf.UseScrypt();
+	kdf.lanes        = lanes;
+	kdf.costExponent = KeyDerivation::MinCostExponent;
+	if (kdf.MemoryRequired() > std::min(maxMemory, KeyDerivation::MemoryLimit())) {
+		return kdf;
+	}
+	
+	double elapsed = kdf.MeasureDerivation();
+	
+	//Each increment of the exponent doubles both the time and the memory, so keep doubling while the doubled time is closer to the target
+	while (kdf.costExponent < KeyDerivation::MaxCostExponent && elapsed * 3 <= targetMilliseconds * 2.0)
+	{
+		//Stop if the next cost would exceed the memory limit
+		kdf.costExponent++;
+		if (kdf.MemoryRequired() > std::min(maxMemory, KeyDerivation::MemoryLimit()))
+		{
+			kdf.costExponent--;
+			break;
+		}
+		
+		elapsed = kdf.MeasureDerivation();
+	}
+	
+	return kdf;
+}
+
+double KeyDerivation::MeasureDerivation()
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	this->DeriveKey("calibration", 32);
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
@@ -0,0 +1,101 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _KEY_DERIVATION
+#define _KEY_DERIVATION
+
+#include <stdint.h>
+#include <string>
+using std::string;
+
+//Default upper bound (in megabytes) on the memory that a key derivation may use, or that calibration may select
+#define DEFAULT_KDF_MEMORY_LIMIT 1024
+
+//Neater usage syntax in C++ than an enum
+namespace KeyDerivationType
+{
+	static const int SHA256 = 0;  //A single unsalted SHA-256 digest of the password (the only type supported by the default header)
+	static const int Scrypt = 1;  //The memory-hard scrypt function, with a random salt
+}
+
+class KeyDerivation
+{
+	public:
+		KeyDerivation();
+		
+		//Selects the scrypt function with the default cost parameters and a new random salt
+		void UseScrypt();
+		
+		//Derives a key of the specified length from a password using scrypt, throwing an error if it would exceed the memory limit
+		string DeriveKey(string password, size_t keyLength);
+		
+		//Determines if the cost parameters are within the supported range
+		bool IsValid();
+		
+		//The amount of memory (in bytes) used by a derivation with the current parameters. Every lane is mixed at once on its own thread,
+		//so this grows with the number of lanes, while the running time only grows with N and r (given enough cores).
+		uint64_t MemoryRequired();
+		
+		//The most memory (in bytes) that a derivation may use. The parameters read from a file are chosen by whoever wrote it,
+		//so this stops a file from demanding an unreasonable amount of memory and time. Defaults to DEFAULT_KDF_MEMORY_LIMIT megabytes.
+		static void SetMemoryLimit(uint64_t limit);
+		static uint64_t MemoryLimit();
+		
+		//Gives a verbose description of the algorithm and its parameters
+		string Description();
+		
+		//Finds the scrypt cost that brings the derivation time closest to the target on this host, without exceeding the memory limit
+		//(or the limit set with SetMemoryLimit). If even the cheapest cost exceeds it, that cost is returned without being measured.
+		static KeyDerivation Calibrate(unsigned int targetMilliseconds, uint32_t lanes, uint64_t maxMemory);
+		
+		//Algorithm and parameters
+		int32_t  algorithm;     //The derivation function used, i.e: KeyDerivationType::[...]
+		string   salt;          //The random salt
+		uint8_t  costExponent;  //The scrypt CPU/memory cost, N = 2^costExponent
+		uint32_t blockSize;     //The scrypt block size, r
+		uint32_t lanes;         //The scrypt parallelisation, p (lanes are computed independently, on threads of their own)
+		
+		static const int SaltSize            = 16;
+		static const int DefaultCostExponent = 16;
+		static const int DefaultBlockSize    = 8;
+		static const int MinCostExponent     = 10;
+		static const int MaxCostExponent     = 24;
+		static const int MaxBlockSize        = 32;
+		static const int MaxLanes            = 64;
+		
+		//The parameters are also limited jointly, since the memory (and time) grows with the product of N, r and p
+		static const uint64_t MaxMemoryRequired = (uint64_t)64*1024*1024*1024;
+	
+	private:
+		static uint64_t& Limit();
+		
+		//Helper function to measure the time (in milliseconds) taken by a derivation with the current parameters
+		double MeasureDerivation();
+		
+		//Mixes one of scrypt's lanes in place (ROMix), using 128 * r * N bytes of scratch space
+		static void MixLane(uint8_t* lane, uint32_t blockSize, uint64_t cost);
+		
+		//Mixes the 2r blocks of 16 words of a lane through Salsa20/8 (BlockMix)
+		static void BlockMix(const uint32_t* input, uint32_t* output, uint32_t blockSize);
+};
+
+#endif
@@ -0,0 +1,42 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _STORED_CHECKSUM_READER
+#define _STORED_CHECKSUM_READER
+
+#include "../utility/MeteredFilestream.h"
+
+#include <string>
+using std::string;
+
+//Reads the checksum of the original file that is stored, encrypted, ahead of a container's payload, without decrypting the payload.
+//Only the decrypters of ciphers whose checksum can be decrypted on its own implement this (see EncryptionFactory::CreateStoredChecksumReader).
+class StoredChecksumReader
+{
+	public:
+		virtual ~StoredChecksumReader();
+		
+		//Reads the IV and decrypts the checksum that follows it (into a blank checksum of the right length), without reading any of the payload
+		virtual void ReadStoredChecksum(MeteredIfstream& inputFile, string& key, string& checksum) = 0;
+};
+
+#endif
@@ -0,0 +1,245 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#include "AlignedBufferPool.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace
+{
+	//Sums the transparent huge pages (in bytes) that the kernel reports for the mappings overlapping any of the address ranges
+	uint64_t TransparentHugePages(const vector< std::pair<uintptr_t, uintptr_t> >& ranges)
+	{
+		uint64_t total = 0;
+		std::ifstream smaps("/proc/self/smaps");
+		string line;
+		bool overlaps = false;
+		while (std::getline(smaps, line))
+		{
+			//Each mapping begins with its address range, followed by its statistics
+			unsigned long long first = 0, last = 0;
+			char separator = 0;
+			std::istringstream fields(line);
+			if (line.find("AnonHugePages:") == 0)
+			{
+				string label;
+				uint64_t kilobytes = 0;
+				fields >> label >> kilobytes;
+				if (overlaps) {
+					total += kilobytes * 1024;
+				}
+			}
+			else if ((fields >> std::hex >> first >> separator >> last) && separator == '-')
+			{
+				overlaps = false;
+				for (size_t i = 0; i < ranges.size(); ++i) {
+					overlaps = overlaps || (first < ranges[i].second && last > ranges[i].first);
+				}
+			}
+		}
+		
+		return total;
+	}
+}
+
+std::mutex& AlignedBufferPool::Lock()
+{
+	static std::mutex lock;
+	return lock;
+}
+
+std::multimap<size_t, char*>& AlignedBufferPool::FreeBuffers()
+{
+	static std::multimap<size_t, char*> freeBuffers;
+	return freeBuffers;
+}
+
+AlignedBufferPool::Arena& AlignedBufferPool::CurrentArena()
+{
+	static Arena arena = { false, NULL, 0, vector<Region>() };
+	return arena;
+}
+
+char* AlignedBufferPool::Acquire(size_t size)
+{
+	//Reuse a released buffer of the same size, if there is one
+	{
+		std::lock_guard<std::mutex> guard(Lock());
+		std::multimap<size_t, char*>::iterator existing = FreeBuffers().find(size);
+		if (existing != FreeBuffers().end())
+		{
+			char* buffer = existing->second;
+			FreeBuffers().erase(existing);
+			return buffer;
+		}
+		
+		//Otherwise, carve one out of the arena if we are using huge pages
+		if (CurrentArena().enabled)
+		{
+			char* carved = AllocateFromArena(size);
+			if (carved != NULL) {
+				return carved;
+			}
+		}
+	}
+	
+	//Otherwise, allocate a new one
+	void* buffer = NULL;
+	#ifdef _WIN32
+	buffer = _aligned_malloc(size, Alignment);
+	#else
+	if (posix_memalign(&buffer, Alignment, size) != 0) {
+		buffer = NULL;
+	}
+	#endif
+	
+	if (buffer == NULL) {
+		throw string("Could not allocate an aligned I/O buffer");
+	}
+	
+	return (char*)buffer;
+}
+
+char* AlignedBufferPool::AllocateFromArena(size_t size)
+{
+	Arena& arena = CurrentArena();
+	size_t rounded = ((size + Alignment - 1) / Alignment) * Alignment;
+	if (rounded > arena.remaining)
+	{
+		//Map a new region, keeping whichever of the old and new regions has more space left over for the next buffer
+		Region region;
+		if (MapRegion(((rounded + HugePageSize - 1) / HugePageSize) * HugePageSize, region) == false) {
+			return NULL;
+		}
+		
+		arena.regions.push_back(region);
+		if (region.length - rounded <= arena.remaining) {
+			return region.start;
+		}
+		
+		arena.next      = region.start;
+		arena.remaining = region.length;
+	}
+	
+	char* buffer = arena.next;
+	arena.next      += rounded;
+	arena.remaining -= rounded;
+	return buffer;
+}
+
+bool AlignedBufferPool::MapRegion(size_t length, Region& region)
+{
+	#ifdef _WIN32
+	return false;
+	#else
+	region.length   = length;
+	region.reserved = false;
+	void* mapping   = MAP_FAILED;
+	
+	//Use the huge pages set aside by the administrator, if there are enough of them
+	#ifdef MAP_HUGETLB
+	mapping = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	region.reserved = (mapping != MAP_FAILED);
+	#endif
+	
+	if (mapping == MAP_FAILED)
+	{
+		//Transparent huge pages can only back the parts of a mapping that are aligned to a huge page, so map an extra page and trim the ends
+		char* oversized = (char*)mmap(NULL, length + HugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (oversized == (char*)MAP_FAILED) {
+			return false;
+		}
+		
+		char* aligned = (char*)((((uintptr_t)oversized) + HugePageSize - 1) & ~((uintptr_t)HugePageSize - 1));
+		if (aligned > oversized) {
+			munmap(oversized, aligned - oversized);
+		}
+		munmap(aligned + length, (oversized + HugePageSize) - aligned);
+		
+		#ifdef MADV_HUGEPAGE
+		madvise(aligned, length, MADV_HUGEPAGE);
+		#endif
+		
+		mapping = aligned;
+	}
+	
+	//Touch every page now, rather than faulting them in one at a time while processing the data
+	region.start = (char*)mapping;
+	for (size_t offset = 0; offset < length; offset += Alignment) {
+		region.start[offset] = 0;
+	}
+	
+	return true;
+	#endif
+}
+
+void AlignedBufferPool::UseHugePages(bool enable)
+{
+	std::lock_guard<std::mutex> guard(Lock());
+	CurrentArena().enabled = enable;
+}
+
+string AlignedBufferPool::HugePageReport()
+{
+	std::lock_guard<std::mutex> guard(Lock());
+	
+	//Reserved huge pages back the whole region, while transparent ones are only used where the kernel could find them
+	uint64_t mapped   = 0;
+	uint64_t reserved = 0;
+	vector< std::pair<uintptr_t, uintptr_t> > advised;
+	const vector<Region>& regions = CurrentArena().regions;
+	for (size_t i = 0; i < regions.size(); ++i)
+	{
+		mapped += regions[i].length;
+		if (regions[i].reserved) {
+			reserved += regions[i].length;
+		}
+		else {
+			advised.push_back(std::make_pair((uintptr_t)regions[i].start, (uintptr_t)(regions[i].start + regions[i].length)));
+		}
+	}
+	
+	uint64_t transparent = (advised.size() > 0) ? TransparentHugePages(advised) : 0;
+	
+	std::stringstream report;
+	report << "Buffer arena: " << mapped / (1024*1024) << " MB mapped, "
+	       << reserved / (1024*1024) << " MB in reserved huge pages, "
+	       << transparent / (1024*1024) << " MB in transparent huge pages";
+	return report.str();
+}
+
+void AlignedBufferPool::Release(char* buffer, size_t size)
+{
+	if (buffer != NULL)
+	{
+		std::lock_guard<std::mutex> guard(Lock());
+		FreeBuffers().insert(std::make_pair(size, buffer));
+	}
+}
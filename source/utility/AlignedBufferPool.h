@@ -0,0 +1,91 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _ALIGNED_BUFFER_POOL
+#define _ALIGNED_BUFFER_POOL
+
+#include <stdint.h>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+using std::string;
+using std::vector;
+
+//A pool of buffers aligned for direct I/O. Released buffers are kept for reuse, so that the streams
+//opened one after another (such as the files in a batch, or the per-thread streams used for hashing)
+//don't repeatedly allocate and free large blocks of memory.
+//
+//With huge pages enabled, new buffers are carved out of an arena of regions backed by huge pages, using
+//the pages reserved by the administrator (MAP_HUGETLB) where there are any and transparent huge pages
+//(MADV_HUGEPAGE) otherwise. The regions are pre-faulted when they are mapped, so the pipeline doesn't
+//take a page fault for every 4KB of buffer on its first pass through the data.
+class AlignedBufferPool
+{
+	public:
+		//Returns a buffer of the specified size, aligned to AlignedBufferPool::Alignment
+		static char* Acquire(size_t size);
+		
+		//Returns a buffer to the pool
+		static void Release(char* buffer, size_t size);
+		
+		//Selects whether buffers allocated from here on are backed by huge pages
+		static void UseHugePages(bool enable);
+		
+		//Describes how much of the arena is actually backed by huge pages
+		static string HugePageReport();
+		
+		//Satisfies the alignment requirements of O_DIRECT for all common logical block sizes
+		static const size_t Alignment = 4096;
+		
+		//The arena's regions are mapped in multiples of the huge page size used on x86-64 and ARM64
+		static const size_t HugePageSize = 2*1024*1024;
+		
+	private:
+		struct Region
+		{
+			char*  start;
+			size_t length;
+			bool   reserved;
+		};
+		
+		struct Arena
+		{
+			bool   enabled;
+			char*  next;
+			size_t remaining;
+			vector<Region> regions;
+		};
+		
+		static std::mutex& Lock();
+		static std::multimap<size_t, char*>& FreeBuffers();
+		static Arena& CurrentArena();
+		
+		//Carves a buffer out of the arena, mapping a new region if necessary (the lock must be held)
+		static char* AllocateFromArena(size_t size);
+		
+		//Maps and pre-faults a region of huge pages, returning false if no region could be mapped
+		static bool MapRegion(size_t length, Region& region);
+};
+
+#endif
@@ -27,8 +27,21 @@
 #endif
 
 #include "../encryption/EncryptionFactory.h"
+#include "../encryption/InPlaceConversion.h"
 #include "../efc/EFCHeaderFactory.h"
+#include "AlignedBufferPool.h"
+#include "ChecksumUtility.h"
+#include "ChunkSizePolicy.h"
+#include "HeaderJournal.h"
+#include "MemoryBudget.h"
+#include "RateLimiter.h"
+#include "ProcessPriority.h"
+#include "SplitInputBackend.h"
+#include "SplitOutputBackend.h"
 #include <iostream>
+#include <cstdint>
+#include <cstdlib>
+#include <thread>
 using std::clog;
 using std::endl;
 
@@ -42,11 +55,44 @@ ApplicationConfig::ApplicationConfig(int argc, char* argv[], int mode)
 	outfilePath   = "";
 	autoOverwrite = false;
 	
-	keyMode = 0;  //Sentinel value, does not match a valid KeyMode member
+	infile    = NULL;
+	header    = NULL;
+	streaming = false;
+	
+	volumeSize = 0;
+	
+	newKeyMode = 0;  //Sentinel value, does not match a valid KeyMode member
+	
+	useEnvelope = false;
+	sparse      = false;
+	inPlace     = false;
+	keySlot     = -1;
+	
+	kdfType              = KeyDerivationType::Scrypt;
+	kdfCost              = 0;
+	kdfLanes             = 0;
+	kdfMemoryLimit       = (uint64_t)DEFAULT_KDF_MEMORY_LIMIT * 1024 * 1024;
+	kdfCalibrationTarget = 0;
 	
 	cipher      = DEFAULT_CIPHER;
 	compression = DEFAULT_COMPRESS;
 	
+	maxReadRate  = 0;
+	maxWriteRate = 0;
+	idlePriority = false;
+	maxMemory    = 0;
+	checksumReserved = 0;
+	hugePages    = false;
+	
+	checksumType  = ChecksumType::SHA1;
+	threads       = std::thread::hardware_concurrency();
+	headerVersion = EFCHeaderVersion::Default;
+	
+	//Not all platforms are able to report the number of hardware threads
+	if (threads < 1) {
+		threads = 1;
+	}
+	
 	viewOutput   = false;
 	deleteOutput = false;
 	
@@ -58,6 +104,15 @@ ApplicationConfig::ApplicationConfig(int argc, char* argv[], int mode)
 	ParseArguments(argc, argv, mode);
 }
 
+ApplicationConfig::~ApplicationConfig()
+{
+	delete header;
+	delete infile;
+	delete io.readLimiter;
+	delete io.writeLimiter;
+	MemoryBudget::Release(checksumReserved);
+}
+
 //Helper function to output the list of supported ciphers
 void ApplicationConfig::ListSupportedCiphers(bool showWhitespace)
 {
@@ -88,6 +143,48 @@ void ApplicationConfig::ListSupportedCiphers(bool showWhitespace)
 	}
 }
 
+//Helper function to select the key derivation parameters for a new password-protected file
+void ApplicationConfig::SelectKeyDerivation()
+{
+	//The legacy unsalted hash is only used if explicitly requested
+	if (this->kdfType == KeyDerivationType::SHA256)
+	{
+		this->kdf = KeyDerivation();
+		return;
+	}
+	
+	uint32_t lanes = (this->kdfLanes > 0) ? this->kdfLanes : 1;
+	if (this->kdfCalibrationTarget > 0)
+	{
+		//Find the cost that hits the requested derivation time on this host
+		this->kdf = KeyDerivation::Calibrate(this->kdfCalibrationTarget, lanes, this->kdfMemoryLimit);
+		clog << "Calibrated key derivation: " << this->kdf.Description() << endl
+		     << "Use \"-kdf-cost " << (int)this->kdf.costExponent << " -kdf-lanes " << this->kdf.lanes << "\" to reuse these parameters." << endl;
+	}
+	else
+	{
+		//Use the default parameters, overridden by any that were explicitly specified
+		this->kdf.UseScrypt();
+		this->kdf.lanes = lanes;
+		if (this->kdfCost > 0) {
+			this->kdf.costExponent = this->kdfCost;
+		}
+	}
+}
+
+//Helper function to transform a password or file into a key, based on the key mode
+string ApplicationConfig::TransformKey(EncryptionStrategy* encryption, int transformMode, string& passwordOrFile)
+{
+	if (transformMode == KeyMode::Password) {
+		return encryption->GenerateKeyFromPassword(passwordOrFile, this->kdf);
+	}
+	else if (transformMode == KeyMode::TransformFile) {
+		return encryption->GenerateKeyFromFile(passwordOrFile);
+	}
+	
+	return "";
+}
+
 //Parses the application's command line arguments
 void ApplicationConfig::ParseArguments(int argc, char* argv[], int mode)
 {
@@ -106,16 +203,44 @@ void ApplicationConfig::ParseArguments(int argc, char* argv[], int mode)
 		//The main logic loop. For two-part args, the counter will increment extra to skip appropriately
 		if (currArg == "-i")
 		{
-			//The next argument is the input file
-			this->infilePath = nextArg;
+			//The next argument is an input file (when encrypting, several can be specified)
+			this->infilePaths.push_back(nextArg);
+			this->infilePath = this->infilePaths[0];
 			
 			//Skip ahead, as we have consumed the next argument
 			argNum++;
 		}
 		else if (currArg == "-o")
 		{
-			//The next argument is the output file
-			this->outfilePath = nextArg;
+			//The next argument is the output file, and any further output files receive copies of it
+			if (this->outfilePath == "") {
+				this->outfilePath = nextArg;
+			}
+			else {
+				this->teePaths.push_back(nextArg);
+			}
+			
+			//Skip ahead, as we have consumed the next argument
+			argNum++;
+		}
+		else if (currArg == "-split")
+		{
+			//The next argument is the size of each volume, in megabytes
+			int suppliedSize = atoi(nextArg.c_str());
+			if (suppliedSize > 0) {
+				this->volumeSize = (uint64_t)suppliedSize * 1024 * 1024;
+			}
+			else {
+				this->error += "Invalid volume size \"" + nextArg + "\"\n";
+			}
+			
+			//Skip ahead, as we have consumed the next argument
+			argNum++;
+		}
+		else if (currArg == "-volume-dir")
+		{
+			//The next argument is another directory that volumes are written to (or searched for when decrypting)
+			this->volumeDirs.push_back(nextArg);
 			
 			//Skip ahead, as we have consumed the next argument
 			argNum++;
@@ -143,50 +268,301 @@ void ApplicationConfig::ParseArguments(int argc, char* argv[], int mode)
 			//Skip ahead, as we have consumed the next argument
 			argNum++;
 		}
+		else if (currArg == "-checksum")
+		{
+			//The next argument is the checksum type to be used
+			if (nextArg == "sha1") {
+				this->checksumType = ChecksumType::SHA1;
+			}
+			else if (nextArg == "tree") {
+				this->checksumType = ChecksumType::Tree;
+			}
+			else
+			{
+				//Invalid checksum type specified
+				this->error += "Invalid checksum type \"" + nextArg + "\"\n";
+			}
+			
+			//Skip ahead, as we have consumed the next argument
+			argNum++;
+		}
+		else if (currArg == "-threads")
+		{
+			//The next argument is the number of worker threads
+			int suppliedThreads = atoi(nextArg.c_str());
+			if (suppliedThreads > 0) {
+				this->threads = suppliedThreads;
+			}
+			else {
+				this->error += "Invalid thread count \"" + nextArg + "\"\n";
+			}
+			
+			//Skip ahead, as we have consumed the next argument
+			argNum++;
+		}
+		else if (currArg == "--direct-io")
+		{
+			//Bypass the page cache when reading and writing files
+			this->io.directIO = true;
+		}
+		else if (currArg == "--drop-cache")
+		{
+			//Drop the files' pages from the page cache once we are done with them
+			this->io.dropCache = true;
+		}
+		else if (currArg == "-io-engine")
+		{
+			//The next argument is the I/O engine to use
+			if (nextArg == "default") {
+				this->io.engine = IOEngine::Default;
+			}
+			else if (nextArg == "uring") {
+				this->io.engine = IOEngine::Uring;
+			}
+			else {
+				this->error += "Invalid I/O engine \"" + nextArg + "\"\n";
+			}
+			
+			//Skip ahead, as we have consumed the next argument
+			argNum++;
+		}
+		else if (currArg == "-chunk-size")
+		{
+			//The next argument is the chunk size in kilobytes, or "auto" to choose it for each file
+			size_t suppliedSize = (size_t)atoi(nextArg.c_str()) * 1024;
+			if (nextArg == "auto") {
+				this->io.chunkSize = 0;
+			}
+			else if (ChunkSizePolicy::IsValid(suppliedSize)) {
+				this->io.chunkSize = suppliedSize;
+			}
+			else {
+				this->error += "Invalid chunk size \"" + nextArg + "\"\n";
+			}
+			
+			//Skip ahead, as we have consumed the next argument
+			argNum++;
+		}
+		else if (currArg == "--max-read-rate" || currArg == "--max-write-rate")
+		{
+			//The next argument is the maximum rate, in megabytes per second
+			double suppliedRate = atof(nextArg.c_str());
+			if (suppliedRate > 0 && currArg == "--max-read-rate") {
+				this->maxReadRate = (uint64_t)(suppliedRate * 1024 * 1024);
+			}
+			else if (suppliedRate > 0) {
+				this->maxWriteRate = (uint64_t)(suppliedRate * 1024 * 1024);
+			}
+			else {
+				this->error += "Invalid rate \"" + nextArg + "\"\n";
+			}
+			
+			//Skip ahead, as we have consumed the next argument
+			argNum++;
+		}
+		else if (currArg == "--max-memory")
+		{
+			//The next argument is the memory limit, in megabytes
+			int suppliedLimit = atoi(nextArg.c_str());
+			if (suppliedLimit >= MIN_MEMORY_LIMIT) {
+				this->maxMemory = (uint64_t)suppliedLimit * 1024 * 1024;
+			}
+			else {
+				this->error += "Invalid memory limit \"" + nextArg + "\"\n";
+			}
+			
+			//Skip ahead, as we have consumed the next argument
+			argNum++;
+		}
+		else if (currArg == "--huge-pages")
+		{
+			//Back the pipeline buffers with huge pages, to reduce TLB misses and page faults
+			this->hugePages = true;
+		}
+		else if (currArg == "--idle")
+		{
+			//Only use the CPU and disk time that other processes leave idle
+			this->idlePriority = true;
+		}
+		else if (currArg == "-durability")
+		{
+			//The next argument is how output files are made durable
+			if (nextArg == "none") {
+				this->io.durability = DurabilityMode::None;
+			}
+			else if (nextArg == "sync") {
+				this->io.durability = DurabilityMode::Sync;
+			}
+			else if (nextArg == "periodic") {
+				this->io.durability = DurabilityMode::Periodic;
+			}
+			else {
+				this->error += "Invalid durability mode \"" + nextArg + "\"\n";
+			}
+			
+			//Skip ahead, as we have consumed the next argument
+			argNum++;
+		}
 		else if (currArg == "-pass" || currArg == "-password")
 		{
 			//The next argument is the password
-			this->keyMode = KeyMode::Password;
-			password = nextArg;
+			string password = nextArg;
 			
 			//Skip ahead, as we have consumed the next argument
 			argNum++;
 			
-			//Check if we are actually reading the password from stdin (newline delimited)
-			if (nextArg == "-")
-			{
-				//Read the password from stdin, hiding the characters if using a console window
-				password = get_cli_password_hidden("Password: ");
-				
-				//Account for windows line endings (\r\n)
-				password = strip_chars("\r", password);
+			//A password of "-" is read from stdin once all of the arguments are parsed, since stdin may also be the input
+			this->keyModes.push_back(KeyMode::Password);
+			this->keySources.push_back(password);
+		}
+		else if (currArg == "-kdf")
+		{
+			//The next argument is the key derivation function to use for passwords
+			if (nextArg == "scrypt") {
+				this->kdfType = KeyDerivationType::Scrypt;
+			}
+			else if (nextArg == "sha256") {
+				this->kdfType = KeyDerivationType::SHA256;
+			}
+			else {
+				this->error += "Invalid key derivation function \"" + nextArg + "\"\n";
+			}
+			
+			//Skip ahead, as we have consumed the next argument
+			argNum++;
+		}
+		else if (currArg == "-kdf-cost")
+		{
+			//The next argument is the base 2 logarithm of the scrypt cost
+			this->kdfCost = atoi(nextArg.c_str());
+			if (this->kdfCost < KeyDerivation::MinCostExponent || this->kdfCost > KeyDerivation::MaxCostExponent) {
+				this->error += "Invalid key derivation cost \"" + nextArg + "\"\n";
+			}
+			
+			//Skip ahead, as we have consumed the next argument
+			argNum++;
+		}
+		else if (currArg == "-kdf-lanes")
+		{
+			//The next argument is the number of independent scrypt lanes
+			int suppliedLanes = atoi(nextArg.c_str());
+			if (suppliedLanes >= 1 && suppliedLanes <= KeyDerivation::MaxLanes) {
+				this->kdfLanes = suppliedLanes;
+			}
+			else {
+				this->error += "Invalid key derivation lane count \"" + nextArg + "\"\n";
+			}
+			
+			//Skip ahead, as we have consumed the next argument
+			argNum++;
+		}
+		else if (currArg == "-kdf-memory")
+		{
+			//The next argument is the maximum memory (in megabytes) that key derivation may use, or that calibration may select
+			int suppliedLimit = atoi(nextArg.c_str());
+			if (suppliedLimit > 0) {
+				this->kdfMemoryLimit = (uint64_t)suppliedLimit * 1024 * 1024;
+			}
+			else {
+				this->error += "Invalid key derivation memory limit \"" + nextArg + "\"\n";
+			}
+			
+			//Skip ahead, as we have consumed the next argument
+			argNum++;
+		}
+		else if (currArg == "--calibrate-kdf")
+		{
+			//The next argument is the target key derivation time, in milliseconds
+			int suppliedTarget = atoi(nextArg.c_str());
+			if (suppliedTarget > 0) {
+				this->kdfCalibrationTarget = suppliedTarget;
 			}
+			else {
+				this->error += "Invalid calibration target \"" + nextArg + "\"\n";
+			}
+			
+			//Skip ahead, as we have consumed the next argument
+			argNum++;
 		}
 		else if (currArg == "-keyfile")
 		{
 			//The next argument is a keyfile
-			this->keyMode  = KeyMode::KeyFile;
+			this->keyModes.push_back(KeyMode::KeyFile);
 			
 			//Skip ahead, as we have consumed the next argument
 			argNum++;
 			
 			//Read the contents of the keyfile
-			this->key = file_get_contents(nextArg);
+			this->keySources.push_back(file_get_contents(nextArg));
 			
 			//Check that the keyfile read properly
-			if (this->key.length() == 0) {
+			if (this->keySources.back().length() == 0) {
 				this->error += "Invalid keyfile supplied!\n";
 			}
 		}
 		else if (currArg == "-hkeyfile")
 		{
 			//The next argument is a file to be transformed into the key
-			this->keyMode  = KeyMode::TransformFile;
-			transformFile   = nextArg;
+			this->keyModes.push_back(KeyMode::TransformFile);
+			this->keySources.push_back(nextArg);
+			
+			//Skip ahead, as we have consumed the next argument
+			argNum++;
+		}
+		else if (currArg == "-newpass" || currArg == "-newpassword")
+		{
+			//The next argument is the new password
+			this->newKeyMode = KeyMode::Password;
+			newPassword = nextArg;
+			
+			//Skip ahead, as we have consumed the next argument
+			argNum++;
+			
+			//Check if we are actually reading the password from stdin (newline delimited)
+			if (nextArg == "-")
+			{
+				newPassword = get_cli_password_hidden("New password: ");
+				newPassword = strip_chars("\r", newPassword);
+			}
+		}
+		else if (currArg == "-newkeyfile")
+		{
+			//The next argument is the new keyfile
+			this->newKeyMode = KeyMode::KeyFile;
+			this->newKey     = file_get_contents(nextArg);
+			
+			//Skip ahead, as we have consumed the next argument
+			argNum++;
+			
+			//Check that the keyfile read properly
+			if (this->newKey.length() == 0) {
+				this->error += "Invalid new keyfile supplied!\n";
+			}
+		}
+		else if (currArg == "-newhkeyfile")
+		{
+			//The next argument is a file to be transformed into the new key
+			this->newKeyMode = KeyMode::TransformFile;
+			newTransformFile = nextArg;
 			
 			//Skip ahead, as we have consumed the next argument
 			argNum++;
 		}
+		else if (currArg == "-envelope")
+		{
+			//Encrypt the payload under a random data key, so the file can be rekeyed later
+			this->useEnvelope = true;
+		}
+		else if (currArg == "--sparse")
+		{
+			//Skip the holes in sparse input files
+			this->sparse = true;
+		}
+		else if (currArg == "--in-place")
+		{
+			//Convert the input file itself, rather than writing a separate output file
+			this->inPlace = true;
+		}
 		else if (currArg == "--view")
 		{
 			//Open the output file for viewing after decryption
@@ -206,18 +582,127 @@ void ApplicationConfig::ParseArguments(int argc, char* argv[], int mode)
 		}
 		#endif
 		
+		else if (currArg == "--help" && mode == ConfigMode::Rekey)
+		{
+			//Display the usage syntax for rekeying
+			clog << "Usage Syntax:" << endl << "efcrekey -i INFILE [current key] [new key]" << endl << endl
+			     << "Replaces the key that an envelope-encrypted file's data key is wrapped under," << endl
+			     << "rewriting only the header. The payload is not read or modified. A split file" << endl
+			     << "can be named by its own name or that of its first volume (INFILE.000)." << endl << endl
+			     << "Current Key Options:" << endl
+			     << " -pass PASS          Derive the current key from the supplied password," << endl
+			     << "                     use \"-\" for interactive keyboard input" << endl
+			     << " -keyfile  FILE      Read the current key as raw data from FILE" << endl
+			     << " -hkeyfile FILE      Hash the contents of FILE and use that as the current key" << endl
+			     << "                     Supply several keys to try each of them in turn" << endl << endl
+			     << "New Key Options:" << endl
+			     << " -newpass PASS       Derive the new key from the supplied password," << endl
+			     << "                     use \"-\" for interactive keyboard input" << endl
+			     << " -newkeyfile  FILE   Read the new key as raw data from FILE" << endl
+			     << " -newhkeyfile FILE   Hash the contents of FILE and use that as the new key" << endl << endl
+			     << "Password Options:" << endl
+			     << " -kdf-memory MB      Limit the memory (and so the time) that deriving the keys from" << endl
+			     << "                     passwords may use, since the file chooses the cost (default: " << DEFAULT_KDF_MEMORY_LIMIT << ")" << endl;
+			
+			//Instruct the application to abort immediately, halting the parsing process
+			this->abort = true;
+			this->error = "";
+			return;
+		}
 		else if (currArg == "--help")
 		{
 			//Display the usage syntax
-			clog << "Usage Syntax:" << endl << ((mode == EncryptionMode::Encrypt) ? "efcencode" : "efcdecode") << " -i INFILE [options, must include key in some form] [-o OUTFILE]" << endl << endl
+			clog << "Usage Syntax:" << endl << ((mode == EncryptionMode::Encrypt) ? "efcencode" : "efcdecode") << " -i INFILE [options, must include key in some form] [-o OUTFILE]" << endl;
+			
+			//Output the batch syntax
+			if (mode == EncryptionMode::Encrypt)
+			{
+				clog << "efcencode -i INFILE -i INFILE ... [options] [-o OUTDIR]" << endl
+				     << "efcencode -i INFILE [options] -o OUTFILE -o COPY ..." << endl << endl
+				     << "Small files in a batch are encrypted together, interleaving their AES work." << endl
+				     << "Each extra -o receives a copy of the output as it is written, from its own thread." << endl;
+			}
+			
+			clog << endl
 			     << "Output Options:" << endl
-			     << " -o OUTFILE       Set output filename" << endl
+			     << " -o OUTFILE       Set output filename, or \"-\" for stdout (the default when" << endl
+			     << "                  the input file is \"-\", which reads from stdin)" << endl;
+			
+			//Output the volume options
+			if (mode == EncryptionMode::Encrypt)
+			{
+				clog << " -split MB        Split the output into volumes of MB megabytes (OUTFILE.000, .001, ...)" << endl
+				     << " -volume-dir DIR  Also place volumes in DIR, taking turns with the output directory," << endl
+				     << "                  with a writer thread for each directory" << endl;
+			}
+			else
+			{
+				clog << " -volume-dir DIR  Search DIR for the volumes of a split file, as well as the directory" << endl
+				     << "                  of the first volume (INFILE.000)" << endl;
+			}
+			
+			clog << " --in-place       " << ((mode == EncryptionMode::Encrypt) ? "Encrypt INFILE itself (without compression), then rename it to OUTFILE."
+			                                                                   : "Decrypt a file that was encrypted in place, then rename it to OUTFILE.") << endl
+			     << "                  Progress is journaled, so an interrupted run resumes when repeated" << endl
+			     << "                  (each chunk is flushed as it is converted, so --direct-io and" << endl
+			     << "                  -durability can't be used)" << endl
 			     << " -y, --overwrite  Don't prompt for file overwrite" << endl << endl
 			     << "Key Options:" << endl
-			     << " -pass PASS       Hash the supplied password and use the hash as the key," << endl
+			     << " -pass PASS       Derive the key from the supplied password," << endl
 			     << "                  use \"-\" for interactive keyboard input" << endl
 			     << " -keyfile  FILE   Read the key as raw data from FILE" << endl
-			     << " -hkeyfile FILE   Hash the contents of FILE and use that as the key" << endl << endl;
+			     << " -hkeyfile FILE   Hash the contents of FILE and use that as the key" << endl
+			     << "                  " << ((mode == EncryptionMode::Encrypt) ? "Supply several keys to encrypt the file for multiple recipients"
+			                                                                   : "Supply several keys to try each of them in turn") << endl << endl;
+			
+			//Output the key derivation options
+			if (mode == EncryptionMode::Encrypt)
+			{
+				clog << "Password Options:" << endl
+				     << " -kdf FUNCTION    Derive the key from the password using \"scrypt\" (default)," << endl
+				     << "                  or \"sha256\" for compatibility with older decoders" << endl
+				     << " -kdf-cost N      Use an scrypt cost of 2^N (default: " << KeyDerivation::DefaultCostExponent << ")" << endl
+				     << " -kdf-lanes N     Use N independent scrypt lanes (default: 1), which are computed in parallel" << endl
+				     << "                  on N threads, each using the memory of a whole derivation" << endl
+				     << " --calibrate-kdf MS" << endl
+				     << "                  Choose the scrypt cost that takes MS milliseconds on this host," << endl
+				     << "                  run without an input file to just print the parameters" << endl
+				     << " -kdf-memory MB   Limit the memory that key derivation may use, and so the cost that" << endl
+				     << "                  calibration may select (default: " << DEFAULT_KDF_MEMORY_LIMIT << ")" << endl << endl;
+			}
+			else
+			{
+				clog << "Password Options:" << endl
+				     << " -kdf-memory MB   Limit the memory (and so the time) that deriving the key from the" << endl
+				     << "                  password may use, since the file chooses the cost (default: " << DEFAULT_KDF_MEMORY_LIMIT << ")" << endl << endl;
+			}
+			
+			clog << "Performance Options:" << endl
+			     << " -threads N       Use N worker threads for parallelisable work (default: all cores)" << endl
+			     << " --direct-io      Bypass the page cache (O_DIRECT) so that large files don't evict" << endl
+			     << "                  other programs' cached data, where the filesystem supports it" << endl
+			     << " --drop-cache     Read ahead in large windows, and drop the pages of the files from" << endl
+			     << "                  the page cache once they have been processed (posix_fadvise)" << endl
+			     << " -io-engine ENGINE" << endl
+			     << "                  Use \"uring\" to keep several reads and writes in flight with io_uring" << endl
+			     << "                  (" << ((IOOptions::UringAvailable()) ? "available" : "not available in this build") << "), or \"default\"" << endl
+			     << " -chunk-size KB   Read and transform files in chunks of KB kilobytes (" << ChunkSizePolicy::MinChunkSize / 1024 << " to " << ChunkSizePolicy::MaxChunkSize / 1024 << "), or" << endl
+			     << "                  \"auto\" (the default) to choose it from the file size, filesystem block size" << endl
+			     << "                  and the device's optimal I/O size" << endl
+			     << " --max-read-rate MB" << endl
+			     << "                  Limit the rate at which files are read to MB megabytes per second" << endl
+			     << " --max-write-rate MB" << endl
+			     << "                  Limit the rate at which files are written to MB megabytes per second" << endl
+			     << " --max-memory MB  Limit the memory used for buffers, key derivation, stored checksums and batches" << endl
+			     << "                  to MB megabytes (at least " << MIN_MEMORY_LIMIT << "); smaller buffers are used to stay within it" << endl
+			     << " --huge-pages     Back the I/O and pipeline buffers with huge pages (reserved ones where" << endl
+			     << "                  available, transparent ones otherwise) and report how many were used" << endl
+			     << " --idle           Run at idle CPU and I/O priority, so only spare capacity is used" << endl
+			     << " -durability MODE" << endl
+			     << "                  Use \"sync\" to flush each output file to disk when it is complete, or" << endl
+			     << "                  \"periodic\" to also write it out as it is written, to smooth writeback." << endl
+			     << "                  Batches are written to temporary files, which are flushed and renamed" << endl
+			     << "                  into place together. The default is \"none\", which leaves it to the OS" << endl << endl;
 			
 			//Output the decryption-specific options
 			if (mode == EncryptionMode::Decrypt)
@@ -230,8 +715,20 @@ void ApplicationConfig::ParseArguments(int argc, char* argv[], int mode)
 			//Output the encryption options
 			clog << "Encryption Options:" << endl
 			     << " -cipher CIPHER   Use the specified cipher for encryption/decryption" << endl
-				 << "                  See below for supported values." << endl << endl
-			     << "Supported Ciphers:" << endl;
+				 << "                  See below for supported values." << endl;
+			
+			//Output the encryption-specific options
+			if (mode == EncryptionMode::Encrypt)
+			{
+				clog << " -checksum TYPE   Use \"sha1\" (default) to checksum the whole file, or \"tree\" to" << endl
+				     << "                  hash chunks in parallel and locate any damaged chunks" << endl
+				     << " -envelope        Encrypt the payload under a random data key stored in the" << endl
+				     << "                  header, so the file can be rekeyed quickly with efcrekey" << endl
+			     << " --sparse         Skip the holes in sparse files (found with SEEK_DATA/SEEK_HOLE)," << endl
+			     << "                  storing where they are so that decryption recreates them" << endl;
+			}
+			
+			clog << endl << "Supported Ciphers:" << endl;
 			
 			//List the supported ciphers
 			ListSupportedCiphers(true);
@@ -258,28 +755,221 @@ void ApplicationConfig::ParseArguments(int argc, char* argv[], int mode)
 		}
 	}
 	
+	//The memory limit applies to every buffer allocated from here on, and key derivation (including calibration) must not exceed it
+	MemoryBudget::SetLimit(this->maxMemory);
+	AlignedBufferPool::UseHugePages(this->hugePages);
+	if (this->maxMemory > 0 && this->kdfMemoryLimit > this->maxMemory) {
+		this->kdfMemoryLimit = this->maxMemory;
+	}
+	KeyDerivation::SetMemoryLimit(this->kdfMemoryLimit);
+	
+	//Calibration can be run on its own, in which case we just print the parameters
+	if (mode == EncryptionMode::Encrypt && this->kdfCalibrationTarget > 0 && this->infilePath.length() == 0 && this->error.length() == 0)
+	{
+		this->kdfType = KeyDerivationType::Scrypt;
+		this->SelectKeyDerivation();
+		if (this->kdf.MemoryRequired() > this->kdfMemoryLimit) {
+			this->error += "Even the cheapest key derivation cost with these lanes exceeds the memory limit.\n";
+		}
+		this->abort = true;
+		return;
+	}
+	
+	//Every stream shares the same limits, so that they apply to the process as a whole
+	if (this->maxReadRate > 0) {
+		this->io.readLimiter = new RateLimiter(this->maxReadRate);
+	}
+	if (this->maxWriteRate > 0) {
+		this->io.writeLimiter = new RateLimiter(this->maxWriteRate);
+	}
+	
+	//Streams opened from here on use the selected I/O settings
+	IOOptions::Defaults() = this->io;
+	
+	//Lower our priority before any of the work (including key derivation) starts, so that every worker thread inherits it
+	if (this->idlePriority && !ProcessPriority::UseIdle()) {
+		this->error += "Could not switch to idle CPU and I/O priority.\n";
+	}
+	
 	//Input file is a required argument
 	if (this->infilePath.length() == 0) {
 		this->error += "No input file specified.\n";
 	}
 	
+	//Only encryption supports batches of input files
+	if (mode != EncryptionMode::Encrypt && this->infilePaths.size() > 1) {
+		this->error += "Only one input file can be specified.\n";
+	}
+	
+	//Only encryption of a single file supports several output files
+	if (this->teePaths.size() > 0 && (mode != EncryptionMode::Encrypt || this->infilePaths.size() > 1)) {
+		this->error += "Several output files (-o) can only be specified when encrypting a single file.\n";
+	}
+	
+	//Only a single file can be split into volumes, since the volumes are named after its output file
+	if (this->volumeSize > 0 && (mode != EncryptionMode::Encrypt || this->infilePaths.size() > 1 || this->teePaths.size() > 0)) {
+		this->error += "Only a single file with a single output file can be split into volumes (-split).\n";
+	}
+	
+	//In-place conversion rewrites a single file, which holds the whole container
+	if (this->inPlace && (mode == ConfigMode::Rekey || this->infilePaths.size() > 1 || this->teePaths.size() > 0 || this->volumeSize > 0 || this->sparse)) {
+		this->error += "Only a single file with a single output file can be converted in place (--in-place), without -split or --sparse.\n";
+	}
+	
+	//Every chunk converted in place is flushed to disk before the next one is started, so the file is always durable,
+	//and the displaced bytes are written at offsets that O_DIRECT can't use
+	if (this->inPlace && (this->io.directIO || this->io.durability != DurabilityMode::None)) {
+		this->error += "Files converted in place (--in-place) are always flushed to disk as they are converted, so --direct-io and -durability can't be used.\n";
+	}
+	
+	for (size_t i = 0; i < this->volumeDirs.size(); ++i)
+	{
+		if (!is_dir(this->volumeDirs[i])) {
+			this->error += "The volume directory \"" + this->volumeDirs[i] + "\" does not exist.\n";
+		}
+	}
+	
+	//Stdin can only be read once, so it can't hold both the password and the input, or be part of a batch
+	bool stdinInput = false;
+	for (size_t i = 0; i < this->infilePaths.size(); ++i) {
+		stdinInput = stdinInput || IOOptions::IsStandardStream(this->infilePaths[i]);
+	}
+	
+	if (stdinInput && this->infilePaths.size() > 1) {
+		this->error += "Stdin (\"-\") can't be encrypted as part of a batch.\n";
+	}
+	
+	for (size_t i = 0; i < this->keySources.size(); ++i)
+	{
+		if (this->keyModes[i] != KeyMode::Password || this->keySources[i] != "-") {
+			continue;
+		}
+		
+		if (stdinInput)
+		{
+			this->error += "The password can't be read from stdin when it is also the input.\n";
+			break;
+		}
+		
+		//Read the password from stdin, hiding the characters if using a console window
+		this->keySources[i] = get_cli_password_hidden("Password: ");
+		
+		//Account for windows line endings (\r\n)
+		this->keySources[i] = strip_chars("\r", this->keySources[i]);
+	}
+	
+	//Rekeying modifies the input file in place
+	if (mode == ConfigMode::Rekey && stdinInput) {
+		this->error += "Rekeying requires an input file, not stdin.\n";
+	}
+	
+	if (this->inPlace && (stdinInput || IOOptions::IsStandardStream(this->outfilePath))) {
+		this->error += "Stdin and stdout (\"-\") can't be converted in place.\n";
+	}
+	
+	//When reading from stdin, we write to stdout unless told otherwise, so that we can be used as a filter
+	if (stdinInput && this->outfilePath == "") {
+		this->outfilePath = "-";
+	}
+	
 	//If there were no errors, we can perform the advanced steps
 	if (this->error.length() == 0)
 	{
-		//If we are decrypting, we need to read the filename and cipher information from the input EFC file's header
-		if (mode == EncryptionMode::Decrypt)
+		//When decrypting or rekeying, these are read from the header for envelope-encrypted files
+		vector<string> wrappedKeys;
+		
+		//If we are decrypting or rekeying, we need to read the filename and cipher information from the input EFC file's header
+		if (mode == EncryptionMode::Decrypt || mode == ConfigMode::Rekey)
 		{
+			//A split file can be referred to by its own name, rather than that of its first volume (which holds the header that rekeying rewrites)
+			string firstVolume = SplitOutputBackend::VolumePath(this->infilePath, "", 0);
+			if (!stdinInput && !file_exists(this->infilePath) && file_exists(firstVolume)) {
+				this->infilePath = firstVolume;
+			}
+			
+			//An interrupted in-place conversion may already have overwritten the header, so the copy in its journal is used instead
+			int interruptedMode = mode;
+			EFCHeader* interrupted = (this->inPlace && mode == EncryptionMode::Decrypt) ? InPlaceConversion::InterruptedHeader(this->infilePath, interruptedMode) : NULL;
+			if (interruptedMode != mode) {
+				this->error += "\"" + this->infilePath + "\" was being encrypted in place when it was interrupted (run efcencode --in-place again to finish).\n";
+			}
+			
+			//Rekeying that was interrupted may have left the header half-written, so it puts back the original saved in its journal
+			HeaderJournal headerJournal(this->infilePath);
+			if (!stdinInput && headerJournal.Exists())
+			{
+				if (mode == ConfigMode::Rekey)
+				{
+					try
+					{
+						if (headerJournal.Recover()) {
+							clog << "Restored the original header of \"" << this->infilePath << "\", whose rekeying was interrupted." << endl;
+						}
+					}
+					catch (const string& recoveryError) {
+						this->error += recoveryError + ".\n";
+					}
+				}
+				else {
+					this->error += "\"" + this->infilePath + "\" was being rekeyed when it was interrupted (run efcrekey again to finish).\n";
+				}
+			}
+			
 			//Attempt to open the input file
-			MeteredIfstream infile(this->infilePath);
-			if (infile.is_open())
+			this->infile = new MeteredIfstream(this->infilePath);
+			if (this->infile->is_open())
 			{
 				//Attemp to read the file's header
-				EFCHeader* header = EFCHeaderFactory::parseHeader(infile);
+				this->header = (interrupted != NULL) ? interrupted : EFCHeaderFactory::parseHeader(*this->infile);
 				if (header != NULL)
 				{
 					//Read the correct encryption algorithm to use
 					this->cipher = header->cipher;
 					
+					//Read the parameters needed to derive the key from a password
+					this->kdf = header->kdf;
+					
+					//Read the wrapped copies of the data key
+					wrappedKeys = header->wrappedKeys;
+				}
+				
+				//The payload of a split file continues through the rest of its volumes, which must all be present
+				if (header != NULL && header->IsSplit() && mode == EncryptionMode::Decrypt)
+				{
+					vector<string> volumes = (stdinInput) ? vector<string>() : SplitInputBackend::FindVolumes(this->infilePath, header->volumeCount, header->volumeSize, this->volumeDirs);
+					if (stdinInput) {
+						this->error += "A split file must be read from its volumes, rather than from stdin.\n";
+					}
+					else if (volumes.size() == 0 || volumes.size() < header->volumeCount)
+					{
+						string container = this->infilePath.substr(0, this->infilePath.rfind('.'));
+						this->error += "Could not find volume " + SplitOutputBackend::VolumePath(container, "", volumes.size()) + " of the split file (or it is incomplete).\n";
+					}
+					else
+					{
+						//Streams are split without knowing how many volumes there will be, so we go by how many were found
+						this->infile->JoinVolumes(volumes, header->volumeSize);
+						header->volumeCount = volumes.size();
+					}
+				}
+				
+				//Files encrypted in place have the start of their payload at the end, so they are read in the order of the container instead
+				if (header != NULL && header->IsDisplaced() && mode == EncryptionMode::Decrypt && !this->inPlace)
+				{
+					if (stdinInput) {
+						this->error += "A file that was encrypted in place can't be read from stdin, since part of its payload is at the end.\n";
+					}
+					else
+					{
+						streamoff position = this->infile->tellg();
+						this->infile->SkipHoles(header->DisplacedExtents());
+						this->infile->seekg(position);
+					}
+				}
+				
+				//Rekeying modifies the input file in place, so there is no output filename to determine
+				if (header != NULL && mode == EncryptionMode::Decrypt && !IOOptions::IsStandardStream(this->outfilePath))
+				{
 					//If the current output filename is a directory with a trailing slash, truncate it (including it may cause is_dir() to return false)
 					if (ends_with("/", this->outfilePath) || ends_with("\\", this->outfilePath)) {
 						this->outfilePath = this->outfilePath.substr(0, this->outfilePath.length() - 1);
@@ -303,20 +993,149 @@ void ApplicationConfig::ParseArguments(int argc, char* argv[], int mode)
 					}
 				}
 				
-				//Close the input file
-				infile.close();
+				//Rekeying opens the file for writing itself
+				if (mode == ConfigMode::Rekey)
+				{
+					delete this->header;
+					delete this->infile;
+					this->header = NULL;
+					this->infile = NULL;
+				}
+				
+				#ifndef _WIN32
+				//Output that is deleted once it has been viewed is simply printed, so stream it straight to stdout rather than writing it to disk
+				if (mode == EncryptionMode::Decrypt && this->viewOutput == true && this->deleteOutput == true) {
+					this->outfilePath = "-";
+				}
+				#endif
 			}
 		}
 		else if (mode == EncryptionMode::Encrypt)
 		{
-			//Unless already set, the output filename is the .efc version of the input filename
-			if (this->outfilePath == "") {
+			if (this->infilePaths.size() > 1)
+			{
+				//When encrypting several files, the output (if set) must be the directory to place them in
+				string outputDir = this->outfilePath;
+				if (outputDir != "" && !is_dir(outputDir)) {
+					this->error += "When encrypting multiple files, the output (-o) must be an existing directory.\n";
+				}
+				else if (outputDir != "" && !ends_with("/", outputDir) && !ends_with("\\", outputDir)) {
+					outputDir += "/";
+				}
+				
+				//Each output filename is the .efc version of its input filename
+				for (size_t i = 0; i < this->infilePaths.size(); ++i)
+				{
+					string path = replace_extension(this->infilePaths[i], "efc");
+					this->outfilePaths.push_back((outputDir != "") ? outputDir + basename(path) : path);
+				}
+				
+				this->outfilePath = this->outfilePaths[0];
+			}
+			else if (this->outfilePath == "")
+			{
+				//Unless already set, the output filename is the .efc version of the input filename
 				this->outfilePath = replace_extension(this->infilePath, "efc");
 			}
+			
+			if (this->volumeSize > 0 && IOOptions::IsStandardStream(this->outfilePath)) {
+				this->error += "Output written to stdout can't be split into volumes.\n";
+			}
+			
+			if (this->inPlace && this->error.length() == 0)
+			{
+				//The payload of a file encrypted in place is the file itself, so it can't be compressed. The data key stored in the header
+				//lets the key be checked before anything is decrypted in place, or before an interrupted conversion is resumed.
+				this->compression = CompressionType::None;
+				this->useEnvelope = true;
+				
+				//An interrupted conversion is resumed with the header (and so the key derivation parameters and data key) that it started with
+				int interruptedMode = mode;
+				this->header = InPlaceConversion::InterruptedHeader(this->infilePath, interruptedMode);
+				if (interruptedMode != mode) {
+					this->error += "\"" + this->infilePath + "\" was being decrypted in place when it was interrupted (run efcdecode --in-place again to finish).\n";
+				}
+				else if (this->header != NULL)
+				{
+					this->cipher = header->cipher;
+					this->kdf    = header->kdf;
+					wrappedKeys  = header->wrappedKeys;
+				}
+				else
+				{
+					//A container that was encrypted in place (whose journal is already gone) is not encrypted a second time
+					MeteredIfstream existing(this->infilePath);
+					EFCHeader* existingHeader = (existing.is_open()) ? EFCHeaderFactory::parseHeader(existing) : NULL;
+					if (existingHeader != NULL) {
+						this->error += "\"" + this->infilePath + "\" is already an EFC container.\n";
+					}
+					delete existingHeader;
+				}
+			}
+			
+			//Pipes can't be read twice or seeked, so the checksum and payload size are written in a trailer after the payload
+			this->streaming = (stdinInput || IOOptions::IsStandardStream(this->outfilePath));
+			for (size_t i = 0; i < this->teePaths.size(); ++i) {
+				this->streaming = this->streaming || IOOptions::IsStandardStream(this->teePaths[i]);
+			}
+			if (this->streaming && this->checksumType == ChecksumType::Tree) {
+				this->error += "Tree checksums can't be used when reading from stdin or writing to stdout.\n";
+			}
+			
+			//Encrypting for several recipients requires a data key that can be wrapped under each of their keys
+			if (this->keyModes.size() > 1) {
+				this->useEnvelope = true;
+			}
+			
+			//Passwords are stretched using the selected key derivation function.
+			//Envelope headers always store the parameters, so that the file can later be rekeyed to use a password.
+			bool usesPassword = false;
+			for (size_t i = 0; i < this->keyModes.size(); ++i) {
+				usesPassword = usesPassword || (this->keyModes[i] == KeyMode::Password);
+			}
+			
+			if ((usesPassword || this->useEnvelope) && this->header == NULL) {
+				this->SelectKeyDerivation();
+			}
+			
+			//Tree checksums, key derivation parameters, wrapped keys, the trailer flag, sparse extents and the volume manifest can only be stored in the optional fields.
+			//They also record the plaintext size, so the binary header is used for every new file unless the legacy key derivation was requested for compatibility.
+			if (this->checksumType == ChecksumType::Tree || this->kdfType != KeyDerivationType::SHA256 || this->useEnvelope || this->streaming || this->sparse || this->volumeSize > 0) {
+				this->headerVersion = EFCHeaderVersion::Binary;
+			}
+		}
+		
+		//Deriving a key from a password needs the scratch space of the key derivation function, which must fit within the memory limit.
+		//When decrypting, the parameters come from the file, so this also stops it from demanding an unreasonable amount of memory and time.
+		bool derivesKey = (this->newKeyMode == KeyMode::Password);
+		for (size_t i = 0; i < this->keyModes.size(); ++i) {
+			derivesKey = derivesKey || (this->keyModes[i] == KeyMode::Password);
+		}
+		
+		if (derivesKey && !this->kdf.IsValid()) {
+			this->error += "The key derivation parameters are outside of the supported range.\n";
+		}
+		else if (derivesKey && this->kdf.MemoryRequired() > this->kdfMemoryLimit)
+		{
+			this->error += "Key derivation would require " + std::to_string(this->kdf.MemoryRequired() / (1024*1024)) + " MB, more than the limit of " +
+			               std::to_string(this->kdfMemoryLimit / (1024*1024)) + " MB (raise it with -kdf-memory, within any --max-memory limit).\n";
+		}
+		
+		//The tree checksum stored in a file is held for the whole decryption, along with the two buffers used to decrypt it and the checksum of the
+		//output, so room for all four is reserved before any of them are allocated. Under a memory limit, this stops a file demanding an unreasonable amount.
+		if (mode == EncryptionMode::Decrypt && this->header != NULL && this->header->checksumType == ChecksumType::Tree && !this->header->streaming)
+		{
+			uint64_t checksumLength = ChecksumUtility::TreeChecksumLength(this->header->checksumChunkCount);
+			if (checksumLength > SIZE_MAX / 4 || !MemoryBudget::TryReserve((size_t)checksumLength * 4)) {
+				this->error += "The file's tree checksum would require " + std::to_string(checksumLength / (1024*1024) * 4) + " MB, more than is available within the memory limit.\n";
+			}
+			else {
+				this->checksumReserved = (size_t)checksumLength * 4;
+			}
 		}
 		
-		//If we are transforming a password or file to generate the key, we will need to instantiate the appropriate encryption context
-		if (this->keyMode == KeyMode::Password || KeyMode::TransformFile)
+		//Transform each password or file into a key (raw keys from keyfiles are used as-is)
+		if (this->error.length() == 0 && (this->keyModes.size() > 0 || this->newKeyMode != 0))
 		{
 			//Instantiate the encryption context for the correct cipher
 			EncryptionStrategy* encryption = EncryptionFactory::CreateEncryption(this->cipher, mode);
@@ -326,24 +1145,96 @@ void ApplicationConfig::ParseArguments(int argc, char* argv[], int mode)
 				throw "Invalid cipher!";
 			}
 			
-			//Perform the relevant transformation
-			if (this->keyMode == KeyMode::Password) {
-				this->key = encryption->GenerateKeyFromPassword(password);
+			//Perform the relevant transformations (all passwords share the same key derivation parameters and salt).
+			//Key derivation fails if its working set doesn't fit in what is left of the memory limit.
+			try
+			{
+				for (size_t i = 0; i < this->keyModes.size(); ++i)
+				{
+					if (this->keyModes[i] == KeyMode::KeyFile) {
+						this->keys.push_back(this->keySources[i]);
+					}
+					else {
+						this->keys.push_back(this->TransformKey(encryption, this->keyModes[i], this->keySources[i]));
+					}
+				}
+				
+				//The first key is used unless one of the others is found to unlock the file
+				if (this->keys.size() > 0) {
+					this->key = this->keys[0];
+				}
+				
+				//When rekeying, the new key is derived using the same parameters
+				if (this->newKeyMode == KeyMode::Password) {
+					this->newKey = this->TransformKey(encryption, this->newKeyMode, newPassword);
+				}
+				else if (this->newKeyMode == KeyMode::TransformFile) {
+					this->newKey = this->TransformKey(encryption, this->newKeyMode, newTransformFile);
+				}
 			}
-			else if (this->keyMode == KeyMode::TransformFile) {
-				this->key = encryption->GenerateKeyFromFile(transformFile);
+			catch (const string& message) {
+				this->error += message + ".\n";
 			}
 			
 			//Free the encryption instance
 			delete encryption;
 		}
 		
-		//If the specified output file already exists, prompt (unless auto overwrite is enabled)
-		if (this->outfilePath != "" && this->autoOverwrite == false && file_exists(this->outfilePath))
+		//Find the wrapped copy of the data key that one of our keys unlocks (the GCM tag acts as a key check, so the payload is never touched)
+		if (wrappedKeys.size() > 0 && this->keys.size() > 0)
+		{
+			EncryptionStrategy* encryption = EncryptionFactory::CreateEncryption(this->cipher, mode);
+			if (encryption == NULL) {
+				throw "Invalid cipher!";
+			}
+			
+			for (size_t k = 0; k < this->keys.size() && this->keySlot < 0; ++k)
+			{
+				for (size_t i = 0; i < wrappedKeys.size() && this->keySlot < 0; ++i)
+				{
+					if (encryption->UnwrapKey(wrappedKeys[i], this->keys[k], this->dataKey))
+					{
+						this->key     = this->keys[k];
+						this->keySlot = i;
+					}
+				}
+			}
+			
+			if (this->keySlot < 0) {
+				this->error += (this->keys.size() > 1) ? "None of the supplied keys match this file.\n" : "The supplied key does not match this file.\n";
+			}
+			
+			delete encryption;
+		}
+		
+		//Unless we are encrypting a batch, there is a single output file
+		if (this->outfilePaths.size() == 0 && this->outfilePath != "") {
+			this->outfilePaths.push_back(this->outfilePath);
+		}
+		
+		//If any of the specified output files (including the copies) already exist, prompt (unless auto overwrite is enabled).
+		//Only the first volume of a split file is known in advance, and the others are replaced along with it.
+		vector<string> destinations = this->outfilePaths;
+		destinations.insert(destinations.end(), this->teePaths.begin(), this->teePaths.end());
+		if (this->volumeSize > 0 && mode == EncryptionMode::Encrypt && destinations.size() > 0) {
+			destinations[0] = SplitOutputBackend::VolumePath(this->outfilePath, "", 0);
+		}
+		for (size_t i = 0; i < destinations.size() && this->error.length() == 0 && this->abort == false && this->autoOverwrite == false; ++i)
 		{
+			if (file_exists(destinations[i]) == false || IOOptions::IsStandardStream(destinations[i]) || (this->inPlace && destinations[i] == this->infilePath)) {
+				continue;
+			}
+			
+			//The prompt reads from stdin, which may be the input
+			if (stdinInput)
+			{
+				this->error += "The file \"" + destinations[i] + "\" already exists (use -y to overwrite it).\n";
+				break;
+			}
+			
 			//Keep track of whether or not the users confirms the overwrite
 			bool overwrite = false;
-			string prompt = "The file \"" + this->outfilePath + "\" already exists.";
+			string prompt = "The file \"" + destinations[i] + "\" already exists.";
 			
 			#ifdef _WIN32
 			//If we are in GUI mode, we use a graphical prompt
@@ -378,6 +1269,11 @@ void ApplicationConfig::ParseArguments(int argc, char* argv[], int mode)
 		this->error += "No key specified.\n";
 	}
 	
+	//Rekeying also requires the new key
+	if (mode == ConfigMode::Rekey && this->newKey.length() == 0 && this->error.length() == 0) {
+		this->error += "No new key specified.\n";
+	}
+	
 	//If any errors were generated, the application should abort
 	if (this->error.length() > 0) {
 		this->abort = true;
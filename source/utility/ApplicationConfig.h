@@ -25,14 +25,34 @@
 
 #include "../compression/CompressionFactory.h"
 #include "../encryption/EncryptionFactory.h"
+#include "../encryption/KeyDerivation.h"
+#include "ChecksumUtility.h"
+#include "IOOptions.h"
 #include <simple-base/base.h>
 #include <string>
+#include <vector>
 using std::string;
+using std::vector;
+
+class EFCHeader;
 
 //Default compression and encryption settings
 #define DEFAULT_COMPRESS  CompressionType::Zlib
 #define DEFAULT_CIPHER    EncryptionType::AES_256_CFB
 
+//Files that are encrypted together in a batch must be no larger than this (in bytes), and a batch holds at most this many files
+#define BATCH_MAX_FILESIZE (1024*1024)
+#define BATCH_MAX_FILES    32
+
+//Smallest memory limit (in megabytes) accepted by --max-memory, which leaves room for the compression state and minimal buffers
+#define MIN_MEMORY_LIMIT 4
+
+//Tools that parse their arguments using ApplicationConfig, alongside EncryptionMode::Encrypt and EncryptionMode::Decrypt
+namespace ConfigMode
+{
+	static const int Rekey = 2;  //Replaces the key that a data key is wrapped under
+}
+
 //Describe the different methods in which the user can supply a key
 namespace KeyMode
 {
@@ -47,6 +67,7 @@ class ApplicationConfig
 	public:
 		//Parses the application's command line arguments (the mode should be EncryptionMode::Encrypt or EncryptionMode::Decrypt)
 		ApplicationConfig(int argc, char* argv[], int mode);
+		~ApplicationConfig();
 		
 		//Control flow settings
 		bool      abort;  //If true, the application should abort immediately after parsing is complete
@@ -57,13 +78,81 @@ class ApplicationConfig
 		string outfilePath;
 		bool   autoOverwrite;
 		
-		//Encryption/Decryption key
+		//When decrypting, the input file, positioned just past its header, and the parsed header.
+		//These are kept open rather than reopened, since stdin can only be read once.
+		//When resuming an in-place conversion (including encryption), the header is the copy in its journal.
+		MeteredIfstream* infile;
+		EFCHeader*       header;
+		
+		//When encrypting, whether the input or output is a pipe (specified as "-"), so that the file must be processed in a single pass
+		bool streaming;
+		
+		//When encrypting a batch of files, every input filename and its corresponding output filename (the first pair match the above)
+		vector<string> infilePaths;
+		vector<string> outfilePaths;
+		
+		//When encrypting a single file, the extra destinations (from repeated -o options) that receive a copy of the output as it is written
+		vector<string> teePaths;
+		
+		//When encrypting, the size (in bytes) of the volumes to split the output into (zero for a single file), and the directories
+		//that the volumes are spread across besides that of the output file. When decrypting, the directories searched for volumes.
+		uint64_t       volumeSize;
+		vector<string> volumeDirs;
+		
+		//Encryption/Decryption key (when several keys were supplied, the first one, or the one that matched when decrypting)
 		string key;
 		
+		//Every key supplied, one per recipient when encrypting (the payload key is wrapped once under each)
+		vector<string> keys;
+		
+		//When rekeying, the key that the data key will be wrapped under instead
+		string newKey;
+		
+		//When decrypting or rekeying an envelope-encrypted file, the data key and the index of the wrapped copy that the key unlocked
+		string dataKey;
+		int    keySlot;
+		
+		//Encrypt the payload under a random data key, which is wrapped under the user's key in the header
+		bool useEnvelope;
+		
+		//Skip the holes in sparse files when encrypting, storing where they are instead
+		bool sparse;
+		
+		//Encrypt or decrypt the input file in place, then rename it to the output filename (see InPlaceConversion)
+		bool inPlace;
+		
+		//The function used to derive the key from a password (read from the header when decrypting)
+		KeyDerivation kdf;
+		
 		//Override default compression and encryption algorithms
 		int cipher;
 		int compression;
 		
+		//Checksum type used to verify the integrity of the decrypted data
+		int checksumType;
+		
+		//Number of worker threads used for parallelisable work, such as hashing
+		unsigned int threads;
+		
+		//Settings for the file streams (these become the defaults for every stream once parsing is complete)
+		IOOptions io;
+		
+		//The maximum rates (in bytes per second) at which files are read and written (zero for no limit)
+		uint64_t maxReadRate;
+		uint64_t maxWriteRate;
+		
+		//Whether to run at idle CPU and I/O priority, so that only spare capacity is used
+		bool idlePriority;
+		
+		//The limit (in bytes) on the memory used for buffers, key derivation and tree checksums (zero for no limit)
+		uint64_t maxMemory;
+		
+		//Whether the pipeline buffers are backed by huge pages (with their usage reported at the end)
+		bool hugePages;
+		
+		//The header version required to store the selected options (EFCHeaderVersion::[...])
+		int headerVersion;
+		
 		//Settings specific to decryption
 		bool viewOutput;
 		bool deleteOutput;
@@ -74,16 +163,40 @@ class ApplicationConfig
 		#endif
 	
 	private:
-		//These strings are used for temporarily storing a password/filename for key transformation, based on the value of keyMode
-		int    keyMode;
-		string password;
-		string transformFile;
+		//The config owns the input file and header, so it can't be copied
+		ApplicationConfig(const ApplicationConfig&);
+		ApplicationConfig& operator=(const ApplicationConfig&);
+		
+		//These are used for temporarily storing the password/filename/raw key of each supplied key, based on its key mode
+		vector<int>    keyModes;
+		vector<string> keySources;
+		
+		//The same, for the new key when rekeying
+		int    newKeyMode;
+		string newPassword;
+		string newTransformFile;
+		
+		//Key derivation settings requested for encryption (zero values select the defaults)
+		int          kdfType;
+		int          kdfCost;
+		uint32_t     kdfLanes;
+		uint64_t     kdfMemoryLimit;
+		unsigned int kdfCalibrationTarget;
+		
+		//The memory reserved for the tree checksum of the file being decrypted, which is held until the config is destroyed
+		size_t checksumReserved;
 		
 		//Helper function to parse the application's command line arguments
 		void ParseArguments(int argc, char* argv[], int mode);
 		
 		//Helper function to output the list of supported ciphers
 		void ListSupportedCiphers(bool showWhitespace);
+		
+		//Helper function to select the key derivation parameters for a new password-protected file
+		void SelectKeyDerivation();
+		
+		//Helper function to transform a password or file into a key, based on the key mode
+		string TransformKey(EncryptionStrategy* encryption, int transformMode, string& passwordOrFile);
 };
 
 #endif
@@ -0,0 +1,51 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _CALLBACK_INPUT_BACKEND
+#define _CALLBACK_INPUT_BACKEND
+
+#include "PipeInputBackend.h"
+
+//Reads up to n bytes into s, returning the number of bytes read (zero at the end of the input). Errors are reported by throwing a string.
+typedef size_t (*InputCallback)(void* context, char* s, size_t n);
+
+//Reads input from a function supplied by the caller, such as a network connection or a decompressor. Like a pipe, the input
+//can only be read sequentially, so the payload must be encrypted with TransformStream rather than TransformFile.
+class CallbackInputBackend : public PipeInputBackend
+{
+	public:
+		//The context is passed to each call of the callback, and is not owned by the backend
+		CallbackInputBackend(InputCallback callback, void* context);
+		~CallbackInputBackend();
+		
+		bool is_open();
+		void close();
+		
+	protected:
+		size_t ReadSome(char* s, size_t n);
+		
+	private:
+		InputCallback callback;
+		void*         context;
+};
+
+#endif
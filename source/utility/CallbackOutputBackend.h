@@ -0,0 +1,51 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _CALLBACK_OUTPUT_BACKEND
+#define _CALLBACK_OUTPUT_BACKEND
+
+#include "PipeOutputBackend.h"
+
+//Writes all n bytes from s. Errors are reported by throwing a string, which the backend records as its WriteError().
+typedef void (*OutputCallback)(void* context, const char* s, size_t n);
+
+//Writes output to a function supplied by the caller, such as an upload to remote storage. Like a pipe, the output can
+//only be written sequentially, so the payload must be encrypted with TransformStream rather than TransformFile.
+class CallbackOutputBackend : public PipeOutputBackend
+{
+	public:
+		//The context is passed to each call of the callback, and is not owned by the backend
+		CallbackOutputBackend(OutputCallback callback, void* context);
+		~CallbackOutputBackend();
+		
+		bool is_open();
+		void close();
+		
+	protected:
+		void WriteThrough(const char* s, size_t n);
+		
+	private:
+		OutputCallback callback;
+		void*          context;
+};
+
+#endif
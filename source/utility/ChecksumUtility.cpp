@@ -22,7 +22,14 @@
 */
 #include "ChecksumUtility.h"
 
-#include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+//Each worker thread reads its chunks into a buffer of this size, a piece at a time
+#define TREE_READ_SIZE (1024*1024)
 
 string ChecksumUtility::GenerateFileChecksum(string filename)
 {
@@ -43,8 +50,8 @@ string ChecksumUtility::GenerateFileChecksum(MeteredIfstream& file)
 	//Record the original position of the get pointer
 	off_t oldPos = file.tellg();
 	
-	//Create a buffer to hold the checksum
-	char* theChecksum = new char[ChecksumUtility::ChecksumSize];
+	//Create a string to hold the checksum
+	string checksum;
 	
 	//Check that the file opened properly
 	if (file.is_open())
@@ -52,37 +59,18 @@ string ChecksumUtility::GenerateFileChecksum(MeteredIfstream& file)
 		//Create a SHA-1 instance to calculate the checksum
 		SHA1 chcksum;
 		
-		//Create a buffer to hold the data
-		size_t bufSize = 512*1024;
-		char* buffer = new char[bufSize];
-		
-		//Read the data
+		//Read the data, using it in place where the file is memory mapped
+		size_t bufSize = file.ChunkSize();
+		const char* buffer = NULL;
 		size_t bytesRead = 0;
-		while ((bytesRead = file.read(buffer, bufSize)))
+		while ((bytesRead = file.ReadView(&buffer, bufSize)))
 		{
 			//Add the contents of the buffer to the checksum
 			chcksum.Input(buffer, bytesRead);
 		}
 		
-		//Free the buffer
-		delete[] buffer;
-		
 		//Calculate the checksum
-		uint32_t checksum_bytes[5];
-		if (!chcksum.Result(checksum_bytes)) {
-			throw "Couldn't compute checksum!";
-		}
-		
-		//SHA-1 is big-endian, so for little-endian systems, flip the endianness
-		if (endianness() == LITTLE_ENDIAN)
-		{
-			for (int i = 0; i < 5; ++i) {
-				checksum_bytes[i] = flipEndianness(checksum_bytes[i]);
-			}
-		}
-		
-		//Copy the binary checksum to our buffer
-		memcpy(theChecksum, (char*)checksum_bytes, sizeof(checksum_bytes));
+		checksum = DigestBytes(chcksum);
 	}
 	else {
 		throw "File stream not open!";
@@ -91,11 +79,6 @@ string ChecksumUtility::GenerateFileChecksum(MeteredIfstream& file)
 	//Seek the file back to the original position
 	file.seekg(oldPos);
 	
-	//Create a string to hold the checksum and free the buffer
-	string checksum;
-	checksum.assign(theChecksum, ChecksumUtility::ChecksumSize);
-	delete[] theChecksum;
-	
 	//Return the generated checksum
 	return checksum;
 }
@@ -105,3 +88,208 @@ string ChecksumUtility::GenerateBlankChecksum()
 	//Create a string of the right length, filled with null bytes
 	return string(ChecksumUtility::ChecksumSize, 0);
 }
+
+string ChecksumUtility::GenerateTreeChecksum(string filename, size_t chunkSize, unsigned int threads)
+{
+	//Determine the size of the file, and hence the number of chunks it is split into
+	struct stat details;
+	if (stat(filename.c_str(), &details) != 0) {
+		throw string("Couldn't open input file to calculate checksum!");
+	}
+	uint64_t chunkCount = TreeChunkCount(details.st_size, chunkSize);
+	
+	//There is no point starting more threads than there are chunks
+	if (threads < 1) { threads = 1; }
+	if (threads > chunkCount) { threads = chunkCount; }
+	
+	//The threads share a single stream, reading their chunks at the chunks' offsets rather than through its position
+	MeteredIfstream file(filename);
+	if (!file.is_open()) {
+		throw string("Couldn't open input file to calculate checksum!");
+	}
+	
+	//Create a buffer to hold the hash of each chunk
+	char* leafHashes = new char[chunkCount * ChecksumUtility::ChecksumSize];
+	
+	//Split the chunks into contiguous ranges (so each thread reads sequentially) and hash each range on its own thread
+	vector<std::thread> workers;
+	bool* failed = new bool[threads];
+	for (unsigned int t = 0; t < threads; ++t)
+	{
+		failed[t] = false;
+		uint64_t firstChunk = (chunkCount * t) / threads;
+		uint64_t lastChunk  = (chunkCount * (t + 1)) / threads;
+		workers.push_back(std::thread(&ChecksumUtility::HashChunkRange, &file, chunkSize, firstChunk, lastChunk, leafHashes, &failed[t]));
+	}
+	
+	//Wait for all of the threads to complete
+	bool anyFailed = false;
+	for (unsigned int t = 0; t < threads; ++t)
+	{
+		workers[t].join();
+		anyFailed = anyFailed || failed[t];
+	}
+	delete[] failed;
+	file.close();
+	
+	if (anyFailed)
+	{
+		delete[] leafHashes;
+		throw string("Couldn't open input file to calculate checksum!");
+	}
+	
+	//The checksum consists of the root hash followed by all of the chunk hashes
+	string checksum = ComputeTreeRoot(leafHashes, chunkCount);
+	checksum.append(leafHashes, chunkCount * ChecksumUtility::ChecksumSize);
+	delete[] leafHashes;
+	
+	return checksum;
+}
+
+string ChecksumUtility::GenerateBlankTreeChecksum(uint64_t chunkCount)
+{
+	//Filled with null bytes
+	return string(TreeChecksumLength(chunkCount), 0);
+}
+
+uint64_t ChecksumUtility::TreeChecksumLength(uint64_t chunkCount)
+{
+	return (chunkCount + 1) * ChecksumUtility::ChecksumSize;
+}
+
+uint64_t ChecksumUtility::TreeChunkCount(uint64_t fileSize, size_t chunkSize)
+{
+	uint64_t chunkCount = (fileSize + chunkSize - 1) / chunkSize;
+	return (chunkCount > 0) ? chunkCount : 1;
+}
+
+vector<uint64_t> ChecksumUtility::FindDamagedChunks(const string& expected, const string& actual)
+{
+	vector<uint64_t> damaged;
+	
+	//Compare each of the chunk hashes (skipping the root hash), treating missing chunks as damaged
+	uint64_t expectedChunks = (expected.length() / ChecksumUtility::ChecksumSize) - 1;
+	uint64_t actualChunks   = (actual.length()   / ChecksumUtility::ChecksumSize) - 1;
+	for (uint64_t i = 0; i < expectedChunks; ++i)
+	{
+		size_t offset = (i + 1) * ChecksumUtility::ChecksumSize;
+		if (i >= actualChunks || expected.compare(offset, ChecksumUtility::ChecksumSize, actual, offset, ChecksumUtility::ChecksumSize) != 0) {
+			damaged.push_back(i);
+		}
+	}
+	
+	//Any extra chunks in the actual data are also considered damaged
+	for (uint64_t i = expectedChunks; i < actualChunks; ++i) {
+		damaged.push_back(i);
+	}
+	
+	return damaged;
+}
+
+string ChecksumUtility::TypeDescription(int type)
+{
+	switch (type)
+	{
+		//SHA-1 digest of the entire file
+		case ChecksumType::SHA1:
+			return "SHA-1";
+		
+		//SHA-1 hash tree
+		case ChecksumType::Tree:
+			return "SHA-1 Hash Tree";
+		
+		//Unrecognised checksum type
+		default:
+			return "[Unrecognised Checksum]";
+	}
+}
+
+string ChecksumUtility::DigestBytes(SHA1& digest)
+{
+	//Calculate the checksum
+	uint32_t checksum_bytes[5];
+	if (!digest.Result(checksum_bytes)) {
+		throw "Couldn't compute checksum!";
+	}
+	
+	//SHA-1 is big-endian, so for little-endian systems, flip the endianness
+	if (endianness() == LITTLE_ENDIAN)
+	{
+		for (int i = 0; i < 5; ++i) {
+			checksum_bytes[i] = flipEndianness(checksum_bytes[i]);
+		}
+	}
+	
+	//Copy the binary checksum into a string
+	string checksum;
+	checksum.assign((char*)checksum_bytes, sizeof(checksum_bytes));
+	return checksum;
+}
+
+void ChecksumUtility::HashChunkRange(MeteredIfstream* file, size_t chunkSize, uint64_t firstChunk, uint64_t lastChunk, char* leafHashes, bool* failed)
+{
+	vector<char> buffer(std::min(chunkSize, (size_t)TREE_READ_SIZE));
+	try
+	{
+		for (uint64_t chunk = firstChunk; chunk < lastChunk; ++chunk)
+		{
+			//Leaf hashes are prefixed with a zero byte to distinguish them from interior nodes
+			SHA1 leaf;
+			char prefix = 0x0;
+			leaf.Input(&prefix, sizeof(prefix));
+			
+			//Read the chunk in pieces (the final chunk may be shorter than the others)
+			uint64_t offset = chunk * chunkSize;
+			size_t remaining = chunkSize;
+			size_t bytesRead = 0;
+			while (remaining > 0 && (bytesRead = file->ReadAt(&buffer[0], std::min(remaining, buffer.size()), offset)) > 0)
+			{
+				leaf.Input(&buffer[0], bytesRead);
+				remaining -= bytesRead;
+				offset    += bytesRead;
+			}
+			
+			//Store the hash at the chunk's position in the list
+			string hash = DigestBytes(leaf);
+			memcpy(leafHashes + (chunk * ChecksumUtility::ChecksumSize), hash.data(), hash.length());
+		}
+	}
+	catch (const string&) {
+		*failed = true;
+	}
+}
+
+string ChecksumUtility::ComputeTreeRoot(const char* leafHashes, uint64_t chunkCount)
+{
+	//Start with the list of chunk hashes as the bottom level of the tree
+	string level(leafHashes, chunkCount * ChecksumUtility::ChecksumSize);
+	uint64_t nodes = chunkCount;
+	
+	//Combine pairs of nodes until only the root remains
+	while (nodes > 1)
+	{
+		string parentLevel;
+		for (uint64_t i = 0; i < nodes; i += 2)
+		{
+			if (i + 1 < nodes)
+			{
+				//Interior nodes are prefixed with a one byte to distinguish them from leaves
+				SHA1 node;
+				char prefix = 0x1;
+				node.Input(&prefix, sizeof(prefix));
+				node.Input(level.data() + (i * ChecksumUtility::ChecksumSize), ChecksumUtility::ChecksumSize * 2);
+				parentLevel += DigestBytes(node);
+			}
+			else
+			{
+				//An unpaired node is promoted to the next level unchanged
+				parentLevel.append(level, i * ChecksumUtility::ChecksumSize, ChecksumUtility::ChecksumSize);
+			}
+		}
+		
+		level = parentLevel;
+		nodes = (nodes + 1) / 2;
+	}
+	
+	return level;
+}
@@ -25,12 +25,22 @@
 
 #include "MeteredFilestream.h"
 #include <simple-base/base.h>
+#include <stdint.h>
 #include <string>
+#include <vector>
 #include <fstream>
 using std::string;
+using std::vector;
 using std::ifstream;
 using std::ofstream;
 
+//Neater usage syntax in C++ than an enum
+namespace ChecksumType
+{
+	static const int SHA1 = 0;  //A single SHA-1 digest of the entire file
+	static const int Tree = 1;  //A SHA-1 hash tree built over fixed-size chunks of the file
+}
+
 class ChecksumUtility
 {
 	public:
@@ -38,7 +48,35 @@ class ChecksumUtility
 		static string GenerateFileChecksum(MeteredIfstream& file);
 		static string GenerateBlankChecksum();
 		
+		//Generates a hash tree checksum, hashing the chunks of the file concurrently using the specified number of threads.
+		//The returned string contains the root hash, followed by the hash of each chunk in order.
+		static string GenerateTreeChecksum(string filename, size_t chunkSize, unsigned int threads);
+		static string GenerateBlankTreeChecksum(uint64_t chunkCount);
+		
+		//Determines the length of a tree checksum over the given number of chunks (the root hash plus one hash for each chunk)
+		static uint64_t TreeChecksumLength(uint64_t chunkCount);
+		
+		//Determines the number of chunks a file of the given size is split into (an empty file still has a single chunk)
+		static uint64_t TreeChunkCount(uint64_t fileSize, size_t chunkSize);
+		
+		//Compares two tree checksums and returns the indices of the chunks whose hashes do not match
+		static vector<uint64_t> FindDamagedChunks(const string& expected, const string& actual);
+		
+		//Gives a verbose description of a given checksum type
+		static string TypeDescription(int type);
+		
+		//Retrieves the binary digest from a SHA-1 instance
+		static string DigestBytes(SHA1& digest);
+		
+		//Combines the chunk hashes into the root hash of the tree
+		static string ComputeTreeRoot(const char* leafHashes, uint64_t chunkCount);
+		
 		static const int ChecksumSize = 20;
+		static const int DefaultTreeChunkSize = 1024*1024;
+	
+	private:
+		//Helper function to hash a contiguous range of chunks, run on each of the worker threads
+		static void HashChunkRange(MeteredIfstream* file, size_t chunkSize, uint64_t firstChunk, uint64_t lastChunk, char* leafHashes, bool* failed);
 };
 
 #endif
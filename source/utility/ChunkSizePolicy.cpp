@@ -0,0 +1,105 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#include "ChunkSizePolicy.h"
+#include "IOOptions.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/sysmacros.h>
+#endif
+
+size_t ChunkSizePolicy::Select(const string& file, size_t requested)
+{
+	if (requested != 0) {
+		return requested;
+	}
+	
+	//Without a regular file to look at (such as stdin), we have nothing better than the default
+	struct stat info;
+	bool found = (IOOptions::IsStandardStream(file)) ? (fstat(0, &info) == 0) : (stat(file.c_str(), &info) == 0);
+	if (!found || !S_ISREG(info.st_mode)) {
+		return DefaultChunkSize;
+	}
+	
+	//Striped devices report their stripe width as the optimal I/O size, and others (such as NVMe drives) may still accept
+	//requests larger than the default, although beyond a megabyte or so there is little to gain from them
+	size_t unit = (size_t)QueueAttribute(info.st_dev, "optimal_io_size");
+	if (unit == 0) {
+		unit = std::min((size_t)QueueAttribute(info.st_dev, "max_sectors_kb") * 1024, (size_t)MaxRequestSize);
+	}
+	
+	size_t chunkSize = DefaultChunkSize;
+	if (unit > 0) {
+		chunkSize = RoundUp(chunkSize, unit);
+	}
+	
+	//Reads should also cover whole filesystem blocks (which may be larger than a page on some filesystems)
+	#ifndef _WIN32
+	if (info.st_blksize > 0) {
+		chunkSize = RoundUp(chunkSize, info.st_blksize);
+	}
+	#endif
+	
+	//A file smaller than a chunk is read in one piece
+	if ((uint64_t)info.st_size < chunkSize) {
+		chunkSize = RoundUp(std::max((size_t)info.st_size, (size_t)1), MinChunkSize);
+	}
+	
+	return std::max((size_t)MinChunkSize, std::min(chunkSize, (size_t)MaxChunkSize));
+}
+
+bool ChunkSizePolicy::IsValid(size_t size)
+{
+	return (size >= MinChunkSize && size <= MaxChunkSize);
+}
+
+uint64_t ChunkSizePolicy::QueueAttribute(uint64_t device, const string& name)
+{
+	#ifdef __linux__
+	std::stringstream path;
+	path << "/sys/dev/block/" << major(device) << ":" << minor(device);
+	
+	//A partition shares the request queue of its whole device, which is its parent in sysfs
+	const char* queues[] = { "/queue/", "/../queue/" };
+	for (size_t i = 0; i < sizeof(queues) / sizeof(queues[0]); ++i)
+	{
+		std::ifstream attribute((path.str() + queues[i] + name).c_str());
+		uint64_t value = 0;
+		if (attribute >> value) {
+			return value;
+		}
+	}
+	#endif
+	
+	return 0;
+}
+
+size_t ChunkSizePolicy::RoundUp(size_t size, size_t unit)
+{
+	return ((size + unit - 1) / unit) * unit;
+}
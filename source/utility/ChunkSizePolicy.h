@@ -0,0 +1,58 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _CHUNK_SIZE_POLICY
+#define _CHUNK_SIZE_POLICY
+
+#include <stdint.h>
+#include <cstddef>
+#include <string>
+using std::string;
+
+//Chooses the size of the chunks in which a file is read and transformed. Large files are read in multiples of the
+//device's preferred request size (so that each read covers whole RAID stripes or NVMe requests), while a file smaller
+//than a chunk is read in a single piece, so that its buffers stay small enough to remain in the cache.
+class ChunkSizePolicy
+{
+	public:
+		//Selects the chunk size for a file, using the requested size if one was given (zero chooses it automatically)
+		static size_t Select(const string& file, size_t requested);
+		
+		//Determines if a requested chunk size is within the supported range
+		static bool IsValid(size_t size);
+		
+		static const size_t DefaultChunkSize = 512*1024;
+		static const size_t MinChunkSize     = 4*1024;
+		static const size_t MaxChunkSize     = 16*1024*1024;
+		
+	private:
+		//The largest request size reported by a device that is used in place of an optimal I/O size
+		static const size_t MaxRequestSize = 1024*1024;
+		
+		//Reads one of the block device's queue attributes from sysfs, returning zero if it isn't available
+		static uint64_t QueueAttribute(uint64_t device, const string& name);
+		
+		//Rounds a size up to a multiple of the unit
+		static size_t RoundUp(size_t size, size_t unit);
+};
+
+#endif
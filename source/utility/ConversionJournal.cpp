@@ -0,0 +1,289 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#include "ConversionJournal.h"
+#include "DurabilityPolicy.h"
+
+#include <simple-base/base.h>
+#include <zlib.h>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+//Suffix for the journal of a file that is being converted in place
+#define JOURNAL_SUFFIX ".journal"
+
+//Identifies a journal file
+#define JOURNAL_MAGIC "EFCJ"
+
+ConversionJournal::ConversionJournal(const string& file)
+{
+	path            = PathFor(file);
+	fd              = -1;
+	slotsOffset     = 0;
+	mode            = 0;
+	plaintextSize   = 0;
+	displacedOffset = 0;
+	displacedLength = 0;
+	displacedTo     = 0;
+	headerLength    = 0;
+	
+	latest.sequence = 0;
+	latest.phase    = 0;
+	latest.offset   = 0;
+	latest.length   = 0;
+	latest.used     = 0;
+	memset(latest.feedback, 0, sizeof(latest.feedback));
+	memset(latest.partial,  0, sizeof(latest.partial));
+}
+
+ConversionJournal::~ConversionJournal()
+{
+	#ifndef _WIN32
+	if (fd != -1) {
+		close(fd);
+	}
+	#endif
+}
+
+string ConversionJournal::PathFor(const string& file)
+{
+	return file + JOURNAL_SUFFIX;
+}
+
+bool ConversionJournal::Exists()
+{
+	return file_exists(path);
+}
+
+uint64_t ConversionJournal::SlotSize()
+{
+	//The fixed fields, the checksums of each page before and after, and the CRC-32 of the slot
+	uint64_t maxPages = MaxChunkSize / PageSize + 1;
+	return 8 + 1 + 8 + 8 + 16 + 16 + 1 + 4 + (maxPages * 2 * 4) + 4;
+}
+
+bool ConversionJournal::Open(bool create)
+{
+	#ifndef _WIN32
+	if (fd == -1) {
+		fd = open(path.c_str(), (create) ? (O_RDWR | O_CREAT | O_TRUNC) : O_RDWR, 0600);
+	}
+	#endif
+	
+	return (fd != -1);
+}
+
+void ConversionJournal::AppendValue(string& s, uint64_t value, size_t n)
+{
+	for (size_t i = 0; i < n; ++i) {
+		s += (char)((value >> (i * 8)) & 0xff);
+	}
+}
+
+uint64_t ConversionJournal::ExtractValue(const string& s, size_t& offset, size_t n)
+{
+	uint64_t value = 0;
+	for (size_t i = 0; i < n && offset + i < s.length(); ++i) {
+		value |= (uint64_t)(unsigned char)s[offset + i] << (i * 8);
+	}
+	
+	offset += n;
+	return value;
+}
+
+void ConversionJournal::Create()
+{
+	string description = JOURNAL_MAGIC;
+	AppendValue(description, mode,            1);
+	AppendValue(description, plaintextSize,   8);
+	AppendValue(description, displacedOffset, 8);
+	AppendValue(description, displacedLength, 8);
+	AppendValue(description, displacedTo,     8);
+	AppendValue(description, headerLength,    8);
+	AppendValue(description, prefix.length(), 8);
+	description += prefix;
+	AppendValue(description, crc32(0L, (const Bytef*)description.data(), description.length()), 4);
+	
+	//Both checkpoint slots start out empty
+	slotsOffset = description.length();
+	description.append(2 * SlotSize(), '\0');
+	latest.sequence = 0;
+	latest.phase    = 0;
+	
+	#ifndef _WIN32
+	if (!this->Open(true) || pwrite(fd, description.data(), description.length(), 0) != (ssize_t)description.length() || fsync(fd) != 0) {
+		throw string("Could not write the journal (" + path + ")");
+	}
+	
+	//The journal itself must survive a crash, not just its contents
+	if (!DurabilityPolicy::SyncDirectory(DurabilityPolicy::ParentDirectory(path))) {
+		throw string("Could not flush the directory of the journal (" + path + ") to disk");
+	}
+	#else
+	throw string("In-place conversion is not supported on this platform");
+	#endif
+}
+
+bool ConversionJournal::ParseSlot(const string& slot, Checkpoint& checkpoint)
+{
+	size_t offset = slot.length() - 4;
+	uint32_t stored = ExtractValue(slot, offset, 4);
+	if (stored != crc32(0L, (const Bytef*)slot.data(), slot.length() - 4)) {
+		return false;
+	}
+	
+	offset = 0;
+	checkpoint.sequence = ExtractValue(slot, offset, 8);
+	checkpoint.phase    = ExtractValue(slot, offset, 1);
+	checkpoint.offset   = ExtractValue(slot, offset, 8);
+	checkpoint.length   = ExtractValue(slot, offset, 8);
+	memcpy(checkpoint.feedback, slot.data() + offset, sizeof(checkpoint.feedback));
+	offset += sizeof(checkpoint.feedback);
+	memcpy(checkpoint.partial, slot.data() + offset, sizeof(checkpoint.partial));
+	offset += sizeof(checkpoint.partial);
+	checkpoint.used = ExtractValue(slot, offset, 1);
+	
+	uint32_t pages = ExtractValue(slot, offset, 4);
+	if (pages > MaxChunkSize / PageSize + 1 || checkpoint.used >= sizeof(checkpoint.partial)) {
+		return false;
+	}
+	
+	checkpoint.before.resize(pages);
+	checkpoint.after.resize(pages);
+	for (uint32_t page = 0; page < pages; ++page)
+	{
+		checkpoint.before[page] = ExtractValue(slot, offset, 4);
+		checkpoint.after[page]  = ExtractValue(slot, offset, 4);
+	}
+	
+	return (checkpoint.sequence > 0);
+}
+
+bool ConversionJournal::Load()
+{
+	std::ifstream file(path.c_str(), std::ios::binary);
+	if (!file.is_open()) {
+		return false;
+	}
+	
+	std::stringstream buffer;
+	buffer << file.rdbuf();
+	string journal = buffer.str();
+	
+	//The description must be intact, or the conversion never started
+	size_t offset = 4;
+	if (journal.compare(0, 4, JOURNAL_MAGIC) != 0) {
+		return false;
+	}
+	
+	mode            = ExtractValue(journal, offset, 1);
+	plaintextSize   = ExtractValue(journal, offset, 8);
+	displacedOffset = ExtractValue(journal, offset, 8);
+	displacedLength = ExtractValue(journal, offset, 8);
+	displacedTo     = ExtractValue(journal, offset, 8);
+	headerLength    = ExtractValue(journal, offset, 8);
+	uint64_t prefixLength = ExtractValue(journal, offset, 8);
+	if (prefixLength > journal.length() || offset + prefixLength + 4 + 2 * SlotSize() > journal.length() || headerLength + 16 > prefixLength) {
+		return false;
+	}
+	
+	prefix = journal.substr(offset, prefixLength);
+	offset += prefixLength;
+	
+	size_t crcOffset = offset;
+	if (ExtractValue(journal, offset, 4) != crc32(0L, (const Bytef*)journal.data(), crcOffset)) {
+		return false;
+	}
+	
+	//Resume from the latest of the checkpoints that were written in full
+	slotsOffset = offset;
+	latest.sequence = 0;
+	latest.phase    = 0;
+	for (int slot = 0; slot < 2; ++slot)
+	{
+		Checkpoint checkpoint;
+		if (ParseSlot(journal.substr(slotsOffset + slot * SlotSize(), SlotSize()), checkpoint) && checkpoint.sequence > latest.sequence) {
+			latest = checkpoint;
+		}
+	}
+	
+	return this->Open(false);
+}
+
+void ConversionJournal::Record(Checkpoint& checkpoint)
+{
+	checkpoint.sequence = latest.sequence + 1;
+	
+	string slot = "";
+	AppendValue(slot, checkpoint.sequence, 8);
+	AppendValue(slot, checkpoint.phase,    1);
+	AppendValue(slot, checkpoint.offset,   8);
+	AppendValue(slot, checkpoint.length,   8);
+	slot.append(checkpoint.feedback, sizeof(checkpoint.feedback));
+	slot.append(checkpoint.partial,  sizeof(checkpoint.partial));
+	AppendValue(slot, checkpoint.used, 1);
+	AppendValue(slot, checkpoint.before.size(), 4);
+	for (size_t page = 0; page < checkpoint.before.size(); ++page)
+	{
+		AppendValue(slot, checkpoint.before[page], 4);
+		AppendValue(slot, checkpoint.after[page],  4);
+	}
+	slot.resize(SlotSize() - 4, '\0');
+	AppendValue(slot, crc32(0L, (const Bytef*)slot.data(), slot.length()), 4);
+	
+	//The slots are used in turn, so the previous checkpoint survives if this one is torn
+	#ifndef _WIN32
+	off_t offset = slotsOffset + (checkpoint.sequence % 2) * SlotSize();
+	if (fd == -1 || pwrite(fd, slot.data(), slot.length(), offset) != (ssize_t)slot.length() || fdatasync(fd) != 0) {
+		throw string("Could not write the journal (" + path + ")");
+	}
+	#endif
+	
+	latest = checkpoint;
+}
+
+ConversionJournal::Checkpoint& ConversionJournal::Latest()
+{
+	return latest;
+}
+
+void ConversionJournal::Remove()
+{
+	#ifndef _WIN32
+	if (fd != -1)
+	{
+		close(fd);
+		fd = -1;
+	}
+	#endif
+	
+	if (remove(path.c_str()) != 0 || !DurabilityPolicy::SyncDirectory(DurabilityPolicy::ParentDirectory(path))) {
+		throw string("Could not remove the journal (" + path + ")");
+	}
+}
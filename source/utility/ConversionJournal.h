@@ -0,0 +1,126 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _CONVERSION_JOURNAL
+#define _CONVERSION_JOURNAL
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+using std::string;
+using std::vector;
+
+//The steps of an in-place conversion (see InPlaceConversion), in the order they are performed
+namespace ConversionPhase
+{
+	static const uint8_t Head     = 1;  //The start of the file is being moved to (or restored from) its end
+	static const uint8_t Body     = 2;  //The rest of the file is being transformed in place, one chunk at a time
+	static const uint8_t Finish   = 3;  //The header is being written over the start of the file (or the start of the file restored)
+	static const uint8_t Truncate = 4;  //The file is being cut back to the size of the original (decryption only)
+}
+
+//Records the progress of an in-place conversion in a file beside the one being converted, so that it can be resumed after a
+//crash. The description of the conversion (including the bytes that make up the start of the container) is written once,
+//and each checkpoint is written to one of two slots in turn, so that a torn write never destroys the previous checkpoint.
+//Everything is flushed to disk before the journal returns, so the file itself must only be modified afterwards.
+class ConversionJournal
+{
+	public:
+		//The position of the conversion: the chunk about to be written, the state of the cipher at its start, and the CRC-32
+		//of each page of the chunk before and after it is transformed, so that a chunk left half-written can be told apart
+		struct Checkpoint
+		{
+			uint64_t sequence;
+			uint8_t  phase;
+			uint64_t offset;
+			uint64_t length;
+			
+			//The last complete block of ciphertext (or the IV), and the ciphertext of the current block so far
+			char    feedback[16];
+			char    partial[16];
+			uint8_t used;
+			
+			vector<uint32_t> before;
+			vector<uint32_t> after;
+		};
+		
+		ConversionJournal(const string& file);
+		~ConversionJournal();
+		
+		//The journal for a file
+		static string PathFor(const string& file);
+		
+		//Determines if a journal exists for the file
+		bool Exists();
+		
+		//Writes the description of a new conversion (set below), replacing any existing journal, and flushes it to disk
+		void Create();
+		
+		//Reads the description and the latest checkpoint of an existing journal, returning false if it is missing or damaged
+		bool Load();
+		
+		//Writes a checkpoint (numbering it after the latest one) and flushes it to disk
+		void Record(Checkpoint& checkpoint);
+		
+		//The latest checkpoint (with phase zero if none has been recorded)
+		Checkpoint& Latest();
+		
+		//Deletes the journal once the conversion is complete
+		void Remove();
+		
+		//Pages are the unit in which the file's chunks are checksummed, aligned to multiples of their size in the file
+		static const uint64_t PageSize = 4096;
+		
+		//No chunk may be larger than this
+		static const uint64_t MaxChunkSize = 16*1024*1024;
+		
+		//The description of the conversion
+		int      mode;             //EncryptionMode::Encrypt or EncryptionMode::Decrypt
+		uint64_t plaintextSize;    //The size of the original file
+		uint64_t displacedOffset;  //The container layout (see EFCHeader)
+		uint64_t displacedLength;
+		uint64_t displacedTo;
+		string   prefix;           //The header, IV and encrypted checksum, which fill the first displacedOffset bytes of the container
+		uint64_t headerLength;     //The length of the header at the start of the prefix
+		
+	private:
+		string   path;
+		int      fd;
+		uint64_t slotsOffset;
+		
+		Checkpoint latest;
+		
+		//The size of each checkpoint slot, which holds the checksums of as many pages as a chunk can touch
+		static uint64_t SlotSize();
+		
+		//Opens the journal, returning false if it can't be
+		bool Open(bool create);
+		
+		//Helpers to append and extract little endian integers
+		static void     AppendValue(string& s, uint64_t value, size_t n);
+		static uint64_t ExtractValue(const string& s, size_t& offset, size_t n);
+		
+		//Parses a checkpoint slot, returning false if it is empty or damaged
+		static bool ParseSlot(const string& slot, Checkpoint& checkpoint);
+};
+
+#endif
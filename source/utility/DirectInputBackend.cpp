@@ -0,0 +1,199 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#include "DirectInputBackend.h"
+#include "AlignedBufferPool.h"
+#include "MemoryBudget.h"
+
+#include <cstring>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+DirectInputBackend::DirectInputBackend(string file)
+{
+	fd           = -1;
+	size         = 0;
+	position     = 0;
+	buffer       = NULL;
+	bufferStart  = 0;
+	bufferLength = 0;
+	
+	#if !defined(_WIN32) && defined(O_DIRECT)
+	//Filesystems that don't support direct I/O (such as tmpfs) reject O_DIRECT when the file is opened
+	fd = open(file.c_str(), O_RDONLY | O_DIRECT);
+	if (fd == -1) {
+		return;
+	}
+	
+	//Only regular files can be read directly
+	struct stat info;
+	if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode))
+	{
+		::close(fd);
+		fd = -1;
+		return;
+	}
+	
+	//Without room for the buffer in the memory limit, the stream falls back to another backend
+	if (!MemoryBudget::TryReserve(BufferSize))
+	{
+		::close(fd);
+		fd = -1;
+		return;
+	}
+	
+	size   = info.st_size;
+	buffer = AlignedBufferPool::Acquire(BufferSize);
+	#endif
+}
+
+DirectInputBackend::~DirectInputBackend()
+{
+	this->close();
+}
+
+size_t DirectInputBackend::Fill()
+{
+	if (position >= size) {
+		return 0;
+	}
+	
+	#ifndef _WIN32
+	//Read the aligned block containing the current position, unless it's already in the buffer
+	if (position < bufferStart || position >= bufferStart + bufferLength)
+	{
+		bufferStart  = (position / AlignedBufferPool::Alignment) * AlignedBufferPool::Alignment;
+		bufferLength = 0;
+		
+		//The final read of the file may be short
+		while (bufferLength < BufferSize && bufferStart + bufferLength < size)
+		{
+			ssize_t result = pread(fd, buffer + bufferLength, BufferSize - bufferLength, bufferStart + bufferLength);
+			if (result <= 0) {
+				break;
+			}
+			
+			bufferLength += result;
+			
+			//Direct reads must remain aligned, so stop at a short read that isn't a whole number of blocks
+			if (bufferLength % AlignedBufferPool::Alignment != 0) {
+				break;
+			}
+		}
+		
+		if (position >= bufferStart + bufferLength) {
+			throw string("Could not read from input file");
+		}
+	}
+	#endif
+	
+	return (bufferStart + bufferLength) - position;
+}
+
+size_t DirectInputBackend::read(char* s, size_t n)
+{
+	//Copy out of the buffer, refilling it as many times as necessary
+	size_t total = 0;
+	const char* source = NULL;
+	size_t available = 0;
+	while (total < n && (available = this->view(&source, n - total)) > 0)
+	{
+		memcpy(s + total, source, available);
+		total += available;
+	}
+	
+	return total;
+}
+
+size_t DirectInputBackend::view(const char** s, size_t n)
+{
+	//A view never extends past the end of the buffer, so it may be shorter than requested
+	size_t available = std::min(n, this->Fill());
+	*s = buffer + (position - bufferStart);
+	position += available;
+	return available;
+}
+
+bool DirectInputBackend::more()
+{
+	return (position < size);
+}
+
+void DirectInputBackend::getline(string& s, char delim)
+{
+	s = "";
+	size_t available = 0;
+	while ((available = this->Fill()) > 0)
+	{
+		//Search the remainder of the buffer for the delimiter
+		const char* start = buffer + (position - bufferStart);
+		const char* found = (const char*)memchr(start, delim, available);
+		size_t length = (found != NULL) ? (size_t)(found - start) : available;
+		s.append(start, length);
+		position += length;
+		
+		//Skip past the delimiter
+		if (found != NULL)
+		{
+			position++;
+			return;
+		}
+	}
+}
+
+bool DirectInputBackend::is_open()
+{
+	return (fd != -1);
+}
+
+void DirectInputBackend::close()
+{
+	#ifndef _WIN32
+	if (fd != -1) {
+		::close(fd);
+	}
+	#endif
+	
+	if (buffer != NULL) {
+		MemoryBudget::Release(BufferSize);
+	}
+	
+	AlignedBufferPool::Release(buffer, BufferSize);
+	fd     = -1;
+	buffer = NULL;
+}
+
+void DirectInputBackend::seekg(streamoff pos)
+{
+	//The buffer is kept, in case the new position falls within it
+	position = (pos > 0) ? (uint64_t)pos : 0;
+}
+
+streampos DirectInputBackend::tellg()
+{
+	return (streamoff)position;
+}
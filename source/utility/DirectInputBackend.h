@@ -0,0 +1,64 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _DIRECT_INPUT_BACKEND
+#define _DIRECT_INPUT_BACKEND
+
+#include "InputBackend.h"
+#include <stdint.h>
+
+//Reads input with O_DIRECT into an aligned buffer, bypassing the page cache.
+//If the platform or filesystem doesn't support direct I/O, is_open() returns false so that another backend can be used.
+class DirectInputBackend : public InputBackend
+{
+	public:
+		DirectInputBackend(string file);
+		~DirectInputBackend();
+		
+		size_t read(char* s, size_t n);
+		size_t view(const char** s, size_t n);
+		bool   more();
+		void   getline(string& s, char delim);
+		
+		bool      is_open();
+		void      close();
+		void      seekg(streamoff pos);
+		streampos tellg();
+		
+		//The size of each direct read (a multiple of AlignedBufferPool::Alignment)
+		static const size_t BufferSize = 4*1024*1024;
+		
+	private:
+		int      fd;
+		uint64_t size;
+		uint64_t position;
+		
+		//The buffer holds the bytes of the file starting at the aligned offset bufferStart
+		char*    buffer;
+		uint64_t bufferStart;
+		size_t   bufferLength;
+		
+		//Ensures that the buffer contains the byte at the current position, returning the number of bytes available from there
+		size_t Fill();
+};
+
+#endif
@@ -0,0 +1,211 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#include "DirectOutputBackend.h"
+#include "AlignedBufferPool.h"
+#include "MemoryBudget.h"
+
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+DirectOutputBackend::DirectOutputBackend(string file, const IOOptions& options)
+{
+	directFd     = -1;
+	bufferedFd   = -1;
+	buffer       = NULL;
+	bufferStart  = 0;
+	bufferLength = 0;
+	position     = 0;
+	sequential   = true;
+	
+	#if !defined(_WIN32) && defined(O_DIRECT)
+	//Without room for the buffer in the memory limit, the stream falls back to another backend
+	if (!MemoryBudget::TryReserve(BufferSize)) {
+		return;
+	}
+	
+	//Filesystems that don't support direct I/O (such as tmpfs) reject O_DIRECT when the file is opened
+	directFd = open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0666);
+	if (directFd == -1)
+	{
+		MemoryBudget::Release(BufferSize);
+		return;
+	}
+	
+	bufferedFd = open(file.c_str(), O_WRONLY);
+	if (bufferedFd == -1)
+	{
+		::close(directFd);
+		directFd = -1;
+		MemoryBudget::Release(BufferSize);
+		return;
+	}
+	
+	buffer = AlignedBufferPool::Acquire(BufferSize);
+	reservation.Attach(bufferedFd);
+	durability.Attach(bufferedFd, options.durability);
+	#endif
+}
+
+DirectOutputBackend::~DirectOutputBackend()
+{
+	this->close();
+}
+
+void DirectOutputBackend::WriteAt(int fd, const char* s, size_t n, uint64_t offset)
+{
+	//Once a write has failed, the rest of the output is discarded
+	if (!this->WriteError().empty()) {
+		return;
+	}
+	
+	#ifndef _WIN32
+	while (n > 0)
+	{
+		ssize_t result = pwrite(fd, s, n, offset);
+		if (result == -1 && errno == EINTR) {
+			continue;
+		}
+		
+		if (result <= 0)
+		{
+			this->Fail(string("Could not write to output file (") + ((result == 0) ? "no bytes written" : strerror(errno)) + ")");
+			return;
+		}
+		
+		s      += result;
+		n      -= result;
+		offset += result;
+	}
+	#endif
+}
+
+void DirectOutputBackend::FlushAligned()
+{
+	size_t aligned = (bufferLength / AlignedBufferPool::Alignment) * AlignedBufferPool::Alignment;
+	if (aligned > 0)
+	{
+		this->WriteAt(directFd, buffer, aligned, bufferStart);
+		
+		//Move the unaligned remainder to the start of the buffer
+		memmove(buffer, buffer + aligned, bufferLength - aligned);
+		bufferStart  += aligned;
+		bufferLength -= aligned;
+	}
+}
+
+void DirectOutputBackend::FlushAll()
+{
+	this->FlushAligned();
+	if (bufferLength > 0)
+	{
+		this->WriteAt(bufferedFd, buffer, bufferLength, bufferStart);
+		bufferStart += bufferLength;
+		bufferLength = 0;
+	}
+}
+
+void DirectOutputBackend::write(const char* s, size_t n)
+{
+	//Once we have seeked, writes go straight through the ordinary descriptor
+	if (sequential == false)
+	{
+		this->WriteAt(bufferedFd, s, n, position);
+		position += n;
+		return;
+	}
+	
+	//Fill the buffer, writing it whenever it becomes full
+	while (n > 0)
+	{
+		size_t count = std::min(n, BufferSize - bufferLength);
+		memcpy(buffer + bufferLength, s, count);
+		bufferLength += count;
+		position     += count;
+		s            += count;
+		n            -= count;
+		
+		if (bufferLength == BufferSize) {
+			this->FlushAligned();
+		}
+	}
+}
+
+void DirectOutputBackend::preallocate(uint64_t size)
+{
+	reservation.Reserve(size);
+}
+
+bool DirectOutputBackend::is_open()
+{
+	return (directFd != -1);
+}
+
+void DirectOutputBackend::close()
+{
+	if (directFd == -1) {
+		return;
+	}
+	
+	if (sequential == true) {
+		this->FlushAll();
+	}
+	
+	reservation.Finish();
+	if (!durability.Finish()) {
+		this->Fail("Could not flush output file to disk");
+	}
+	
+	#ifndef _WIN32
+	::close(directFd);
+	::close(bufferedFd);
+	#endif
+	
+	MemoryBudget::Release(BufferSize);
+	AlignedBufferPool::Release(buffer, BufferSize);
+	directFd   = -1;
+	bufferedFd = -1;
+	buffer     = NULL;
+}
+
+void DirectOutputBackend::seekp(streamoff pos)
+{
+	//Write out everything we have buffered, since later writes may overlap it
+	if (sequential == true)
+	{
+		this->FlushAll();
+		sequential = false;
+	}
+	
+	position = (pos > 0) ? (uint64_t)pos : 0;
+}
+
+streampos DirectOutputBackend::tellp()
+{
+	return (streamoff)position;
+}
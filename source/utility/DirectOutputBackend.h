@@ -0,0 +1,79 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _DIRECT_OUTPUT_BACKEND
+#define _DIRECT_OUTPUT_BACKEND
+
+#include "OutputBackend.h"
+#include "IOOptions.h"
+#include "SpaceReservation.h"
+#include "DurabilityPolicy.h"
+#include <stdint.h>
+
+//Writes output with O_DIRECT from an aligned buffer, bypassing the page cache. Direct writes must be whole
+//aligned blocks, so the unaligned tail of the file, and anything written after seeking (such as the rewritten
+//header), goes through a second, ordinary descriptor instead.
+//If the platform or filesystem doesn't support direct I/O, is_open() returns false so that another backend can be used.
+class DirectOutputBackend : public OutputBackend
+{
+	public:
+		DirectOutputBackend(string file, const IOOptions& options);
+		~DirectOutputBackend();
+		
+		void write(const char* s, size_t n);
+		void preallocate(uint64_t size);
+		
+		bool      is_open();
+		void      close();
+		void      seekp(streamoff pos);
+		streampos tellp();
+		
+		//The size of each direct write (a multiple of AlignedBufferPool::Alignment)
+		static const size_t BufferSize = 4*1024*1024;
+		
+	private:
+		int directFd;
+		int bufferedFd;
+		
+		SpaceReservation reservation;
+		DurabilityPolicy durability;
+		
+		//The buffer holds the bytes that will be written at the aligned offset bufferStart
+		char*    buffer;
+		uint64_t bufferStart;
+		size_t   bufferLength;
+		
+		//The logical write position, and whether we are still writing sequentially through the buffer
+		uint64_t position;
+		bool     sequential;
+		
+		//Writes the whole aligned blocks in the buffer directly, keeping the remainder
+		void FlushAligned();
+		
+		//Writes everything in the buffer, using the ordinary descriptor for the unaligned remainder
+		void FlushAll();
+		
+		//Writes a range of bytes at the specified offset, retrying short writes
+		void WriteAt(int fd, const char* s, size_t n, uint64_t offset);
+};
+
+#endif
@@ -0,0 +1,138 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#include "DurabilityPolicy.h"
+#include "IOOptions.h"
+
+#include <cerrno>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+DurabilityPolicy::DurabilityPolicy()
+{
+	fd         = -1;
+	mode       = DurabilityMode::None;
+	syncedTo   = 0;
+	flushingTo = 0;
+}
+
+void DurabilityPolicy::Attach(int fd, int mode)
+{
+	this->fd   = fd;
+	this->mode = mode;
+}
+
+void DurabilityPolicy::Written(uint64_t offset)
+{
+	#if defined(__linux__) && defined(SYNC_FILE_RANGE_WRITE)
+	if (fd == -1 || mode != DurabilityMode::Periodic || offset < flushingTo + Window) {
+		return;
+	}
+	
+	//Wait for the writeback started last time, so that no more than two windows are ever waiting to be written
+	if (flushingTo > syncedTo)
+	{
+		sync_file_range(fd, syncedTo, flushingTo - syncedTo, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+		syncedTo = flushingTo;
+	}
+	
+	//Start writeback of everything written since then, without waiting for it
+	sync_file_range(fd, flushingTo, offset - flushingTo, SYNC_FILE_RANGE_WRITE);
+	flushingTo = offset;
+	#endif
+}
+
+bool DurabilityPolicy::Finish()
+{
+	if (fd == -1 || mode == DurabilityMode::None)
+	{
+		fd = -1;
+		return true;
+	}
+	
+	#if defined(__linux__) && defined(SYNC_FILE_RANGE_WRITE)
+	//Deferred files are flushed later as a group, so we just make sure their writeback is under way
+	if (mode == DurabilityMode::Deferred)
+	{
+		sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+		fd = -1;
+		return true;
+	}
+	#endif
+	
+	#ifndef _WIN32
+	//Special files (such as /dev/null) can't be flushed, and don't need to be
+	if (mode != DurabilityMode::Deferred && fdatasync(fd) != 0 && errno != EINVAL)
+	{
+		fd = -1;
+		return false;
+	}
+	#endif
+	
+	fd = -1;
+	return true;
+}
+
+bool DurabilityPolicy::SyncFile(const string& path)
+{
+	#ifndef _WIN32
+	int file = open(path.c_str(), O_WRONLY);
+	if (file == -1) {
+		return false;
+	}
+	
+	bool synced = (fdatasync(file) == 0);
+	close(file);
+	return synced;
+	#else
+	return true;
+	#endif
+}
+
+bool DurabilityPolicy::SyncDirectory(const string& directory)
+{
+	#ifndef _WIN32
+	int dir = open(directory.c_str(), O_RDONLY);
+	if (dir == -1) {
+		return false;
+	}
+	
+	bool synced = (fsync(dir) == 0);
+	close(dir);
+	return synced;
+	#else
+	return true;
+	#endif
+}
+
+string DurabilityPolicy::ParentDirectory(const string& path)
+{
+	size_t separator = path.find_last_of("/\\");
+	if (separator == string::npos) {
+		return ".";
+	}
+	
+	return (separator == 0) ? path.substr(0, 1) : path.substr(0, separator);
+}
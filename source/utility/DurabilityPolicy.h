@@ -0,0 +1,69 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _DURABILITY_POLICY
+#define _DURABILITY_POLICY
+
+#include <stdint.h>
+#include <string>
+using std::string;
+
+//Makes the output files durable according to the selected DurabilityMode::[...], rather than leaving it to the kernel.
+//Periodic writeback uses sync_file_range(), where available, to start writing each window out as soon as it is complete,
+//so that the final flush doesn't have to write the whole file at once. On platforms without fdatasync() this does nothing.
+class DurabilityPolicy
+{
+	public:
+		DurabilityPolicy();
+		
+		//Sets the file to make durable, and how
+		void Attach(int fd, int mode);
+		
+		//Tells the policy that the output has been written up to the specified offset
+		void Written(uint64_t offset);
+		
+		//Flushes the file to disk (or, for DurabilityMode::Deferred, starts writing it out), once it is complete,
+		//returning false if this fails
+		bool Finish();
+		
+		//Flushes a closed file to disk, returning false if this fails
+		static bool SyncFile(const string& path);
+		
+		//Flushes a directory, so that the files created or renamed within it are durable
+		static bool SyncDirectory(const string& directory);
+		
+		//Determines the directory containing a path
+		static string ParentDirectory(const string& path);
+		
+		//Periodic writeback is started in windows of this size
+		static const uint64_t Window = 8*1024*1024;
+		
+	private:
+		int fd;
+		int mode;
+		
+		//Everything before syncedTo has been written out, and writeback has been started for everything before flushingTo
+		uint64_t syncedTo;
+		uint64_t flushingTo;
+};
+
+#endif
@@ -0,0 +1,155 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#include "FileOutputBackend.h"
+#include "AlignedBufferPool.h"
+#include "MemoryBudget.h"
+
+#include <cerrno>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+FileOutputBackend::FileOutputBackend(string file, bool truncate, const IOOptions& options)
+{
+	fd           = -1;
+	bufferStart  = 0;
+	bufferLength = 0;
+	bufferSize   = MemoryBudget::Reserve(BufferSize, 0);
+	buffer       = (bufferSize > 0) ? AlignedBufferPool::Acquire(bufferSize) : NULL;
+	
+	#ifndef _WIN32
+	fd = open(file.c_str(), O_WRONLY | O_CREAT | ((truncate) ? O_TRUNC : 0), 0666);
+	if (fd != -1 && options.dropCache) {
+		advisor.AttachOutput(fd);
+	}
+	
+	reservation.Attach(fd);
+	durability.Attach(fd, options.durability);
+	#endif
+}
+
+FileOutputBackend::~FileOutputBackend()
+{
+	this->close();
+	AlignedBufferPool::Release(buffer, bufferSize);
+	MemoryBudget::Release(bufferSize);
+}
+
+void FileOutputBackend::WriteThrough(const char* s, size_t n)
+{
+	//Once a write has failed, the rest of the output is discarded
+	if (!this->WriteError().empty()) {
+		return;
+	}
+	
+	#ifndef _WIN32
+	while (n > 0)
+	{
+		ssize_t result = pwrite(fd, s, n, bufferStart);
+		if (result == -1 && errno == EINTR) {
+			continue;
+		}
+		
+		if (result <= 0)
+		{
+			this->Fail(string("Could not write to output file (") + ((result == 0) ? "no bytes written" : strerror(errno)) + ")");
+			return;
+		}
+		
+		s           += result;
+		n           -= result;
+		bufferStart += result;
+	}
+	#endif
+	
+	advisor.Written(bufferStart);
+	durability.Written(bufferStart);
+}
+
+void FileOutputBackend::Flush()
+{
+	this->WriteThrough(buffer, bufferLength);
+	bufferLength = 0;
+}
+
+void FileOutputBackend::write(const char* s, size_t n)
+{
+	//Large writes bypass the buffer
+	if (bufferLength + n > bufferSize)
+	{
+		this->Flush();
+		if (n >= bufferSize)
+		{
+			this->WriteThrough(s, n);
+			return;
+		}
+	}
+	
+	memcpy(buffer + bufferLength, s, n);
+	bufferLength += n;
+}
+
+void FileOutputBackend::preallocate(uint64_t size)
+{
+	reservation.Reserve(size);
+}
+
+bool FileOutputBackend::is_open()
+{
+	return (fd != -1);
+}
+
+void FileOutputBackend::close()
+{
+	if (fd == -1) {
+		return;
+	}
+	
+	this->Flush();
+	advisor.Finish();
+	reservation.Finish();
+	if (!durability.Finish()) {
+		this->Fail("Could not flush output file to disk");
+	}
+	
+	#ifndef _WIN32
+	if (::close(fd) != 0) {
+		this->Fail(string("Could not close output file (") + strerror(errno) + ")");
+	}
+	#endif
+	fd = -1;
+}
+
+void FileOutputBackend::seekp(streamoff pos)
+{
+	this->Flush();
+	bufferStart = (pos > 0) ? (uint64_t)pos : 0;
+}
+
+streampos FileOutputBackend::tellp()
+{
+	return (streamoff)(bufferStart + bufferLength);
+}
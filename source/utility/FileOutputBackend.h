@@ -0,0 +1,75 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _FILE_OUTPUT_BACKEND
+#define _FILE_OUTPUT_BACKEND
+
+#include "OutputBackend.h"
+#include "IOOptions.h"
+#include "PageCacheAdvisor.h"
+#include "SpaceReservation.h"
+#include "DurabilityPolicy.h"
+#include <stdint.h>
+
+//Writes output through a POSIX file descriptor, which (unlike an ofstream) lets us advise the kernel about the pages we write.
+//If the platform doesn't provide file descriptors, is_open() returns false so that another backend can be used.
+class FileOutputBackend : public OutputBackend
+{
+	public:
+		//Unless truncate is false, any existing contents of the file are discarded
+		FileOutputBackend(string file, bool truncate, const IOOptions& options);
+		~FileOutputBackend();
+		
+		void write(const char* s, size_t n);
+		void preallocate(uint64_t size);
+		
+		bool      is_open();
+		void      close();
+		void      seekp(streamoff pos);
+		streampos tellp();
+		
+		//Writes are gathered into a buffer of this size
+		static const size_t BufferSize = 1024*1024;
+		
+	private:
+		int fd;
+		
+		//The buffer holds the bytes that will be written at the offset bufferStart
+		char*        buffer;
+		size_t       bufferLength;
+		uint64_t     bufferStart;
+		
+		//The capacity of the buffer, which may be less than BufferSize (or zero) under a memory limit
+		size_t bufferSize;
+		
+		PageCacheAdvisor advisor;
+		SpaceReservation reservation;
+		DurabilityPolicy durability;
+		
+		//Writes bytes at bufferStart, advancing it past them
+		void WriteThrough(const char* s, size_t n);
+		
+		//Writes out the buffer
+		void Flush();
+};
+
+#endif
@@ -0,0 +1,140 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#include "HeaderJournal.h"
+#include "DurabilityPolicy.h"
+
+#include <simple-base/base.h>
+#include <zlib.h>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+//Suffix for the journal of a file whose header is being rewritten
+#define HEADER_JOURNAL_SUFFIX ".header-journal"
+
+//Identifies a header journal, which holds the magic, the original header, and the CRC-32 of both
+#define HEADER_JOURNAL_MAGIC "EFCH"
+
+HeaderJournal::HeaderJournal(const string& file)
+{
+	this->file = file;
+	this->path = PathFor(file);
+}
+
+string HeaderJournal::PathFor(const string& file)
+{
+	return file + HEADER_JOURNAL_SUFFIX;
+}
+
+bool HeaderJournal::Exists()
+{
+	return file_exists(path);
+}
+
+bool HeaderJournal::Recover()
+{
+	std::ifstream journalFile(path.c_str(), std::ios::binary);
+	if (!journalFile.is_open()) {
+		throw string("Could not read the journal (" + path + ")");
+	}
+	
+	std::stringstream buffer;
+	buffer << journalFile.rdbuf();
+	journalFile.close();
+	string journal = buffer.str();
+	
+	//A journal that is incomplete was interrupted before the file itself was modified, so there is nothing to restore
+	bool restored = false;
+	size_t magicLength = string(HEADER_JOURNAL_MAGIC).length();
+	if (journal.length() > magicLength + 4 && journal.compare(0, magicLength, HEADER_JOURNAL_MAGIC) == 0)
+	{
+		size_t crcOffset = journal.length() - 4;
+		uint32_t stored = 0;
+		for (size_t i = 0; i < 4; ++i) {
+			stored |= (uint32_t)(unsigned char)journal[crcOffset + i] << (i * 8);
+		}
+		
+		if (stored == crc32(0L, (const Bytef*)journal.data(), crcOffset))
+		{
+			this->WriteFileStart(journal.substr(magicLength, crcOffset - magicLength));
+			restored = true;
+		}
+	}
+	
+	this->Remove();
+	return restored;
+}
+
+void HeaderJournal::Rewrite(uint64_t headerLength, const string& replacement)
+{
+	if (replacement.length() != headerLength) {
+		throw string("The rewritten header is a different length, so it can't replace the original");
+	}
+	
+	//Read the original header
+	std::ifstream original(file.c_str(), std::ios::binary);
+	string header(headerLength, '\0');
+	if (!original.is_open() || !original.read(&header[0], headerLength)) {
+		throw string("Could not read the header of " + file);
+	}
+	original.close();
+	
+	//Save it in the journal, which must be on disk before the file is modified
+	string journal = HEADER_JOURNAL_MAGIC + header;
+	uint32_t crc = crc32(0L, (const Bytef*)journal.data(), journal.length());
+	for (size_t i = 0; i < 4; ++i) {
+		journal += (char)((crc >> (i * 8)) & 0xff);
+	}
+	
+	std::ofstream journalFile(path.c_str(), std::ios::binary | std::ios::trunc);
+	journalFile.write(journal.data(), journal.length());
+	journalFile.close();
+	if (!journalFile || !DurabilityPolicy::SyncFile(path) || !DurabilityPolicy::SyncDirectory(DurabilityPolicy::ParentDirectory(path))) {
+		throw string("Could not write the journal (" + path + ")");
+	}
+	
+	this->WriteFileStart(replacement);
+	this->Remove();
+}
+
+void HeaderJournal::WriteFileStart(const string& data)
+{
+	std::fstream target(file.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+	if (target.is_open())
+	{
+		target.seekp(0);
+		target.write(data.data(), data.length());
+		target.close();
+	}
+	
+	if (!target || !DurabilityPolicy::SyncFile(file)) {
+		throw string("Could not write the header of " + file);
+	}
+}
+
+void HeaderJournal::Remove()
+{
+	if (remove(path.c_str()) != 0 || !DurabilityPolicy::SyncDirectory(DurabilityPolicy::ParentDirectory(path))) {
+		throw string("Could not remove the journal (" + path + ")");
+	}
+}
@@ -0,0 +1,62 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _HEADER_JOURNAL
+#define _HEADER_JOURNAL
+
+#include <stdint.h>
+#include <string>
+using std::string;
+
+//Rewrites the header at the start of a container in place (as efcrekey does when it replaces a wrapped key) without putting the only copy
+//of it at risk. The original header is saved to a journal beside the container and flushed to disk before the container is touched, so
+//if the rewrite is interrupted, Recover() puts the original back. The new header must be the same length, since the payload follows it.
+class HeaderJournal
+{
+	public:
+		HeaderJournal(const string& file);
+		
+		//The journal for a file
+		static string PathFor(const string& file);
+		
+		//Determines if an earlier rewrite of the file was interrupted
+		bool Exists();
+		
+		//Writes the saved header back over the start of the file (unless the journal was never completed, in which case the file
+		//was not touched), then removes the journal. Returns true if the header was restored.
+		bool Recover();
+		
+		//Replaces the header of the specified length at the start of the file with a new one, throwing an error if it is a different length
+		void Rewrite(uint64_t headerLength, const string& replacement);
+		
+	private:
+		string file;
+		string path;
+		
+		//Writes bytes over the start of the file and flushes them to disk
+		void WriteFileStart(const string& data);
+		
+		//Deletes the journal
+		void Remove();
+};
+
+#endif
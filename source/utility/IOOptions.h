@@ -0,0 +1,82 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _IO_OPTIONS
+#define _IO_OPTIONS
+
+#include <string>
+using std::string;
+
+class RateLimiter;
+
+//The different engines used to perform file I/O
+namespace IOEngine
+{
+	static const int Default = 0;  //Memory mapping for input where possible, otherwise synchronous reads and writes
+	static const int Uring   = 1;  //Asynchronous reads and writes using io_uring, where available
+}
+
+//How output files are made durable once they have been written
+namespace DurabilityMode
+{
+	static const int None     = 0;  //Leave writeback to the kernel
+	static const int Sync     = 1;  //Flush each file to disk with fdatasync() when it is closed
+	static const int Periodic = 2;  //Start writeback as the file is written (with sync_file_range()), and flush it when it is closed
+	static const int Deferred = 3;  //Start writeback when the file is closed, leaving the flush to be performed later (used for batches)
+}
+
+//Settings that control how MeteredIfstream and MeteredOfstream access files
+class IOOptions
+{
+	public:
+		IOOptions();
+		
+		//Bypass the page cache using O_DIRECT, where the platform and filesystem support it
+		bool directIO;
+		
+		//Drop the pages of the files we read and write from the page cache once we are done with them
+		bool dropCache;
+		
+		//The I/O engine to use (IOEngine::[...]), which falls back to the default engine if unavailable
+		int engine;
+		
+		//How output files are made durable (DurabilityMode::[...])
+		int durability;
+		
+		//The size of the chunks in which input files are read and transformed (zero to choose it for each file)
+		size_t chunkSize;
+		
+		//The limits on the rate of reading and writing, shared between every stream that uses these options (NULL for no limit)
+		RateLimiter* readLimiter;
+		RateLimiter* writeLimiter;
+		
+		//Determines if a path refers to stdin (for input) or stdout (for output), which is specified as "-"
+		static bool IsStandardStream(const string& path);
+		
+		//Determines if the io_uring engine was compiled in
+		static bool UringAvailable();
+		
+		//The options used by streams that aren't given any explicitly (set by ApplicationConfig from the command line)
+		static IOOptions& Defaults();
+};
+
+#endif
@@ -0,0 +1,63 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _INPUT_BACKEND
+#define _INPUT_BACKEND
+
+#include <string>
+#include <fstream>
+#include <stdint.h>
+using std::string;
+using std::streampos;
+using std::streamoff;
+
+//The source of the bytes read through a MeteredIfstream
+class InputBackend
+{
+	public:
+		virtual ~InputBackend();
+		
+		//Reads up to n bytes into s, returning the number of bytes read
+		virtual size_t read(char* s, size_t n) = 0;
+		
+		//Points s at up to n bytes of input, without copying them where possible, and returns the number of bytes available.
+		//The bytes remain valid until the next call to any of the backend's functions.
+		virtual size_t view(const char** s, size_t n) = 0;
+		
+		//Determines if there are any bytes left to be read
+		virtual bool more() = 0;
+		
+		//Reads up to n bytes from the specified offset into s without using or moving the current position, returning the number of bytes read.
+		//Backends that can do this from several threads at once (such as those reading from memory) override both of these functions.
+		virtual bool   positional();
+		virtual size_t ReadAt(char* s, size_t n, uint64_t offset);
+		
+		//Reads bytes up to (and discarding) the delimiter
+		virtual void getline(string& s, char delim) = 0;
+		
+		virtual bool is_open() = 0;
+		virtual void close() = 0;
+		virtual void seekg(streamoff pos) = 0;
+		virtual streampos tellg() = 0;
+};
+
+#endif
@@ -0,0 +1,186 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#include "MappedInputBackend.h"
+
+#include <cstring>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedInputBackend::MappedInputBackend(string file, const IOOptions& options)
+{
+	fd           = -1;
+	data         = NULL;
+	size         = 0;
+	position     = 0;
+	readaheadEnd = 0;
+	
+	#ifndef _WIN32
+	fd = open(file.c_str(), O_RDONLY);
+	if (fd == -1) {
+		return;
+	}
+	
+	//Only non-empty regular files can be mapped (pipes and special files use the stream backend instead)
+	struct stat info;
+	if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0 && (uint64_t)info.st_size <= (uint64_t)SIZE_MAX)
+	{
+		void* mapping = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapping != MAP_FAILED)
+		{
+			data = (const char*)mapping;
+			size = info.st_size;
+			
+			//We read the file from start to finish, so the kernel can read ahead aggressively and drop pages behind us
+			madvise(mapping, size, MADV_SEQUENTIAL);
+			this->Readahead();
+		}
+	}
+	
+	//The mapping remains valid after the descriptor is closed, but the advisor needs it to drop pages we have consumed
+	if (data != NULL && options.dropCache) {
+		advisor.AttachInput(fd, data);
+	}
+	else
+	{
+		::close(fd);
+		fd = -1;
+	}
+	#endif
+}
+
+MappedInputBackend::~MappedInputBackend()
+{
+	this->close();
+}
+
+void MappedInputBackend::Readahead()
+{
+	#ifndef _WIN32
+	if (position + (ReadaheadWindow / 2) < readaheadEnd || readaheadEnd >= size) {
+		return;
+	}
+	
+	//madvise() requires a page-aligned address
+	uint64_t pageSize = sysconf(_SC_PAGESIZE);
+	uint64_t start    = (position / pageSize) * pageSize;
+	uint64_t end      = std::min(size, position + ReadaheadWindow);
+	madvise((void*)(data + start), end - start, MADV_WILLNEED);
+	readaheadEnd = end;
+	#endif
+}
+
+size_t MappedInputBackend::read(char* s, size_t n)
+{
+	const char* source = NULL;
+	size_t available = this->view(&source, n);
+	memcpy(s, source, available);
+	return available;
+}
+
+size_t MappedInputBackend::view(const char** s, size_t n)
+{
+	//Everything before this view has been consumed
+	advisor.Consumed(position);
+	
+	//Point directly into the mapping
+	size_t available = (size_t)std::min((uint64_t)n, size - std::min(size, position));
+	*s = data + position;
+	position += available;
+	this->Readahead();
+	return available;
+}
+
+bool MappedInputBackend::more()
+{
+	return (position < size);
+}
+
+void MappedInputBackend::getline(string& s, char delim)
+{
+	s = "";
+	if (position >= size) {
+		return;
+	}
+	
+	//Find the delimiter, and skip past it
+	const char* start = data + position;
+	const char* found = (const char*)memchr(start, delim, size - position);
+	size_t length = (found != NULL) ? (size_t)(found - start) : (size_t)(size - position);
+	s.assign(start, length);
+	position += length + ((found != NULL) ? 1 : 0);
+}
+
+bool MappedInputBackend::positional()
+{
+	return (data != NULL);
+}
+
+size_t MappedInputBackend::ReadAt(char* s, size_t n, uint64_t offset)
+{
+	size_t available = (size_t)std::min((uint64_t)n, size - std::min(size, offset));
+	memcpy(s, data + offset, available);
+	return available;
+}
+
+bool MappedInputBackend::is_open()
+{
+	return (data != NULL);
+}
+
+void MappedInputBackend::close()
+{
+	#ifndef _WIN32
+	if (data != NULL) {
+		munmap((void*)data, size);
+	}
+	
+	if (fd != -1)
+	{
+		advisor.Finish();
+		::close(fd);
+	}
+	#endif
+	
+	fd       = -1;	
+	data     = NULL;
+	size     = 0;
+	position = 0;
+}
+
+void MappedInputBackend::seekg(streamoff pos)
+{
+	position = (pos > 0) ? (uint64_t)pos : 0;
+	readaheadEnd = 0;
+	this->Readahead();
+}
+
+streampos MappedInputBackend::tellg()
+{
+	return (streamoff)position;
+}
@@ -0,0 +1,72 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _MAPPED_INPUT_BACKEND
+#define _MAPPED_INPUT_BACKEND
+
+#include "InputBackend.h"
+#include "IOOptions.h"
+#include "PageCacheAdvisor.h"
+#include <stdint.h>
+
+//Reads input from a memory mapping of the file, so that the data can be used directly from the page cache.
+//Only regular files can be mapped; if the file can't be mapped, is_open() returns false so that another backend can be used.
+class MappedInputBackend : public InputBackend
+{
+	public:
+		MappedInputBackend(string file, const IOOptions& options);
+		~MappedInputBackend();
+		
+		size_t read(char* s, size_t n);
+		size_t view(const char** s, size_t n);
+		bool   more();
+		void   getline(string& s, char delim);
+		
+		//The data is already in memory, so it can be copied from any offset on any thread (until the mapping is closed)
+		bool   positional();
+		size_t ReadAt(char* s, size_t n, uint64_t offset);
+		
+		bool      is_open();
+		void      close();
+		void      seekg(streamoff pos);
+		streampos tellg();
+		
+		//How far ahead of the current position the kernel is asked to read in advance
+		static const uint64_t ReadaheadWindow = 8*1024*1024;
+		
+	private:
+		const char* data;
+		uint64_t    size;
+		uint64_t    position;
+		
+		//The end of the range that readahead has been requested for
+		uint64_t readaheadEnd;
+		
+		//When dropping pages from the page cache, the descriptor is kept open for the advisor
+		int              fd;
+		PageCacheAdvisor advisor;
+		
+		//Requests readahead for the window following the current position, once we get close to the end of the previous one
+		void Readahead();
+};
+
+#endif
@@ -0,0 +1,103 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#include "MemoryBudget.h"
+
+#include <algorithm>
+#include <string>
+using std::string;
+
+std::mutex& MemoryBudget::Lock()
+{
+	static std::mutex lock;
+	return lock;
+}
+
+MemoryBudget::Usage& MemoryBudget::Current()
+{
+	static Usage usage = { 0, 0, 0 };
+	return usage;
+}
+
+void MemoryBudget::SetLimit(uint64_t limit)
+{
+	std::lock_guard<std::mutex> guard(Lock());
+	Current().limit = limit;
+}
+
+uint64_t MemoryBudget::Limit()
+{
+	std::lock_guard<std::mutex> guard(Lock());
+	return Current().limit;
+}
+
+size_t MemoryBudget::Reserve(size_t preferred, size_t minimum)
+{
+	std::lock_guard<std::mutex> guard(Lock());
+	Usage& usage = Current();
+	
+	//Take no more than half of what remains in the budget (or the minimum, if that's more), so that the buffers
+	//allocated later can still get theirs
+	size_t size = preferred;
+	if (usage.limit != 0)
+	{
+		uint64_t remaining = (usage.used < usage.limit) ? usage.limit - usage.used : 0;
+		uint64_t share     = std::max(remaining / 2, std::min((uint64_t)minimum, remaining));
+		size = (size_t)std::min((uint64_t)preferred, share);
+	}
+	
+	if (size < minimum) {
+		throw string("Could not allocate a buffer within the memory limit");
+	}
+	
+	usage.used += size;
+	usage.peak  = std::max(usage.peak, usage.used);
+	return size;
+}
+
+bool MemoryBudget::TryReserve(size_t size)
+{
+	std::lock_guard<std::mutex> guard(Lock());
+	Usage& usage = Current();
+	
+	//Fixed-size buffers are optional, so they may only use half of the limit, leaving the rest for the buffers that are needed
+	if (usage.limit != 0 && usage.used + size > usage.limit / 2) {
+		return false;
+	}
+	
+	usage.used += size;
+	usage.peak  = std::max(usage.peak, usage.used);
+	return true;
+}
+
+void MemoryBudget::Release(size_t size)
+{
+	std::lock_guard<std::mutex> guard(Lock());
+	Usage& usage = Current();
+	usage.used -= std::min((uint64_t)size, usage.used);
+}
+
+uint64_t MemoryBudget::Peak()
+{
+	std::lock_guard<std::mutex> guard(Lock());
+	return Current().peak;
+}
@@ -0,0 +1,67 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _MEMORY_BUDGET
+#define _MEMORY_BUDGET
+
+#include <stdint.h>
+#include <cstddef>
+#include <mutex>
+
+//Accounts for the large buffers used for file I/O and by the transformation pipeline, so that peak memory use can be held
+//to the limit given with --max-memory, however large the input is and however well it compresses. Buffers that can work at
+//any size take as much of the budget as they can (up to their preferred size), while fixed-size buffers that don't fit cause
+//the stream that wanted them to fall back to a more frugal backend. Without a limit, every buffer gets its preferred size.
+class MemoryBudget
+{
+	public:
+		//Sets the limit in bytes (zero for no limit)
+		static void SetLimit(uint64_t limit);
+		static uint64_t Limit();
+		
+		//Reserves as much of the preferred size as the budget can spare, throwing an error if even the minimum isn't available
+		static size_t Reserve(size_t preferred, size_t minimum);
+		
+		//Reserves exactly the requested size for an optional buffer, returning false (and reserving nothing) if it would
+		//take the reservations past half of the limit
+		static bool TryReserve(size_t size);
+		
+		//Returns a reservation to the budget
+		static void Release(size_t size);
+		
+		//The most that was reserved at any one time
+		static uint64_t Peak();
+		
+	private:
+		struct Usage
+		{
+			uint64_t limit;
+			uint64_t used;
+			uint64_t peak;
+		};
+		
+		//Buffers are reserved by streams on several threads (such as those hashing a tree checksum)
+		static std::mutex& Lock();
+		static Usage& Current();
+};
+
+#endif
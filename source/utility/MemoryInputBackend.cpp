@@ -0,0 +1,106 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#include "MemoryInputBackend.h"
+
+#include <algorithm>
+#include <cstring>
+
+MemoryInputBackend::MemoryInputBackend(const char* data, size_t size)
+{
+	this->data = data;
+	this->size = size;
+	position   = 0;
+}
+
+MemoryInputBackend::~MemoryInputBackend() {}
+
+size_t MemoryInputBackend::read(char* s, size_t n)
+{
+	const char* source = NULL;
+	size_t available = this->view(&source, n);
+	memcpy(s, source, available);
+	return available;
+}
+
+size_t MemoryInputBackend::view(const char** s, size_t n)
+{
+	//Point directly into the buffer
+	size_t available = (size_t)std::min((uint64_t)n, size - std::min(size, position));
+	*s = data + position;
+	position += available;
+	return available;
+}
+
+bool MemoryInputBackend::more()
+{
+	return (position < size);
+}
+
+void MemoryInputBackend::getline(string& s, char delim)
+{
+	s = "";
+	if (position >= size) {
+		return;
+	}
+	
+	//Find the delimiter, and skip past it
+	const char* start = data + position;
+	const char* found = (const char*)memchr(start, delim, size - position);
+	size_t length = (found != NULL) ? (size_t)(found - start) : (size_t)(size - position);
+	s.assign(start, length);
+	position += length + ((found != NULL) ? 1 : 0);
+}
+
+bool MemoryInputBackend::positional()
+{
+	return true;
+}
+
+size_t MemoryInputBackend::ReadAt(char* s, size_t n, uint64_t offset)
+{
+	size_t available = (size_t)std::min((uint64_t)n, size - std::min(size, offset));
+	memcpy(s, data + offset, available);
+	return available;
+}
+
+bool MemoryInputBackend::is_open()
+{
+	return (data != NULL);
+}
+
+void MemoryInputBackend::close()
+{
+	data     = NULL;
+	size     = 0;
+	position = 0;
+}
+
+void MemoryInputBackend::seekg(streamoff pos)
+{
+	position = (pos > 0) ? (uint64_t)pos : 0;
+}
+
+streampos MemoryInputBackend::tellg()
+{
+	return (streamoff)position;
+}
@@ -0,0 +1,57 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _MEMORY_INPUT_BACKEND
+#define _MEMORY_INPUT_BACKEND
+
+#include "InputBackend.h"
+#include <stdint.h>
+
+//Reads input from a buffer in memory, such as data that is to be encrypted without ever being written to disk.
+//The buffer is not copied, so it must remain valid (and unchanged) for as long as the backend is in use.
+class MemoryInputBackend : public InputBackend
+{
+	public:
+		MemoryInputBackend(const char* data, size_t size);
+		~MemoryInputBackend();
+		
+		size_t read(char* s, size_t n);
+		size_t view(const char** s, size_t n);
+		bool   more();
+		void   getline(string& s, char delim);
+		
+		//The data is already in memory, so it can be copied from any offset on any thread
+		bool   positional();
+		size_t ReadAt(char* s, size_t n, uint64_t offset);
+		
+		bool      is_open();
+		void      close();
+		void      seekg(streamoff pos);
+		streampos tellg();
+		
+	private:
+		const char* data;
+		uint64_t    size;
+		uint64_t    position;
+};
+
+#endif
@@ -0,0 +1,78 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#include "MemoryOutputBackend.h"
+
+#include <algorithm>
+
+MemoryOutputBackend::MemoryOutputBackend(string& buffer)
+{
+	this->buffer = &buffer;
+	this->buffer->clear();
+	position = 0;
+}
+
+MemoryOutputBackend::~MemoryOutputBackend() {}
+
+void MemoryOutputBackend::write(const char* s, size_t n)
+{
+	if (buffer == NULL) {
+		return;
+	}
+	
+	//Writing past the end (after seeking there) fills the gap with zeroes, as it would in a file
+	if (position > buffer->length()) {
+		buffer->resize(position, '\0');
+	}
+	
+	size_t overwritten = (size_t)std::min((uint64_t)n, buffer->length() - position);
+	buffer->replace(position, overwritten, s, overwritten);
+	buffer->append(s + overwritten, n - overwritten);
+	position += n;
+}
+
+void MemoryOutputBackend::preallocate(uint64_t size)
+{
+	if (buffer != NULL) {
+		buffer->reserve(size);
+	}
+}
+
+bool MemoryOutputBackend::is_open()
+{
+	return (buffer != NULL);
+}
+
+void MemoryOutputBackend::close()
+{
+	buffer = NULL;
+}
+
+void MemoryOutputBackend::seekp(streamoff pos)
+{
+	position = (pos > 0) ? (uint64_t)pos : 0;
+}
+
+streampos MemoryOutputBackend::tellp()
+{
+	return (streamoff)position;
+}
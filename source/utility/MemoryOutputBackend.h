@@ -0,0 +1,51 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _MEMORY_OUTPUT_BACKEND
+#define _MEMORY_OUTPUT_BACKEND
+
+#include "OutputBackend.h"
+#include <stdint.h>
+
+//Writes output into a string, such as a container that is to be sent somewhere rather than saved to a file.
+//Unlike a pipe, the output can be seeked, so the header can be rewritten once the payload is complete.
+class MemoryOutputBackend : public OutputBackend
+{
+	public:
+		//The string is not owned by the backend, and any existing contents are discarded
+		MemoryOutputBackend(string& buffer);
+		~MemoryOutputBackend();
+		
+		void write(const char* s, size_t n);
+		void preallocate(uint64_t size);
+		
+		bool      is_open();
+		void      close();
+		void      seekp(streamoff pos);
+		streampos tellp();
+		
+	private:
+		string*  buffer;
+		uint64_t position;
+};
+
+#endif
@@ -22,14 +22,103 @@
 */
 #include "MeteredIfstream.h"
 
+#include "ChunkSizePolicy.h"
+#include "DirectInputBackend.h"
+#include "MappedInputBackend.h"
+#include "PipeInputBackend.h"
+#include "SparseInputBackend.h"
+#include "SplitInputBackend.h"
+#include "StreamInputBackend.h"
+#include "UringInputBackend.h"
+#include "StreamingChecksum.h"
+#include "RateLimiter.h"
 #include <simple-base/base.h>
+#include <cerrno>
+#include <cstring>
 
-MeteredIfstream::MeteredIfstream(string file)
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MeteredIfstream::MeteredIfstream(string file, const IOOptions& options)
+{
+	backend   = OpenBackend(file, options);
+	filename  = file;
+	chunkSize = ChunkSizePolicy::Select(file, options.chunkSize);
+	savedPos  = 0;
+	lastReadCount = 0;
+	checksum = NULL;
+	limiter  = options.readLimiter;
+	ResetReadCount();
+	
+	positionalFd        = -1;
+	positionalAllowed   = !IOOptions::IsStandardStream(file);
+	positionalReadCount = 0;
+}
+
+MeteredIfstream::MeteredIfstream(InputBackend* backend, string name, const IOOptions& options)
 {
-	stream.open(file.c_str(), ios::binary);
-	filename = file;
-	savedPos = 0;
+	this->backend = backend;
+	filename  = name;
+	chunkSize = (options.chunkSize != 0) ? options.chunkSize : ChunkSizePolicy::DefaultChunkSize;
+	savedPos  = 0;
+	lastReadCount = 0;
+	checksum = NULL;
+	limiter  = options.readLimiter;
 	ResetReadCount();
+	
+	//There is no file behind the name, so only backends that support positional reads themselves can perform them
+	positionalFd        = -1;
+	positionalAllowed   = false;
+	positionalReadCount = 0;
+}
+
+InputBackend* MeteredIfstream::OpenBackend(const string& file, const IOOptions& options)
+{
+	//Standard input can only be read sequentially
+	InputBackend* backend = NULL;
+	if (IOOptions::IsStandardStream(file)) {
+		backend = new PipeInputBackend(0);
+	}
+	
+	//Use io_uring or direct I/O if requested, otherwise memory map the file if we can
+	if (backend == NULL && options.engine == IOEngine::Uring)
+	{
+		backend = new UringInputBackend(file, options);
+		if (!backend->is_open())
+		{
+			delete backend;
+			backend = NULL;
+		}
+	}
+	
+	if (backend == NULL && options.directIO) {
+		backend = new DirectInputBackend(file);
+	}
+	else if (backend == NULL) {
+		backend = new MappedInputBackend(file, options);
+	}
+	
+	//Fall back to reading the file as a stream
+	if (!backend->is_open())
+	{
+		delete backend;
+		backend = new StreamInputBackend(file);
+	}
+	
+	return backend;
+}
+
+MeteredIfstream::~MeteredIfstream()
+{
+	#ifndef _WIN32
+	if (positionalFd != -1) {
+		::close(positionalFd);
+	}
+	#endif
+	
+	delete backend;
 }
 
 //Accessors
@@ -43,6 +132,11 @@ size_t MeteredIfstream::ReadCount()
 	return readCount;
 }
 
+size_t MeteredIfstream::ChunkSize()
+{
+	return chunkSize;
+}
+
 //Mutators
 void MeteredIfstream::ResetReadCount()
 {
@@ -61,44 +155,160 @@ void MeteredIfstream::RestorePos()
 	seekg(savedPos);
 }
 
+void MeteredIfstream::SkipHoles(const SparseMap& map)
+{
+	backend = new SparseInputBackend(backend, map);
+	positionalAllowed = false;
+}
+
+void MeteredIfstream::JoinVolumes(const vector<string>& volumes, uint64_t volumeSize, const IOOptions& options)
+{
+	backend = new SplitInputBackend(backend, volumes, volumeSize, options);
+	positionalAllowed = false;
+}
+
+void MeteredIfstream::AttachChecksum(StreamingChecksum* checksum)
+{
+	this->checksum = checksum;
+}
+
 void MeteredIfstream::SetReadLimit(size_t limit)
 {
 	ResetReadCount();
 	readLimit = limit;
 }
 
-size_t MeteredIfstream::read(char* s, size_t n)
+size_t MeteredIfstream::ApplyReadLimit(size_t n)
 {
 	//Determine how many bytes can be read, based on the read limit
 	if (readLimit != 0)
 	{
-		//If we have already reached the limit, no bytes can be read
+		//If we have already reached the limit, no bytes can be read, otherwise allow the remaining bytes to be read, but no more
 		if (readLimitReached == true) {
 			n = 0;
 		}
-		else
-		{
-			//Below the limit, check if this is the final read
-			size_t desiredEnd = readCount + n;
-			int    diff       = desiredEnd - readLimit;
-			if (diff >= 0)
-			{
-				//Allow the remaining bytes to be read, but no more
-				n -= diff;
-				readLimitReached = true;
-			}
+		else if (readCount + n >= readLimit) {
+			n = readLimit - readCount;
 		}
 	}
 	
+	return n;
+}
+
+void MeteredIfstream::CountRead(size_t n)
+{
+	//Backends may return fewer bytes than requested, so the limit is only reached once the bytes have actually been read
+	lastReadCount = n;
+	readCount += n;
+	if (readLimit != 0 && readCount >= readLimit) {
+		readLimitReached = true;
+	}
+	
+	//Throttle the reads if a maximum rate was requested
+	if (limiter != NULL) {
+		limiter->Consume(n);
+	}
+}
+
+size_t MeteredIfstream::read(char* s, size_t n)
+{
 	//Perform the read
-	if (n > 0)
+	n = this->ApplyReadLimit(n);
+	this->CountRead((n > 0) ? backend->read(s, n) : 0);
+	if (checksum != NULL) {
+		checksum->Input(s, lastReadCount);
+	}
+	
+	return lastReadCount;
+}
+
+size_t MeteredIfstream::ReadView(const char** s, size_t n)
+{
+	//Perform the read
+	n = this->ApplyReadLimit(n);
+	this->CountRead((n > 0) ? backend->view(s, n) : 0);
+	if (checksum != NULL) {
+		checksum->Input(*s, lastReadCount);
+	}
+	
+	return lastReadCount;
+}
+
+int MeteredIfstream::PositionalDescriptor()
+{
+	if (!positionalAllowed) {
+		throw string("Positional reads are not supported for " + filename);
+	}
+	
+	//Once the descriptor is open, the threads reading through it don't need to take the lock
+	int fd = positionalFd;
+	if (fd != -1) {
+		return fd;
+	}
+	
+	//The first thread to need the descriptor opens it, while the others wait and then use the same one
+	std::lock_guard<std::mutex> guard(positionalLock);
+	#ifndef _WIN32
+	if (positionalFd == -1)
 	{
-		stream.read(s, n);
-		readCount += stream.gcount();
-		return stream.gcount();
+		fd = open(filename.c_str(), O_RDONLY);
+		if (fd == -1) {
+			throw string("Could not open " + filename + " for positional reads (" + strerror(errno) + ")");
+		}
+		
+		positionalFd = fd;
 	}
+	#else
+	throw string("Positional reads are not supported for " + filename);
+	#endif
 	
-	return 0;
+	return positionalFd;
+}
+
+size_t MeteredIfstream::ReadAt(char* s, size_t n, uint64_t offset)
+{
+	size_t bytesRead = 0;
+	if (backend->positional()) {
+		bytesRead = backend->ReadAt(s, n, offset);
+	}
+	else
+	{
+		//The backend has a position of its own, so a separate descriptor is read instead, which pread() leaves unmoved
+		int fd = this->PositionalDescriptor();
+		
+		#ifndef _WIN32
+		while (bytesRead < n)
+		{
+			ssize_t result = pread(fd, s + bytesRead, n - bytesRead, offset + bytesRead);
+			if (result == -1 && errno == EINTR) {
+				continue;
+			}
+			
+			if (result < 0) {
+				throw string("Could not read from " + filename);
+			}
+			
+			//We have reached the end of the file
+			if (result == 0) {
+				break;
+			}
+			
+			bytesRead += result;
+		}
+		#endif
+	}
+	
+	positionalReadCount += bytesRead;
+	if (limiter != NULL) {
+		limiter->Consume(bytesRead);
+	}
+	
+	return bytesRead;
+}
+
+uint64_t MeteredIfstream::PositionalReadCount()
+{
+	return positionalReadCount;
 }
 
 //Helper function for the endian-specific functions
@@ -128,31 +338,39 @@ size_t MeteredIfstream::ReadBigEndian(char* s, size_t n)
 	return this->ReadAsTarget(s, n, BIG_ENDIAN);
 }
 
-//Functions directly delegated to the fstream object
+//Functions directly delegated to the backend
 bool MeteredIfstream::is_open()
 {
-	return stream.is_open();
+	return backend->is_open();
 }
 
 void MeteredIfstream::close()
 {
-	stream.close();
+	backend->close();
+	
+	#ifndef _WIN32
+	std::lock_guard<std::mutex> guard(positionalLock);
+	if (positionalFd != -1)
+	{
+		::close(positionalFd);
+		positionalFd = -1;
+	}
+	#endif
 }
 
 void MeteredIfstream::seekg(streamoff pos)
 {
-	stream.clear();
-	stream.seekg(pos, ios::beg);
+	backend->seekg(pos);
 }
 
 streampos MeteredIfstream::tellg()
 {
-	return stream.tellg();
+	return backend->tellg();
 }
 
 size_t MeteredIfstream::gcount()
 {
-	return stream.gcount();
+	return lastReadCount;
 }
 
 bool MeteredIfstream::BytesRemaining()
@@ -161,11 +379,10 @@ bool MeteredIfstream::BytesRemaining()
 		return false;
 	}
 	
-	return !stream.eof();
+	return backend->more();
 }
 
 void MeteredIfstream::getline(string& s, char delim)
 {
-	std::getline(stream, s, delim);
+	backend->getline(s, delim);
 }
-
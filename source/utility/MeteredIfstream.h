@@ -23,44 +23,95 @@
 #ifndef _METERED_IFSTREAM
 #define _METERED_IFSTREAM
 
+#include "InputBackend.h"
+#include "IOOptions.h"
+#include "SparseMap.h"
+#include <atomic>
 #include <fstream>
+#include <mutex>
 #include <string>
+#include <vector>
 using std::ifstream;
 using std::string;
+using std::vector;
 using std::ios;
 using std::streampos;
 using std::streamoff;
 
+class StreamingChecksum;
+class RateLimiter;
+
 class MeteredIfstream
 {
 	public:
-		MeteredIfstream(string file);
+		//Regular files are read directly (if requested) or memory mapped where possible, falling back to an ifstream for pipes and special files.
+		//The file "-" refers to stdin.
+		MeteredIfstream(string file, const IOOptions& options = IOOptions::Defaults());
+		
+		//Reads from a backend that has already been opened, such as a buffer in memory (see MemoryInputBackend) or a callback (see CallbackInputBackend).
+		//The stream takes ownership of the backend, and the name is only used in place of a filename (such as the one stored in the header).
+		MeteredIfstream(InputBackend* backend, string name, const IOOptions& options = IOOptions::Defaults());
+		~MeteredIfstream();
+		
+		//Selects and opens the backend for a file
+		static InputBackend* OpenBackend(const string& file, const IOOptions& options);
 		
 		//Accessors
 		string GetFileName();
 		size_t ReadCount();
 		bool   BytesRemaining();
 		
+		//The size of the chunks in which the file should be read and transformed
+		size_t ChunkSize();
+		
 		//Mutators
 		void ResetReadCount();
 		void SavePos();
 		void RestorePos();
 		
+		//Reads only the data extents of a sparse file from here on, as if the holes had been removed (positions become offsets into the data).
+		//The extents are read in the order they are listed, which is also used to put the parts of a displaced container back in order.
+		void SkipHoles(const SparseMap& map);
+		
+		//Reads the rest of a split container from here on, continuing through each of the volumes (the file being the first of them)
+		void JoinVolumes(const vector<string>& volumes, uint64_t volumeSize, const IOOptions& options = IOOptions::Defaults());
+		
+		//Adds every byte read hereafter to the checksum (NULL stops adding them)
+		void AttachChecksum(StreamingChecksum* checksum);
+		
 		//Resets the read count and only allows n number of bytes to be read hereafter (until we call ResetReadCount() again)
 		void SetReadLimit(size_t limit);
 		
 		//Increments the counter and returns the number of bytes read
 		size_t read(char* s, size_t n);
 		
+		//The same as read(), but points s at the bytes instead of copying them where the backend allows it.
+		//The view may be shorter than requested even when more bytes remain.
+		//The bytes remain valid until the next call to any of the stream's functions.
+		size_t ReadView(const char** s, size_t n);
+		
+		//Reads up to n bytes from the specified offset into s, returning the number of bytes read (fewer only at the end of the file).
+		//Unlike read(), this neither uses nor moves the stream's position, so any number of threads can call it at once (on a memory
+		//mapping the bytes are copied, otherwise they are read with pread() from a descriptor shared by every thread). Positional reads
+		//are throttled by the rate limiter and counted by PositionalReadCount(), but aren't added to the checksum or the read limit.
+		//Sparse and split input can't be read this way, since the offsets in the file no longer match those of the stream.
+		size_t ReadAt(char* s, size_t n, uint64_t offset);
+		
+		//The number of bytes read by ReadAt() on every thread so far
+		uint64_t PositionalReadCount();
+		
 		//Reads a number of bytes, and treats them as being little endian (flips them on big endian systems)
 		size_t ReadLittleEndian(char* s, size_t n);
 		
 		//Reads a number of bytes, and treats them as being big endian (flips them on little endian systems)
 		size_t ReadBigEndian(char* s, size_t n);
 		
-		//Functions directly delegated to the ifstream object
-		bool is_open();
+		//Closes the backend and the descriptor for positional reads (which is opened again if ReadAt() is called afterwards).
+		//This must not be called while other threads are still inside ReadAt(), since they may be reading through the descriptor.
 		void close();
+		
+		//Functions directly delegated to the backend
+		bool is_open();
 		void seekg(streamoff pos);
 		streampos tellg();
 		size_t gcount();
@@ -68,18 +119,44 @@ class MeteredIfstream
 		void getline(string& s, char delim);
 		
 	private:
-		ifstream stream;
+		//Streams own their backend, so they can't be copied
+		MeteredIfstream(const MeteredIfstream&);
+		MeteredIfstream& operator=(const MeteredIfstream&);
+		
+		InputBackend* backend;
 		string filename;
+		size_t chunkSize;
+		
+		StreamingChecksum* checksum;
+		RateLimiter*       limiter;
 		
 		size_t readCount;
+		size_t lastReadCount;
 		
 		streampos savedPos;
 		
 		size_t readLimit;
 		bool   readLimitReached;
 		
+		//The descriptor for positional reads through backends that can't perform them, opened by the first thread that needs it
+		//(and opened again if it is needed after the stream has been closed)
+		std::atomic<int> positionalFd;
+		bool             positionalAllowed;
+		std::mutex       positionalLock;
+		
+		std::atomic<uint64_t> positionalReadCount;
+		
+		//Returns the descriptor for positional reads, opening it if necessary (throws if it can't be opened)
+		int PositionalDescriptor();
+		
 		//Helper function for the endian-specific functions
 		size_t ReadAsTarget(char* s, size_t n, int targetEndianness);
+		
+		//Helper function to reduce the size of a read so that it doesn't exceed the read limit
+		size_t ApplyReadLimit(size_t n);
+		
+		//Helper function to update the counters after a read
+		void CountRead(size_t n);
 };
 
 #endif
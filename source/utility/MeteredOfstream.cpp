@@ -22,16 +22,100 @@
 */
 #include "MeteredOfstream.h"
 
+#include "DirectOutputBackend.h"
+#include "FileOutputBackend.h"
+#include "PipeOutputBackend.h"
+#include "SparseOutputBackend.h"
+#include "SplitOutputBackend.h"
+#include "StreamOutputBackend.h"
+#include "TeeOutputBackend.h"
+#include "UringOutputBackend.h"
+#include "StreamingChecksum.h"
+#include "RateLimiter.h"
 #include <simple-base/base.h>
 
-MeteredOfstream::MeteredOfstream(string file)
+MeteredOfstream::MeteredOfstream(string file, bool truncate, const IOOptions& options)
 {
-	stream.open(file.c_str(), ios::binary);
+	backend  = OpenBackend(file, truncate, options);
 	filename = file;
 	savedPos = 0;
+	checksum = NULL;
+	limiter  = options.writeLimiter;
 	ResetWriteCount();
 }
 
+MeteredOfstream::MeteredOfstream(string file, uint64_t volumeSize, const vector<string>& directories, const IOOptions& options)
+{
+	backend  = (volumeSize > 0) ? new SplitOutputBackend(file, volumeSize, directories, options) : OpenBackend(file, true, options);
+	filename = file;
+	savedPos = 0;
+	checksum = NULL;
+	limiter  = options.writeLimiter;
+	ResetWriteCount();
+}
+
+MeteredOfstream::MeteredOfstream(OutputBackend* backend, string name, const IOOptions& options)
+{
+	this->backend = backend;
+	filename = name;
+	savedPos = 0;
+	checksum = NULL;
+	limiter  = options.writeLimiter;
+	ResetWriteCount();
+}
+
+OutputBackend* MeteredOfstream::OpenBackend(const string& file, bool truncate, const IOOptions& options)
+{
+	//Standard output can only be written sequentially
+	OutputBackend* backend = NULL;
+	if (IOOptions::IsStandardStream(file)) {
+		backend = new PipeOutputBackend(1);
+	}
+	
+	//io_uring and direct I/O are only used for new files, falling back to an ofstream if they aren't supported
+	if (backend == NULL && options.engine == IOEngine::Uring && truncate)
+	{
+		backend = new UringOutputBackend(file, options);
+		if (!backend->is_open())
+		{
+			delete backend;
+			backend = NULL;
+		}
+	}
+	
+	if (backend == NULL && options.directIO && truncate)
+	{
+		backend = new DirectOutputBackend(file, options);
+		if (!backend->is_open())
+		{
+			delete backend;
+			backend = NULL;
+		}
+	}
+	
+	//Advising the kernel about the pages we write, or reserving space for them, requires a file descriptor
+	if (backend == NULL)
+	{
+		backend = new FileOutputBackend(file, truncate, options);
+		if (!backend->is_open())
+		{
+			delete backend;
+			backend = NULL;
+		}
+	}
+	
+	if (backend == NULL) {
+		backend = new StreamOutputBackend(file, truncate);
+	}
+	
+	return backend;
+}
+
+MeteredOfstream::~MeteredOfstream()
+{
+	delete backend;
+}
+
 //Accessors
 string MeteredOfstream::GetFileName()
 {
@@ -59,10 +143,66 @@ void MeteredOfstream::RestorePos()
 	seekp(savedPos);
 }
 
+void MeteredOfstream::RecreateHoles(const SparseMap& map)
+{
+	backend = new SparseOutputBackend(backend, filename, map, IOOptions::IsStandardStream(filename));
+}
+
+bool MeteredOfstream::Tee(const vector<string>& files, const IOOptions& options)
+{
+	//The copies are always written from the start, just like the original
+	vector<OutputBackend*> destinations(1, backend);
+	for (size_t i = 0; i < files.size(); ++i) {
+		destinations.push_back(OpenBackend(files[i], true, options));
+	}
+	
+	backend = new TeeOutputBackend(destinations);
+	return backend->is_open();
+}
+
+void MeteredOfstream::Preallocate(uint64_t size)
+{
+	try {
+		backend->preallocate(size);
+	}
+	catch (const string& message) {
+		this->Fail(message);
+	}
+}
+
+void MeteredOfstream::AttachChecksum(StreamingChecksum* checksum)
+{
+	this->checksum = checksum;
+}
+
 void MeteredOfstream::write(const char* s, size_t n)
 {
-	stream.write(s, n);
+	//Once the output has failed, the rest of it is discarded
+	if (this->fail()) {
+		return;
+	}
+	
+	//Backends that hand the writes to other threads (such as TeeOutputBackend) throw the errors those threads encounter,
+	//which are recorded here, just as the other backends record their own
+	try {
+		backend->write(s, n);
+	}
+	catch (const string& message)
+	{
+		this->Fail(message);
+		return;
+	}
+	
 	writeCount += n;
+	
+	if (checksum != NULL) {
+		checksum->Input(s, n);
+	}
+	
+	//Throttle the writes if a maximum rate was requested
+	if (limiter != NULL) {
+		limiter->Consume(n);
+	}
 }
 
 //Helper function for the endian-specific functions
@@ -101,24 +241,47 @@ void MeteredOfstream::WriteBigEndian(char* s, size_t n)
 	this->WriteForTarget(s, n, BIG_ENDIAN);
 }
 
-//Functions directly delegated to the fstream object
-bool MeteredOfstream::is_open()
+void MeteredOfstream::Fail(const string& message)
+{
+	if (error.empty()) {
+		error = message;
+	}
+}
+
+bool MeteredOfstream::fail()
 {
-	return stream.is_open();
+	return (!error.empty() || !backend->WriteError().empty());
 }
 
-void MeteredOfstream::close()
+string MeteredOfstream::WriteError()
 {
-	stream.close();
+	return (error.empty()) ? backend->WriteError() : error;
+}
+
+bool MeteredOfstream::close()
+{
+	backend->close();
+	return !this->fail();
 }
 
 void MeteredOfstream::seekp(streamoff pos)
 {
-	stream.seekp(pos, ios::beg);
-	stream.clear();
+	//Seeking a backend that can't seek (such as a pipe) fails the output, just as a write error would
+	try {
+		backend->seekp(pos);
+	}
+	catch (const string& message) {
+		this->Fail(message);
+	}
+}
+
+//Functions directly delegated to the backend
+bool MeteredOfstream::is_open()
+{
+	return backend->is_open();
 }
 
 streampos MeteredOfstream::tellp()
 {
-	return stream.tellp();
+	return backend->tellp();
 }
@@ -23,18 +23,39 @@
 #ifndef _METERED_OFSTREAM
 #define _METERED_OFSTREAM
 
+#include "OutputBackend.h"
+#include "IOOptions.h"
+#include "SparseMap.h"
 #include <fstream>
 #include <string>
+#include <vector>
 using std::ofstream;
 using std::string;
+using std::vector;
 using std::ios;
 using std::streampos;
 using std::streamoff;
 
+class StreamingChecksum;
+class RateLimiter;
+
 class MeteredOfstream
 {
 	public:
-		MeteredOfstream(string file);
+		//Unless truncate is false, any existing contents of the file are discarded. The file "-" refers to stdout.
+		MeteredOfstream(string file, bool truncate = true, const IOOptions& options = IOOptions::Defaults());
+		
+		//Splits the output into volumes of the specified size (in bytes), named after the file with the volume number appended
+		//and spread across the directories (see SplitOutputBackend). A volume size of zero writes a single file, as above.
+		MeteredOfstream(string file, uint64_t volumeSize, const vector<string>& directories, const IOOptions& options = IOOptions::Defaults());
+		
+		//Writes to a backend that has already been opened, such as a string in memory (see MemoryOutputBackend) or a callback (see CallbackOutputBackend).
+		//The stream takes ownership of the backend, and the name is only used in place of a filename.
+		MeteredOfstream(OutputBackend* backend, string name, const IOOptions& options = IOOptions::Defaults());
+		~MeteredOfstream();
+		
+		//Selects and opens the backend for a file
+		static OutputBackend* OpenBackend(const string& file, bool truncate, const IOOptions& options);
 		
 		//Accessors
 		string GetFileName();
@@ -45,6 +66,19 @@ class MeteredOfstream
 		void SavePos();
 		void RestorePos();
 		
+		//Writes the data written from here on into the extents of a sparse file, recreating the holes between them (or filling them with zeroes, for stdout)
+		void RecreateHoles(const SparseMap& map);
+		
+		//Writes a copy of everything written from here on (including any rewritten headers) to each of the files, returning false if any of them couldn't be opened
+		bool Tee(const vector<string>& files, const IOOptions& options = IOOptions::Defaults());
+		
+		//Reserves disk space for the specified number of bytes, so the file can be allocated in as few extents as possible
+		//(any space left unused is given back when the file is closed)
+		void Preallocate(uint64_t size);
+		
+		//Adds every byte written hereafter to the checksum (NULL stops adding them)
+		void AttachChecksum(StreamingChecksum* checksum);
+		
 		//Writes to the file and increments the counter
 		void write(const char* s, size_t n);
 		
@@ -54,20 +88,41 @@ class MeteredOfstream
 		//Writes a number of bytes, and treats the output as being big endian (flips the bytes on little endian systems)
 		void WriteBigEndian(char* s, size_t n);
 		
-		//Functions directly delegated to the fstream object
+		//Whether any of the output couldn't be written, in which case the rest of it is discarded
+		bool fail();
+		
+		//The first error encountered writing the output, or an empty string if there has been none
+		string WriteError();
+		
+		//Closes the backend, returning false if any of the output couldn't be written (including what it had buffered)
+		bool close();
+		
+		//Functions directly delegated to the backend
 		bool is_open();
-		void close();
 		void seekp(streamoff pos);
 		streampos tellp();
 		
 	private:
-		ofstream stream;
+		//Streams own their backend, so they can't be copied
+		MeteredOfstream(const MeteredOfstream&);
+		MeteredOfstream& operator=(const MeteredOfstream&);
+		
+		OutputBackend* backend;
 		string filename;
 		
+		//An error thrown by the backend, rather than recorded as its WriteError()
+		string error;
+		
+		StreamingChecksum* checksum;
+		RateLimiter*       limiter;
+		
 		size_t writeCount;
 		
 		streampos savedPos;
 		
+		//Records an error thrown by the backend, keeping the first one
+		void Fail(const string& message);
+		
 		//Helper function for the endian-specific functions
 		void WriteForTarget(char* s, size_t n, int targetEndianness);
 };
@@ -0,0 +1,62 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _OUTPUT_BACKEND
+#define _OUTPUT_BACKEND
+
+#include <string>
+#include <fstream>
+#include <stdint.h>
+using std::string;
+using std::streampos;
+using std::streamoff;
+
+//The destination of the bytes written through a MeteredOfstream. Errors writing to the destination are recorded
+//rather than thrown from close() (which destructors call to flush the rest of the output), and once one has been
+//recorded the backend may discard anything else that is written.
+class OutputBackend
+{
+	public:
+		virtual ~OutputBackend();
+		
+		virtual void write(const char* s, size_t n) = 0;
+		
+		//Reserves space for the specified number of bytes, if the destination supports it (by default this does nothing)
+		virtual void preallocate(uint64_t size);
+		
+		virtual bool is_open() = 0;
+		virtual void close() = 0;
+		virtual void seekp(streamoff pos) = 0;
+		virtual streampos tellp() = 0;
+		
+		//The first error encountered writing to the destination, or an empty string if there has been none
+		virtual const string& WriteError();
+		
+	protected:
+		//Records an error, keeping the first one
+		void Fail(const string& message);
+		
+	private:
+		string writeError;
+};
+
+#endif
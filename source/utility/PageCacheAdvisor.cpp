@@ -0,0 +1,143 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#include "PageCacheAdvisor.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+PageCacheAdvisor::PageCacheAdvisor()
+{
+	fd         = -1;
+	mapping    = NULL;
+	output     = false;
+	droppedTo  = 0;
+	flushingTo = 0;
+}
+
+void PageCacheAdvisor::AttachInput(int fd, const char* mapping)
+{
+	this->fd      = fd;
+	this->mapping = mapping;
+	this->output  = false;
+	
+	#ifdef POSIX_FADV_SEQUENTIAL
+	//Sequential access doubles the kernel's readahead, and we request the first window explicitly
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	posix_fadvise(fd, 0, Window, POSIX_FADV_WILLNEED);
+	#endif
+}
+
+void PageCacheAdvisor::AttachOutput(int fd)
+{
+	this->fd     = fd;
+	this->output = true;
+}
+
+void PageCacheAdvisor::Drop(uint64_t start, uint64_t end)
+{
+	#if !defined(_WIN32) && defined(POSIX_FADV_DONTNEED)
+	uint64_t pageSize = sysconf(_SC_PAGESIZE);
+	start = (start / pageSize) * pageSize;
+	end   = (end / pageSize) * pageSize;
+	if (end <= start) {
+		return;
+	}
+	
+	//Pages that we have mapped can't be dropped from the page cache until we unmap them
+	if (mapping != NULL) {
+		madvise((void*)(mapping + start), end - start, MADV_DONTNEED);
+	}
+	
+	posix_fadvise(fd, start, end - start, POSIX_FADV_DONTNEED);
+	#endif
+}
+
+void PageCacheAdvisor::Consumed(uint64_t offset)
+{
+	if (fd == -1 || output) {
+		return;
+	}
+	
+	//After seeking backwards, the pages from there on will be read again
+	if (offset < droppedTo)
+	{
+		droppedTo = offset;
+		return;
+	}
+	
+	//Once a whole window has been consumed, drop it and request the window after the current position
+	if (offset - droppedTo >= Window)
+	{
+		this->Drop(droppedTo, offset);
+		droppedTo = offset;
+		
+		#ifdef POSIX_FADV_WILLNEED
+		posix_fadvise(fd, offset, Window, POSIX_FADV_WILLNEED);
+		#endif
+	}
+}
+
+void PageCacheAdvisor::Written(uint64_t offset)
+{
+	#if defined(__linux__) && defined(SYNC_FILE_RANGE_WRITE)
+	if (fd == -1 || !output || offset < flushingTo + Window) {
+		return;
+	}
+	
+	//Wait for the writeback started last time to complete, so that those pages can be dropped
+	if (flushingTo > droppedTo)
+	{
+		sync_file_range(fd, droppedTo, flushingTo - droppedTo, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+		this->Drop(droppedTo, flushingTo);
+		droppedTo = flushingTo;
+	}
+	
+	//Start writeback of everything written since then, without waiting for it
+	sync_file_range(fd, flushingTo, offset - flushingTo, SYNC_FILE_RANGE_WRITE);
+	flushingTo = offset;
+	#endif
+}
+
+void PageCacheAdvisor::Finish()
+{
+	if (fd == -1) {
+		return;
+	}
+	
+	#if defined(__linux__) && defined(SYNC_FILE_RANGE_WRITE)
+	//Output pages can only be dropped once they have been written back
+	if (output) {
+		sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+	}
+	#endif
+	
+	//Drop the whole file, including any parts we seeked back over after they had been dropped
+	#ifdef POSIX_FADV_DONTNEED
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	#endif
+	
+	fd = -1;
+}
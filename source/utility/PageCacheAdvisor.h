@@ -0,0 +1,67 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _PAGE_CACHE_ADVISOR
+#define _PAGE_CACHE_ADVISOR
+
+#include <cstddef>
+#include <stdint.h>
+
+//Tells the kernel how we are using a file's pages, so that a large sequential pass over a file leaves the page cache as it found it.
+//Input is read ahead in large windows and dropped once consumed, and output is written back and dropped shortly after it is written.
+//The advice is only a hint, so on platforms without posix_fadvise() (or sync_file_range() for output) this does nothing.
+class PageCacheAdvisor
+{
+	public:
+		PageCacheAdvisor();
+		
+		//Sets the file to advise about. For input that is memory mapped, the mapping must be supplied so that our own
+		//mapping of the pages can be dropped first.
+		void AttachInput(int fd, const char* mapping = NULL);
+		void AttachOutput(int fd);
+		
+		//Tells the advisor that the input has been consumed up to the specified offset
+		void Consumed(uint64_t offset);
+		
+		//Tells the advisor that the output has been written up to the specified offset
+		void Written(uint64_t offset);
+		
+		//Writes back and drops everything that remains, once the file is complete (input must be unmapped first)
+		void Finish();
+		
+		//Advice is given in windows of this size
+		static const uint64_t Window = 8*1024*1024;
+		
+	private:
+		int         fd;
+		const char* mapping;
+		bool        output;
+		
+		//Everything before droppedTo has been dropped, and for output, everything before flushingTo has started writeback
+		uint64_t droppedTo;
+		uint64_t flushingTo;
+		
+		//Drops a range of pages from the page cache (the range is reduced to whole pages)
+		void Drop(uint64_t start, uint64_t end);
+};
+
+#endif
@@ -0,0 +1,179 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#include "PipeInputBackend.h"
+#include "AlignedBufferPool.h"
+#include "MemoryBudget.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <unistd.h>
+#endif
+
+PipeInputBackend::PipeInputBackend(int fd) : PipeInputBackend()
+{
+	this->fd = fd;
+	
+	#ifdef _WIN32
+	//Standard streams are opened in text mode under Windows
+	_setmode(fd, _O_BINARY);
+	#endif
+}
+
+PipeInputBackend::PipeInputBackend()
+{
+	fd           = -1;
+	position     = 0;
+	bufferPos    = 0;
+	bufferLength = 0;
+	current      = 0;
+	
+	//Under a memory limit, the buffers may be smaller than BufferSize
+	bufferSize = MemoryBudget::Reserve(2 * BufferSize, 2 * MinimumBufferSize) / 2;
+	buffers[0] = AlignedBufferPool::Acquire(bufferSize);
+	buffers[1] = AlignedBufferPool::Acquire(bufferSize);
+}
+
+PipeInputBackend::~PipeInputBackend()
+{
+	AlignedBufferPool::Release(buffers[0], bufferSize);
+	AlignedBufferPool::Release(buffers[1], bufferSize);
+	MemoryBudget::Release(2 * bufferSize);
+}
+
+size_t PipeInputBackend::Fill()
+{
+	if (bufferPos == bufferLength && this->is_open())
+	{
+		current      = 1 - current;
+		bufferPos    = 0;
+		bufferLength = 0;
+		bufferLength = this->ReadSome(buffers[current], bufferSize);
+	}
+	
+	return bufferLength - bufferPos;
+}
+
+size_t PipeInputBackend::ReadSome(char* s, size_t n)
+{
+	int result = -1;
+	do {
+		result = ::read(fd, s, n);
+	} while (result == -1 && errno == EINTR);
+	
+	if (result < 0) {
+		throw string("Could not read from input pipe");
+	}
+	
+	return result;
+}
+
+char* PipeInputBackend::Data()
+{
+	return buffers[current] + bufferPos;
+}
+
+void PipeInputBackend::Consume(size_t n)
+{
+	bufferPos += n;
+	position  += n;
+}
+
+size_t PipeInputBackend::read(char* s, size_t n)
+{
+	//Unlike the other backends, reads from a pipe can return early, so keep reading until the request is satisfied
+	size_t bytesRead = 0;
+	size_t available = 0;
+	while (bytesRead < n && (available = this->Fill()) > 0)
+	{
+		size_t bytes = std::min(available, n - bytesRead);
+		memcpy(s + bytesRead, this->Data(), bytes);
+		this->Consume(bytes);
+		bytesRead += bytes;
+	}
+	
+	return bytesRead;
+}
+
+size_t PipeInputBackend::view(const char** s, size_t n)
+{
+	//Expose whatever the last read from the descriptor returned
+	size_t bytes = std::min(this->Fill(), n);
+	*s = this->Data();
+	this->Consume(bytes);
+	return bytes;
+}
+
+bool PipeInputBackend::more()
+{
+	return (this->Fill() > 0);
+}
+
+void PipeInputBackend::getline(string& s, char delim)
+{
+	s.clear();
+	size_t available = 0;
+	while ((available = this->Fill()) > 0)
+	{
+		//Consume up to and including the delimiter, if it is in the buffer
+		const char* start = this->Data();
+		const char* found = (const char*)memchr(start, delim, available);
+		if (found != NULL)
+		{
+			s.append(start, found - start);
+			this->Consume((found - start) + 1);
+			return;
+		}
+		
+		s.append(start, available);
+		this->Consume(available);
+	}
+}
+
+bool PipeInputBackend::is_open()
+{
+	return (fd != -1);
+}
+
+void PipeInputBackend::close()
+{
+	fd = -1;
+}
+
+void PipeInputBackend::seekg(streamoff pos)
+{
+	//We can only "seek" to where we already are
+	if (pos != (streamoff)position) {
+		throw string("Cannot seek within an input pipe");
+	}
+}
+
+streampos PipeInputBackend::tellg()
+{
+	return (streamoff)position;
+}
@@ -0,0 +1,80 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _PIPE_INPUT_BACKEND
+#define _PIPE_INPUT_BACKEND
+
+#include "InputBackend.h"
+#include <stdint.h>
+
+//Reads input from a file descriptor that can't be seeked or mapped, such as stdin connected to a pipe
+class PipeInputBackend : public InputBackend
+{
+	public:
+		//The descriptor is not closed by the backend
+		PipeInputBackend(int fd);
+		~PipeInputBackend();
+		
+		size_t read(char* s, size_t n);
+		size_t view(const char** s, size_t n);
+		bool   more();
+		void   getline(string& s, char delim);
+		
+		bool      is_open();
+		void      close();
+		void      seekg(streamoff pos);
+		streampos tellg();
+		
+		//The size of each read from the descriptor
+		static const size_t BufferSize = 1024*1024;
+		static const size_t MinimumBufferSize = 4*1024;
+		
+	protected:
+		//Backends that read from something other than a descriptor (see CallbackInputBackend) override ReadSome(), is_open() and close()
+		PipeInputBackend();
+		
+		//Reads up to n bytes into s, returning the number of bytes read (zero at the end of the input)
+		virtual size_t ReadSome(char* s, size_t n);
+		
+	private:
+		int      fd;
+		uint64_t position;
+		
+		//The bytes in the current buffer from bufferPos onwards have been read from the descriptor but not consumed.
+		//Refills alternate between two buffers, so that a view remains valid when more() reads ahead.
+		char*        buffers[2];
+		size_t       bufferSize;
+		int          current;
+		size_t       bufferPos;
+		size_t       bufferLength;
+		
+		//Refills the other buffer once the current one has been consumed, returning the number of bytes available (zero at the end of the input)
+		size_t Fill();
+		
+		//The unconsumed bytes in the current buffer
+		char* Data();
+		
+		//Consumes bytes from the buffer
+		void Consume(size_t n);
+};
+
+#endif
@@ -0,0 +1,155 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#include "PipeOutputBackend.h"
+#include "AlignedBufferPool.h"
+#include "MemoryBudget.h"
+
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <unistd.h>
+#endif
+
+PipeOutputBackend::PipeOutputBackend(int fd) : PipeOutputBackend()
+{
+	this->fd = fd;
+	
+	#ifdef _WIN32
+	//Standard streams are opened in text mode under Windows
+	_setmode(fd, _O_BINARY);
+	#endif
+}
+
+PipeOutputBackend::PipeOutputBackend()
+{
+	fd           = -1;
+	position     = 0;
+	bufferLength = 0;
+	bufferSize   = MemoryBudget::Reserve(BufferSize, 0);
+	buffer       = (bufferSize > 0) ? AlignedBufferPool::Acquire(bufferSize) : NULL;
+}
+
+PipeOutputBackend::~PipeOutputBackend()
+{
+	this->close();
+	AlignedBufferPool::Release(buffer, bufferSize);
+	MemoryBudget::Release(bufferSize);
+}
+
+void PipeOutputBackend::WriteThrough(const char* s, size_t n)
+{
+	while (n > 0)
+	{
+		int result = ::write(fd, s, n);
+		if (result == -1 && errno == EINTR) {
+			continue;
+		}
+		
+		if (result <= 0)
+		{
+			this->Fail(string("Could not write to output pipe (") + ((result == 0) ? "no bytes written" : strerror(errno)) + ")");
+			return;
+		}
+		
+		s += result;
+		n -= result;
+	}
+}
+
+void PipeOutputBackend::Flush()
+{
+	this->Send(buffer, bufferLength);
+	bufferLength = 0;
+}
+
+void PipeOutputBackend::Send(const char* s, size_t n)
+{
+	//Once a write has failed, the rest of the output is discarded
+	if (!this->WriteError().empty()) {
+		return;
+	}
+	
+	//Subclasses may report errors by throwing them
+	try {
+		this->WriteThrough(s, n);
+	}
+	catch (const string& message) {
+		this->Fail(message);
+	}
+}
+
+void PipeOutputBackend::write(const char* s, size_t n)
+{
+	//Large writes bypass the buffer
+	if (bufferLength + n > bufferSize)
+	{
+		this->Flush();
+		if (n >= bufferSize) {
+			this->Send(s, n);
+		}
+		else
+		{
+			memcpy(buffer, s, n);
+			bufferLength = n;
+		}
+	}
+	else
+	{
+		memcpy(buffer + bufferLength, s, n);
+		bufferLength += n;
+	}
+	
+	position += n;
+}
+
+bool PipeOutputBackend::is_open()
+{
+	return (fd != -1);
+}
+
+void PipeOutputBackend::close()
+{
+	if (fd == -1) {
+		return;
+	}
+	
+	this->Flush();
+	fd = -1;
+}
+
+void PipeOutputBackend::seekp(streamoff pos)
+{
+	//We can only "seek" to where we already are
+	if (pos != (streamoff)position) {
+		throw string("Cannot seek within an output pipe");
+	}
+}
+
+streampos PipeOutputBackend::tellp()
+{
+	return (streamoff)position;
+}
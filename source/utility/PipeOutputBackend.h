@@ -0,0 +1,72 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _PIPE_OUTPUT_BACKEND
+#define _PIPE_OUTPUT_BACKEND
+
+#include "OutputBackend.h"
+#include <stdint.h>
+
+//Writes output to a file descriptor that can't be seeked, such as stdout connected to a pipe
+class PipeOutputBackend : public OutputBackend
+{
+	public:
+		//The descriptor is not closed by the backend
+		PipeOutputBackend(int fd);
+		~PipeOutputBackend();
+		
+		void write(const char* s, size_t n);
+		
+		bool      is_open();
+		void      close();
+		void      seekp(streamoff pos);
+		streampos tellp();
+		
+		//Writes are gathered into a buffer of this size
+		static const size_t BufferSize = 1024*1024;
+		
+	protected:
+		//Backends that write to something other than a descriptor (see CallbackOutputBackend) override WriteThrough(), is_open() and close()
+		PipeOutputBackend();
+		
+		//Writes bytes to the descriptor, retrying partial writes
+		virtual void WriteThrough(const char* s, size_t n);
+		
+		//Writes out the buffer
+		void Flush();
+		
+	private:
+		//Calls WriteThrough(), recording any error it throws
+		void Send(const char* s, size_t n);
+		
+
+		int      fd;
+		uint64_t position;
+		
+		char*  buffer;
+		size_t bufferLength;
+		
+		//The capacity of the buffer, which may be less than BufferSize (or zero) under a memory limit
+		size_t bufferSize;
+};
+
+#endif
@@ -0,0 +1,63 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#include "RateLimiter.h"
+
+#include <algorithm>
+#include <thread>
+
+RateLimiter::RateLimiter(uint64_t rate)
+{
+	this->rate   = (double)rate;
+	this->burst  = this->rate * BurstSeconds;
+	this->tokens = this->burst;
+	this->lastRefill = std::chrono::steady_clock::now();
+}
+
+void RateLimiter::Consume(uint64_t n)
+{
+	if (n == 0 || rate <= 0) {
+		return;
+	}
+	
+	double wait = 0;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		
+		//Add the tokens that have accumulated since the last transfer
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		double elapsed = std::chrono::duration<double>(now - lastRefill).count();
+		tokens = std::min(burst, tokens + (elapsed * rate));
+		lastRefill = now;
+		
+		//Take the tokens for this transfer, and wait for any debt to be paid off
+		tokens -= (double)n;
+		if (tokens < 0) {
+			wait = -tokens / rate;
+		}
+	}
+	
+	//Sleep outside the lock, so that other threads can account for their own transfers in the meantime
+	if (wait > 0) {
+		std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+	}
+}
@@ -0,0 +1,55 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _RATE_LIMITER
+#define _RATE_LIMITER
+
+#include <stdint.h>
+#include <chrono>
+#include <mutex>
+
+//Limits the rate at which bytes pass through the streams that share it, using a token bucket. Tokens accumulate at the
+//configured rate up to a small burst allowance, and a transfer that takes more tokens than are available puts the bucket
+//into debt, so the caller sleeps until it has been paid off. This keeps the long-run rate exact regardless of transfer sizes.
+class RateLimiter
+{
+	public:
+		//The rate is in bytes per second
+		RateLimiter(uint64_t rate);
+		
+		//Accounts for n bytes that have been transferred, sleeping as long as necessary to stay within the rate
+		void Consume(uint64_t n);
+		
+		//The bucket holds at most this many seconds' worth of tokens
+		static constexpr double BurstSeconds = 0.1;
+		
+	private:
+		double rate;
+		double burst;
+		double tokens;
+		std::chrono::steady_clock::time_point lastRefill;
+		
+		//Streams on different threads (such as those hashing a tree checksum) can share the same limiter
+		std::mutex mutex;
+};
+
+#endif
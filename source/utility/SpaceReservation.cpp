@@ -0,0 +1,67 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#include "SpaceReservation.h"
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+SpaceReservation::SpaceReservation()
+{
+	fd       = -1;
+	reserved = false;
+}
+
+void SpaceReservation::Attach(int fd)
+{
+	this->fd = fd;
+}
+
+void SpaceReservation::Reserve(uint64_t size)
+{
+	#if defined(__linux__) && defined(FALLOC_FL_KEEP_SIZE)
+	//posix_fallocate() would fall back to writing zeroes and extend the file, so only the native call is used
+	if (fd != -1 && size > 0 && fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, size) == 0) {
+		reserved = true;
+	}
+	#endif
+}
+
+void SpaceReservation::Finish()
+{
+	#ifndef _WIN32
+	//Truncating the file to its own size releases the blocks allocated beyond the end of it
+	struct stat info;
+	if (fd != -1 && reserved && fstat(fd, &info) == 0)
+	{
+		//Failing to give the space back isn't an error, since the contents of the file are unaffected
+		int result = ftruncate(fd, info.st_size);
+		(void)result;
+	}
+	#endif
+	
+	fd       = -1;
+	reserved = false;
+}
@@ -0,0 +1,50 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _SPACE_RESERVATION
+#define _SPACE_RESERVATION
+
+#include <stdint.h>
+
+//Reserves disk space for an output file before it is written, so that the filesystem can allocate it in as few extents as
+//possible, rather than extending the file a piece at a time. The file's size is left alone, and whatever was reserved past the
+//end of the file is given back once it is complete. Reservation is only a hint, so where fallocate() isn't supported this does nothing.
+class SpaceReservation
+{
+	public:
+		SpaceReservation();
+		
+		//Sets the file to reserve space for
+		void Attach(int fd);
+		
+		//Reserves space for the specified number of bytes from the start of the file
+		void Reserve(uint64_t size);
+		
+		//Gives back the space reserved past the end of the file, once it is complete
+		void Finish();
+		
+	private:
+		int  fd;
+		bool reserved;
+};
+
+#endif
@@ -0,0 +1,130 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#include "SparseInputBackend.h"
+
+#include <algorithm>
+
+SparseInputBackend::SparseInputBackend(InputBackend* file, const SparseMap& map) : map(map)
+{
+	this->file = file;
+	this->seekg(0);
+}
+
+SparseInputBackend::~SparseInputBackend()
+{
+	delete file;
+}
+
+uint64_t SparseInputBackend::Available()
+{
+	while (extent < map.offsets.size() && extentPos == map.lengths[extent])
+	{
+		//Skip over the hole to the start of the next extent
+		++extent;
+		extentPos = 0;
+		if (extent < map.offsets.size()) {
+			file->seekg((streamoff)map.offsets[extent]);
+		}
+	}
+	
+	return (extent < map.offsets.size()) ? map.lengths[extent] - extentPos : 0;
+}
+
+size_t SparseInputBackend::read(char* s, size_t n)
+{
+	size_t bytesRead = 0;
+	uint64_t available = 0;
+	while (bytesRead < n && (available = this->Available()) > 0)
+	{
+		size_t bytes = file->read(s + bytesRead, (size_t)std::min((uint64_t)(n - bytesRead), available));
+		if (bytes == 0) {
+			break;
+		}
+		
+		bytesRead += bytes;
+		extentPos += bytes;
+		position  += bytes;
+	}
+	
+	return bytesRead;
+}
+
+size_t SparseInputBackend::view(const char** s, size_t n)
+{
+	//Views never span extents
+	uint64_t available = this->Available();
+	size_t bytes = (available > 0) ? file->view(s, (size_t)std::min((uint64_t)n, available)) : 0;
+	extentPos += bytes;
+	position  += bytes;
+	return bytes;
+}
+
+bool SparseInputBackend::more()
+{
+	return (this->Available() > 0 && file->more());
+}
+
+void SparseInputBackend::getline(string& s, char delim)
+{
+	s.clear();
+	char c = 0;
+	while (this->read(&c, 1) == 1 && c != delim) {
+		s += c;
+	}
+}
+
+bool SparseInputBackend::is_open()
+{
+	return file->is_open();
+}
+
+void SparseInputBackend::close()
+{
+	file->close();
+}
+
+void SparseInputBackend::seekg(streamoff pos)
+{
+	//Find the extent containing the position
+	uint64_t target = (pos > 0) ? (uint64_t)pos : 0;
+	extent    = 0;
+	extentPos = 0;
+	position  = 0;
+	while (extent < map.offsets.size() && target - position >= map.lengths[extent])
+	{
+		position += map.lengths[extent];
+		++extent;
+	}
+	
+	if (extent < map.offsets.size())
+	{
+		extentPos = target - position;
+		position  = target;
+		file->seekg((streamoff)(map.offsets[extent] + extentPos));
+	}
+}
+
+streampos SparseInputBackend::tellg()
+{
+	return (streamoff)position;
+}
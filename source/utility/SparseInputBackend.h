@@ -0,0 +1,61 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _SPARSE_INPUT_BACKEND
+#define _SPARSE_INPUT_BACKEND
+
+#include "InputBackend.h"
+#include "SparseMap.h"
+
+//Reads only the data extents of a sparse file from another backend, so that the holes appear to have been removed.
+//Positions (for seekg() and tellg()) are offsets into the data extents, rather than into the file.
+class SparseInputBackend : public InputBackend
+{
+	public:
+		//Takes ownership of the backend
+		SparseInputBackend(InputBackend* file, const SparseMap& map);
+		~SparseInputBackend();
+		
+		size_t read(char* s, size_t n);
+		size_t view(const char** s, size_t n);
+		bool   more();
+		void   getline(string& s, char delim);
+		
+		bool      is_open();
+		void      close();
+		void      seekg(streamoff pos);
+		streampos tellg();
+		
+	private:
+		InputBackend* file;
+		SparseMap     map;
+		
+		//The current extent, and our position within it and within the data as a whole
+		size_t   extent;
+		uint64_t extentPos;
+		uint64_t position;
+		
+		//Moves on from any exhausted extents, returning the number of bytes left in the current one
+		uint64_t Available();
+};
+
+#endif
@@ -0,0 +1,172 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#include "SparseMap.h"
+
+#include <simple-base/base.h>
+#include <cerrno>
+#include <cstring>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+SparseMap::SparseMap()
+{
+	fileSize = 0;
+}
+
+bool SparseMap::Scan(const string& file)
+{
+	offsets.clear();
+	lengths.clear();
+	fileSize = 0;
+	
+	#if !defined(_WIN32) && defined(SEEK_DATA) && defined(SEEK_HOLE)
+	int fd = open(file.c_str(), O_RDONLY);
+	if (fd == -1) {
+		return false;
+	}
+	
+	struct stat details;
+	if (fstat(fd, &details) != 0 || !S_ISREG(details.st_mode))
+	{
+		close(fd);
+		return false;
+	}
+	fileSize = details.st_size;
+	
+	//Alternate between finding the start of the next data extent and the hole that follows it
+	uint64_t dataLength = 0;
+	off_t position = 0;
+	bool supported = true;
+	while ((uint64_t)position < fileSize)
+	{
+		off_t dataStart = lseek(fd, position, SEEK_DATA);
+		if (dataStart == -1)
+		{
+			//ENXIO means there is no more data before the end of the file
+			supported = (errno == ENXIO);
+			break;
+		}
+		
+		off_t holeStart = lseek(fd, dataStart, SEEK_HOLE);
+		if (holeStart == -1 || (uint64_t)holeStart > fileSize) {
+			holeStart = fileSize;
+		}
+		
+		offsets.push_back(dataStart);
+		lengths.push_back(holeStart - dataStart);
+		dataLength += holeStart - dataStart;
+		position = holeStart;
+	}
+	close(fd);
+	
+	//Filesystems without hole support report the whole file as a single data extent
+	if (supported && dataLength < fileSize) {
+		return true;
+	}
+	#endif
+	
+	offsets.clear();
+	lengths.clear();
+	fileSize = 0;
+	return false;
+}
+
+bool SparseMap::IsEmpty()
+{
+	return (fileSize == 0 && offsets.size() == 0);
+}
+
+uint64_t SparseMap::DataLength()
+{
+	uint64_t length = 0;
+	for (size_t i = 0; i < lengths.size(); ++i) {
+		length += lengths[i];
+	}
+	
+	return length;
+}
+
+string SparseMap::Serialise()
+{
+	vector<uint64_t> values;
+	values.push_back(fileSize);
+	for (size_t i = 0; i < offsets.size(); ++i)
+	{
+		values.push_back(offsets[i]);
+		values.push_back(lengths[i]);
+	}
+	
+	//Flip the values on big endian systems
+	string data((const char*)values.data(), values.size() * sizeof(uint64_t));
+	if (endianness() != LITTLE_ENDIAN)
+	{
+		for (size_t i = 0; i < values.size(); ++i) {
+			flipBytes(&data[i * sizeof(uint64_t)], sizeof(uint64_t));
+		}
+	}
+	
+	return data;
+}
+
+bool SparseMap::Parse(const string& data)
+{
+	//The file size, followed by pairs of values
+	if (data.length() % (sizeof(uint64_t) * 2) != sizeof(uint64_t)) {
+		return false;
+	}
+	
+	vector<uint64_t> values(data.length() / sizeof(uint64_t));
+	memcpy(values.data(), data.data(), data.length());
+	if (endianness() != LITTLE_ENDIAN)
+	{
+		for (size_t i = 0; i < values.size(); ++i) {
+			flipBytes((char*)&values[i], sizeof(uint64_t));
+		}
+	}
+	
+	fileSize = values[0];
+	offsets.clear();
+	lengths.clear();
+	
+	//Make sure the extents are in order, don't overlap, and lie within the file
+	uint64_t end = 0;
+	for (size_t i = 1; i + 1 < values.size(); i += 2)
+	{
+		uint64_t offset = values[i];
+		uint64_t length = values[i + 1];
+		if (offset < end || length > fileSize || offset > fileSize - length) {
+			return false;
+		}
+		
+		offsets.push_back(offset);
+		lengths.push_back(length);
+		end = offset + length;
+	}
+	
+	return true;
+}
@@ -0,0 +1,62 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _SPARSE_MAP
+#define _SPARSE_MAP
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+using std::string;
+using std::vector;
+
+//Describes which ranges (extents) of a sparse file hold data, so that the holes between them don't need to be read or stored
+class SparseMap
+{
+	public:
+		SparseMap();
+		
+		//Finds the data extents of a file using SEEK_DATA/SEEK_HOLE. Returns false if the file has no holes,
+		//or the platform or filesystem can't report them, in which case the file should be read in full.
+		bool Scan(const string& file);
+		
+		//Determines if the map describes any extents (an empty map means the file is not sparse)
+		bool IsEmpty();
+		
+		//The total length of the data extents
+		uint64_t DataLength();
+		
+		//Serialises the map as the file size, followed by the offset and length of each extent (all 64-bit little endian)
+		string Serialise();
+		
+		//Parses a map produced by Serialise(), returning false if it is malformed
+		bool Parse(const string& data);
+		
+		//The size of the file, including any holes at the end
+		uint64_t fileSize;
+		
+		//The offset and length of each data extent, in increasing order of offset (other users of the map may list them in any order)
+		vector<uint64_t> offsets;
+		vector<uint64_t> lengths;
+};
+
+#endif
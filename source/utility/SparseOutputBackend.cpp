@@ -0,0 +1,145 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#include "SparseOutputBackend.h"
+
+#include <algorithm>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+SparseOutputBackend::SparseOutputBackend(OutputBackend* file, const string& filename, const SparseMap& map, bool fillHoles) : map(map)
+{
+	this->file      = file;
+	this->filename  = filename;
+	this->fillHoles = fillHoles;
+	
+	extent    = 0;
+	extentPos = 0;
+	position  = 0;
+}
+
+SparseOutputBackend::~SparseOutputBackend()
+{
+	delete file;
+}
+
+void SparseOutputBackend::SkipTo(uint64_t offset)
+{
+	if (offset <= position) {
+		return;
+	}
+	
+	if (fillHoles)
+	{
+		static const char zeroes[64*1024] = {0};
+		while (position < offset)
+		{
+			size_t bytes = (size_t)std::min((uint64_t)sizeof(zeroes), offset - position);
+			file->write(zeroes, bytes);
+			position += bytes;
+		}
+	}
+	else
+	{
+		file->seekp((streamoff)offset);
+		position = offset;
+	}
+}
+
+void SparseOutputBackend::write(const char* s, size_t n)
+{
+	while (n > 0)
+	{
+		//Move on from any exhausted extents
+		while (extent < map.offsets.size() && extentPos == map.lengths[extent])
+		{
+			++extent;
+			extentPos = 0;
+		}
+		
+		if (extent == map.offsets.size()) {
+			throw string("The decrypted data is larger than the sparse file's extents");
+		}
+		
+		//Skip over any hole before the current position in the extent
+		this->SkipTo(map.offsets[extent] + extentPos);
+		
+		size_t bytes = (size_t)std::min((uint64_t)n, map.lengths[extent] - extentPos);
+		file->write(s, bytes);
+		
+		s         += bytes;
+		n         -= bytes;
+		extentPos += bytes;
+		position  += bytes;
+	}
+}
+
+bool SparseOutputBackend::is_open()
+{
+	return file->is_open();
+}
+
+void SparseOutputBackend::close()
+{
+	if (!file->is_open()) {
+		return;
+	}
+	
+	//Recreate any hole at the end of the file by extending it to its full size
+	if (fillHoles) {
+		this->SkipTo(map.fileSize);
+	}
+	
+	#ifdef _WIN32
+	else if (position < map.fileSize)
+	{
+		this->SkipTo(map.fileSize - 1);
+		file->write("", 1);
+		position = map.fileSize;
+	}
+	#endif
+	
+	file->close();
+	
+	#ifndef _WIN32
+	if (!fillHoles && position < map.fileSize && truncate(filename.c_str(), (off_t)map.fileSize) != 0) {
+		this->Fail("Could not extend the output file to its original size");
+	}
+	#endif
+}
+
+const string& SparseOutputBackend::WriteError()
+{
+	return (file->WriteError().empty()) ? OutputBackend::WriteError() : file->WriteError();
+}
+
+void SparseOutputBackend::seekp(streamoff pos)
+{
+	throw string("Cannot seek within a sparse output file");
+}
+
+streampos SparseOutputBackend::tellp()
+{
+	return (streamoff)position;
+}
@@ -0,0 +1,63 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _SPARSE_OUTPUT_BACKEND
+#define _SPARSE_OUTPUT_BACKEND
+
+#include "OutputBackend.h"
+#include "SparseMap.h"
+
+//Writes the data extents of a sparse file through another backend, seeking over the holes so that the filesystem recreates them.
+//Output that can't be seeked (such as a pipe) has the holes filled with zeroes instead.
+class SparseOutputBackend : public OutputBackend
+{
+	public:
+		//Takes ownership of the backend
+		SparseOutputBackend(OutputBackend* file, const string& filename, const SparseMap& map, bool fillHoles);
+		~SparseOutputBackend();
+		
+		void write(const char* s, size_t n);
+		
+		bool      is_open();
+		void      close();
+		void      seekp(streamoff pos);
+		streampos tellp();
+		
+		//Errors writing to the backend come before our own
+		const string& WriteError();
+		
+	private:
+		OutputBackend* file;
+		string         filename;
+		SparseMap      map;
+		bool           fillHoles;
+		
+		//The current extent, our position within it, and the position in the file that the backend will write to next
+		size_t   extent;
+		uint64_t extentPos;
+		uint64_t position;
+		
+		//Moves the backend's position forward to the specified offset
+		void SkipTo(uint64_t offset);
+};
+
+#endif
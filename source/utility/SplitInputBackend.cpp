@@ -0,0 +1,222 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#include "SplitInputBackend.h"
+#include "SplitOutputBackend.h"
+#include "MeteredIfstream.h"
+
+#include <cstring>
+#include <algorithm>
+#include <simple-base/base.h>
+
+SplitInputBackend::SplitInputBackend(InputBackend* first, const vector<string>& volumes, uint64_t volumeSize, const IOOptions& options)
+{
+	this->paths      = volumes;
+	this->volumeSize = volumeSize;
+	this->options    = options;
+	this->volumes.resize(std::max((size_t)1, volumes.size()), NULL);
+	this->volumes[0] = first;
+	current = 0;
+	
+	this->OpenAhead();
+}
+
+SplitInputBackend::~SplitInputBackend()
+{
+	this->close();
+}
+
+vector<string> SplitInputBackend::FindVolumes(const string& first, uint32_t count, uint64_t volumeSize, const vector<string>& directories)
+{
+	//The first volume is named "NAME.000", and the others are named after it wherever they are
+	string container = first.substr(0, first.rfind('.'));
+	vector<string> found;
+	for (uint32_t volume = 0; count == 0 || volume < count; ++volume)
+	{
+		string path = (volume == 0) ? first : SplitOutputBackend::VolumePath(container, "", volume);
+		for (size_t i = 0; i < directories.size() && volume > 0 && !file_exists(path); ++i)
+		{
+			string directory = directories[i];
+			if (!ends_with("/", directory) && !ends_with("\\", directory)) {
+				directory += "/";
+			}
+			
+			path = SplitOutputBackend::VolumePath(container, directory, volume);
+		}
+		
+		//Only the last volume may be shorter than the volume size, and no volume is empty. When the number of volumes is known,
+		//one that is cut short before the last is left out, so that it is the one reported as incomplete.
+		std::ifstream volumeFile(path.c_str(), std::ios::binary | std::ios::ate);
+		streamoff size = (volumeFile.is_open()) ? (streamoff)volumeFile.tellg() : 0;
+		if (size <= 0 || (uint64_t)size > volumeSize || (count != 0 && volume + 1 < count && (uint64_t)size < volumeSize)) {
+			break;
+		}
+		
+		found.push_back(path);
+		if ((uint64_t)size < volumeSize) {
+			break;
+		}
+	}
+	
+	return found;
+}
+
+void SplitInputBackend::OpenAhead()
+{
+	size_t next = current + 1;
+	if (next < volumes.size() && volumes[next] == NULL && !opener.joinable())
+	{
+		//Opening the volume maps it (or submits its first reads), so the kernel starts reading it straight away
+		opener = std::thread(&SplitInputBackend::OpenVolume, this, next);
+	}
+}
+
+void SplitInputBackend::OpenVolume(size_t index)
+{
+	volumes[index] = MeteredIfstream::OpenBackend(paths[index], options);
+}
+
+void SplitInputBackend::Join()
+{
+	if (opener.joinable()) {
+		opener.join();
+	}
+}
+
+InputBackend* SplitInputBackend::Volume(size_t index)
+{
+	//The background thread may be opening the very volume we need (and only writes to the volume it opens)
+	this->Join();
+	if (volumes[index] == NULL) {
+		this->OpenVolume(index);
+	}
+	
+	return volumes[index];
+}
+
+bool SplitInputBackend::Advance()
+{
+	if (current + 1 >= volumes.size()) {
+		return false;
+	}
+	
+	//The volumes behind us are closed, releasing their mappings and buffers
+	this->Join();
+	delete volumes[current];
+	volumes[current] = NULL;
+	
+	current++;
+	this->Volume(current)->seekg(0);
+	this->OpenAhead();
+	return true;
+}
+
+size_t SplitInputBackend::read(char* s, size_t n)
+{
+	//Copy out of the volumes, moving through as many of them as necessary
+	size_t total = 0;
+	const char* source = NULL;
+	size_t available = 0;
+	while (total < n && (available = this->view(&source, n - total)) > 0)
+	{
+		memcpy(s + total, source, available);
+		total += available;
+	}
+	
+	return total;
+}
+
+size_t SplitInputBackend::view(const char** s, size_t n)
+{
+	//A view never extends past the end of a volume, so it may be shorter than requested
+	size_t available = 0;
+	do
+	{
+		InputBackend* volume = this->Volume(current);
+		uint64_t remaining = volumeSize - std::min(volumeSize, (uint64_t)(streamoff)volume->tellg());
+		available = volume->view(s, (size_t)std::min((uint64_t)n, remaining));
+	}
+	while (available == 0 && n > 0 && this->Advance());
+	
+	return available;
+}
+
+bool SplitInputBackend::more()
+{
+	return (this->Volume(current)->more() || current + 1 < volumes.size());
+}
+
+void SplitInputBackend::getline(string& s, char delim)
+{
+	s = "";
+	const char* start = NULL;
+	size_t available = 0;
+	while ((available = this->view(&start, volumeSize)) > 0)
+	{
+		//Search the view for the delimiter, stepping back to just past it if it was found
+		const char* found = (const char*)memchr(start, delim, available);
+		if (found != NULL)
+		{
+			s.append(start, found - start);
+			this->seekg((streamoff)this->tellg() - (streamoff)(available - (found - start) - 1));
+			return;
+		}
+		
+		s.append(start, available);
+	}
+}
+
+bool SplitInputBackend::is_open()
+{
+	//The current volume is only missing once the container has been closed
+	return (volumes[current] != NULL && volumes[current]->is_open());
+}
+
+void SplitInputBackend::close()
+{
+	this->Join();
+	for (size_t i = 0; i < volumes.size(); ++i)
+	{
+		delete volumes[i];
+		volumes[i] = NULL;
+	}
+}
+
+void SplitInputBackend::seekg(streamoff pos)
+{
+	//Positions past the end of the last volume are left for its backend to deal with
+	uint64_t position = (pos > 0) ? (uint64_t)pos : 0;
+	size_t volume = (size_t)std::min((uint64_t)(volumes.size() - 1), position / volumeSize);
+	if (volume != current)
+	{
+		this->Join();
+		current = volume;
+		this->OpenAhead();
+	}
+	
+	this->Volume(current)->seekg((streamoff)(position - volume * volumeSize));
+}
+
+streampos SplitInputBackend::tellg()
+{
+	return (streamoff)(current * volumeSize + (uint64_t)(streamoff)this->Volume(current)->tellg());
+}
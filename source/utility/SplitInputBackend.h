@@ -0,0 +1,86 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _SPLIT_INPUT_BACKEND
+#define _SPLIT_INPUT_BACKEND
+
+#include "InputBackend.h"
+#include "IOOptions.h"
+#include <stdint.h>
+#include <thread>
+#include <vector>
+using std::vector;
+
+//Reads a container that was split into volumes (see SplitOutputBackend) as if it were a single file. While one volume is
+//being read, the next is opened on another thread, which starts the kernel reading its beginning, so that volumes stored
+//on different disks are read at the same time. Positions (for seekg() and tellg()) are offsets into the whole container.
+class SplitInputBackend : public InputBackend
+{
+	public:
+		//Takes ownership of the backend, which reads the first of the volumes
+		SplitInputBackend(InputBackend* first, const vector<string>& volumes, uint64_t volumeSize, const IOOptions& options);
+		~SplitInputBackend();
+		
+		size_t read(char* s, size_t n);
+		size_t view(const char** s, size_t n);
+		bool   more();
+		void   getline(string& s, char delim);
+		
+		bool      is_open();
+		void      close();
+		void      seekg(streamoff pos);
+		streampos tellg();
+		
+		//Finds the volumes of a split container from its first volume, searching the first volume's directory and then each
+		//of the others. Every volume but the last must be exactly the volume size, and a count of zero finds as many as exist.
+		//The search stops at the first volume that is missing (or the wrong size), so fewer volumes than expected may be returned.
+		static vector<string> FindVolumes(const string& first, uint32_t count, uint64_t volumeSize, const vector<string>& directories);
+		
+	private:
+		vector<string>        paths;
+		vector<InputBackend*> volumes;
+		uint64_t              volumeSize;
+		IOOptions             options;
+		
+		//The volume being read
+		size_t current;
+		
+		//The thread opening the volume after the current one, if any
+		std::thread opener;
+		
+		//Returns the backend for a volume, opening it if it isn't already (or waiting for it to be opened in the background)
+		InputBackend* Volume(size_t index);
+		
+		//Moves on to the start of the next volume, returning false if there are none left
+		bool Advance();
+		
+		//Starts opening the volume after the current one in the background
+		void OpenAhead();
+		
+		//Opens a volume (on the background thread, when opened ahead)
+		void OpenVolume(size_t index);
+		
+		//Waits for a volume being opened in the background
+		void Join();
+};
+
+#endif
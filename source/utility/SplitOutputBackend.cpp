@@ -0,0 +1,356 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#include "SplitOutputBackend.h"
+#include "MemoryBudget.h"
+#include "MeteredOfstream.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <simple-base/base.h>
+
+//Queues smaller than this would make the stream wait on the writers for every piece
+#define MIN_QUEUE_SIZE (256*1024)
+
+//Marks a volume whose writer's position is unknown, such as one that has just been reopened
+#define UNKNOWN_OFFSET ((uint64_t)-1)
+
+SplitOutputBackend::SplitOutputBackend(const string& file, uint64_t volumeSize, const vector<string>& directories, const IOOptions& options)
+{
+	this->file       = file;
+	this->options    = options;
+	this->volumeSize = volumeSize;
+	position   = 0;
+	reserved   = 0;
+	queued     = 0;
+	stopping   = false;
+	queueLimit = MemoryBudget::Reserve(QueueSize, MIN_QUEUE_SIZE);
+	
+	//The output file's own directory comes first, so that the first volume is always found next to where the file was expected
+	this->directories.push_back("");
+	for (size_t i = 0; i < directories.size(); ++i)
+	{
+		string directory = directories[i];
+		if (!ends_with("/", directory) && !ends_with("\\", directory)) {
+			directory += "/";
+		}
+		
+		this->directories.push_back(directory);
+	}
+	
+	//The first volume is opened straight away, so that is_open() reports whether the output can be written at all
+	writers.resize(this->directories.size());
+	OutputBackend* first = MeteredOfstream::OpenBackend(this->PathOf(0), true, options);
+	failed = !first->is_open();
+	if (failed) {
+		delete first;
+	}
+	else
+	{
+		writers[0].volumes[0] = first;
+		opened.push_back(true);
+		offsets.push_back(0);
+	}
+	
+	//The threads are started once the list of writers is complete, since they refer to its elements
+	for (size_t i = 0; i < writers.size(); ++i) {
+		threads.push_back(std::thread(&SplitOutputBackend::WriterThread, this, i));
+	}
+}
+
+SplitOutputBackend::~SplitOutputBackend()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	
+	workAvailable.notify_all();
+	for (size_t i = 0; i < threads.size(); ++i) {
+		threads[i].join();
+	}
+	
+	//Any volumes that are still open (if the output wasn't closed) are closed as they are deleted
+	for (size_t i = 0; i < writers.size(); ++i)
+	{
+		for (std::map<uint32_t, OutputBackend*>::iterator volume = writers[i].volumes.begin(); volume != writers[i].volumes.end(); ++volume) {
+			delete volume->second;
+		}
+	}
+	
+	MemoryBudget::Release(queueLimit);
+}
+
+string SplitOutputBackend::VolumePath(const string& file, const string& directory, uint32_t volume)
+{
+	char suffix[16];
+	snprintf(suffix, sizeof(suffix), ".%03u", volume);
+	return ((directory == "") ? file : directory + basename(file)) + suffix;
+}
+
+string SplitOutputBackend::PathOf(uint32_t volume)
+{
+	return VolumePath(file, directories[volume % directories.size()], volume);
+}
+
+void SplitOutputBackend::Prepare(uint32_t volume, uint64_t offset)
+{
+	//Volumes are created in order, each with its share of any space that was reserved
+	while (opened.size() <= volume)
+	{
+		uint32_t created = opened.size();
+		opened.push_back(true);
+		offsets.push_back(0);
+		this->Enqueue(OpenOperation, created, 1);
+		if (reserved > created * volumeSize) {
+			this->Enqueue(PreallocateOperation, created, std::min(volumeSize, reserved - created * volumeSize));
+		}
+	}
+	
+	//Volumes that have been closed keep their contents when they are reopened
+	if (!opened[volume])
+	{
+		this->Enqueue(OpenOperation, volume, 0);
+		opened[volume]  = true;
+		offsets[volume] = UNKNOWN_OFFSET;
+	}
+	
+	if (offsets[volume] != offset)
+	{
+		this->Enqueue(SeekOperation, volume, offset);
+		offsets[volume] = offset;
+	}
+}
+
+void SplitOutputBackend::Enqueue(int type, uint32_t volume, uint64_t value, const char* data, size_t n)
+{
+	std::unique_lock<std::mutex> guard(lock);
+	
+	//Wait for room in the queues (a write larger than the limit is let through once they are empty)
+	while (queued > 0 && queued + n > queueLimit && error.empty()) {
+		workCompleted.wait(guard);
+	}
+	
+	//A volume that couldn't be written fails the whole output, just as a single file would
+	if (!error.empty()) {
+		throw error;
+	}
+	
+	Writer& writer = writers[volume % writers.size()];
+	writer.queue.push_back(Operation());
+	Operation& operation = writer.queue.back();
+	operation.type   = type;
+	operation.volume = volume;
+	operation.value  = value;
+	operation.data.assign((data != NULL) ? data : "", n);
+	queued += n;
+	
+	workAvailable.notify_all();
+}
+
+void SplitOutputBackend::Drain()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	for (size_t i = 0; i < writers.size(); ++i)
+	{
+		while (!writers[i].queue.empty() && error.empty()) {
+			workCompleted.wait(guard);
+		}
+	}
+	
+	if (!error.empty()) {
+		throw error;
+	}
+}
+
+void SplitOutputBackend::WriterThread(size_t index)
+{
+	Writer& writer = writers[index];
+	std::unique_lock<std::mutex> guard(lock);
+	while (true)
+	{
+		while (writer.queue.empty() && !stopping) {
+			workAvailable.wait(guard);
+		}
+		
+		if (writer.queue.empty()) {
+			return;
+		}
+		
+		//The operation stays at the front of the queue until it has been performed, so that Drain() waits for it
+		//(references to the elements of a deque remain valid as others are added to the back)
+		const Operation& operation = writer.queue.front();
+		guard.unlock();
+		
+		string message;
+		try {
+			this->Perform(writer, operation);
+		}
+		catch (const string& thrown) {
+			message = thrown;
+		}
+		
+		guard.lock();
+		queued -= operation.data.length();
+		writer.queue.pop_front();
+		
+		//Once a volume has failed, the rest of the output is discarded
+		if (!message.empty() && error.empty()) {
+			error = message;
+		}
+		
+		if (!error.empty())
+		{
+			for (size_t i = 0; i < writer.queue.size(); ++i) {
+				queued -= writer.queue[i].data.length();
+			}
+			writer.queue.clear();
+		}
+		
+		workCompleted.notify_all();
+	}
+}
+
+void SplitOutputBackend::Perform(Writer& writer, const Operation& operation)
+{
+	if (operation.type == OpenOperation)
+	{
+		//The value is non-zero for new volumes, which replace any existing file
+		OutputBackend* volume = MeteredOfstream::OpenBackend(this->PathOf(operation.volume), operation.value != 0, options);
+		if (!volume->is_open())
+		{
+			delete volume;
+			throw string("Could not open output volume (" + this->PathOf(operation.volume) + ")");
+		}
+		
+		writer.volumes[operation.volume] = volume;
+		return;
+	}
+	
+	OutputBackend* volume = writer.volumes[operation.volume];
+	if (operation.type == CloseOperation)
+	{
+		volume->close();
+		string message = volume->WriteError();
+		delete volume;
+		writer.volumes.erase(operation.volume);
+		
+		if (!message.empty()) {
+			throw message;
+		}
+		
+		return;
+	}
+	
+	switch (operation.type)
+	{
+		case WriteOperation:
+			volume->write(operation.data.data(), operation.data.length());
+			break;
+		
+		case SeekOperation:
+			volume->seekp((streamoff)operation.value);
+			break;
+		
+		case PreallocateOperation:
+			volume->preallocate(operation.value);
+			break;
+	}
+	
+	//Volumes record their errors rather than throwing them, so they are thrown here to fail the output
+	if (!volume->WriteError().empty()) {
+		throw volume->WriteError();
+	}
+}
+
+void SplitOutputBackend::write(const char* s, size_t n)
+{
+	while (n > 0)
+	{
+		//Write as much as fits in the current volume
+		uint32_t volume = position / volumeSize;
+		uint64_t offset = position % volumeSize;
+		size_t   length = (size_t)std::min((uint64_t)n, volumeSize - offset);
+		this->Prepare(volume, offset);
+		this->Enqueue(WriteOperation, volume, 0, s, length);
+		offsets[volume] += length;
+		position += length;
+		s += length;
+		n -= length;
+		
+		//A filled volume is closed (and flushed, if requested) by its writer while the next one is being written
+		if (offset + length == volumeSize && volume > 0)
+		{
+			this->Enqueue(CloseOperation, volume, 0);
+			opened[volume] = false;
+		}
+	}
+}
+
+void SplitOutputBackend::preallocate(uint64_t size)
+{
+	//Each volume reserves its own share of the space, including those that are created later
+	reserved = size;
+	for (uint32_t volume = 0; volume < opened.size(); ++volume)
+	{
+		if (opened[volume] && reserved > volume * volumeSize) {
+			this->Enqueue(PreallocateOperation, volume, std::min(volumeSize, reserved - volume * volumeSize));
+		}
+	}
+}
+
+bool SplitOutputBackend::is_open()
+{
+	return !failed;
+}
+
+void SplitOutputBackend::close()
+{
+	try
+	{
+		//The writers close their volumes at the same time as each other
+		for (uint32_t volume = 0; volume < opened.size(); ++volume)
+		{
+			if (opened[volume])
+			{
+				this->Enqueue(CloseOperation, volume, 0);
+				opened[volume] = false;
+			}
+		}
+		
+		this->Drain();
+	}
+	catch (const string& message) {
+		this->Fail(message);
+	}
+}
+
+void SplitOutputBackend::seekp(streamoff pos)
+{
+	//The volume is positioned when it is next written to
+	position = (pos > 0) ? (uint64_t)pos : 0;
+}
+
+streampos SplitOutputBackend::tellp()
+{
+	return (streamoff)position;
+}
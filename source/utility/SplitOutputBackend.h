@@ -0,0 +1,128 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _SPLIT_OUTPUT_BACKEND
+#define _SPLIT_OUTPUT_BACKEND
+
+#include "OutputBackend.h"
+#include "IOOptions.h"
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+using std::vector;
+
+//Splits the output into volumes of a fixed size, for destinations that limit the size of a file. Each volume is named after
+//the output file with its number appended (".000", ".001", ...), and they are placed in the output file's directory and
+//each of the other directories in turn. Every directory has its own writer thread, so that volumes on different disks are
+//written (and flushed) at the same time. Filled volumes are closed as soon as the next one is started, apart from the first,
+//which holds the header that is rewritten once the payload is complete.
+class SplitOutputBackend : public OutputBackend
+{
+	public:
+		SplitOutputBackend(const string& file, uint64_t volumeSize, const vector<string>& directories, const IOOptions& options);
+		~SplitOutputBackend();
+		
+		void write(const char* s, size_t n);
+		void preallocate(uint64_t size);
+		
+		bool      is_open();
+		void      close();
+		void      seekp(streamoff pos);
+		streampos tellp();
+		
+		//Determines the path of a volume when it is placed in the specified directory (or in the file's own directory, if empty)
+		static string VolumePath(const string& file, const string& directory, uint32_t volume);
+		
+		//The amount of data that may be queued for the writers, before writes wait for them
+		static const size_t QueueSize = 8*1024*1024;
+		
+	private:
+		//The operations queued for the writers, each of which applies to a single volume
+		static const int OpenOperation        = 0;
+		static const int WriteOperation       = 1;
+		static const int SeekOperation        = 2;
+		static const int PreallocateOperation = 3;
+		static const int CloseOperation       = 4;
+		
+		struct Operation
+		{
+			int      type;
+			uint32_t volume;
+			uint64_t value;
+			string   data;
+		};
+		
+		struct Writer
+		{
+			std::deque<Operation> queue;
+			
+			//The writer's open volumes, which are only used by its own thread once it has started
+			std::map<uint32_t, OutputBackend*> volumes;
+		};
+		
+		string         file;
+		vector<string> directories;
+		IOOptions      options;
+		uint64_t       volumeSize;
+		
+		//For every volume created so far, whether it is open and the offset that its writer will be positioned at
+		vector<bool>     opened;
+		vector<uint64_t> offsets;
+		
+		uint64_t position;
+		uint64_t reserved;
+		bool     failed;
+		
+		vector<Writer>      writers;
+		vector<std::thread> threads;
+		size_t              queued;
+		size_t              queueLimit;
+		string              error;
+		bool                stopping;
+		
+		std::mutex              lock;
+		std::condition_variable workAvailable;
+		std::condition_variable workCompleted;
+		
+		//Opens (or reopens) a volume if necessary, and positions it at the specified offset
+		void Prepare(uint32_t volume, uint64_t offset);
+		
+		//Adds an operation to the queue of the writer for its volume, waiting while the queues are full (throws the error of any writer that has failed)
+		void Enqueue(int type, uint32_t volume, uint64_t value, const char* data = NULL, size_t n = 0);
+		
+		//Waits until every writer has performed all of its queued operations, throwing the first error any of them encountered
+		void Drain();
+		
+		//The thread that performs the queued operations for the volumes in a directory
+		void WriterThread(size_t index);
+		
+		//Performs an operation on one of a writer's volumes
+		void Perform(Writer& writer, const Operation& operation);
+		
+		//The path of a volume, in the directory it is assigned to
+		string PathOf(uint32_t volume);
+};
+
+#endif
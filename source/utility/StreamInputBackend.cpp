@@ -0,0 +1,77 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#include "StreamInputBackend.h"
+
+StreamInputBackend::StreamInputBackend(string file)
+{
+	stream.open(file.c_str(), std::ios::binary);
+}
+
+size_t StreamInputBackend::read(char* s, size_t n)
+{
+	stream.read(s, n);
+	return stream.gcount();
+}
+
+size_t StreamInputBackend::view(const char** s, size_t n)
+{
+	//The stream has no buffer we can expose, so read into our own
+	if (viewBuffer.size() < n) {
+		viewBuffer.resize(n);
+	}
+	
+	*s = viewBuffer.data();
+	return this->read(viewBuffer.data(), n);
+}
+
+bool StreamInputBackend::more()
+{
+	//Peeking detects the end of the file even when the last read finished exactly at the end
+	return (stream.good() && stream.peek() != ifstream::traits_type::eof());
+}
+
+void StreamInputBackend::getline(string& s, char delim)
+{
+	std::getline(stream, s, delim);
+}
+
+bool StreamInputBackend::is_open()
+{
+	return stream.is_open();
+}
+
+void StreamInputBackend::close()
+{
+	stream.close();
+}
+
+void StreamInputBackend::seekg(streamoff pos)
+{
+	stream.clear();
+	stream.seekg(pos, std::ios::beg);
+}
+
+streampos StreamInputBackend::tellg()
+{
+	return stream.tellg();
+}
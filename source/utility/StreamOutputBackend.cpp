@@ -0,0 +1,66 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#include "StreamOutputBackend.h"
+
+StreamOutputBackend::StreamOutputBackend(string file, bool truncate)
+{
+	//Opening for input as well as output prevents the existing contents being truncated, so they can be updated in place
+	stream.open(file.c_str(), (truncate) ? std::ios::binary : (std::ios::binary | std::ios::in | std::ios::out));
+}
+
+void StreamOutputBackend::write(const char* s, size_t n)
+{
+	stream.write(s, n);
+	if (stream.bad()) {
+		this->Fail("Could not write to output file");
+	}
+}
+
+bool StreamOutputBackend::is_open()
+{
+	return stream.is_open();
+}
+
+void StreamOutputBackend::close()
+{
+	if (!stream.is_open()) {
+		return;
+	}
+	
+	//Closing flushes the stream's buffer, which fails the stream if it can't be written
+	stream.close();
+	if (stream.fail()) {
+		this->Fail("Could not write to output file");
+	}
+}
+
+void StreamOutputBackend::seekp(streamoff pos)
+{
+	stream.seekp(pos, std::ios::beg);
+	stream.clear();
+}
+
+streampos StreamOutputBackend::tellp()
+{
+	return stream.tellp();
+}
@@ -0,0 +1,89 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#include "StreamingChecksum.h"
+
+#include <algorithm>
+
+StreamingChecksum::StreamingChecksum(int type, size_t chunkSize)
+{
+	this->type      = type;
+	this->chunkSize = chunkSize;
+	this->length    = 0;
+	this->chunkFill = 0;
+	
+	if (type == ChecksumType::Tree) {
+		this->StartChunk();
+	}
+}
+
+void StreamingChecksum::StartChunk()
+{
+	//Leaf hashes are prefixed with a zero byte to distinguish them from interior nodes
+	digest.Reset();
+	char prefix = 0x0;
+	digest.Input(&prefix, sizeof(prefix));
+	chunkFill = 0;
+}
+
+void StreamingChecksum::Input(const char* data, size_t length)
+{
+	this->length += length;
+	if (type != ChecksumType::Tree)
+	{
+		digest.Input(data, length);
+		return;
+	}
+	
+	while (length > 0)
+	{
+		//A chunk is only completed once data arrives for the next one, since the final chunk is never empty unless it is the only one
+		if (chunkFill == chunkSize)
+		{
+			leafHashes += ChecksumUtility::DigestBytes(digest);
+			this->StartChunk();
+		}
+		
+		size_t bytes = std::min(length, chunkSize - chunkFill);
+		digest.Input(data, bytes);
+		chunkFill += bytes;
+		data      += bytes;
+		length    -= bytes;
+	}
+}
+
+uint64_t StreamingChecksum::Length()
+{
+	return length;
+}
+
+string StreamingChecksum::Result()
+{
+	if (type != ChecksumType::Tree) {
+		return ChecksumUtility::DigestBytes(digest);
+	}
+	
+	//The checksum consists of the root hash followed by all of the chunk hashes
+	string leaves = leafHashes + ChecksumUtility::DigestBytes(digest);
+	uint64_t chunkCount = leaves.length() / ChecksumUtility::ChecksumSize;
+	return ChecksumUtility::ComputeTreeRoot(leaves.data(), chunkCount) + leaves;
+}
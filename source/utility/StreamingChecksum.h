@@ -0,0 +1,59 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _STREAMING_CHECKSUM
+#define _STREAMING_CHECKSUM
+
+#include "ChecksumUtility.h"
+
+//Calculates a checksum incrementally as data passes through, for input and output that can't be read a second time
+class StreamingChecksum
+{
+	public:
+		//For tree checksums, the chunk size determines where each chunk hash begins and ends
+		StreamingChecksum(int type, size_t chunkSize = ChecksumUtility::DefaultTreeChunkSize);
+		
+		//Adds the next bytes of the data to the checksum
+		void Input(const char* data, size_t length);
+		
+		//The number of bytes of data seen so far
+		uint64_t Length();
+		
+		//Finalises the checksum, in the same form as the one ChecksumUtility generates for a file of the same contents
+		string Result();
+		
+	private:
+		int    type;
+		size_t chunkSize;
+		
+		uint64_t length;
+		SHA1     digest;
+		
+		//For tree checksums, the number of bytes in the current chunk and the hashes of the completed chunks
+		size_t chunkFill;
+		string leafHashes;
+		
+		//Helper function to start hashing a new chunk
+		void StartChunk();
+};
+
+#endif
@@ -0,0 +1,246 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#include "TeeOutputBackend.h"
+#include "MemoryBudget.h"
+
+//Queues smaller than this would make the writers wait on each other for every piece
+#define MIN_QUEUE_SIZE (256*1024)
+
+TeeOutputBackend::TeeOutputBackend(const vector<OutputBackend*>& destinations)
+{
+	position   = 0;
+	stopping   = false;
+	queueLimit = MemoryBudget::Reserve(QueueSize, MIN_QUEUE_SIZE);
+	
+	writers.resize(destinations.size());
+	for (size_t i = 0; i < destinations.size(); ++i)
+	{
+		writers[i].backend = destinations[i];
+		writers[i].queued  = 0;
+	}
+	
+	//The threads are started once the list of writers is complete, since they refer to its elements
+	for (size_t i = 0; i < writers.size(); ++i) {
+		threads.push_back(std::thread(&TeeOutputBackend::WriterThread, this, i));
+	}
+}
+
+TeeOutputBackend::~TeeOutputBackend()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	
+	workAvailable.notify_all();
+	for (size_t i = 0; i < threads.size(); ++i) {
+		threads[i].join();
+	}
+	
+	for (size_t i = 0; i < writers.size(); ++i) {
+		delete writers[i].backend;
+	}
+	
+	MemoryBudget::Release(queueLimit);
+}
+
+void TeeOutputBackend::Enqueue(const OperationPtr& operation)
+{
+	std::unique_lock<std::mutex> guard(lock);
+	
+	//Wait for room in every queue (an operation larger than the limit is let through once a queue is empty)
+	size_t length = operation->data.length();
+	for (size_t i = 0; i < writers.size(); ++i)
+	{
+		Writer& writer = writers[i];
+		while (writer.queued > 0 && writer.queued + length > queueLimit && writer.error.empty()) {
+			workCompleted.wait(guard);
+		}
+	}
+	
+	//A destination that has failed fails the whole output, just as a single destination would
+	for (size_t i = 0; i < writers.size(); ++i)
+	{
+		if (!writers[i].error.empty()) {
+			throw writers[i].error;
+		}
+	}
+	
+	for (size_t i = 0; i < writers.size(); ++i)
+	{
+		writers[i].queue.push_back(operation);
+		writers[i].queued += length;
+	}
+	
+	workAvailable.notify_all();
+}
+
+void TeeOutputBackend::Drain()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	for (size_t i = 0; i < writers.size(); ++i)
+	{
+		while (!writers[i].queue.empty() && writers[i].error.empty()) {
+			workCompleted.wait(guard);
+		}
+	}
+	
+	for (size_t i = 0; i < writers.size(); ++i)
+	{
+		if (!writers[i].error.empty()) {
+			throw writers[i].error;
+		}
+	}
+}
+
+void TeeOutputBackend::WriterThread(size_t index)
+{
+	Writer& writer = writers[index];
+	std::unique_lock<std::mutex> guard(lock);
+	while (true)
+	{
+		while (writer.queue.empty() && !stopping) {
+			workAvailable.wait(guard);
+		}
+		
+		if (writer.queue.empty()) {
+			return;
+		}
+		
+		//The operation stays at the front of the queue until it has been performed, so that Drain() waits for it
+		OperationPtr operation = writer.queue.front();
+		guard.unlock();
+		
+		string error;
+		try {
+			Perform(writer.backend, *operation);
+		}
+		catch (const string& message) {
+			error = message;
+		}
+		
+		guard.lock();
+		writer.queue.pop_front();
+		writer.queued -= operation->data.length();
+		
+		//Once a destination has failed, the rest of its operations are discarded
+		if (!error.empty())
+		{
+			writer.error = error;
+			writer.queue.clear();
+			writer.queued = 0;
+		}
+		
+		workCompleted.notify_all();
+	}
+}
+
+void TeeOutputBackend::Perform(OutputBackend* backend, const Operation& operation)
+{
+	switch (operation.type)
+	{
+		case WriteOperation:
+			backend->write(operation.data.data(), operation.data.length());
+			break;
+		
+		case SeekOperation:
+			backend->seekp((streamoff)operation.value);
+			break;
+		
+		case PreallocateOperation:
+			backend->preallocate(operation.value);
+			break;
+		
+		case CloseOperation:
+			backend->close();
+			break;
+	}
+	
+	//Backends record their errors rather than throwing them, so they are thrown here to fail the destination
+	if (!backend->WriteError().empty()) {
+		throw backend->WriteError();
+	}
+}
+
+void TeeOutputBackend::write(const char* s, size_t n)
+{
+	//A single copy of the data is shared by every destination
+	std::shared_ptr<Operation> operation(new Operation());
+	operation->type  = WriteOperation;
+	operation->value = 0;
+	operation->data.assign(s, n);
+	this->Enqueue(operation);
+	position += n;
+}
+
+void TeeOutputBackend::preallocate(uint64_t size)
+{
+	std::shared_ptr<Operation> operation(new Operation());
+	operation->type  = PreallocateOperation;
+	operation->value = size;
+	this->Enqueue(operation);
+}
+
+bool TeeOutputBackend::is_open()
+{
+	//Every destination is opened before the writers start, so we can check them directly
+	for (size_t i = 0; i < writers.size(); ++i)
+	{
+		if (!writers[i].backend->is_open()) {
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+void TeeOutputBackend::close()
+{
+	//Each destination is closed (and flushed, if requested) on its own thread, at the same time as the others
+	std::shared_ptr<Operation> operation(new Operation());
+	operation->type  = CloseOperation;
+	operation->value = 0;
+	
+	try
+	{
+		this->Enqueue(operation);
+		this->Drain();
+	}
+	catch (const string& message) {
+		this->Fail(message);
+	}
+}
+
+void TeeOutputBackend::seekp(streamoff pos)
+{
+	std::shared_ptr<Operation> operation(new Operation());
+	operation->type  = SeekOperation;
+	operation->value = (pos > 0) ? (uint64_t)pos : 0;
+	this->Enqueue(operation);
+	position = operation->value;
+}
+
+streampos TeeOutputBackend::tellp()
+{
+	return (streamoff)position;
+}
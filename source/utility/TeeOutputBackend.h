@@ -0,0 +1,103 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _TEE_OUTPUT_BACKEND
+#define _TEE_OUTPUT_BACKEND
+
+#include "OutputBackend.h"
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+using std::vector;
+
+//Writes the same bytes to several backends at once, each from its own thread, so that making extra copies of
+//an output file costs neither another pass over the input nor reading the first copy back. Seeks (such as
+//those made to rewrite a header) and closing are applied to every destination in order with the writes.
+class TeeOutputBackend : public OutputBackend
+{
+	public:
+		//Takes ownership of the backends
+		TeeOutputBackend(const vector<OutputBackend*>& destinations);
+		~TeeOutputBackend();
+		
+		void write(const char* s, size_t n);
+		void preallocate(uint64_t size);
+		
+		bool      is_open();
+		void      close();
+		void      seekp(streamoff pos);
+		streampos tellp();
+		
+		//The amount of data that may be queued for a destination that is falling behind, before writes wait for it
+		static const size_t QueueSize = 8*1024*1024;
+		
+	private:
+		//The operations queued for the writers (each one is shared between all of the destinations' queues)
+		static const int WriteOperation       = 0;
+		static const int SeekOperation        = 1;
+		static const int PreallocateOperation = 2;
+		static const int CloseOperation       = 3;
+		
+		struct Operation
+		{
+			int      type;
+			uint64_t value;
+			string   data;
+		};
+		
+		typedef std::shared_ptr<const Operation> OperationPtr;
+		
+		struct Writer
+		{
+			OutputBackend*           backend;
+			std::deque<OperationPtr> queue;
+			size_t                   queued;
+			string                   error;
+		};
+		
+		vector<Writer>      writers;
+		vector<std::thread> threads;
+		uint64_t            position;
+		size_t              queueLimit;
+		bool                stopping;
+		
+		std::mutex              lock;
+		std::condition_variable workAvailable;
+		std::condition_variable workCompleted;
+		
+		//Adds an operation to every destination's queue, waiting while any of them is full (throws the error of any destination that has failed)
+		void Enqueue(const OperationPtr& operation);
+		
+		//Waits until every destination has performed all of its queued operations, throwing the first error any of them encountered
+		void Drain();
+		
+		//The thread that performs the queued operations for a destination
+		void WriterThread(size_t index);
+		
+		//Performs an operation on a backend
+		static void Perform(OutputBackend* backend, const Operation& operation);
+};
+
+#endif
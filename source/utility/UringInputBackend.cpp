@@ -0,0 +1,304 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#include "UringInputBackend.h"
+#include "AlignedBufferPool.h"
+#include "MemoryBudget.h"
+
+#include <cstring>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+UringInputBackend::UringInputBackend(string file, const IOOptions& options)
+{
+	dropCache = options.dropCache;
+	fd        = -1;
+	size      = 0;
+	position  = 0;
+	ready     = false;
+	for (size_t i = 0; i < QueueDepth; ++i)
+	{
+		slots[i].buffer  = NULL;
+		slots[i].pending = false;
+		slots[i].valid   = false;
+	}
+	
+	#ifdef EFC_HAVE_LIBURING
+	//Direct I/O is used if requested and supported by the filesystem
+	#ifdef O_DIRECT
+	if (options.directIO) {
+		fd = open(file.c_str(), O_RDONLY | O_DIRECT);
+	}
+	#endif
+	if (fd == -1) {
+		fd = open(file.c_str(), O_RDONLY);
+	}
+	
+	//Only regular files have a known size that we can read ahead within
+	struct stat info;
+	if (fd == -1 || fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || io_uring_queue_init(QueueDepth, &ring, 0) != 0)
+	{
+		if (fd != -1) {
+			::close(fd);
+		}
+		fd = -1;
+		return;
+	}
+	
+	size  = info.st_size;
+	ready = true;
+	
+	if (dropCache) {
+		advisor.AttachInput(fd);
+	}
+	
+	//Without room for the buffers in the memory limit, the stream falls back to another backend
+	if (!MemoryBudget::TryReserve(QueueDepth * BufferSize))
+	{
+		this->close();
+		return;
+	}
+	
+	//Register the buffers with the kernel, so they don't need to be mapped for every read
+	struct iovec buffers[QueueDepth];
+	for (size_t i = 0; i < QueueDepth; ++i)
+	{
+		slots[i].buffer = AlignedBufferPool::Acquire(BufferSize);
+		buffers[i].iov_base = slots[i].buffer;
+		buffers[i].iov_len  = BufferSize;
+	}
+	
+	if (io_uring_register_buffers(&ring, buffers, QueueDepth) != 0)
+	{
+		this->close();
+		return;
+	}
+	
+	//Start reading the beginning of the file
+	for (uint64_t block = 0; block < QueueDepth; ++block) {
+		this->Submit(block);
+	}
+	#endif
+}
+
+UringInputBackend::~UringInputBackend()
+{
+	this->close();
+}
+
+void UringInputBackend::Submit(uint64_t block)
+{
+	Slot& slot = slots[block % QueueDepth];
+	slot.block  = block;
+	slot.length = 0;
+	slot.valid  = true;
+	
+	//There's nothing to read past the end of the file
+	if (block * BufferSize >= size) {
+		return;
+	}
+	
+	#ifdef EFC_HAVE_LIBURING
+	struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+	io_uring_prep_read_fixed(sqe, fd, slot.buffer, BufferSize, block * BufferSize, block % QueueDepth);
+	io_uring_sqe_set_data(sqe, &slot);
+	io_uring_submit(&ring);
+	slot.pending = true;
+	#endif
+}
+
+void UringInputBackend::WaitFor(Slot& slot)
+{
+	#ifdef EFC_HAVE_LIBURING
+	while (slot.pending)
+	{
+		//Completions can arrive in any order, so record each one against its own slot
+		struct io_uring_cqe* cqe = NULL;
+		if (io_uring_wait_cqe(&ring, &cqe) != 0) {
+			throw string("Could not read from input file");
+		}
+		
+		Slot* completed = (Slot*)io_uring_cqe_get_data(cqe);
+		completed->length  = (cqe->res > 0) ? cqe->res : 0;
+		completed->pending = false;
+		io_uring_cqe_seen(&ring, cqe);
+		
+		//Complete any short read (other than at the end of the file) synchronously
+		uint64_t offset = completed->block * BufferSize;
+		uint64_t wanted = std::min((uint64_t)BufferSize, size - offset);
+		while (completed->length < wanted)
+		{
+			ssize_t result = pread(fd, completed->buffer + completed->length, wanted - completed->length, offset + completed->length);
+			if (result <= 0) {
+				throw string("Could not read from input file");
+			}
+			completed->length += result;
+		}
+	}
+	#endif
+}
+
+void UringInputBackend::Drain()
+{
+	for (size_t i = 0; i < QueueDepth; ++i) {
+		this->WaitFor(slots[i]);
+	}
+}
+
+size_t UringInputBackend::Fill()
+{
+	if (position >= size) {
+		return 0;
+	}
+	
+	//Everything before the current position has been consumed
+	advisor.Consumed(position);
+	
+	uint64_t block = position / BufferSize;
+	Slot& slot = slots[block % QueueDepth];
+	
+	//After a seek outside the window, start reading ahead from the new position
+	if (slot.valid == false || slot.block != block)
+	{
+		this->Drain();
+		for (uint64_t b = block; b < block + QueueDepth; ++b) {
+			this->Submit(b);
+		}
+	}
+	
+	//The bytes from earlier blocks have been used, so their slots can be refilled further ahead
+	for (size_t i = 0; i < QueueDepth; ++i)
+	{
+		if (slots[i].valid && slots[i].pending == false && slots[i].block < block) {
+			this->Submit(slots[i].block + QueueDepth);
+		}
+	}
+	
+	this->WaitFor(slot);
+	uint64_t offset = position - (block * BufferSize);
+	return (offset < slot.length) ? (size_t)(slot.length - offset) : 0;
+}
+
+size_t UringInputBackend::read(char* s, size_t n)
+{
+	//Copy out of the buffers, moving through as many of them as necessary
+	size_t total = 0;
+	const char* source = NULL;
+	size_t available = 0;
+	while (total < n && (available = this->view(&source, n - total)) > 0)
+	{
+		memcpy(s + total, source, available);
+		total += available;
+	}
+	
+	return total;
+}
+
+size_t UringInputBackend::view(const char** s, size_t n)
+{
+	//A view never extends past the end of a buffer, so it may be shorter than requested
+	size_t available = std::min(n, this->Fill());
+	*s = slots[(position / BufferSize) % QueueDepth].buffer + (position % BufferSize);
+	position += available;
+	return available;
+}
+
+bool UringInputBackend::more()
+{
+	return (position < size);
+}
+
+void UringInputBackend::getline(string& s, char delim)
+{
+	s = "";
+	size_t available = 0;
+	while ((available = this->Fill()) > 0)
+	{
+		//Search the remainder of the buffer for the delimiter
+		const char* start = slots[(position / BufferSize) % QueueDepth].buffer + (position % BufferSize);
+		const char* found = (const char*)memchr(start, delim, available);
+		size_t length = (found != NULL) ? (size_t)(found - start) : available;
+		s.append(start, length);
+		position += length;
+		
+		//Skip past the delimiter
+		if (found != NULL)
+		{
+			position++;
+			return;
+		}
+	}
+}
+
+bool UringInputBackend::is_open()
+{
+	return (fd != -1);
+}
+
+void UringInputBackend::close()
+{
+	#ifdef EFC_HAVE_LIBURING
+	if (ready)
+	{
+		//The kernel may still be writing into the buffers, so wait for it before releasing them
+		this->Drain();
+		io_uring_queue_exit(&ring);
+		ready = false;
+	}
+	
+	if (fd != -1)
+	{
+		advisor.Finish();
+		::close(fd);
+	}
+	#endif
+	
+	for (size_t i = 0; i < QueueDepth; ++i)
+	{
+		if (slots[i].buffer != NULL) {
+			MemoryBudget::Release(BufferSize);
+		}
+		
+		AlignedBufferPool::Release(slots[i].buffer, BufferSize);
+		slots[i].buffer = NULL;
+		slots[i].valid  = false;
+	}
+	
+	fd = -1;
+}
+
+void UringInputBackend::seekg(streamoff pos)
+{
+	//The reads in flight are kept, in case the new position falls within them
+	position = (pos > 0) ? (uint64_t)pos : 0;
+}
+
+streampos UringInputBackend::tellg()
+{
+	return (streamoff)position;
+}
@@ -0,0 +1,97 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _URING_INPUT_BACKEND
+#define _URING_INPUT_BACKEND
+
+#include "InputBackend.h"
+#include "IOOptions.h"
+#include "PageCacheAdvisor.h"
+#include <stdint.h>
+
+#ifdef EFC_HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+//Reads input using io_uring, keeping several reads in flight ahead of the current position so that the
+//cipher never waits for the disk. Reads go into a fixed set of registered buffers from the AlignedBufferPool.
+//If io_uring isn't available (at compile time or at runtime), is_open() returns false so that another backend can be used.
+class UringInputBackend : public InputBackend
+{
+	public:
+		UringInputBackend(string file, const IOOptions& options);
+		~UringInputBackend();
+		
+		size_t read(char* s, size_t n);
+		size_t view(const char** s, size_t n);
+		bool   more();
+		void   getline(string& s, char delim);
+		
+		bool      is_open();
+		void      close();
+		void      seekg(streamoff pos);
+		streampos tellg();
+		
+		//The number of reads kept in flight, and the size of each (a multiple of AlignedBufferPool::Alignment)
+		static const size_t QueueDepth = 4;
+		static const size_t BufferSize = 1024*1024;
+		
+	private:
+		int      fd;
+		uint64_t size;
+		uint64_t position;
+		bool     ready;
+		
+		//Drops the pages we have consumed from the page cache, if requested
+		PageCacheAdvisor advisor;
+		bool             dropCache;
+		
+		//Block n of the file is always read into slot (n % QueueDepth)
+		struct Slot
+		{
+			char*    buffer;
+			uint64_t block;
+			size_t   length;
+			bool     pending;
+			bool     valid;
+		};
+		Slot slots[QueueDepth];
+		
+		#ifdef EFC_HAVE_LIBURING
+		struct io_uring ring;
+		#endif
+		
+		//Queues the read of a block into its slot
+		void Submit(uint64_t block);
+		
+		//Waits for the read into a slot to complete
+		void WaitFor(Slot& slot);
+		
+		//Waits for all of the reads in flight to complete
+		void Drain();
+		
+		//Reuses the slots holding blocks before the current position for the blocks after the window, and makes
+		//sure the block at the current position has been read, returning the number of bytes available from there
+		size_t Fill();
+};
+
+#endif
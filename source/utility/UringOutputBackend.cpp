@@ -0,0 +1,315 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#include "UringOutputBackend.h"
+#include "AlignedBufferPool.h"
+#include "MemoryBudget.h"
+
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+UringOutputBackend::UringOutputBackend(string file, const IOOptions& options)
+{
+	fd            = -1;
+	bufferedFd    = -1;
+	ready         = false;
+	current       = 0;
+	currentOffset = 0;
+	position      = 0;
+	sequential    = true;
+	for (size_t i = 0; i < QueueDepth; ++i)
+	{
+		slots[i].buffer  = NULL;
+		slots[i].length  = 0;
+		slots[i].pending = false;
+	}
+	
+	#ifdef EFC_HAVE_LIBURING
+	//Direct I/O is used if requested and supported by the filesystem, in which case we also need an ordinary descriptor
+	#ifdef O_DIRECT
+	if (options.directIO)
+	{
+		fd = open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0666);
+		if (fd != -1) {
+			bufferedFd = open(file.c_str(), O_WRONLY);
+		}
+	}
+	#endif
+	if (fd == -1)
+	{
+		fd = open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+		bufferedFd = fd;
+	}
+	
+	if (fd == -1 || bufferedFd == -1 || io_uring_queue_init(QueueDepth, &ring, 0) != 0)
+	{
+		ready = false;
+		this->close();
+		return;
+	}
+	
+	ready = true;
+	
+	//Direct writes bypass the page cache already
+	if (options.dropCache && fd == bufferedFd) {
+		advisor.AttachOutput(fd);
+	}
+	
+	reservation.Attach(bufferedFd);
+	durability.Attach(bufferedFd, options.durability);
+	
+	//Without room for the buffers in the memory limit, the stream falls back to another backend
+	if (!MemoryBudget::TryReserve(QueueDepth * BufferSize))
+	{
+		this->close();
+		return;
+	}
+	
+	//Register the buffers with the kernel, so they don't need to be mapped for every write
+	struct iovec buffers[QueueDepth];
+	for (size_t i = 0; i < QueueDepth; ++i)
+	{
+		slots[i].buffer = AlignedBufferPool::Acquire(BufferSize);
+		buffers[i].iov_base = slots[i].buffer;
+		buffers[i].iov_len  = BufferSize;
+	}
+	
+	if (io_uring_register_buffers(&ring, buffers, QueueDepth) != 0) {
+		this->close();
+	}
+	#endif
+}
+
+UringOutputBackend::~UringOutputBackend()
+{
+	this->close();
+}
+
+void UringOutputBackend::WriteAt(int fd, const char* s, size_t n, uint64_t offset)
+{
+	//Once a write has failed, the rest of the output is discarded
+	if (!this->WriteError().empty()) {
+		return;
+	}
+	
+	#ifndef _WIN32
+	while (n > 0)
+	{
+		ssize_t result = pwrite(fd, s, n, offset);
+		if (result == -1 && errno == EINTR) {
+			continue;
+		}
+		
+		if (result <= 0)
+		{
+			this->Fail(string("Could not write to output file (") + ((result == 0) ? "no bytes written" : strerror(errno)) + ")");
+			return;
+		}
+		
+		s      += result;
+		n      -= result;
+		offset += result;
+	}
+	#endif
+}
+
+void UringOutputBackend::Submit()
+{
+	#ifdef EFC_HAVE_LIBURING
+	Slot& slot = slots[current];
+	
+	//Once a write has failed, the rest of the output is discarded
+	if (!this->WriteError().empty())
+	{
+		slot.length = 0;
+		return;
+	}
+	
+	struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+	io_uring_prep_write_fixed(sqe, fd, slot.buffer, slot.length, currentOffset, current);
+	io_uring_sqe_set_data(sqe, &slot);
+	io_uring_submit(&ring);
+	slot.pending = true;
+	
+	//Move on to the next slot, waiting for its previous write to complete before we overwrite it
+	currentOffset += slot.length;
+	current = (current + 1) % QueueDepth;
+	this->WaitFor(slots[current]);
+	slots[current].length = 0;
+	advisor.Written(currentOffset);
+	durability.Written(currentOffset);
+	#endif
+}
+
+void UringOutputBackend::WaitFor(Slot& slot)
+{
+	#ifdef EFC_HAVE_LIBURING
+	while (slot.pending)
+	{
+		//Completions can arrive in any order, so record each one against its own slot
+		struct io_uring_cqe* cqe = NULL;
+		int waited = io_uring_wait_cqe(&ring, &cqe);
+		if (waited == -EINTR) {
+			continue;
+		}
+		
+		//If the ring itself has failed, the slot is abandoned along with the rest of the output
+		if (waited != 0)
+		{
+			this->Fail(string("Could not write to output file (") + strerror(-waited) + ")");
+			slot.pending = false;
+			return;
+		}
+		
+		Slot* completed = (Slot*)io_uring_cqe_get_data(cqe);
+		int result = cqe->res;
+		io_uring_cqe_seen(&ring, cqe);
+		completed->pending = false;
+		
+		if (result < 0) {
+			this->Fail(string("Could not write to output file (") + strerror(-result) + ")");
+		}
+		else if ((size_t)result != completed->length) {
+			this->Fail("Could not write to output file (short write)");
+		}
+	}
+	#endif
+}
+
+void UringOutputBackend::Flush()
+{
+	for (size_t i = 0; i < QueueDepth; ++i) {
+		this->WaitFor(slots[i]);
+	}
+	
+	//Direct writes must be whole aligned blocks, so the remainder goes through the ordinary descriptor
+	Slot& slot = slots[current];
+	size_t aligned = (fd != bufferedFd) ? (slot.length / AlignedBufferPool::Alignment) * AlignedBufferPool::Alignment : slot.length;
+	this->WriteAt(fd, slot.buffer, aligned, currentOffset);
+	this->WriteAt(bufferedFd, slot.buffer + aligned, slot.length - aligned, currentOffset + aligned);
+	currentOffset += slot.length;
+	slot.length = 0;
+}
+
+void UringOutputBackend::write(const char* s, size_t n)
+{
+	//Once we have seeked, writes go straight through the ordinary descriptor
+	if (sequential == false)
+	{
+		this->WriteAt(bufferedFd, s, n, position);
+		position += n;
+		return;
+	}
+	
+	//Fill the current buffer, queueing it whenever it becomes full
+	while (n > 0)
+	{
+		Slot& slot = slots[current];
+		size_t count = std::min(n, BufferSize - slot.length);
+		memcpy(slot.buffer + slot.length, s, count);
+		slot.length += count;
+		position    += count;
+		s           += count;
+		n           -= count;
+		
+		if (slot.length == BufferSize) {
+			this->Submit();
+		}
+	}
+}
+
+void UringOutputBackend::preallocate(uint64_t size)
+{
+	reservation.Reserve(size);
+}
+
+bool UringOutputBackend::is_open()
+{
+	return (fd != -1);
+}
+
+void UringOutputBackend::close()
+{
+	#ifdef EFC_HAVE_LIBURING
+	if (ready)
+	{
+		if (sequential == true) {
+			this->Flush();
+		}
+		
+		io_uring_queue_exit(&ring);
+		ready = false;
+	}
+	
+	reservation.Finish();
+	if (!durability.Finish()) {
+		this->Fail("Could not flush output file to disk");
+	}
+	
+	if (bufferedFd != -1 && bufferedFd != fd) {
+		::close(bufferedFd);
+	}
+	
+	if (fd != -1)
+	{
+		advisor.Finish();
+		::close(fd);
+	}
+	#endif
+	
+	for (size_t i = 0; i < QueueDepth; ++i)
+	{
+		if (slots[i].buffer != NULL) {
+			MemoryBudget::Release(BufferSize);
+		}
+		
+		AlignedBufferPool::Release(slots[i].buffer, BufferSize);
+		slots[i].buffer = NULL;
+	}
+	
+	fd         = -1;
+	bufferedFd = -1;
+}
+
+void UringOutputBackend::seekp(streamoff pos)
+{
+	//Write out everything we have buffered, since later writes may overlap it
+	if (sequential == true)
+	{
+		this->Flush();
+		sequential = false;
+	}
+	
+	position = (pos > 0) ? (uint64_t)pos : 0;
+}
+
+streampos UringOutputBackend::tellp()
+{
+	return (streamoff)position;
+}
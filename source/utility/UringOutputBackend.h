@@ -0,0 +1,104 @@
+/*
+//  Encrypted File Container
+//  Copyright (c) 2011, Adam Rehn
+//  
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//  
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//  
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+*/
+#ifndef _URING_OUTPUT_BACKEND
+#define _URING_OUTPUT_BACKEND
+
+#include "OutputBackend.h"
+#include "IOOptions.h"
+#include "PageCacheAdvisor.h"
+#include "SpaceReservation.h"
+#include "DurabilityPolicy.h"
+#include <stdint.h>
+
+#ifdef EFC_HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+//Writes output using io_uring, so that several writes are in flight behind the cipher while it fills the next
+//buffer. Writes come from a fixed set of registered buffers from the AlignedBufferPool. When direct I/O is used,
+//the unaligned tail and anything written after seeking go through a second, ordinary descriptor.
+//If io_uring isn't available (at compile time or at runtime), is_open() returns false so that another backend can be used.
+class UringOutputBackend : public OutputBackend
+{
+	public:
+		UringOutputBackend(string file, const IOOptions& options);
+		~UringOutputBackend();
+		
+		void write(const char* s, size_t n);
+		void preallocate(uint64_t size);
+		
+		bool      is_open();
+		void      close();
+		void      seekp(streamoff pos);
+		streampos tellp();
+		
+		//The number of writes kept in flight, and the size of each (a multiple of AlignedBufferPool::Alignment)
+		static const size_t QueueDepth = 4;
+		static const size_t BufferSize = 1024*1024;
+		
+	private:
+		int  fd;
+		int  bufferedFd;
+		bool ready;
+		
+		//Writes back and drops the pages we have written from the page cache, if requested
+		PageCacheAdvisor advisor;
+		
+		//Reserves the space for the output up front, if requested
+		SpaceReservation reservation;
+		DurabilityPolicy durability;
+		
+		struct Slot
+		{
+			char*  buffer;
+			size_t length;
+			bool   pending;
+		};
+		Slot slots[QueueDepth];
+		
+		//The slot currently being filled, and the file offset that it will be written at
+		size_t   current;
+		uint64_t currentOffset;
+		
+		//The logical write position, and whether we are still writing sequentially through the buffers
+		uint64_t position;
+		bool     sequential;
+		
+		#ifdef EFC_HAVE_LIBURING
+		struct io_uring ring;
+		#endif
+		
+		//Queues the write of the current slot, and moves on to the next one
+		void Submit();
+		
+		//Waits for the write from a slot to complete
+		void WaitFor(Slot& slot);
+		
+		//Waits for all of the writes in flight, then writes the partially-filled current slot synchronously
+		void Flush();
+		
+		//Writes a range of bytes at the specified offset, retrying short writes
+		void WriteAt(int fd, const char* s, size_t n, uint64_t offset);
+};
+
+#endif
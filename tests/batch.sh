@@ -0,0 +1,36 @@
+#!/bin/sh
+# Checks batch encryption, which interleaves the AES work of small files: every file of a batch decrypts to the original,
+# and its payload (the IV, checksum and ciphertext after the header) is the same size as when the file is encrypted on its own.
+# Usage: batch.sh BINDIR
+
+. "$(dirname "$0")/common.sh"
+
+# The size of a container after its header (the headers differ, since only files encrypted on their own record their chunk size)
+payload_size()
+{
+	echo $(($(wc -c < "$1") - $(read_integer "$1" 4 4)))
+}
+
+# Files that are empty, shorter than a block, not a whole number of blocks, and around 64 KB (the longest lanes of the batch)
+mkdir "$WORK/inputs" "$WORK/batch" "$WORK/single"
+sizes="0 1 15 16 17 1000 4095 65536 65537 70001"
+inputs=""
+for size in $sizes; do
+	head -c $size /dev/urandom > "$WORK/inputs/file$size"
+	inputs="$inputs -i $WORK/inputs/file$size"
+done
+
+check "efcencode of a batch" "$BIN/efcencode" $KEY $inputs -o "$WORK/batch" -y
+for size in $sizes; do
+	check "efcdecode of a batched file of $size bytes" "$BIN/efcdecode" -pass pw -i "$WORK/batch/file$size.efc" -o "$WORK/output" -y
+	expect_same "batched file of $size bytes decrypts to the original" "$WORK/inputs/file$size" "$WORK/output"
+	
+	"$BIN/efcencode" $KEY -i "$WORK/inputs/file$size" -o "$WORK/single/file$size.efc" -y > "$WORK/log" 2>&1
+	if [ "$(payload_size "$WORK/batch/file$size.efc")" -eq "$(payload_size "$WORK/single/file$size.efc")" ]; then
+		pass "batched file of $size bytes has the same payload size as one encrypted on its own"
+	else
+		fail "batched file of $size bytes has the same payload size as one encrypted on its own"
+	fi
+done
+
+finish
@@ -0,0 +1,98 @@
+# Helpers shared by the test scripts, which source this file with the directory holding the tools as their first argument.
+# Each check prints "ok" or "FAILED" with a description, and finish() exits with the number of checks that failed.
+
+BIN="${1:-./build/bin}"
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+failures=0
+
+# The password and a low scrypt cost, so that deriving the key doesn't dominate the time the tests take
+KEY="-pass pw -kdf-cost 10"
+
+pass()
+{
+	echo "ok $1"
+}
+
+fail()
+{
+	echo "FAILED $1"
+	failures=$((failures + 1))
+}
+
+# Runs a command, expecting it to succeed
+check()
+{
+	description="$1"
+	shift
+	"$@" > "$WORK/log" 2>&1
+	status=$?
+	if [ $status -eq 0 ]; then
+		pass "$description"
+	else
+		fail "$description (exit status $status)"
+		cat "$WORK/log"
+	fi
+}
+
+# Runs a command, expecting it to fail with a message matching the pattern
+expect_error()
+{
+	description="$1"
+	pattern="$2"
+	shift 2
+	"$@" > "$WORK/log" 2>&1
+	status=$?
+	if [ $status -ne 0 ] && grep -q "$pattern" "$WORK/log"; then
+		pass "$description"
+	else
+		fail "$description (exit status $status)"
+		cat "$WORK/log"
+	fi
+}
+
+# Checks that two files have the same contents
+expect_same()
+{
+	if cmp -s "$2" "$3"; then
+		pass "$1"
+	else
+		fail "$1 ($2 and $3 differ)"
+	fi
+}
+
+# Checks that two files have different contents
+expect_different()
+{
+	if cmp -s "$2" "$3"; then
+		fail "$1 ($2 and $3 are the same)"
+	else
+		pass "$1"
+	fi
+}
+
+# Overwrites the bytes of a file at an offset, with the bytes given as printf escapes (such as '\377')
+patch_bytes()
+{
+	printf "$3" | dd of="$1" bs=1 seek="$2" conv=notrunc 2> /dev/null
+}
+
+# Reads a little endian integer of the given number of bytes from a file
+read_integer()
+{
+	od -A n -t u1 -j "$2" -N "$3" "$1" | awk '{ value = 0; for (i = NF; i >= 1; --i) { value = value * 256 + $i } print value }'
+}
+
+# Recomputes the CRC-32 at the end of a binary header after it has been patched (gzip stores the CRC-32 of its input, little endian)
+reseal_header()
+{
+	length=$(read_integer "$1" 4 4)
+	head -c $((length - 4)) "$1" | gzip -c | tail -c 8 | head -c 4 > "$WORK/crc"
+	dd if="$WORK/crc" of="$1" bs=1 seek=$((length - 4)) conv=notrunc 2> /dev/null
+}
+
+finish()
+{
+	exit $failures
+}
@@ -0,0 +1,129 @@
+#!/bin/sh
+# Checks efcinfo's scan of many containers, from directories, lists of paths and stdin, with a line of JSON or CSV for each,
+# and that --checksum prints the checksum of the original file stored in a container without decrypting its payload.
+# Usage: efcinfo.sh BINDIR
+
+. "$(dirname "$0")/common.sh"
+
+# A directory tree of containers, with a file that isn't one
+mkdir -p "$WORK/tree/nested/deeper"
+head -c 1000 /dev/urandom > "$WORK/input"
+for container in one.efc nested/two.efc nested/deeper/three.efc; do
+	check "efcencode of $container" "$BIN/efcencode" $KEY -i "$WORK/input" -o "$WORK/tree/$container" -y
+done
+echo "not a container" > "$WORK/tree/nested/notes.txt"
+
+# Counts the lines of the output that match a pattern
+count_lines()
+{
+	grep -c "$2" "$1"
+}
+
+# Scanning the directory describes every file in it as JSON, and reports the one that isn't a container
+"$BIN/efcinfo" -threads 3 "$WORK/tree" > "$WORK/scan" 2> "$WORK/log"
+status=$?
+if [ $status -eq 1 ]; then
+	pass "a scan that finds a file which isn't a container exits with status 1"
+else
+	fail "a scan that finds a file which isn't a container exits with status 1 (exit status $status)"
+fi
+if [ "$(count_lines "$WORK/scan" '^{"path":')" = "4" ] && [ "$(count_lines "$WORK/scan" '"error":')" = "1" ]; then
+	pass "the scan prints a JSON line for each file, with an error for the one that isn't a container"
+else
+	fail "the scan prints a JSON line for each file, with an error for the one that isn't a container"
+	cat "$WORK/scan"
+fi
+if grep -q "three.efc\",\"filename\":.*\"original_size\":1000," "$WORK/scan"; then
+	pass "files in nested directories are described"
+else
+	fail "files in nested directories are described"
+	cat "$WORK/scan"
+fi
+if grep -q "^Scanned 4 files, 1 of which are not readable EFC containers" "$WORK/log"; then
+	pass "the scan reports how many files it read"
+else
+	fail "the scan reports how many files it read"
+	cat "$WORK/log"
+fi
+
+# Only containers, so the scan succeeds
+rm "$WORK/tree/nested/notes.txt"
+check "a scan of only containers succeeds" "$BIN/efcinfo" "$WORK/tree"
+
+# CSV output has a header row, and the same columns for every file (once the quoted values, which may hold commas, are removed)
+"$BIN/efcinfo" -format csv "$WORK/tree" > "$WORK/scan" 2> /dev/null
+if head -n 1 "$WORK/scan" | grep -q "^path,filename,.*,error$" && [ "$(sed 's/"[^"]*"//g' "$WORK/scan" | awk -F, '{ print NF }' | sort -u | wc -l)" = "1" ] && [ "$(wc -l < "$WORK/scan")" = "4" ]; then
+	pass "CSV output has a header row and the same columns on each line"
+else
+	fail "CSV output has a header row and the same columns on each line"
+	cat "$WORK/scan"
+fi
+expect_error "an unknown format is refused" "^Error: unknown output format" "$BIN/efcinfo" -format xml "$WORK/tree"
+
+# Paths can be piped in from find, or read from a list, along with those given as arguments
+find "$WORK/tree" -name "*.efc" | "$BIN/efcinfo" -list - > "$WORK/scan" 2> /dev/null
+if [ "$(count_lines "$WORK/scan" '^{"path":')" = "3" ]; then
+	pass "-list - reads the paths from stdin"
+else
+	fail "-list - reads the paths from stdin"
+	cat "$WORK/scan"
+fi
+echo "$WORK/tree/one.efc" > "$WORK/list"
+echo "$WORK/missing.efc" >> "$WORK/list"
+"$BIN/efcinfo" -list "$WORK/list" "$WORK/tree/nested/two.efc" > "$WORK/scan" 2> /dev/null
+status=$?
+if [ $status -eq 1 ] && [ "$(count_lines "$WORK/scan" '^{"path":')" = "3" ] && grep -q "missing.efc\",\"error\":" "$WORK/scan"; then
+	pass "a list and a path are scanned together, and a missing file is an error"
+else
+	fail "a list and a path are scanned together, and a missing file is an error (exit status $status)"
+	cat "$WORK/scan"
+fi
+expect_error "a missing list is an error" "^Error: could not open file list" "$BIN/efcinfo" -list "$WORK/missing.list"
+
+
+# The stored checksum is printed in the same format as sha1sum, so it can be compared with that of the original
+head -c 3000000 /dev/urandom > "$WORK/large"
+head -c 32 /dev/urandom > "$WORK/raw.key"
+check "efcencode of a large file" "$BIN/efcencode" $KEY -i "$WORK/large" -o "$WORK/large.efc" -y
+check "efcencode with a tree checksum" "$BIN/efcencode" $KEY -checksum tree -i "$WORK/large" -o "$WORK/tree.efc" -y
+check "efcencode for two recipients" "$BIN/efcencode" $KEY -keyfile "$WORK/raw.key" -i "$WORK/large" -o "$WORK/envelope.efc" -y
+expected=$(sha1sum < "$WORK/large" | cut -d " " -f 1)
+"$BIN/efcinfo" --checksum -pass pw "$WORK/large.efc" "$WORK/envelope.efc" > "$WORK/checksums" 2> "$WORK/log"
+status=$?
+if [ $status -eq 0 ] && [ "$(cat "$WORK/checksums")" = "$(printf '%s  %s\n%s  %s' $expected "$WORK/large.efc" $expected "$WORK/envelope.efc")" ]; then
+	pass "efcinfo --checksum prints the checksum of the original file"
+else
+	fail "efcinfo --checksum prints the checksum of the original file (exit status $status)"
+	cat "$WORK/checksums" "$WORK/log"
+fi
+"$BIN/efcinfo" --checksum -keyfile "$WORK/raw.key" "$WORK/envelope.efc" > "$WORK/checksums" 2> /dev/null
+if [ "$(cut -d " " -f 1 "$WORK/checksums")" = "$expected" ]; then
+	pass "efcinfo --checksum works with each recipient's key"
+else
+	fail "efcinfo --checksum works with each recipient's key"
+fi
+
+# Only the start of the container is read, so the rest of it doesn't have to be there
+length=$("$BIN/efcinfo" -format json "$WORK/large.efc" 2> /dev/null | sed -n 's/.*"payload_size":\([0-9]*\).*/\1/p')
+head -c $(($(wc -c < "$WORK/large.efc") - length + 64)) "$WORK/large.efc" > "$WORK/truncated.efc"
+"$BIN/efcinfo" --checksum -pass pw "$WORK/truncated.efc" > "$WORK/checksums" 2> /dev/null
+if [ "$(cut -d " " -f 1 "$WORK/checksums")" = "$expected" ]; then
+	pass "efcinfo --checksum reads only the start of the payload"
+else
+	fail "efcinfo --checksum reads only the start of the payload"
+fi
+
+# A tree checksum isn't the SHA-1 of the whole file, which is noted
+"$BIN/efcinfo" --checksum -pass pw "$WORK/tree.efc" > "$WORK/checksums" 2> "$WORK/log"
+if grep -q "^Note: the checksum of .*tree.efc is the root of a tree checksum" "$WORK/log" && [ "$(cut -d " " -f 1 "$WORK/checksums")" != "$expected" ]; then
+	pass "efcinfo --checksum notes a tree checksum"
+else
+	fail "efcinfo --checksum notes a tree checksum"
+	cat "$WORK/checksums" "$WORK/log"
+fi
+
+# Envelope encryption records whether the key is right, and a key is always needed
+expect_error "efcinfo --checksum with the wrong key" "^Error: the supplied key does not match this file" "$BIN/efcinfo" --checksum -pass other "$WORK/envelope.efc"
+expect_error "efcinfo --checksum without a key" "^Error: --checksum requires a key" "$BIN/efcinfo" --checksum "$WORK/large.efc"
+
+finish
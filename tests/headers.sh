@@ -0,0 +1,96 @@
+#!/bin/sh
+# Checks the container headers: the size of the original file is recorded and restored exactly, the space reserved for
+# the output up front is given back once it has been written, and the binary header's CRC and optional fields are checked.
+# Usage: headers.sh BINDIR
+
+. "$(dirname "$0")/common.sh"
+
+# Reads a numeric field of a container's description from efcinfo
+header_field()
+{
+	"$BIN/efcinfo" -format json "$1" 2> /dev/null | sed -n "s/.*\"$2\":\([0-9]*\).*/\1/p"
+}
+
+i=0
+while [ $i -lt 20000 ]; do
+	echo "line $i of a compressible file"
+	i=$((i + 1))
+done > "$WORK/text"
+head -c 3500000 /dev/urandom > "$WORK/random"
+
+for file in text random; do
+	size=$(wc -c < "$WORK/$file")
+	check "efcencode of the $file file" "$BIN/efcencode" $KEY -i "$WORK/$file" -o "$WORK/$file.efc" -y
+	
+	recorded=$(header_field "$WORK/$file.efc" original_size)
+	if [ "$recorded" = "$size" ]; then
+		pass "the size of the $file file is recorded"
+	else
+		fail "the size of the $file file is recorded (${recorded:-nothing} rather than $size)"
+	fi
+	
+	# The output is preallocated assuming the payload is no larger than the input, and anything not written is given back
+	payload=$(header_field "$WORK/$file.efc" payload_size)
+	length=$(read_integer "$WORK/$file.efc" 4 4)
+	if [ "$(wc -c < "$WORK/$file.efc")" -eq $((length + payload)) ]; then
+		pass "the container of the $file file ends with its payload"
+	else
+		fail "the container of the $file file ends with its payload ($(wc -c < "$WORK/$file.efc") bytes rather than $((length + payload)))"
+	fi
+	
+	# An existing output that is larger than the original is cut back to the original's size
+	head -c 5000000 /dev/zero > "$WORK/output"
+	check "efcdecode of the $file file over a larger file" "$BIN/efcdecode" -pass pw -i "$WORK/$file.efc" -o "$WORK/output" -y
+	expect_same "the $file file is restored at its original size" "$WORK/$file" "$WORK/output"
+done
+
+# Writes a little endian integer of the given number of bytes into a file
+write_integer()
+{
+	value=$3
+	bytes=""
+	for i in $(seq 1 $4); do
+		bytes="$bytes\\$(printf '%03o' $((value % 256)))"
+		value=$((value / 256))
+	done
+	patch_bytes "$1" $2 "$bytes"
+}
+
+# Adds an optional field with no value to the end of a binary header, updating the header and field lengths and the CRC
+add_field()
+{
+	length=$(read_integer "$1" 4 4)
+	fields=$(read_integer "$1" 20 4)
+	head -c $((length - 4)) "$1" > "$2"
+	write_integer "$2" $((length - 4)) $3 2
+	write_integer "$2" $((length - 2)) 0 4
+	head -c 4 /dev/zero >> "$2"
+	tail -c +$((length + 1)) "$1" >> "$2"
+	write_integer "$2" 4 $((length + 6)) 4
+	write_integer "$2" 20 $((fields + 6)) 4
+	reseal_header "$2"
+}
+
+# The binary header is protected by a CRC, so a damaged header is rejected rather than misread
+cp "$WORK/random.efc" "$WORK/damaged.efc"
+patch_bytes "$WORK/damaged.efc" 8 '\377'
+expect_error "efcdecode rejects a damaged header" "^Error: invalid EFC header" "$BIN/efcdecode" -pass pw -i "$WORK/damaged.efc" -o "$WORK/output" -y
+
+# Fields this version doesn't know are skipped, unless they are marked as critical to reading the file
+add_field "$WORK/random.efc" "$WORK/unknown.efc" 256
+check "efcdecode skips an unknown field" "$BIN/efcdecode" -pass pw -i "$WORK/unknown.efc" -o "$WORK/output" -y
+expect_same "a file with an unknown field decrypts to the original" "$WORK/random" "$WORK/output"
+add_field "$WORK/random.efc" "$WORK/critical.efc" $((32768 + 256))
+expect_error "efcdecode rejects an unknown critical field" "^Error: invalid EFC header" "$BIN/efcdecode" -pass pw -i "$WORK/critical.efc" -o "$WORK/output" -y
+
+# The legacy key derivation needs no extra fields, so it is still written with the original header
+check "efcencode -kdf sha256" "$BIN/efcencode" -pass pw -kdf sha256 -i "$WORK/random" -o "$WORK/legacy.efc" -y
+if [ "$(read_integer "$WORK/legacy.efc" 3 1)" = "0" ]; then
+	pass "-kdf sha256 uses the original header"
+else
+	fail "-kdf sha256 uses the original header"
+fi
+check "efcdecode of the original header" "$BIN/efcdecode" -pass pw -i "$WORK/legacy.efc" -o "$WORK/output" -y
+expect_same "the original header decrypts to the original" "$WORK/random" "$WORK/output"
+
+finish
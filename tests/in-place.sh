@@ -0,0 +1,61 @@
+#!/bin/sh
+# Checks in-place conversion: files of every layout are encrypted and decrypted in place back to the original, and a conversion
+# killed part of the way through is finished from its journal by running the same command again.
+# Usage: in-place.sh BINDIR
+
+. "$(dirname "$0")/common.sh"
+
+# Converts a file in place and back, comparing the result with the original. An empty file and files smaller than the header,
+# IV and checksum that are moved to the end of the container (so all of the file is displaced) are converted as well as larger ones.
+for size in 0 1 15 100 1000 4000000; do
+	head -c $size /dev/urandom > "$WORK/original"
+	cp "$WORK/original" "$WORK/file"
+	check "efcencode --in-place of $size bytes" "$BIN/efcencode" $KEY --in-place -i "$WORK/file" -o "$WORK/file.efc" -y
+	if [ -e "$WORK/file" ] || [ -e "$WORK/file.journal" ]; then
+		fail "efcencode --in-place of $size bytes left the original or its journal behind"
+	fi
+	
+	check "efcdecode --in-place of $size bytes" "$BIN/efcdecode" $KEY --in-place -i "$WORK/file.efc" -o "$WORK/file" -y
+	expect_same "in-place round trip of $size bytes" "$WORK/original" "$WORK/file"
+	rm -f "$WORK/file" "$WORK/file.efc"
+done
+
+# Runs a conversion throttled to 1 MB/s and kills it after a second, twice, then lets the same command finish it from the journal.
+convert_with_interruptions()
+{
+	description="$1"
+	journal="$2"
+	shift 2
+	for attempt in 1 2; do
+		"$@" --max-write-rate 1 > "$WORK/log" 2>&1 &
+		pid=$!
+		sleep 1
+		kill -9 $pid 2> /dev/null
+		wait $pid 2> /dev/null
+		if [ ! -e "$journal" ]; then
+			fail "$description (the conversion finished or failed before it was interrupted)"
+			cat "$WORK/log"
+			return
+		fi
+	done
+	
+	"$@" > "$WORK/log" 2>&1
+	status=$?
+	if [ $status -eq 0 ] && grep -q "^Resuming the interrupted" "$WORK/log" && [ ! -e "$journal" ]; then
+		pass "$description"
+	else
+		fail "$description (exit status $status)"
+		cat "$WORK/log"
+	fi
+}
+
+head -c 4000000 /dev/urandom > "$WORK/original"
+cp "$WORK/original" "$WORK/file"
+convert_with_interruptions "efcencode --in-place resumes" "$WORK/file.journal" "$BIN/efcencode" $KEY --in-place -i "$WORK/file" -o "$WORK/file.efc" -y
+check "efcdecode of a resumed encryption" "$BIN/efcdecode" $KEY -i "$WORK/file.efc" -o "$WORK/decoded" -y
+expect_same "resumed encryption decrypts to the original" "$WORK/original" "$WORK/decoded"
+
+convert_with_interruptions "efcdecode --in-place resumes" "$WORK/file.efc.journal" "$BIN/efcdecode" $KEY --in-place -i "$WORK/file.efc" -o "$WORK/file" -y
+expect_same "resumed decryption restores the original" "$WORK/original" "$WORK/file"
+
+finish
@@ -0,0 +1,126 @@
+#!/bin/sh
+# Checks that files round trip through efcencode and efcdecode with each of the I/O options, which select different input
+# and output backends and buffer sizes.
+# Usage: io-options.sh BINDIR
+
+. "$(dirname "$0")/common.sh"
+
+# An empty file, a compressible one, and random data spanning several chunks with a partial one at the end
+: > "$WORK/empty"
+i=0
+while [ $i -lt 20000 ]; do
+	echo "line $i of a compressible file"
+	i=$((i + 1))
+done > "$WORK/text"
+head -c 3500000 /dev/urandom > "$WORK/random"
+
+# Encrypts and decrypts each file with the same options, comparing the result with the original
+round_trip()
+{
+	description="$1"
+	shift
+	for file in empty text random; do
+		"$BIN/efcencode" $KEY "$@" -i "$WORK/$file" -o "$WORK/$file.efc" -y > "$WORK/log" 2>&1 &&
+		"$BIN/efcdecode" -pass pw "$@" -i "$WORK/$file.efc" -o "$WORK/output" -y >> "$WORK/log" 2>&1
+		status=$?
+		if [ $status -eq 0 ] && cmp -s "$WORK/$file" "$WORK/output"; then
+			pass "$description ($file)"
+		else
+			fail "$description ($file, exit status $status)"
+			cat "$WORK/log"
+		fi
+	done
+}
+
+# The input is memory-mapped by default
+round_trip "default options"
+
+# O_DIRECT is used where the filesystem supports it, with aligned buffers and a buffered write for the unaligned tail
+round_trip "--direct-io" --direct-io
+
+# io_uring keeps several reads and writes in flight (builds without liburing fall back to the default engine)
+round_trip "-io-engine uring" -io-engine uring
+round_trip "-io-engine uring --direct-io" -io-engine uring --direct-io
+
+# Reading ahead in large windows and dropping the pages once they have been processed
+round_trip "--drop-cache" --drop-cache
+
+# Flushing each output to disk once it is complete, and also writing it out as it goes
+round_trip "-durability sync" -durability sync
+round_trip "-durability periodic" -durability periodic
+expect_error "an unknown durability mode is refused" "^Invalid durability mode" "$BIN/efcencode" $KEY -durability always -i "$WORK/text" -o "$WORK/text.efc" -y
+expect_error "-durability is refused with --in-place" "always flushed to disk" "$BIN/efcencode" $KEY -durability sync --in-place -i "$WORK/text" -o "$WORK/text.efc" -y
+
+# Batches are written to temporary files that are renamed into place once they have all been flushed
+mkdir "$WORK/batch"
+check "efcencode -durability sync of a batch" "$BIN/efcencode" $KEY -durability sync -i "$WORK/empty" -i "$WORK/text" -o "$WORK/batch" -y
+if [ "$(ls -A "$WORK/batch" | tr '\n' ' ')" = "empty.efc text.efc " ]; then
+	pass "a flushed batch leaves only its outputs"
+else
+	fail "a flushed batch leaves only its outputs ($(ls -A "$WORK/batch" | tr '\n' ' '))"
+fi
+check "efcdecode of a flushed batch" "$BIN/efcdecode" -pass pw -i "$WORK/batch/text.efc" -o "$WORK/output" -y
+expect_same "a flushed batch decrypts to the original" "$WORK/text" "$WORK/output"
+
+# Limiting the rate of reads and writes, and running at idle priority, for background jobs
+round_trip "--max-read-rate 100" --max-read-rate 100
+round_trip "--max-write-rate 100" --max-write-rate 100
+round_trip "--idle" --idle
+
+# Encrypting 3.5 MB at a limit of 1 MB per second takes at least a couple of seconds, whichever way it is limited
+for option in --max-read-rate --max-write-rate; do
+	start=$(date +%s)
+	"$BIN/efcencode" $KEY $option 1 -i "$WORK/random" -o "$WORK/random.efc" -y > /dev/null 2>&1
+	elapsed=$(($(date +%s) - start))
+	if [ $elapsed -ge 2 ]; then
+		pass "$option 1 limits the rate"
+	else
+		fail "$option 1 limits the rate (took $elapsed seconds)"
+	fi
+done
+expect_error "a rate of zero is refused" "^Invalid rate" "$BIN/efcencode" $KEY --max-read-rate 0 -i "$WORK/text" -o "$WORK/text.efc" -y
+
+# Keeping every buffer within a small memory budget
+round_trip "--max-memory 8" --max-memory 8
+round_trip "--max-memory 4" --max-memory 4
+expect_error "a budget below 4 MB is refused" "^Invalid memory limit" "$BIN/efcencode" $KEY --max-memory 2 -i "$WORK/text" -o "$WORK/text.efc" -y
+
+# Decompressed data is streamed to the output, so even 16 MB chunks that compress to almost nothing decrypt in a small
+# address space
+head -c 64000000 /dev/zero > "$WORK/zeros"
+check "efcencode of 64 MB of zeros in 16 MB chunks" "$BIN/efcencode" $KEY -chunk-size 16384 -i "$WORK/zeros" -o "$WORK/zeros.efc" -y
+check "efcdecode of 16 MB chunks limited to 24 MB of address space" sh -c "ulimit -v 24576 && \"\$0\" -pass pw --max-memory 4 -i \"\$1\" -o \"\$2\" -y" "$BIN/efcdecode" "$WORK/zeros.efc" "$WORK/output"
+expect_same "the zeros decrypt to the original" "$WORK/zeros" "$WORK/output"
+rm -f "$WORK/zeros" "$WORK/zeros.efc" "$WORK/output"
+
+# Backing the buffers with huge pages, whether or not the system has any reserved
+round_trip "--huge-pages" --huge-pages
+round_trip "--huge-pages --direct-io" --huge-pages --direct-io
+"$BIN/efcencode" $KEY --huge-pages -i "$WORK/random" -o "$WORK/random.efc" -y > "$WORK/log" 2>&1
+if grep -q "^Buffer arena: [0-9]* MB mapped" "$WORK/log"; then
+	pass "--huge-pages reports the buffer arena"
+else
+	fail "--huge-pages reports the buffer arena"
+	cat "$WORK/log"
+fi
+
+# Reading and transforming in the smallest and largest chunks, which are recorded in the header for decryption
+round_trip "-chunk-size 4" -chunk-size 4
+round_trip "-chunk-size 16384" -chunk-size 16384
+check "efcencode -chunk-size 64" "$BIN/efcencode" $KEY -chunk-size 64 -i "$WORK/random" -o "$WORK/random.efc" -y
+check "efcdecode with another chunk size" "$BIN/efcdecode" -pass pw -chunk-size 1024 -i "$WORK/random.efc" -o "$WORK/output" -y
+expect_same "a file decrypted with another chunk size matches the original" "$WORK/random" "$WORK/output"
+for size in 3 16385 huge; do
+	expect_error "-chunk-size $size is refused" "^Invalid chunk size" "$BIN/efcencode" $KEY -chunk-size $size -i "$WORK/text" -o "$WORK/text.efc" -y
+done
+
+# The automatic chunk size is reported along with how it was chosen
+"$BIN/efcencode" $KEY -i "$WORK/random" -o "$WORK/random.efc" -y > "$WORK/log" 2>&1
+if grep -q "^Chunk size: [0-9]* KB (auto)" "$WORK/log"; then
+	pass "the automatic chunk size is reported"
+else
+	fail "the automatic chunk size is reported"
+	cat "$WORK/log"
+fi
+
+finish
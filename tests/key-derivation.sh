@@ -0,0 +1,20 @@
+#!/bin/sh
+# Checks scrypt key derivation: files encrypted with several lanes decrypt with the same password and not with another,
+# and a file whose parameters need more memory than the limit is refused before anything is derived.
+# Usage: key-derivation.sh BINDIR
+
+. "$(dirname "$0")/common.sh"
+
+head -c 100000 /dev/urandom > "$WORK/input"
+for lanes in 1 2 5; do
+	check "efcencode -kdf-lanes $lanes" "$BIN/efcencode" -pass pw -kdf-cost 12 -kdf-lanes $lanes -i "$WORK/input" -o "$WORK/input.efc" -y
+	check "efcdecode of $lanes lanes" "$BIN/efcdecode" -pass pw -i "$WORK/input.efc" -o "$WORK/output" -y
+	expect_same "round trip with $lanes lanes" "$WORK/input" "$WORK/output"
+	expect_error "efcdecode of $lanes lanes rejects another password" "not match" "$BIN/efcdecode" -pass other -i "$WORK/input.efc" -o "$WORK/output" -y
+done
+
+# The last file needs 5 lanes of 128 * 8 * 2^12 bytes (20 MB), all at once
+expect_error "efcdecode refuses parameters above -kdf-memory" "would require 20 MB" "$BIN/efcdecode" -pass pw -kdf-memory 16 -i "$WORK/input.efc" -o "$WORK/output" -y
+expect_error "efcencode refuses lanes above -kdf-memory" "would require 20 MB" "$BIN/efcencode" -pass pw -kdf-cost 12 -kdf-lanes 5 -kdf-memory 16 -i "$WORK/input" -o "$WORK/input.efc" -y
+
+finish
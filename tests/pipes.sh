@@ -0,0 +1,29 @@
+#!/bin/sh
+# Checks that efcencode and efcdecode can be used as filters, reading from stdin and writing to stdout (in which case the
+# checksum and size are written in a trailer after the payload), and that this can be mixed with files.
+# Usage: pipes.sh BINDIR
+
+. "$(dirname "$0")/common.sh"
+
+for size in 0 15 3500000; do
+	head -c $size /dev/urandom > "$WORK/input"
+	
+	check "efcencode from stdin to stdout ($size bytes)" sh -c "\"$BIN/efcencode\" $KEY -i - < \"$WORK/input\" > \"$WORK/piped.efc\""
+	check "efcdecode from stdin to stdout ($size bytes)" sh -c "\"$BIN/efcdecode\" -pass pw -i - < \"$WORK/piped.efc\" > \"$WORK/output\""
+	expect_same "piped round trip ($size bytes)" "$WORK/input" "$WORK/output"
+	
+	check "efcdecode of a piped container from a file ($size bytes)" "$BIN/efcdecode" -pass pw -i "$WORK/piped.efc" -o "$WORK/output" -y
+	expect_same "piped container decrypts from a file ($size bytes)" "$WORK/input" "$WORK/output"
+	
+	check "efcencode of a file to stdout ($size bytes)" sh -c "\"$BIN/efcencode\" $KEY -i \"$WORK/input\" -o - > \"$WORK/stdout.efc\""
+	check "efcdecode of a file to stdout ($size bytes)" sh -c "\"$BIN/efcdecode\" -pass pw -i \"$WORK/stdout.efc\" -o - > \"$WORK/output\""
+	expect_same "round trip through stdout ($size bytes)" "$WORK/input" "$WORK/output"
+done
+
+# A piped container that was cut short has lost its trailer, so what is left is taken as the trailer and doesn't match
+head -c 1000000 "$WORK/piped.efc" > "$WORK/truncated.efc"
+expect_error "efcdecode of a truncated piped container" "checksums do not match" sh -c "\"$BIN/efcdecode\" -pass pw -i - < \"$WORK/truncated.efc\" > \"$WORK/output\""
+
+expect_error "tree checksums are refused for stdin" "^Tree checksums can't be used" sh -c "\"$BIN/efcencode\" $KEY -checksum tree -i - < \"$WORK/input\" > \"$WORK/piped.efc\""
+
+finish
@@ -0,0 +1,30 @@
+#!/bin/sh
+# Checks containers encrypted for several recipients: each key decrypts the file, another key doesn't, and rekeying one
+# recipient leaves the others able to decrypt it.
+# Usage: recipients.sh BINDIR
+
+. "$(dirname "$0")/common.sh"
+
+head -c 3500000 /dev/urandom > "$WORK/input"
+head -c 32 /dev/urandom > "$WORK/raw.key"
+head -c 1000 /dev/urandom > "$WORK/hashed.key"
+check "efcencode for three recipients" "$BIN/efcencode" $KEY -keyfile "$WORK/raw.key" -hkeyfile "$WORK/hashed.key" -i "$WORK/input" -o "$WORK/input.efc" -y
+
+for key in "-pass pw" "-keyfile $WORK/raw.key" "-hkeyfile $WORK/hashed.key"; do
+	recipient=${key%% *}
+	check "efcdecode with the $recipient recipient" "$BIN/efcdecode" $key -i "$WORK/input.efc" -o "$WORK/output" -y
+	expect_same "the $recipient recipient decrypts to the original" "$WORK/input" "$WORK/output"
+done
+expect_error "efcdecode with another key" "key does not match" "$BIN/efcdecode" -pass other -i "$WORK/input.efc" -o "$WORK/output" -y
+
+# The first key that matches is used, so one that doesn't can come first
+check "efcdecode trying several keys" "$BIN/efcdecode" -pass other -keyfile "$WORK/raw.key" -i "$WORK/input.efc" -o "$WORK/output" -y
+expect_same "the matching key decrypts to the original" "$WORK/input" "$WORK/output"
+
+check "efcrekey of one recipient" "$BIN/efcrekey" -pass pw -newpass new -i "$WORK/input.efc"
+check "efcdecode with the new password" "$BIN/efcdecode" -pass new -i "$WORK/input.efc" -o "$WORK/output" -y
+expect_error "efcdecode with the replaced password" "key does not match" "$BIN/efcdecode" -pass pw -i "$WORK/input.efc" -o "$WORK/output" -y
+check "efcdecode with a recipient that wasn't rekeyed" "$BIN/efcdecode" -keyfile "$WORK/raw.key" -i "$WORK/input.efc" -o "$WORK/output" -y
+expect_same "the other recipient still decrypts to the original" "$WORK/input" "$WORK/output"
+
+finish
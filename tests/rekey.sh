@@ -0,0 +1,71 @@
+#!/bin/sh
+# Checks efcrekey: only the header is rewritten, the file decrypts under the new key but not the old one, a header left
+# half-written by an interrupted rekey is restored from its journal, and a split file is rekeyed through its first volume.
+# Usage: rekey.sh BINDIR
+
+. "$(dirname "$0")/common.sh"
+
+OLD="-pass old -kdf-cost 10"
+NEW="-newpass new"
+
+# Checks that everything after the header of two containers is the same
+expect_same_payload()
+{
+	length=$(read_integer "$2" 4 4)
+	tail -c +$((length + 1)) "$2" > "$WORK/payload.before"
+	tail -c +$((length + 1)) "$3" > "$WORK/payload.after"
+	expect_same "$1" "$WORK/payload.before" "$WORK/payload.after"
+}
+
+head -c 3000000 /dev/urandom > "$WORK/input"
+check "efcencode -envelope" "$BIN/efcencode" $OLD -envelope -i "$WORK/input" -o "$WORK/input.efc" -y
+cp "$WORK/input.efc" "$WORK/original.efc"
+
+check "efcrekey" "$BIN/efcrekey" $OLD $NEW -i "$WORK/input.efc"
+expect_same_payload "efcrekey leaves the payload untouched" "$WORK/original.efc" "$WORK/input.efc"
+expect_different "efcrekey rewrites the header" "$WORK/original.efc" "$WORK/input.efc"
+if [ -e "$WORK/input.efc.header-journal" ]; then
+	fail "efcrekey left its journal behind"
+fi
+
+check "efcdecode with the new key" "$BIN/efcdecode" -pass new -i "$WORK/input.efc" -o "$WORK/output" -y
+expect_same "rekeyed file decrypts to the original" "$WORK/input" "$WORK/output"
+expect_error "efcdecode rejects the old key" "key does not match" "$BIN/efcdecode" -pass old -i "$WORK/input.efc" -o "$WORK/output" -y
+expect_error "efcrekey rejects the old key" "key does not match" "$BIN/efcrekey" $OLD -newpass other -i "$WORK/input.efc"
+
+# An interrupted rekey leaves the original header in the journal ("EFCH", the header, and the CRC-32 of both), with the header in the
+# file only partly written. Running efcrekey again puts the original back before rekeying it.
+cp "$WORK/original.efc" "$WORK/input.efc"
+length=$(read_integer "$WORK/input.efc" 4 4)
+printf 'EFCH' > "$WORK/journal"
+head -c $length "$WORK/input.efc" >> "$WORK/journal"
+gzip -c "$WORK/journal" | tail -c 8 | head -c 4 >> "$WORK/journal"
+cp "$WORK/journal" "$WORK/input.efc.header-journal"
+patch_bytes "$WORK/input.efc" 40 '\377\377\377\377\377\377\377\377'
+
+expect_error "efcdecode refuses a file whose rekeying was interrupted" "was being rekeyed" "$BIN/efcdecode" -pass old -i "$WORK/input.efc" -o "$WORK/output" -y
+check "efcrekey after an interrupted rekey" "$BIN/efcrekey" $OLD $NEW -i "$WORK/input.efc"
+if grep -q "^Restored the original header" "$WORK/log"; then
+	pass "efcrekey restores the header from the journal"
+else
+	fail "efcrekey restores the header from the journal"
+fi
+expect_same_payload "recovered file has the original payload" "$WORK/original.efc" "$WORK/input.efc"
+check "efcdecode of a recovered file with the new key" "$BIN/efcdecode" -pass new -i "$WORK/input.efc" -o "$WORK/output" -y
+expect_same "recovered file decrypts to the original" "$WORK/input" "$WORK/output"
+
+# A journal that was never completed means the file wasn't touched, so it is just removed
+cp "$WORK/original.efc" "$WORK/input.efc"
+head -c 20 "$WORK/journal" > "$WORK/input.efc.header-journal"
+check "efcrekey after a rekey interrupted while journalling" "$BIN/efcrekey" $OLD $NEW -i "$WORK/input.efc"
+check "efcdecode after a rekey interrupted while journalling" "$BIN/efcdecode" -pass new -i "$WORK/input.efc" -o "$WORK/output" -y
+
+# The header of a split file is in its first volume, which is found from the name of the container
+check "efcencode -envelope -split" "$BIN/efcencode" $OLD -envelope -split 1 -i "$WORK/input" -o "$WORK/split.efc" -y
+cp "$WORK/split.efc.001" "$WORK/second.before"
+check "efcrekey of a split file" "$BIN/efcrekey" $OLD $NEW -i "$WORK/split.efc"
+expect_same "efcrekey leaves the other volumes untouched" "$WORK/second.before" "$WORK/split.efc.001"
+check "efcdecode of a rekeyed split file" "$BIN/efcdecode" -pass new -i "$WORK/split.efc" -o "$WORK/output" -y
+expect_same "rekeyed split file decrypts to the original" "$WORK/input" "$WORK/output"
+
+finish
@@ -0,0 +1,43 @@
+#!/bin/sh
+# Checks --sparse: only the data extents of a sparse file are stored, and decrypting recreates the file with its holes.
+# Usage: sparse.sh BINDIR
+
+. "$(dirname "$0")/common.sh"
+
+# A 20 MB file with two extents of data, one that is a single hole, and one that has no holes
+truncate -s 20M "$WORK/sparse"
+head -c 100000 /dev/urandom | dd of="$WORK/sparse" bs=1M seek=5 conv=notrunc 2> /dev/null
+head -c 100000 /dev/urandom | dd of="$WORK/sparse" bs=1M seek=15 conv=notrunc 2> /dev/null
+truncate -s 5M "$WORK/hole"
+head -c 3500000 /dev/urandom > "$WORK/dense"
+
+# The holes can only be found where the filesystem keeps them
+holes=$([ "$(du -k "$WORK/sparse" | cut -f 1)" -lt 10240 ] && echo yes)
+
+for file in sparse hole dense; do
+	for checksum in sha1 tree; do
+		check "efcencode --sparse of the $file file ($checksum)" "$BIN/efcencode" $KEY --sparse -checksum $checksum -i "$WORK/$file" -o "$WORK/$file.efc" -y
+		check "efcdecode of the $file file ($checksum)" "$BIN/efcdecode" -pass pw -i "$WORK/$file.efc" -o "$WORK/output" -y
+		expect_same "sparse round trip of the $file file ($checksum)" "$WORK/$file" "$WORK/output"
+	done
+done
+
+if [ -n "$holes" ]; then
+	check "efcencode --sparse" "$BIN/efcencode" $KEY --sparse -i "$WORK/sparse" -o "$WORK/sparse.efc" -y
+	if [ "$(wc -c < "$WORK/sparse.efc")" -lt 1048576 ]; then
+		pass "only the data extents are stored"
+	else
+		fail "only the data extents are stored ($(wc -c < "$WORK/sparse.efc") bytes)"
+	fi
+	
+	check "efcdecode of a sparse file" "$BIN/efcdecode" -pass pw -i "$WORK/sparse.efc" -o "$WORK/output" -y
+	if [ "$(du -k "$WORK/output" | cut -f 1)" -lt 10240 ]; then
+		pass "decrypting recreates the holes"
+	else
+		fail "decrypting recreates the holes ($(du -k "$WORK/output" | cut -f 1) KB allocated)"
+	fi
+else
+	echo "skipped: the filesystem of $WORK doesn't keep holes"
+fi
+
+finish
@@ -0,0 +1,53 @@
+#!/bin/sh
+# Checks that -split writes full volumes in turn to the output directory and each -volume-dir, that they decrypt when found
+# through the same directories, and that a missing or truncated volume is reported as an error.
+# Usage: split.sh BINDIR
+
+. "$(dirname "$0")/common.sh"
+
+# Checks the size of a volume
+expect_size()
+{
+	size=$(wc -c < "$2" 2> /dev/null)
+	if [ "$size" = "$3" ]; then
+		pass "$1"
+	else
+		fail "$1 ($2 is ${size:-missing} bytes rather than $3)"
+	fi
+}
+
+VOLUMES="-volume-dir $WORK/second -volume-dir $WORK/third"
+mkdir "$WORK/first" "$WORK/second" "$WORK/third"
+
+# Three and a half volumes of 1 MB, so the last one is partial
+head -c 3500000 /dev/urandom > "$WORK/input"
+check "efcencode -split" "$BIN/efcencode" $KEY -split 1 $VOLUMES -i "$WORK/input" -o "$WORK/first/split.efc" -y
+expect_size "volume 000 is full, in the output directory" "$WORK/first/split.efc.000" 1048576
+expect_size "volume 001 is full, in the second directory" "$WORK/second/split.efc.001" 1048576
+expect_size "volume 002 is full, in the third directory" "$WORK/third/split.efc.002" 1048576
+
+# The last volume holds the rest of the container, which is the input plus the header, IV and checksum (the random input doesn't compress)
+last=$(wc -c < "$WORK/first/split.efc.003" 2> /dev/null)
+if [ -n "$last" ] && [ $((3 * 1048576 + last)) -gt 3500000 ] && [ "$last" -le 1048576 ]; then
+	pass "volume 003 holds the rest, in the output directory"
+else
+	fail "volume 003 holds the rest, in the output directory (${last:-missing} bytes)"
+fi
+if ls "$WORK"/*/split.efc.004 > /dev/null 2>&1; then
+	fail "efcencode -split wrote more volumes than it needed"
+fi
+
+check "efcdecode of the volumes" "$BIN/efcdecode" -pass pw $VOLUMES -i "$WORK/first/split.efc" -o "$WORK/output" -y
+expect_same "volumes decrypt to the original" "$WORK/input" "$WORK/output"
+check "efcdecode of the volumes by the name of the first" "$BIN/efcdecode" -pass pw $VOLUMES -i "$WORK/first/split.efc.000" -o "$WORK/output" -y
+expect_same "volumes named by the first decrypt to the original" "$WORK/input" "$WORK/output"
+
+expect_error "efcdecode without the other directories" "^Could not find volume .*split.efc.001" "$BIN/efcdecode" -pass pw -i "$WORK/first/split.efc" -o "$WORK/output" -y
+
+mv "$WORK/third/split.efc.002" "$WORK/volume"
+expect_error "efcdecode with a missing volume" "^Could not find volume .*split.efc.002" "$BIN/efcdecode" -pass pw $VOLUMES -i "$WORK/first/split.efc" -o "$WORK/output" -y
+
+head -c 1000000 "$WORK/volume" > "$WORK/third/split.efc.002"
+expect_error "efcdecode with a truncated volume" "^Could not find volume .*split.efc.002" "$BIN/efcdecode" -pass pw $VOLUMES -i "$WORK/first/split.efc" -o "$WORK/output" -y
+
+finish
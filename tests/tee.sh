@@ -0,0 +1,28 @@
+#!/bin/sh
+# Checks that each copy written with several -o options is identical and decrypts, and that a copy that can't be written
+# makes efcencode fail.
+# Usage: tee.sh BINDIR
+
+. "$(dirname "$0")/common.sh"
+
+head -c 3000000 /dev/urandom > "$WORK/input"
+check "efcencode with copies" "$BIN/efcencode" $KEY -i "$WORK/input" -o "$WORK/first.efc" -o "$WORK/second.efc" -o "$WORK/third.efc" -y
+for copy in second third; do
+	expect_same "the $copy copy is identical" "$WORK/first.efc" "$WORK/$copy.efc"
+done
+for copy in first second third; do
+	check "efcdecode of the $copy copy" "$BIN/efcdecode" -pass pw -i "$WORK/$copy.efc" -o "$WORK/output" -y
+	expect_same "the $copy copy decrypts to the original" "$WORK/input" "$WORK/output"
+done
+
+expect_error "efcencode with a copy in a missing directory" "^Error: could not open output file" "$BIN/efcencode" $KEY -i "$WORK/input" -o "$WORK/first.efc" -o "$WORK/missing/second.efc" -y
+
+# Permissions don't stop root from writing, so the read-only directory is only tried by other users
+if [ "$(id -u)" -ne 0 ]; then
+	mkdir "$WORK/readonly"
+	chmod 555 "$WORK/readonly"
+	expect_error "efcencode with a copy in a read-only directory" "^Error: could not open output file" "$BIN/efcencode" $KEY -i "$WORK/input" -o "$WORK/first.efc" -o "$WORK/readonly/second.efc" -y
+	chmod 755 "$WORK/readonly"
+fi
+
+finish
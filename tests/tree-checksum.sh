@@ -0,0 +1,45 @@
+#!/bin/sh
+# Checks tree checksums: files spanning several chunks round trip, a damaged chunk is named by efcdecode,
+# and a header whose chunk count doesn't match the size of the file is rejected.
+# Usage: tree-checksum.sh BINDIR
+
+. "$(dirname "$0")/common.sh"
+
+# Three and a half chunks of 1 MB, so the last chunk is partial
+head -c 3500000 /dev/urandom > "$WORK/input"
+check "efcencode -checksum tree" "$BIN/efcencode" $KEY -checksum tree -threads 3 -i "$WORK/input" -o "$WORK/input.efc" -y
+check "efcdecode of a tree checksum" "$BIN/efcdecode" $KEY -i "$WORK/input.efc" -o "$WORK/output" -y
+expect_same "tree checksum round trip" "$WORK/input" "$WORK/output"
+
+# Random data is stored by zlib almost unchanged, so damaging the ciphertext 1.6 MB in only damages the plaintext of the second chunk
+cp "$WORK/input.efc" "$WORK/damaged.efc"
+patch_bytes "$WORK/damaged.efc" 1600000 '\377'
+expect_error "efcdecode names the damaged chunk" "^Damaged chunk 1 (bytes 1048576 to 2097151)" "$BIN/efcdecode" $KEY -i "$WORK/damaged.efc" -o "$WORK/output" -y
+if grep -q "^Damaged chunk [023]" "$WORK/log"; then
+	fail "efcdecode names only the damaged chunk"
+	cat "$WORK/log"
+fi
+
+# The tree checksum field comes first, after the fixed part of the header and the extension: the tag, the length, the chunk size and then the count
+fields=$((24 + $(read_integer "$WORK/input.efc" 18 2)))
+if [ "$(read_integer "$WORK/input.efc" $fields 2)" != "32769" ] || [ "$(read_integer "$WORK/input.efc" $((fields + 10)) 8)" != "4" ]; then
+	fail "the tree checksum field was not found where expected"
+	finish
+fi
+
+# Rewriting the same count (and recomputing the header's CRC) leaves a valid file, so the patch itself is sound
+cp "$WORK/input.efc" "$WORK/count.efc"
+patch_bytes "$WORK/count.efc" $((fields + 10)) '\004'
+reseal_header "$WORK/count.efc"
+check "efcdecode of a resealed header" "$BIN/efcdecode" $KEY -i "$WORK/count.efc" -o "$WORK/output" -y
+
+# A count one off either way disagrees with the size of the file, and a huge one couldn't fit in the payload
+for patch in "0 \\003 3" "0 \\005 5" "7 \\001 2^56+4"; do
+	set -- $patch
+	cp "$WORK/input.efc" "$WORK/count.efc"
+	patch_bytes "$WORK/count.efc" $((fields + 10 + $1)) "$2"
+	reseal_header "$WORK/count.efc"
+	expect_error "efcdecode rejects a chunk count of $3" "^Error: invalid EFC header" "$BIN/efcdecode" $KEY -i "$WORK/count.efc" -o "$WORK/output" -y
+done
+
+finish
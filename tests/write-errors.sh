@@ -0,0 +1,56 @@
+#!/bin/sh
+# Checks that the tools report a failed write (such as a full disk) as an error, rather than crashing.
+# Every output backend is tried by writing to /dev/full, which fails every write with ENOSPC.
+# Usage: write-errors.sh BINDIR
+
+BIN="${1:-./build/bin}"
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+if [ ! -c /dev/full ]; then
+	echo "skipped: /dev/full is not available"
+	exit 0
+fi
+
+failures=0
+
+# Runs a tool, expecting it to exit with status 1 and report that its output could not be written
+expect_error()
+{
+	description="$1"
+	shift
+	"$@" > /dev/null 2> "$WORK/log"
+	status=$?
+	if [ $status -eq 1 ] && grep -q "^Error: .*[Ww]rit" "$WORK/log"; then
+		echo "ok $description"
+	else
+		echo "FAILED $description (exit status $status)"
+		cat "$WORK/log"
+		failures=$((failures + 1))
+	fi
+}
+
+head -c 3000000 /dev/urandom > "$WORK/input.bin"
+"$BIN/efcencode" -pass pw -i "$WORK/input.bin" -o "$WORK/input.efc" -y > /dev/null 2>&1
+
+for options in "" "--drop-cache" "--direct-io" "-durability sync" "-io-engine uring"; do
+	expect_error "efcencode $options" "$BIN/efcencode" -pass pw -i "$WORK/input.bin" -o /dev/full -y $options
+	expect_error "efcdecode $options" "$BIN/efcdecode" -pass pw -i "$WORK/input.efc" -o /dev/full -y $options
+done
+
+expect_error "efcencode with a copy" "$BIN/efcencode" -pass pw -i "$WORK/input.bin" -o "$WORK/copy.efc" -o /dev/full -y
+expect_error "efcencode to stdout" sh -c "\"$BIN/efcencode\" -pass pw -i \"$WORK/input.bin\" -o - -y > /dev/full"
+expect_error "efcdecode to stdout" sh -c "\"$BIN/efcdecode\" -pass pw -i \"$WORK/input.efc\" -o - -y > /dev/full"
+
+# A batch writes the other files even if one of them fails
+mkdir "$WORK/batch"
+echo first > "$WORK/first"
+echo second > "$WORK/second"
+ln -s /dev/full "$WORK/batch/first.efc"
+expect_error "efcencode batch" "$BIN/efcencode" -pass pw -i "$WORK/first" -i "$WORK/second" -o "$WORK/batch" -y
+if [ ! -s "$WORK/batch/second.efc" ]; then
+	echo "FAILED efcencode batch (the other file was not written)"
+	failures=$((failures + 1))
+fi
+
+exit $failures